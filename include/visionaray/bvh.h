@@ -141,21 +141,251 @@ inline bool operator==(bvh_node const& a, bvh_node const& b)
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// wide_bvh_node
+//
+// Node of a BVH with branching factor W, stored as SoA so that the bounding boxes
+// of all children can be tested against a ray with a single W-wide SIMD slab test
+// Child slot i is either an inner node (num_prims[i] == 0), a leaf with num_prims[i]
+// primitives starting at index[i], or empty (index[i] == ~0U). Valid children are
+// stored contiguously in the first slots
+//
+
+template <unsigned W>
+struct VSNRAY_ALIGN(32) wide_bvh_node
+{
+    enum { Width = W };
+
+    float bbox_min_x[W];
+    float bbox_min_y[W];
+    float bbox_min_z[W];
+    float bbox_max_x[W];
+    float bbox_max_y[W];
+    float bbox_max_z[W];
+    unsigned index[W];
+    unsigned num_prims[W];
+
+    VSNRAY_FUNC bool is_empty(unsigned i) const { return num_prims[i] == 0 && index[i] == ~0U; }
+    VSNRAY_FUNC bool is_inner(unsigned i) const { return num_prims[i] == 0 && index[i] != ~0U; }
+    VSNRAY_FUNC bool is_leaf(unsigned i) const { return num_prims[i] != 0; }
+
+    VSNRAY_FUNC unsigned num_children() const
+    {
+        unsigned n = 0;
+        while (n < W && !is_empty(n))
+        {
+            ++n;
+        }
+        return n;
+    }
+
+    VSNRAY_FUNC aabb get_child_bounds(unsigned i) const
+    {
+        return aabb(
+                vec3(bbox_min_x[i], bbox_min_y[i], bbox_min_z[i]),
+                vec3(bbox_max_x[i], bbox_max_y[i], bbox_max_z[i])
+                );
+    }
+
+    VSNRAY_FUNC aabb get_bounds() const
+    {
+        aabb result;
+        result.invalidate();
+
+        for (unsigned i = 0; i < W && !is_empty(i); ++i)
+        {
+            result.insert(get_child_bounds(i));
+        }
+
+        return result;
+    }
+
+    VSNRAY_FUNC unsigned get_child(unsigned i) const
+    {
+        assert(is_inner(i));
+        return index[i];
+    }
+
+    VSNRAY_FUNC bvh_node::index_range get_indices(unsigned i) const
+    {
+        assert(is_leaf(i));
+        return { index[i], index[i] + num_prims[i] };
+    }
+
+    VSNRAY_FUNC void set_inner(unsigned i, aabb const& bounds, unsigned child_index)
+    {
+        set_bounds(i, bounds);
+        index[i] = child_index;
+        num_prims[i] = 0;
+    }
+
+    VSNRAY_FUNC void set_leaf(unsigned i, aabb const& bounds, unsigned first_primitive_index, unsigned count)
+    {
+        assert(count > 0);
+
+        set_bounds(i, bounds);
+        index[i] = first_primitive_index;
+        num_prims[i] = count;
+    }
+
+    VSNRAY_FUNC void set_empty(unsigned i)
+    {
+        aabb bounds;
+        bounds.invalidate();
+        set_bounds(i, bounds);
+        index[i] = ~0U;
+        num_prims[i] = 0;
+    }
+
+private:
+
+    VSNRAY_FUNC void set_bounds(unsigned i, aabb const& bounds)
+    {
+        bbox_min_x[i] = bounds.min.x;
+        bbox_min_y[i] = bounds.min.y;
+        bbox_min_z[i] = bounds.min.z;
+        bbox_max_x[i] = bounds.max.x;
+        bbox_max_y[i] = bounds.max.y;
+        bbox_max_z[i] = bounds.max.z;
+    }
+};
+
+using bvh_node4 = wide_bvh_node<4>;
+using bvh_node8 = wide_bvh_node<8>;
+
+static_assert( sizeof(bvh_node4) == 128, "Size mismatch" );
+static_assert( sizeof(bvh_node8) == 256, "Size mismatch" );
+
+
+//--------------------------------------------------------------------------------------------------
+// compressed_bvh_node
+//
+// Wide BVH node with child bounds quantized to 8 bits (Q = unsigned char) or 16 bits
+// (Q = unsigned short) relative to the bounds of the node. The quantization grid
+// starts at origin and has a power of two spacing per axis, so that decoding
+// (origin + q * 2^exponent) is exact up to a single rounding. Quantized boxes are
+// conservative, they always contain the original child boxes.
+// num_prims[i] is 0 for inner children and EmptySlot for empty slots
+//
+
+template <unsigned W, typename Q>
+struct VSNRAY_ALIGN(16) compressed_bvh_node
+{
+    enum { Width = W };
+    enum { EmptySlot = 0xFFFF };
+    enum { MaxQ = (1 << (8 * sizeof(Q))) - 1 };
+
+    float origin[3];
+    signed char exponent[3];
+    unsigned char padding;
+    Q qmin_x[W];
+    Q qmin_y[W];
+    Q qmin_z[W];
+    Q qmax_x[W];
+    Q qmax_y[W];
+    Q qmax_z[W];
+    unsigned index[W];
+    unsigned short num_prims[W];
+
+    VSNRAY_FUNC bool is_empty(unsigned i) const { return num_prims[i] == EmptySlot; }
+    VSNRAY_FUNC bool is_inner(unsigned i) const { return num_prims[i] == 0; }
+    VSNRAY_FUNC bool is_leaf(unsigned i) const { return num_prims[i] != 0 && num_prims[i] != EmptySlot; }
+
+    VSNRAY_FUNC unsigned num_children() const
+    {
+        unsigned n = 0;
+        while (n < W && !is_empty(n))
+        {
+            ++n;
+        }
+        return n;
+    }
+
+    // Grid spacing along axis (2^exponent)
+    VSNRAY_FUNC float scale(int axis) const
+    {
+        unsigned bits = static_cast<unsigned>(exponent[axis] + 127) << 23;
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    VSNRAY_FUNC aabb get_child_bounds(unsigned i) const
+    {
+        vec3 o(origin[0], origin[1], origin[2]);
+        vec3 s(scale(0), scale(1), scale(2));
+
+        vec3 qmin(static_cast<float>(qmin_x[i]), static_cast<float>(qmin_y[i]), static_cast<float>(qmin_z[i]));
+        vec3 qmax(static_cast<float>(qmax_x[i]), static_cast<float>(qmax_y[i]), static_cast<float>(qmax_z[i]));
+
+        return aabb(o + qmin * s, o + qmax * s);
+    }
+
+    VSNRAY_FUNC aabb get_bounds() const
+    {
+        aabb result;
+        result.invalidate();
+
+        for (unsigned i = 0; i < W && !is_empty(i); ++i)
+        {
+            result.insert(get_child_bounds(i));
+        }
+
+        return result;
+    }
+
+    VSNRAY_FUNC unsigned get_child(unsigned i) const
+    {
+        assert(is_inner(i));
+        return index[i];
+    }
+
+    VSNRAY_FUNC bvh_node::index_range get_indices(unsigned i) const
+    {
+        assert(is_leaf(i));
+        return { index[i], index[i] + num_prims[i] };
+    }
+};
+
+using compressed_bvh_node4 = compressed_bvh_node<4, unsigned char>;
+using compressed_bvh_node8 = compressed_bvh_node<8, unsigned char>;
+
+static_assert( sizeof(compressed_bvh_node4) == 64, "Size mismatch" );
+static_assert( sizeof(compressed_bvh_node8) == 112, "Size mismatch" );
+static_assert( sizeof(compressed_bvh_node<8, unsigned short>) == 160, "Size mismatch" );
+
+template <typename T>
+struct is_compressed_bvh_node : std::false_type {};
+
+template <unsigned W, typename Q>
+struct is_compressed_bvh_node<compressed_bvh_node<W, Q>> : std::true_type {};
+
+template <typename T>
+struct is_wide_bvh_node : std::false_type {};
+
+template <unsigned W>
+struct is_wide_bvh_node<wide_bvh_node<W>> : std::true_type {};
+
+template <unsigned W, typename Q>
+struct is_wide_bvh_node<compressed_bvh_node<W, Q>> : std::true_type {};
+
+
 //--------------------------------------------------------------------------------------------------
 // [index_]bvh_ref_t
 //
 
-template <typename PrimitiveType>
+template <typename PrimitiveType, typename Node = bvh_node>
 class bvh_ref_t
 {
 public:
 
     using primitive_type = PrimitiveType;
+    using node_type      = Node;
 
 private:
 
     using P = const PrimitiveType;
-    using N = const bvh_node;
+    using N = const Node;
 
     P* primitives_first;
     P* primitives_last;
@@ -196,17 +426,18 @@ public:
     }
 };
 
-template <typename PrimitiveType>
+template <typename PrimitiveType, typename Node = bvh_node>
 class index_bvh_ref_t
 {
 public:
 
     using primitive_type = PrimitiveType;
+    using node_type      = Node;
 
 private:
 
     using P = const PrimitiveType;
-    using N = const bvh_node;
+    using N = const Node;
     using I = const unsigned;
 
     P* primitives_first;
@@ -260,23 +491,24 @@ public:
 // [index_]bvh_inst_t
 //
 
-template <typename PrimitiveType>
+template <typename PrimitiveType, typename Node = bvh_node>
 class bvh_inst_t
 {
 public:
 
     using primitive_type = PrimitiveType;
+    using node_type      = Node;
 
 private:
 
     using P = const PrimitiveType;
-    using N = const bvh_node;
+    using N = const Node;
 
 public:
 
     bvh_inst_t() = default;
 
-    bvh_inst_t(bvh_ref_t<PrimitiveType> const& ref, mat4 const& transform)
+    bvh_inst_t(bvh_ref_t<PrimitiveType, Node> const& ref, mat4 const& transform)
         : ref_(ref)
         , transform_inv_(inverse(transform))
     {
@@ -302,7 +534,7 @@ public:
         return ref_.node(index);
     }
 
-    VSNRAY_FUNC bvh_ref_t<PrimitiveType> get_ref() const
+    VSNRAY_FUNC bvh_ref_t<PrimitiveType, Node> get_ref() const
     {
         return ref_;
     }
@@ -320,30 +552,31 @@ public:
 private:
 
     // BVH ref
-    bvh_ref_t<PrimitiveType> ref_;
+    bvh_ref_t<PrimitiveType, Node> ref_;
 
     // Inverse transformation matrix
     mat4 transform_inv_;
 
 };
 
-template <typename PrimitiveType>
+template <typename PrimitiveType, typename Node = bvh_node>
 class index_bvh_inst_t
 {
 public:
 
     using primitive_type = PrimitiveType;
+    using node_type      = Node;
 
 private:
 
     using P = const PrimitiveType;
-    using N = const bvh_node;
+    using N = const Node;
 
 public:
 
     index_bvh_inst_t() = default;
 
-    index_bvh_inst_t(index_bvh_ref_t<PrimitiveType> const& ref, mat4 const& transform)
+    index_bvh_inst_t(index_bvh_ref_t<PrimitiveType, Node> const& ref, mat4 const& transform)
         : ref_(ref)
         , transform_inv_(inverse(transform))
     {
@@ -374,7 +607,7 @@ public:
         return ref_.node(index);
     }
 
-    VSNRAY_FUNC index_bvh_ref_t<PrimitiveType> get_ref() const
+    VSNRAY_FUNC index_bvh_ref_t<PrimitiveType, Node> get_ref() const
     {
         return ref_;
     }
@@ -392,7 +625,7 @@ public:
 private:
 
     // BVH ref
-    index_bvh_ref_t<PrimitiveType> ref_;
+    index_bvh_ref_t<PrimitiveType, Node> ref_;
 
     // Inverse transformation matrix
     mat4 transform_inv_;
@@ -414,8 +647,8 @@ public:
     using node_type         = typename NodeVector::value_type;
     using node_vector       = NodeVector;
 
-    using bvh_ref  = bvh_ref_t<primitive_type>;
-    using bvh_inst = bvh_inst_t<primitive_type>;
+    using bvh_ref  = bvh_ref_t<primitive_type, node_type>;
+    using bvh_inst = bvh_inst_t<primitive_type, node_type>;
 
 public:
 
@@ -494,8 +727,8 @@ public:
     using node_vector       = NodeVector;
     using index_vector      = IndexVector;
 
-    using bvh_ref  = index_bvh_ref_t<primitive_type>;
-    using bvh_inst = index_bvh_inst_t<primitive_type>;
+    using bvh_ref  = index_bvh_ref_t<primitive_type, node_type>;
+    using bvh_inst = index_bvh_inst_t<primitive_type, node_type>;
 
 public:
 
@@ -639,11 +872,11 @@ struct is_bvh : std::false_type {};
 template <typename T1, typename T2>
 struct is_bvh<bvh_t<T1, T2>> : std::true_type {};
 
-template <typename T>
-struct is_bvh<bvh_ref_t<T>> : std::true_type {};
+template <typename T, typename N>
+struct is_bvh<bvh_ref_t<T, N>> : std::true_type {};
 
-template <typename T>
-struct is_bvh<bvh_inst_t<T>> : std::true_type {};
+template <typename T, typename N>
+struct is_bvh<bvh_inst_t<T, N>> : std::true_type {};
 
 template <typename T>
 struct is_index_bvh : std::false_type {};
@@ -651,11 +884,11 @@ struct is_index_bvh : std::false_type {};
 template <typename T1, typename T2, typename T3>
 struct is_index_bvh<index_bvh_t<T1, T2, T3>> : std::true_type {};
 
-template <typename T>
-struct is_index_bvh<index_bvh_ref_t<T>> : std::true_type {};
+template <typename T, typename N>
+struct is_index_bvh<index_bvh_ref_t<T, N>> : std::true_type {};
 
-template <typename T>
-struct is_index_bvh<index_bvh_inst_t<T>> : std::true_type {};
+template <typename T, typename N>
+struct is_index_bvh<index_bvh_inst_t<T, N>> : std::true_type {};
 
 template <typename T>
 struct is_any_bvh : std::integral_constant<bool, is_bvh<T>::value || is_index_bvh<T>::value>
@@ -666,20 +899,29 @@ struct is_any_bvh : std::integral_constant<bool, is_bvh<T>::value || is_index_bv
 template <typename T>
 struct is_bvh_inst : std::false_type {};
 
-template <typename T>
-struct is_bvh_inst<bvh_inst_t<T>> : std::true_type {};
+template <typename T, typename N>
+struct is_bvh_inst<bvh_inst_t<T, N>> : std::true_type {};
 
 template <typename T>
 struct is_index_bvh_inst : std::false_type {};
 
-template <typename T>
-struct is_index_bvh_inst<index_bvh_inst_t<T>> : std::true_type {};
+template <typename T, typename N>
+struct is_index_bvh_inst<index_bvh_inst_t<T, N>> : std::true_type {};
 
 template <typename T>
 struct is_any_bvh_inst : std::integral_constant<bool, is_bvh_inst<T>::value || is_index_bvh_inst<T>::value>
 {
 };
 
+template <typename T, typename = void>
+struct is_wide_bvh : std::false_type {};
+
+template <typename T>
+struct is_wide_bvh<T, typename std::enable_if<is_any_bvh<T>::value>::type>
+    : is_wide_bvh_node<typename T::node_type>
+{
+};
+
 
 //-------------------------------------------------------------------------------------------------
 // Typedefs
@@ -690,6 +932,24 @@ using bvh               = bvh_t<aligned_vector<P>, aligned_vector<bvh_node, 32>>
 template <typename P>
 using index_bvh         = index_bvh_t<aligned_vector<P>, aligned_vector<bvh_node, 32>, aligned_vector<unsigned>>;
 
+template <typename P>
+using bvh4              = bvh_t<aligned_vector<P>, aligned_vector<bvh_node4, 32>>;
+template <typename P>
+using bvh8              = bvh_t<aligned_vector<P>, aligned_vector<bvh_node8, 32>>;
+template <typename P>
+using index_bvh4        = index_bvh_t<aligned_vector<P>, aligned_vector<bvh_node4, 32>, aligned_vector<unsigned>>;
+template <typename P>
+using index_bvh8        = index_bvh_t<aligned_vector<P>, aligned_vector<bvh_node8, 32>, aligned_vector<unsigned>>;
+
+template <typename P>
+using compressed_bvh4       = bvh_t<aligned_vector<P>, aligned_vector<compressed_bvh_node4, 16>>;
+template <typename P>
+using compressed_bvh8       = bvh_t<aligned_vector<P>, aligned_vector<compressed_bvh_node8, 16>>;
+template <typename P>
+using index_compressed_bvh4 = index_bvh_t<aligned_vector<P>, aligned_vector<compressed_bvh_node4, 16>, aligned_vector<unsigned>>;
+template <typename P>
+using index_compressed_bvh8 = index_bvh_t<aligned_vector<P>, aligned_vector<compressed_bvh_node8, 16>, aligned_vector<unsigned>>;
+
 #ifdef __CUDACC__
 template <typename P>
 using cuda_bvh          = bvh_t<thrust::device_vector<P>, thrust::device_vector<bvh_node>>;
@@ -715,6 +975,7 @@ void traverse_parents(B const& b, N const& n, F func);
 
 } // visionaray
 
+#include "detail/bvh/collapse.h"
 #include "detail/bvh/get_bounds.inl"
 #include "detail/bvh/get_color.h"
 #include "detail/bvh/get_normal.h"
@@ -722,9 +983,12 @@ void traverse_parents(B const& b, N const& n, F func);
 #include "detail/bvh/hit_record.h"
 #include "detail/bvh/intersect.inl"
 #include "detail/bvh/lbvh.h"
+#include "detail/bvh/pack_leaves.h"
 #include "detail/bvh/prim_traits.h"
+#include "detail/bvh/refit.h"
 #include "detail/bvh/sah.h"
 #include "detail/bvh/statistics.h"
+#include "detail/bvh/top_level_bvh.h"
 #include "detail/bvh/traverse.h"
 
 #endif // VSNRAY_BVH_H
@@ -6,6 +6,10 @@
 #ifndef VSNRAY_DETAIL_BASIC_SCHED_H
 #define VSNRAY_DETAIL_BASIC_SCHED_H 1
 
+#include <type_traits>
+
+#include "range.h"
+
 namespace visionaray
 {
 
@@ -23,10 +27,29 @@ public:
     template <typename ...Args>
     void reset(Args&&... args);
 
+    // Number of the next frame, part of the keys of the random generators.
+    // Images rendered with the same frame number are reproducible
+    unsigned frame_num() const;
+    void set_frame_num(unsigned frame_num);
+
 private:
 
+    template <typename K, typename SP>
+    void frame_impl(std::false_type /* stream kernel */, K kernel, SP sched_params);
+
+    template <typename K, typename SP>
+    void frame_impl(std::true_type /* stream kernel */, K kernel, SP sched_params);
+
+    template <typename K, typename SP>
+    void render_packets(std::false_type /* tile culling */, K kernel, SP sched_params, tiled_range2d<int> const& tr, unsigned frame_num);
+
+    template <typename K, typename SP>
+    void render_packets(std::true_type /* tile culling */, K kernel, SP sched_params, tiled_range2d<int> const& tr, unsigned frame_num);
+
     Backend backend_;
 
+    unsigned frame_num_ = 0;
+
 };
 
 } // visionaray
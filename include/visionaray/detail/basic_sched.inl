@@ -1,10 +1,15 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <cstddef>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "../math/ray.h"
 #include "../make_generator.h"
+#include "../random_generator.h"
+#include "../result_record.h"
 #include "range.h"
 #include "sched_common.h"
 
@@ -73,6 +78,141 @@ void call_sample_pixel(
             );
 }
 
+
+//-------------------------------------------------------------------------------------------------
+// Render a tile with a stream kernel
+//
+
+template <typename R, typename K, typename SP, typename Generator>
+void call_stream_kernel(
+        std::false_type         /* has intersector */,
+        R                       /* */,
+        K const&                kernel,
+        SP&                     /* */,
+        ray const*              rays,
+        result_record<float>*   results,
+        size_t                  count,
+        Generator&              gen
+        )
+{
+    kernel(R{}, rays, results, count, gen);
+}
+
+template <typename R, typename K, typename SP, typename Generator>
+void call_stream_kernel(
+        std::true_type          /* has intersector */,
+        R                       /* */,
+        K const&                kernel,
+        SP&                     sparams,
+        ray const*              rays,
+        result_record<float>*   results,
+        size_t                  count,
+        Generator&              gen
+        )
+{
+    kernel(sparams.intersector, R{}, rays, results, count, gen);
+}
+
+// Pixel samplers that take exactly one sample per pixel and frame:
+// uniform, jittered, and their blend and low-discrepancy variants
+
+template <typename PxSamplerT>
+struct is_adaptive_sampler : std::false_type {};
+
+template <typename T>
+struct is_adaptive_sampler<pixel_sampler::basic_adaptive_type<T>> : std::true_type {};
+
+template <typename PxSamplerT>
+struct is_single_sample_sampler : std::integral_constant<bool,
+        std::is_base_of<pixel_sampler::uniform_type, PxSamplerT>::value
+    || (std::is_base_of<pixel_sampler::jittered_type, PxSamplerT>::value && !is_adaptive_sampler<PxSamplerT>::value)
+    >
+{
+};
+
+// Generates one primary ray per pixel, traces them all with the stream kernel
+// and stores the results with the pixel sampler (single sample samplers only)
+template <typename R, typename K, typename SP>
+void render_stream(K const& kernel, SP sparams, range2d<int> const& r, unsigned frame_num)
+{
+    static_assert(
+            is_single_sample_sampler<typename SP::pixel_sampler_type>::value,
+            "Stream kernels only support pixel samplers with a single sample per pixel"
+            );
+
+    using S = typename R::scalar_type;
+
+    int width = sparams.rt.width();
+    int height = sparams.rt.height();
+
+    std::vector<ray> rays;
+    rays.reserve(r.rows().length() * r.cols().length());
+
+    for (int y = r.cols().begin(); y < r.cols().end(); ++y)
+    {
+        for (int x = r.rows().begin(); x < r.rows().end(); ++x)
+        {
+            auto gen = make_generator(float{}, sparams.sample_params, detail::pixel_key(float{}, x, y), 0U, frame_num);
+
+            rays.push_back(detail::make_primary_rays(
+                    ray{},
+                    sparams.sample_params,
+                    gen,
+                    x,
+                    y,
+                    width,
+                    height,
+                    sparams.cam
+                    ));
+        }
+    }
+
+    std::vector<result_record<float>> results(rays.size());
+
+    // Lanes of the stream kernel's generator are keyed by the pixels at the tile
+    // origin, sample index 1 separates them from the primary ray generators
+    random_generator<S> stream_gen(
+            detail::pixel_key(S{}, r.rows().begin(), r.cols().begin()),
+            1U,
+            frame_num
+            );
+
+    call_stream_kernel(
+            typename detail::sched_params_has_intersector<SP>::type(),
+            R{},
+            kernel,
+            sparams,
+            rays.data(),
+            results.data(),
+            rays.size(),
+            stream_gen
+            );
+
+    size_t i = 0;
+
+    for (int y = r.cols().begin(); y < r.cols().end(); ++y)
+    {
+        for (int x = r.rows().begin(); x < r.rows().end(); ++x, ++i)
+        {
+            auto result = results[i];
+            auto gen = make_generator(float{}, sparams.sample_params, detail::pixel_key(float{}, x, y), 0U, frame_num);
+
+            sample_pixel(
+                    [result](ray) { return result; },
+                    sparams.sample_params,
+                    rays[i],
+                    gen,
+                    sparams.rt.ref(),
+                    x,
+                    y,
+                    width,
+                    height,
+                    sparams.cam
+                    );
+        }
+    }
+}
+
 } // basic_sched_impl
 
 
@@ -90,11 +230,20 @@ basic_sched<B, R>::basic_sched(Args&&... args)
 template <typename B, typename R>
 template <typename K, typename SP>
 void basic_sched<B, R>::frame(K kernel, SP sched_params)
+{
+    frame_impl(typename detail::is_stream_kernel<K>::type(), kernel, sched_params);
+}
+
+template <typename B, typename R>
+template <typename K, typename SP>
+void basic_sched<B, R>::frame_impl(std::false_type /* stream kernel */, K kernel, SP sched_params)
 {
     sched_params.cam.begin_frame();
 
     sched_params.rt.begin_frame();
 
+    unsigned frame_num = frame_num_++;
+
     int pw = packet_size<typename R::scalar_type>::w;
     int ph = packet_size<typename R::scalar_type>::h;
 
@@ -108,14 +257,42 @@ void basic_sched<B, R>::frame(K kernel, SP sched_params)
     int nx = x0 + sched_params.scissor_box.w;
     int ny = y0 + sched_params.scissor_box.h;
 
+    render_packets(
+            typename detail::sched_params_has_tile_culling<SP>::type(),
+            kernel,
+            sched_params,
+            tiled_range2d<int>(x0, nx, dx, y0, ny, dy),
+            frame_num
+            );
+
+    sched_params.rt.end_frame();
+
+    sched_params.cam.end_frame();
+}
+
+template <typename B, typename R>
+template <typename K, typename SP>
+void basic_sched<B, R>::render_packets(
+        std::false_type             /* tile culling */,
+        K                           kernel,
+        SP                          sched_params,
+        tiled_range2d<int> const&   tr,
+        unsigned                    frame_num
+        )
+{
+    int pw = packet_size<typename R::scalar_type>::w;
+    int ph = packet_size<typename R::scalar_type>::h;
+
     backend_.for_each_packet(
-        tiled_range2d<int>(x0, nx, dx, y0, ny, dy), pw, ph,
+        tr, pw, ph,
         [=](int x, int y)
         {
             auto gen = make_generator(
                     typename R::scalar_type{},
                     sched_params.sample_params,
-                    detail::tic(typename R::scalar_type{})
+                    detail::pixel_key(typename R::scalar_type{}, x, y),
+                    0U,
+                    frame_num
                     );
 
             basic_sched_impl::call_sample_pixel(
@@ -131,6 +308,101 @@ void basic_sched<B, R>::frame(K kernel, SP sched_params)
                     sched_params.cam
                     );
         });
+}
+
+template <typename B, typename R>
+template <typename K, typename SP>
+void basic_sched<B, R>::render_packets(
+        std::true_type              /* tile culling */,
+        K                           kernel,
+        SP                          sched_params,
+        tiled_range2d<int> const&   tr,
+        unsigned                    frame_num
+        )
+{
+    int pw = packet_size<typename R::scalar_type>::w;
+    int ph = packet_size<typename R::scalar_type>::h;
+
+    int width = sched_params.rt.width();
+    int height = sched_params.rt.height();
+
+    backend_.for_each_tile(
+        tr,
+        [=](range2d<int> const& r)
+        {
+            // Each tile culls with its own copy of the intersector
+            auto isect = sched_params.intersector;
+            isect.cull_tile(sched_params.cam, r, width, height);
+
+            for (int y = r.cols().begin(); y < r.cols().end(); y += ph)
+            {
+                for (int x = r.rows().begin(); x < r.rows().end(); x += pw)
+                {
+                    auto gen = make_generator(
+                            typename R::scalar_type{},
+                            sched_params.sample_params,
+                            detail::pixel_key(typename R::scalar_type{}, x, y),
+                            0U,
+                            frame_num
+                            );
+
+                    auto rays = detail::make_primary_rays(
+                            R{},
+                            sched_params.sample_params,
+                            gen,
+                            x,
+                            y,
+                            width,
+                            height,
+                            sched_params.cam
+                            );
+
+                    sample_pixel(
+                            detail::have_intersector_tag(),
+                            isect,
+                            kernel,
+                            sched_params.sample_params,
+                            rays,
+                            gen,
+                            sched_params.rt.ref(),
+                            x,
+                            y,
+                            width,
+                            height,
+                            sched_params.cam
+                            );
+                }
+            }
+        });
+}
+
+template <typename B, typename R>
+template <typename K, typename SP>
+void basic_sched<B, R>::frame_impl(std::true_type /* stream kernel */, K kernel, SP sched_params)
+{
+    sched_params.cam.begin_frame();
+
+    sched_params.rt.begin_frame();
+
+    unsigned frame_num = frame_num_++;
+
+    // Stream kernels regroup the paths of a whole tile into packets,
+    // use larger tiles so that the packets stay full over several bounces
+    int dx = 64;
+    int dy = 64;
+
+    int x0 = sched_params.scissor_box.x;
+    int y0 = sched_params.scissor_box.y;
+
+    int nx = x0 + sched_params.scissor_box.w;
+    int ny = y0 + sched_params.scissor_box.h;
+
+    backend_.for_each_tile(
+        tiled_range2d<int>(x0, nx, dx, y0, ny, dy),
+        [=](range2d<int> const& r)
+        {
+            basic_sched_impl::render_stream<R>(kernel, sched_params, r, frame_num);
+        });
 
     sched_params.rt.end_frame();
 
@@ -144,4 +416,16 @@ void basic_sched<B, R>::reset(Args&&... args)
     backend_.reset(std::forward<Args>(args)...);
 }
 
+template <typename B, typename R>
+unsigned basic_sched<B, R>::frame_num() const
+{
+    return frame_num_;
+}
+
+template <typename B, typename R>
+void basic_sched<B, R>::set_frame_num(unsigned frame_num)
+{
+    frame_num_ = frame_num;
+}
+
 } // visionaray
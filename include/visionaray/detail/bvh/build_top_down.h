@@ -8,11 +8,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <type_traits>
+#include <vector>
 
 #include <visionaray/aligned_vector.h>
 
 #include "../algorithm.h"
+#include "../parallel_for.h"
+#include "../range.h"
+#include "../thread_pool.h"
 
 namespace visionaray
 {
@@ -172,6 +177,364 @@ inline void build_top_down(Tree& tree, Builder& builder, I first, I last, int ma
     build_top_down_work(tree, builder, root, first, last, max_leaf_size, is_index_bvh<Tree>());
 }
 
+
+//--------------------------------------------------------------------------------------------------
+// build_top_down_parallel_impl
+//
+// Builds the upper levels of the tree on the calling thread. The builder may use the
+// thread pool to process large nodes. Subtrees with no more than task_size primitive
+// references are detached from the builder and are built later on in parallel.
+//
+
+template <typename Builder, typename LeafInfo, typename Nodes, typename Indices>
+struct build_top_down_task
+{
+    int      index;   // Index of the subtree's root node in the final tree
+    Builder  builder; // Builder that owns the subtree's primitive references
+    LeafInfo leaf;    // Root of the subtree
+    Nodes    nodes;   // Subtree nodes, root node at position 0
+    Indices  indices; // Subtree primitive indices
+};
+
+template <typename Nodes, typename Indices, typename Builder, typename LeafInfo, typename Data, typename Tasks>
+inline void build_top_down_parallel_impl(
+        int             index,
+        Nodes&          nodes,
+        Indices&        indices,
+        Builder&        builder,
+        LeafInfo const& leaf,
+        Data const&     data,
+        int             max_leaf_size,
+        int             task_size,
+        thread_pool&    pool,
+        Tasks&          tasks
+        )
+{
+    if (builder.leaf_size(leaf) <= task_size)
+    {
+        tasks.emplace_back();
+        tasks.back().index = index;
+        builder.detach(tasks.back().builder, tasks.back().leaf, leaf);
+        return;
+    }
+
+    typename Builder::leaf_infos childs;
+
+    auto split = builder.split(childs, leaf, data, max_leaf_size, pool);
+
+    if (split)
+    {
+        auto first_child_index = static_cast<int>(nodes.size());
+
+        nodes[index].set_inner(leaf.prim_bounds, first_child_index);
+
+        nodes.emplace_back();
+        nodes.emplace_back();
+
+        // Same order as build_top_down_impl(), the builder's
+        // reference list is consumed from the back
+        build_top_down_parallel_impl(
+                first_child_index + 1,
+                nodes,
+                indices,
+                builder,
+                childs[1],
+                data,
+                max_leaf_size,
+                task_size,
+                pool,
+                tasks
+                );
+
+        build_top_down_parallel_impl(
+                first_child_index + 0,
+                nodes,
+                indices,
+                builder,
+                childs[0],
+                data,
+                max_leaf_size,
+                task_size,
+                pool,
+                tasks
+                );
+    }
+    else
+    {
+        auto first = static_cast<int>(indices.size());
+        auto count = builder.insert_indices(indices, leaf);
+
+        nodes[index].set_leaf(leaf.prim_bounds, first, count);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// build_top_down_parallel_tasks
+//
+// Builds the detached subtrees concurrently and splices them into NODES and INDICES.
+// Tasks are merged in the order they were created, so the resulting tree does not
+// depend on how the threads were scheduled.
+//
+
+template <typename Nodes, typename Indices, typename Data, typename Tasks>
+inline void build_top_down_parallel_tasks(
+        Nodes&          nodes,
+        Indices&        indices,
+        Data const&     data,
+        int             max_leaf_size,
+        thread_pool&    pool,
+        Tasks&          tasks
+        )
+{
+    if (tasks.empty())
+    {
+        return;
+    }
+
+    // Start with the largest subtrees to reduce load imbalance
+
+    std::vector<size_t> order(tasks.size());
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    std::stable_sort(
+            order.begin(),
+            order.end(),
+            [&](size_t a, size_t b)
+            {
+                return tasks[a].builder.leaf_size(tasks[a].leaf) > tasks[b].builder.leaf_size(tasks[b].leaf);
+            }
+            );
+
+    pool.run([&](long i)
+        {
+            auto& t = tasks[order[i]];
+
+            t.nodes.emplace_back();
+
+            build_top_down_impl(0, t.nodes, t.indices, t.builder, t.leaf, data, max_leaf_size);
+
+            // Release the primitive references early
+            t.builder = {};
+
+        }, static_cast<long>(tasks.size()));
+
+
+    // Compute offsets, the root of a subtree replaces its placeholder node
+
+    std::vector<size_t> node_offsets(tasks.size());
+    std::vector<size_t> index_offsets(tasks.size());
+
+    size_t num_nodes = nodes.size();
+    size_t num_indices = indices.size();
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        node_offsets[i] = num_nodes - 1;
+        index_offsets[i] = num_indices;
+
+        num_nodes += tasks[i].nodes.size() - 1;
+        num_indices += tasks[i].indices.size();
+    }
+
+    nodes.resize(num_nodes);
+    indices.resize(num_indices);
+
+    pool.run([&](long i)
+        {
+            auto& t = tasks[i];
+
+            auto node_offset = static_cast<unsigned>(node_offsets[i]);
+            auto index_offset = static_cast<unsigned>(index_offsets[i]);
+
+            for (size_t j = 0; j < t.nodes.size(); ++j)
+            {
+                auto n = t.nodes[j];
+
+                // Copy, set_inner() and set_leaf() must not read from the node they write
+                aabb bounds = n.get_bounds();
+
+                if (is_inner(n))
+                {
+                    n.set_inner(bounds, n.get_child(0) + node_offset);
+                }
+                else
+                {
+                    n.set_leaf(bounds, n.get_first_primitive() + index_offset, n.get_num_primitives());
+                }
+
+                nodes[j == 0 ? t.index : node_offset + j] = n;
+            }
+
+            std::copy(t.indices.begin(), t.indices.end(), indices.begin() + index_offset);
+
+            t.nodes = {};
+            t.indices = {};
+
+        }, static_cast<long>(tasks.size()));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// build_top_down_parallel
+//
+
+template <typename Tree, typename Builder, typename Root, typename I>
+inline void build_top_down_parallel_work(
+        Tree&          tree,
+        Builder&       builder,
+        Root           root,
+        I              first,
+        I              /*last*/,
+        int            max_leaf_size,
+        int            task_size,
+        thread_pool&   pool,
+        std::true_type /*is_index_bvh*/
+        )
+{
+    using task = build_top_down_task<
+            Builder,
+            Root,
+            typename Tree::node_vector,
+            typename Tree::index_vector
+            >;
+
+    std::vector<task> tasks;
+
+    build_top_down_parallel_impl(
+            0, // root node index
+            tree.nodes(),
+            tree.indices(),
+            builder,
+            root,
+            first, // primitive data
+            max_leaf_size,
+            task_size,
+            pool,
+            tasks
+            );
+
+    build_top_down_parallel_tasks(tree.nodes(), tree.indices(), first, max_leaf_size, pool, tasks);
+}
+
+template <typename Tree, typename Builder, typename Root, typename I>
+inline void build_top_down_parallel_work(
+        Tree&           tree,
+        Builder&        builder,
+        Root            root,
+        I               first,
+        I               /*last*/,
+        int             max_leaf_size,
+        int             task_size,
+        thread_pool&    pool,
+        std::false_type /*is_index_bvh*/
+        )
+{
+    using task = build_top_down_task<
+            Builder,
+            Root,
+            typename Tree::node_vector,
+            aligned_vector<unsigned>
+            >;
+
+    aligned_vector<unsigned> indices;
+    std::vector<task> tasks;
+
+    auto uss = builder.use_spatial_splits;
+
+    builder.use_spatial_splits = false;
+
+    build_top_down_parallel_impl(
+            0, // root node index
+            tree.nodes(),
+            indices,
+            builder,
+            root,
+            first, // primitive data
+            max_leaf_size,
+            task_size,
+            pool,
+            tasks
+            );
+
+    build_top_down_parallel_tasks(tree.nodes(), indices, first, max_leaf_size, pool, tasks);
+
+    builder.use_spatial_splits = uss;
+
+    assert(indices.size() == tree.primitives().size());
+
+    // Reorder the primitives according to the indices.
+    // Gather into a copy, this is trivially parallel in contrast to reorder_n().
+    typename Tree::primitive_vector primitives(tree.primitives().size());
+
+    parallel_for(
+        pool,
+        range1d<size_t>(0, indices.size()),
+        [&](size_t i)
+        {
+            primitives[i] = tree.primitives()[indices[i]];
+        });
+
+    tree.primitives().swap(primitives);
+}
+
+template <typename Tree, typename Builder, typename I>
+inline void build_top_down_parallel(
+        Tree&           tree,
+        Builder&        builder,
+        thread_pool&    pool,
+        I               first,
+        I               last,
+        int             max_leaf_size = -1,
+        int             task_size = -1
+        )
+{
+    if (max_leaf_size <= 0)
+    {
+        max_leaf_size = 4;
+    }
+
+    auto count = std::distance(first, last);
+
+    if (task_size <= 0)
+    {
+        // Aim for several subtrees per thread
+        task_size = static_cast<int>(count / (8 * std::max(pool.num_threads, 1U)));
+    }
+
+    task_size = std::max(task_size, max_leaf_size);
+
+    // Precompute primitive data needed by the builder
+
+    auto root = builder.init(first, last, pool);
+
+    // Preallocate memory
+    // Guess number of nodes...
+
+    tree.clear(2 * (count / max_leaf_size));
+
+    // Build the tree
+
+    // Create root node
+    tree.nodes().emplace_back();
+
+    build_top_down_parallel_work(
+            tree,
+            builder,
+            root,
+            first,
+            last,
+            max_leaf_size,
+            task_size,
+            pool,
+            is_index_bvh<Tree>()
+            );
+}
+
 } // detail
 } // visionaray
 
@@ -0,0 +1,277 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_BVH_COLLAPSE_H
+#define VSNRAY_DETAIL_BVH_COLLAPSE_H 1
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <visionaray/math/aabb.h>
+#include <visionaray/aligned_vector.h>
+
+namespace visionaray
+{
+namespace detail
+{
+
+template <typename WideTree, typename Tree>
+void collapse_copy_indices(WideTree& dst, Tree const& src, std::true_type /* index bvh */)
+{
+    dst.indices().assign(src.indices().begin(), src.indices().end());
+}
+
+template <typename WideTree, typename Tree>
+void collapse_copy_indices(WideTree&, Tree const&, std::false_type /* index bvh */)
+{
+}
+
+template <typename NodeVector, typename Tree>
+void collapse_nodes(NodeVector& nodes, Tree const& src)
+{
+    using wide_node = typename NodeVector::value_type;
+
+    enum { W = wide_node::Width };
+
+    if (src.num_nodes() == 0)
+    {
+        return;
+    }
+
+    nodes.emplace_back();
+
+    // (wide node, binary node) pairs that still need to be collapsed
+    std::vector<std::pair<unsigned, unsigned>> work;
+    work.emplace_back(0, 0);
+
+    while (!work.empty())
+    {
+        auto w = work.back();
+        work.pop_back();
+
+        auto const& n = src.node(w.second);
+
+        unsigned children[W];
+        unsigned count = 0;
+
+        if (is_leaf(n))
+        {
+            // Only happens for the root, store the leaf as the single child
+            children[count++] = w.second;
+        }
+        else
+        {
+            children[count++] = n.get_child(0);
+            children[count++] = n.get_child(1);
+        }
+
+        while (count < W)
+        {
+            int best = -1;
+            float best_area = -1.0f;
+
+            for (unsigned i = 0; i < count; ++i)
+            {
+                auto const& c = src.node(children[i]);
+
+                if (is_inner(c) && surface_area(c.get_bounds()) > best_area)
+                {
+                    best = static_cast<int>(i);
+                    best_area = surface_area(c.get_bounds());
+                }
+            }
+
+            if (best < 0)
+            {
+                break;
+            }
+
+            auto const& c = src.node(children[best]);
+            children[best] = c.get_child(0);
+            children[count++] = c.get_child(1);
+        }
+
+        wide_node node;
+
+        for (unsigned i = 0; i < W; ++i)
+        {
+            if (i >= count)
+            {
+                node.set_empty(i);
+                continue;
+            }
+
+            auto const& c = src.node(children[i]);
+
+            if (is_leaf(c))
+            {
+                node.set_leaf(i, c.get_bounds(), c.get_first_primitive(), c.get_num_primitives());
+            }
+            else
+            {
+                auto index = static_cast<unsigned>(nodes.size());
+                nodes.emplace_back();
+                node.set_inner(i, c.get_bounds(), index);
+                work.emplace_back(index, children[i]);
+            }
+        }
+
+        nodes[w.first] = node;
+    }
+
+    // Traversal encodes (node, slot) pairs of leaves in 31 bits
+    assert(nodes.size() * W < (1U << 31));
+}
+
+// Quantize the child bounds of a wide node
+template <unsigned W, typename Q>
+void compress_node(compressed_bvh_node<W, Q>& dst, wide_bvh_node<W> const& src)
+{
+    using node_type = compressed_bvh_node<W, Q>;
+
+    aabb bounds = src.get_bounds();
+
+    for (int a = 0; a < 3; ++a)
+    {
+        dst.origin[a] = bounds.min[a];
+
+        // Smallest power of two spacing so that the grid covers the node bounds
+        int e = -126;
+        float extent = bounds.max[a] - bounds.min[a];
+
+        if (extent > 0.0f)
+        {
+            std::frexp(extent / static_cast<float>(node_type::MaxQ), &e);
+        }
+
+        dst.exponent[a] = static_cast<signed char>(std::max(-126, std::min(e, 127)));
+    }
+
+    dst.padding = 0;
+
+    // Decode exactly like the traversal does, the product is exact
+    auto decode = [&](int q, int a)
+    {
+        return dst.origin[a] + static_cast<float>(q) * dst.scale(a);
+    };
+
+    auto quantize = [&](float lo, float hi, int a, Q& qlo, Q& qhi)
+    {
+        int ilo = static_cast<int>(std::floor((lo - dst.origin[a]) / dst.scale(a)));
+        int ihi = static_cast<int>(std::ceil((hi - dst.origin[a]) / dst.scale(a)));
+
+        ilo = std::max(0, std::min(ilo, static_cast<int>(node_type::MaxQ)));
+        ihi = std::max(0, std::min(ihi, static_cast<int>(node_type::MaxQ)));
+
+        // Compensate rounding, decode(0) and decode(MaxQ) enclose the node bounds
+        while (ilo > 0 && decode(ilo, a) > lo)
+        {
+            --ilo;
+        }
+
+        while (ihi < node_type::MaxQ && decode(ihi, a) < hi)
+        {
+            ++ihi;
+        }
+
+        qlo = static_cast<Q>(ilo);
+        qhi = static_cast<Q>(ihi);
+    };
+
+    for (unsigned i = 0; i < W; ++i)
+    {
+        if (src.is_empty(i))
+        {
+            dst.qmin_x[i] = dst.qmin_y[i] = dst.qmin_z[i] = static_cast<Q>(node_type::MaxQ);
+            dst.qmax_x[i] = dst.qmax_y[i] = dst.qmax_z[i] = 0;
+            dst.index[i] = ~0U;
+            dst.num_prims[i] = node_type::EmptySlot;
+            continue;
+        }
+
+        quantize(src.bbox_min_x[i], src.bbox_max_x[i], 0, dst.qmin_x[i], dst.qmax_x[i]);
+        quantize(src.bbox_min_y[i], src.bbox_max_y[i], 1, dst.qmin_y[i], dst.qmax_y[i]);
+        quantize(src.bbox_min_z[i], src.bbox_max_z[i], 2, dst.qmin_z[i], dst.qmax_z[i]);
+
+        if (src.num_prims[i] >= static_cast<unsigned>(node_type::EmptySlot))
+        {
+            throw std::runtime_error("Leaf too large for compressed BVH node");
+        }
+
+        dst.index[i] = src.index[i];
+        dst.num_prims[i] = static_cast<unsigned short>(src.num_prims[i]);
+    }
+}
+
+template <typename NodeVector, typename Tree, unsigned W>
+void collapse_into(NodeVector& nodes, Tree const& src, wide_bvh_node<W>* /* tag */)
+{
+    collapse_nodes(nodes, src);
+}
+
+template <typename NodeVector, typename Tree, unsigned W, typename Q>
+void collapse_into(NodeVector& nodes, Tree const& src, compressed_bvh_node<W, Q>* /* tag */)
+{
+    aligned_vector<wide_bvh_node<W>, 32> wide_nodes;
+    collapse_nodes(wide_nodes, src);
+
+    nodes.resize(wide_nodes.size());
+
+    for (size_t i = 0; i < wide_nodes.size(); ++i)
+    {
+        compress_node(nodes[i], wide_nodes[i]);
+    }
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Collapse a binary BVH into a BVH with W-wide nodes (W = WideTree::node_type::Width)
+//
+// Starting with the two children of a binary node, the child with the largest
+// surface area is repeatedly replaced by its two children until the wide node is
+// full or only leaves are left. Primitives (and indices, for index BVHs) are copied
+// unchanged, so leaf ranges and primitive list indices of the wide BVH are the same
+// as those of the binary BVH
+//
+// If WideTree has compressed_bvh_nodes, the child bounds of the collapsed nodes are
+// quantized relative to the bounds of their parent. Their leaves hold less than
+// 65535 primitives, collapse() throws std::runtime_error for larger leaves
+//
+// Parameters:
+//
+// [out] dst
+//      BVH with wide_bvh_node or compressed_bvh_node nodes
+//
+// [in] src
+//      Binary BVH (bvh_t or index_bvh_t) built with any of the builders
+//
+
+template <typename WideTree, typename Tree>
+void collapse(WideTree& dst, Tree const& src)
+{
+    using wide_node = typename WideTree::node_type;
+
+    static_assert(is_wide_bvh_node<wide_node>::value, "Destination must be a wide BVH");
+    static_assert(is_index_bvh<WideTree>::value == is_index_bvh<Tree>::value, "BVH type mismatch");
+
+    dst.clear(src.num_nodes() / (wide_node::Width - 1) + 1);
+
+    dst.primitives().assign(src.primitives().begin(), src.primitives().end());
+    detail::collapse_copy_indices(dst, src, std::integral_constant<bool, is_index_bvh<Tree>::value>{});
+
+    detail::collapse_into(dst.nodes(), src, static_cast<wide_node*>(nullptr));
+}
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_BVH_COLLAPSE_H
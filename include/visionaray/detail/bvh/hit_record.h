@@ -153,6 +153,45 @@ inline hit_record_bvh<basic_ray<T>, decltype(simd::pack(array<Base, N>{{}}))> pa
 }
 
 
+template <
+    size_t N,
+    typename T = simd::float_from_simd_width_t<N>,
+    typename Base
+    >
+VSNRAY_FUNC
+inline hit_record_bvh_inst<basic_ray<T>, decltype(simd::pack(array<Base, N>{{}}))> pack(
+        array<hit_record_bvh_inst<ray, Base>, N> const& hrs
+        )
+{
+    using I = int_type_t<T>;
+    using int_array = aligned_array_t<I>;
+    using PackedBase = decltype(pack(array<Base, N>{{}}));
+    using RT = hit_record_bvh_inst<basic_ray<T>, PackedBase>;
+
+    array<hit_record_bvh<ray, Base>, N> bases;
+    int_array primitive_list_index_inst;
+    array<vec4, N> cols[4];
+
+    for (unsigned i = 0; i < N; ++i)
+    {
+        // Slicing (on purpose)!
+        bases[i] = hit_record_bvh<ray, Base>(hrs[i]);
+        primitive_list_index_inst[i] = hrs[i].primitive_list_index_inst;
+
+        for (int c = 0; c < 4; ++c)
+        {
+            cols[c][i] = hrs[i].transform_inv(c);
+        }
+    }
+
+    return RT(
+            pack(bases),
+            I(primitive_list_index_inst),
+            matrix<4, 4, T>(pack(cols[0]), pack(cols[1]), pack(cols[2]), pack(cols[3]))
+            );
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // simd::unpack()
 //
@@ -5,8 +5,10 @@
 #include <type_traits>
 #include <utility>
 
+#include <visionaray/math/simd/type_traits.h>
 #include <visionaray/math/limits.h>
 #include <visionaray/math/matrix.h>
+#include <visionaray/array.h>
 #include <visionaray/intersector.h>
 #include <visionaray/update_if.h>
 
@@ -23,6 +25,111 @@ namespace visionaray
 // Ray / BVH intersection
 //
 
+namespace detail
+{
+
+// Traverse the subtree rooted at node address <root> and update result in place
+// Returns true if traversal can be terminated early
+
+template <
+    traversal_type Traversal,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename RT,
+    typename T,
+    typename Cond
+    >
+VSNRAY_FUNC
+inline bool intersect_subtree(
+        R const&     ray,
+        BVH const&   b,
+        Intersector& isect,
+        unsigned     root,
+        RT&          result,
+        T            max_t,
+        Cond         update_cond
+        )
+{
+    using HR = hit_record_bvh<R, decltype(isect(ray, std::declval<typename BVH::primitive_type>()))>;
+
+    stack<32> st;
+    st.push(root);
+
+    auto inv_dir = T(1.0) / ray.dir;
+
+    // while ray not terminated
+next:
+    while (!st.empty())
+    {
+        auto node = b.node(st.pop());
+
+        // while node does not contain primitives
+        //     traverse to the next node
+
+        while (!is_leaf(node))
+        {
+            auto children = &b.node(node.get_child(0));
+
+            auto hr1 = isect(ray, children[0].get_bounds(), inv_dir);
+            auto hr2 = isect(ray, children[1].get_bounds(), inv_dir);
+
+            auto b1 = any( is_closer(hr1, result, max_t) );
+            auto b2 = any( is_closer(hr2, result, max_t) );
+
+            if (b1 && b2)
+            {
+                unsigned near_addr = all( hr1.tnear < hr2.tnear ) ? 0 : 1;
+                st.push(node.get_child(!near_addr));
+                node = b.node(node.get_child(near_addr));
+            }
+            else if (b1)
+            {
+                node = b.node(node.get_child(0));
+            }
+            else if (b2)
+            {
+                node = b.node(node.get_child(1));
+            }
+            else
+            {
+                goto next;
+            }
+        }
+
+
+        // while node contains untested primitives
+        //     perform a ray-primitive intersection test
+
+        for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+        {
+            auto prim = b.primitive(i);
+
+            auto hr = HR(isect(ray, prim), i);
+            auto closer = update_cond(hr, result, max_t);
+
+#ifndef __CUDA_ARCH__
+            if (!any(closer))
+            {
+                continue;
+            }
+#endif
+
+            update_if(result, hr, closer);
+
+            exit_traversal<Traversal> early_exit;
+            if (early_exit.check(result))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+} // detail
+
 template <
     detail::traversal_type Traversal,
     size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
@@ -30,8 +137,10 @@ template <
     typename BVH,
     typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
     typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value>::type,
+    typename = typename std::enable_if<!is_wide_bvh<BVH>::value>::type,
     typename Intersector,
     typename T = typename R::scalar_type,
+    typename = typename std::enable_if<!simd::is_simd_vector<T>::value>::type,
     typename Cond = is_closer_t
     >
 VSNRAY_FUNC
@@ -55,48 +164,318 @@ inline auto intersect(
 
     RT result;
 
-    stack<32> st;
-    st.push(0); // address of root node
+    intersect_subtree<Traversal>(ray, b, isect, 0, result, max_t, update_cond);
+
+    return result;
+
+}
+
+
+// Overload for ray packets -------------------------------
+//
+// Children are visited front to back, where the lanes disagree the order is
+// given by the packet's dominant direction. Each stack entry carries the mask
+// of lanes that reached the node. When
+// no more than packet_compaction_threshold() lanes remain active, the surviving
+// lanes traverse the rest of the subtree as single rays. This keeps incoherent
+// (e.g. secondary) packets from descending into nodes only a few lanes need.
+//
+
+namespace detail
+{
+
+template <typename T>
+constexpr int packet_compaction_threshold()
+{
+    return simd::num_elements<T>::value / 4 > 1 ? simd::num_elements<T>::value / 4 : 1;
+}
+
+// Single ray fallback requires that the packet hit record can be split into
+// per-lane hit records and reassembled, and that the intersector (and the
+// update condition) accept single rays
+
+template <typename R, typename BVH, typename Intersector, typename Cond>
+struct supports_lane_compaction_impl
+{
+    using primitive_type = typename BVH::primitive_type;
+
+    enum { N = simd::num_elements<typename R::scalar_type>::value };
+
+    template <typename U>
+    static auto test(U* isect)
+        -> typename std::enable_if<
+                std::is_same<
+                    decltype(simd::pack(simd::unpack(std::declval<hit_record_bvh<
+                            R,
+                            decltype( (*isect)(std::declval<R>(), std::declval<primitive_type>()) )
+                            >>()))),
+                    hit_record_bvh<R, decltype( (*isect)(std::declval<R>(), std::declval<primitive_type>()) )>
+                    >::value &&
+                std::is_same<
+                    decltype(simd::unpack(std::declval<hit_record_bvh<
+                            R,
+                            decltype( (*isect)(std::declval<R>(), std::declval<primitive_type>()) )
+                            >>())),
+                    array<hit_record_bvh<
+                            basic_ray<float>,
+                            decltype( (*isect)(std::declval<basic_ray<float>>(), std::declval<primitive_type>()) )
+                            >, N>
+                    >::value,
+                std::true_type
+                >::type;
+
+    template <typename U>
+    static std::false_type test(...);
+
+    using type = typename std::conditional<
+            std::is_same<Cond, is_closer_t>::value,
+            decltype( test<Intersector>(nullptr) ),
+            std::false_type
+            >::type;
+};
+
+template <traversal_type Traversal, typename R, typename BVH, typename Intersector, typename Cond>
+struct supports_lane_compaction
+    : std::integral_constant<
+            bool,
+            Traversal != MultiHit && supports_lane_compaction_impl<R, BVH, Intersector, Cond>::type::value
+            >
+{
+};
+
+// Number of active lanes, the all() test is the fast path for coherent packets
+
+template <typename M>
+inline int count_active(M const& active)
+{
+    using I = simd::int_type_t<simd::float_type_t<M>>;
+    using int_array = simd::aligned_array_t<I>;
+
+    enum { N = simd::num_elements<M>::value };
+
+    if (all(active))
+    {
+        return N;
+    }
+
+    int_array act;
+    store(act, convert_to_int(active));
+
+    int count = 0;
+
+    for (int i = 0; i < N; ++i)
+    {
+        count += act[i] ? 1 : 0;
+    }
+
+    return count;
+}
+
+// Traverse the subtree rooted at <root> with each active lane as a single ray
+
+template <traversal_type Traversal, typename R, typename BVH, typename Intersector, typename RT, typename T, typename M, typename Cond>
+inline void intersect_lanes(
+        std::true_type              /* supports lane compaction */,
+        R const&                    ray,
+        BVH const&                  b,
+        Intersector&                isect,
+        unsigned                    root,
+        RT&                         result,
+        T                           max_t,
+        M const&                    active,
+        Cond                        update_cond
+        )
+{
+    using I = simd::int_type_t<T>;
+    using int_array = simd::aligned_array_t<I>;
+    using float_array = simd::aligned_array_t<T>;
+
+    enum { N = simd::num_elements<T>::value };
+
+    auto rays = simd::unpack(ray);
+    auto hrs = simd::unpack(result);
+
+    int_array act;
+    store(act, convert_to_int(active));
+
+    float_array max_ts;
+    store(max_ts, max_t);
+
+    float_array updated;
+
+    for (int i = 0; i < N; ++i)
+    {
+        if (act[i])
+        {
+            intersect_subtree<Traversal>(rays[i], b, isect, root, hrs[i], max_ts[i], update_cond);
+        }
+
+        updated[i] = act[i] && hrs[i].hit ? 1.0f : 0.0f;
+    }
+
+    // Merge active lanes with a mask built from the float lanes, pack() does
+    // not produce valid hit masks for the emulated SIMD types
+    update_if(result, simd::pack(hrs), T(updated) > T(0.0));
+}
+
+template <traversal_type Traversal, typename R, typename BVH, typename Intersector, typename RT, typename T, typename M, typename Cond>
+inline void intersect_lanes(
+        std::false_type             /* supports lane compaction */,
+        R const&                    /* */,
+        BVH const&                  /* */,
+        Intersector&                /* */,
+        unsigned                    /* */,
+        RT&                         /* */,
+        T                           /* */,
+        M const&                    /* */,
+        Cond                        /* */
+        )
+{
+}
+
+// Traverse the subtrees rooted at roots[0..num_roots) with a ray packet, in that order
+
+enum { MaxPacketRoots = 16 };
+
+template <
+    traversal_type Traversal,
+    size_t MultiHitMax,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename Cond
+    >
+inline auto intersect_packet(
+        R const&        ray,
+        BVH const&      b,
+        Intersector&    isect,
+        unsigned const* roots,
+        unsigned        num_roots,
+        T               max_t,
+        Cond            update_cond
+        )
+    -> typename traversal_result< hit_record_bvh<
+            R,
+            decltype( isect(ray, std::declval<typename BVH::primitive_type>()) )
+            >, Traversal, MultiHitMax>::type
+{
+    using HR = hit_record_bvh<R, decltype(isect(ray, std::declval<typename BVH::primitive_type>()))>;
+
+    using RT = typename detail::traversal_result<HR, Traversal, MultiHitMax>::type;
+    using M  = simd::mask_type_t<T>;
+
+    using compaction = supports_lane_compaction<Traversal, R, BVH, Intersector, Cond>;
+
+    struct entry
+    {
+        unsigned addr;
+        M        active;
+    };
+
+    RT result;
+
+    // Room for the roots and the traversal stack below them
+    stack<32 + MaxPacketRoots, entry> st;
+
+    // Push in reverse order so the first root is visited first, all lanes active
+    for (unsigned i = num_roots; i > 0; --i)
+    {
+        st.push({ roots[i - 1], M(true) });
+    }
 
     auto inv_dir = T(1.0) / ray.dir;
 
-    // while ray not terminated
+    // Sign of the packet's summed direction per axis
+    auto dirs = simd::unpack(ray.dir);
+    vec3 dir_sum(0.0f);
+
+    for (auto const& d : dirs)
+    {
+        dir_sum += d;
+    }
+
+    // while packet not terminated
 next:
     while (!st.empty())
     {
-        auto node = b.node(st.pop());
+        auto e = st.pop();
+        auto node = b.node(e.addr);
+        auto addr = e.addr;
+        auto active = e.active;
 
         // while node does not contain primitives
         //     traverse to the next node
 
         while (!is_leaf(node))
         {
+            if (compaction::value && count_active(active) <= packet_compaction_threshold<T>())
+            {
+                intersect_lanes<Traversal>(compaction{}, ray, b, isect, addr, result, max_t, active, update_cond);
+
+                exit_traversal<Traversal> early_exit;
+                if (early_exit.check(result))
+                {
+                    return result;
+                }
+
+                goto next;
+            }
+
             auto children = &b.node(node.get_child(0));
 
-            auto hr1 = isect(ray, children[0].get_bounds(), inv_dir);
-            auto hr2 = isect(ray, children[1].get_bounds(), inv_dir);
+            auto bounds1 = children[0].get_bounds();
+            auto bounds2 = children[1].get_bounds();
 
-            auto b1 = any( is_closer(hr1, result, max_t) );
-            auto b2 = any( is_closer(hr2, result, max_t) );
+            auto hr1 = isect(ray, bounds1, inv_dir);
+            auto hr2 = isect(ray, bounds2, inv_dir);
+
+            M m1 = active & is_closer(hr1, result, max_t);
+            M m2 = active & is_closer(hr2, result, max_t);
+
+            auto b1 = any(m1);
+            auto b2 = any(m2);
 
             if (b1 && b2)
             {
-                unsigned near_addr = all( hr1.tnear < hr2.tnear ) ? 0 : 1;
-                st.push(node.get_child(!near_addr));
-                node = b.node(node.get_child(near_addr));
+                // If the lanes disagree on the entry order, order along the axis that
+                // separates the children best: the near child is the one the packet's
+                // dominant direction points away from
+                unsigned near_addr = 0;
+
+                if (all( hr2.tnear < hr1.tnear ))
+                {
+                    near_addr = 1;
+                }
+                else if (!all( hr1.tnear < hr2.tnear ))
+                {
+                    vec3 diff = (bounds2.min + bounds2.max) - (bounds1.min + bounds1.max);
+                    vec3 adiff(abs(diff.x), abs(diff.y), abs(diff.z));
+                    int axis = adiff.x > adiff.y ? (adiff.x > adiff.z ? 0 : 2) : (adiff.y > adiff.z ? 1 : 2);
+
+                    near_addr = (diff[axis] >= 0.0f) == (dir_sum[axis] >= 0.0f) ? 0 : 1;
+                }
+
+                st.push({ node.get_child(!near_addr), near_addr ? m1 : m2 });
+                addr = node.get_child(near_addr);
+                active = near_addr ? m2 : m1;
             }
             else if (b1)
             {
-                node = b.node(node.get_child(0));
+                addr = node.get_child(0);
+                active = m1;
             }
             else if (b2)
             {
-                node = b.node(node.get_child(1));
+                addr = node.get_child(1);
+                active = m2;
             }
             else
             {
                 goto next;
             }
+
+            node = b.node(addr);
         }
 
 
@@ -108,14 +487,12 @@ next:
             auto prim = b.primitive(i);
 
             auto hr = HR(isect(ray, prim), i);
-            auto closer = update_cond(hr, result, max_t);
+            auto closer = active & update_cond(hr, result, max_t);
 
-#ifndef __CUDA_ARCH__
             if (!any(closer))
             {
                 continue;
             }
-#endif
 
             update_if(result, hr, closer);
 
@@ -127,6 +504,367 @@ next:
         }
     }
 
+    return result;
+}
+
+} // detail
+
+template <
+    detail::traversal_type Traversal,
+    size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
+    typename R,
+    typename BVH,
+    typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
+    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value>::type,
+    typename = typename std::enable_if<!is_wide_bvh<BVH>::value>::type,
+    typename Intersector,
+    typename T = typename R::scalar_type,
+    typename std::enable_if<simd::is_simd_vector<T>::value, int>::type = 0,
+    typename Cond = is_closer_t
+    >
+inline auto intersect(
+        R const&     ray,
+        BVH const&   b,
+        Intersector& isect,
+        T            max_t = numeric_limits<T>::max(),
+        Cond         update_cond = Cond()
+        )
+    -> typename detail::traversal_result< hit_record_bvh<
+            R,
+            decltype( isect(ray, std::declval<typename BVH::primitive_type>()) )
+            >, Traversal, MultiHitMax>::type
+{
+    unsigned root = 0; // address of root node
+
+    return detail::intersect_packet<Traversal, MultiHitMax>(ray, b, isect, &root, 1, max_t, update_cond);
+}
+
+
+// Overload for BVHs with wide nodes ----------------------
+
+namespace detail
+{
+
+// Upper bound for the distance to child boxes that may still contain closer hits
+
+template <typename HR, typename T>
+VSNRAY_FUNC
+inline T wide_bvh_cull_distance(HR const& result, T max_t)
+{
+    return min(result.t, max_t);
+}
+
+template <typename HR, size_t N, typename T>
+VSNRAY_FUNC
+inline T wide_bvh_cull_distance(array<HR, N> const& result, T max_t)
+{
+    // Multi-hit: a box may contain a hit as long as it is closer than the farthest one
+    T t = result[0].t;
+
+    for (size_t i = 1; i < N; ++i)
+    {
+        t = max(t, result[i].t);
+    }
+
+    return min(t, max_t);
+}
+
+// Intersect single ray with all children of a wide node, using one W-wide SIMD slab test
+// The child bounds are passed as aligned SoA arrays
+// Writes the slots of the children that were hit to order[], sorted front to back,
+// and their entry distances to tnear[]
+
+template <unsigned W, typename Node, typename RT>
+inline unsigned intersect_children_soa(
+        basic_ray<float> const&  ray,
+        vector<3, float> const&  inv_dir,
+        Node const&              node,
+        float const*             bbox_min_x,
+        float const*             bbox_min_y,
+        float const*             bbox_min_z,
+        float const*             bbox_max_x,
+        float const*             bbox_max_y,
+        float const*             bbox_max_z,
+        RT const&                result,
+        float                    max_t,
+        unsigned                 order[W],
+        float                    tnear[W]
+        )
+{
+    using F = simd::float_from_simd_width_t<W>;
+
+    F t1x = (F(bbox_min_x) - F(ray.ori.x)) * F(inv_dir.x);
+    F t1y = (F(bbox_min_y) - F(ray.ori.y)) * F(inv_dir.y);
+    F t1z = (F(bbox_min_z) - F(ray.ori.z)) * F(inv_dir.z);
+    F t2x = (F(bbox_max_x) - F(ray.ori.x)) * F(inv_dir.x);
+    F t2y = (F(bbox_max_y) - F(ray.ori.y)) * F(inv_dir.y);
+    F t2z = (F(bbox_max_z) - F(ray.ori.z)) * F(inv_dir.z);
+
+    F tmin = max( max(min(t1x, t2x), min(t1y, t2y)), min(t1z, t2z) );
+    F tmax = min( min(max(t1x, t2x), max(t1y, t2y)), max(t1z, t2z) );
+
+    F cull( wide_bvh_cull_distance(result, max_t) );
+    auto hit = tmax >= tmin && tmax >= F(0.0) && tmin < cull;
+
+    if (!any(hit))
+    {
+        return 0;
+    }
+
+    VSNRAY_ALIGN(32) float dist[W];
+    store(dist, select(hit, tmin, F(numeric_limits<float>::max())));
+
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < W; ++i)
+    {
+        if (dist[i] == numeric_limits<float>::max() || node.is_empty(i))
+        {
+            continue;
+        }
+
+        // Insertion sort, W is small
+        unsigned j = count++;
+
+        while (j > 0 && dist[order[j - 1]] > dist[i])
+        {
+            order[j] = order[j - 1];
+            --j;
+        }
+
+        order[j] = i;
+    }
+
+    for (unsigned k = 0; k < count; ++k)
+    {
+        tnear[k] = dist[order[k]];
+    }
+
+    return count;
+}
+
+template <unsigned W, typename RT>
+inline unsigned intersect_children(
+        basic_ray<float> const&  ray,
+        vector<3, float> const&  inv_dir,
+        wide_bvh_node<W> const&  node,
+        RT const&                result,
+        float                    max_t,
+        unsigned                 order[W],
+        float                    tnear[W]
+        )
+{
+    return intersect_children_soa<W>(
+            ray,
+            inv_dir,
+            node,
+            node.bbox_min_x,
+            node.bbox_min_y,
+            node.bbox_min_z,
+            node.bbox_max_x,
+            node.bbox_max_y,
+            node.bbox_max_z,
+            result,
+            max_t,
+            order,
+            tnear
+            );
+}
+
+// Compressed nodes: decode the quantized child bounds first
+
+template <unsigned W, typename Q, typename RT>
+inline unsigned intersect_children(
+        basic_ray<float> const&             ray,
+        vector<3, float> const&             inv_dir,
+        compressed_bvh_node<W, Q> const&    node,
+        RT const&                           result,
+        float                               max_t,
+        unsigned                            order[W],
+        float                               tnear[W]
+        )
+{
+    VSNRAY_ALIGN(32) float bbox_min_x[W];
+    VSNRAY_ALIGN(32) float bbox_min_y[W];
+    VSNRAY_ALIGN(32) float bbox_min_z[W];
+    VSNRAY_ALIGN(32) float bbox_max_x[W];
+    VSNRAY_ALIGN(32) float bbox_max_y[W];
+    VSNRAY_ALIGN(32) float bbox_max_z[W];
+
+    float sx = node.scale(0);
+    float sy = node.scale(1);
+    float sz = node.scale(2);
+
+    for (unsigned i = 0; i < W; ++i)
+    {
+        bbox_min_x[i] = node.origin[0] + static_cast<float>(node.qmin_x[i]) * sx;
+        bbox_min_y[i] = node.origin[1] + static_cast<float>(node.qmin_y[i]) * sy;
+        bbox_min_z[i] = node.origin[2] + static_cast<float>(node.qmin_z[i]) * sz;
+        bbox_max_x[i] = node.origin[0] + static_cast<float>(node.qmax_x[i]) * sx;
+        bbox_max_y[i] = node.origin[1] + static_cast<float>(node.qmax_y[i]) * sy;
+        bbox_max_z[i] = node.origin[2] + static_cast<float>(node.qmax_z[i]) * sz;
+    }
+
+    return intersect_children_soa<W>(
+            ray,
+            inv_dir,
+            node,
+            bbox_min_x,
+            bbox_min_y,
+            bbox_min_z,
+            bbox_max_x,
+            bbox_max_y,
+            bbox_max_z,
+            result,
+            max_t,
+            order,
+            tnear
+            );
+}
+
+// Ray packets: test children one by one, the SIMD lanes are already occupied by the rays
+
+template <typename R, typename Node, typename RT>
+VSNRAY_FUNC
+inline unsigned intersect_children(
+        R const&                                    ray,
+        vector<3, typename R::scalar_type> const&   inv_dir,
+        Node const&                                 node,
+        RT const&                                   result,
+        typename R::scalar_type                     max_t,
+        unsigned                                    order[Node::Width],
+        typename R::scalar_type                     tnear[Node::Width]
+        )
+{
+    using T = typename R::scalar_type;
+
+    enum { W = Node::Width };
+
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < W && !node.is_empty(i); ++i)
+    {
+        auto hr = intersect(ray, node.get_child_bounds(i), inv_dir);
+        auto closer = is_closer(hr, result, max_t);
+
+        if (any(closer))
+        {
+            tnear[count] = select(closer, hr.tnear, numeric_limits<T>::max());
+            order[count++] = i;
+        }
+    }
+
+    return count;
+}
+
+} // detail
+
+template <
+    detail::traversal_type Traversal,
+    size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
+    typename R,
+    typename BVH,
+    typename = typename std::enable_if<is_wide_bvh<BVH>::value>::type,
+    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value>::type,
+    typename Intersector,
+    typename T = typename R::scalar_type,
+    typename Cond = is_closer_t
+    >
+inline auto intersect(
+        R const&     ray,
+        BVH const&   b,
+        Intersector& isect,
+        T            max_t = numeric_limits<T>::max(),
+        Cond         update_cond = Cond()
+        )
+    -> typename detail::traversal_result< hit_record_bvh<
+            R,
+            decltype( isect(ray, std::declval<typename BVH::primitive_type>()) )
+            >, Traversal, MultiHitMax>::type
+{
+
+    using namespace detail;
+    using HR = hit_record_bvh<R, decltype(isect(ray, std::declval<typename BVH::primitive_type>()))>;
+
+    using RT = typename detail::traversal_result<HR, Traversal, MultiHitMax>::type;
+
+    enum { W = BVH::node_type::Width };
+
+    // Leaves are pushed as (node * W + slot) with the high bit set, so that
+    // children are visited strictly front to back
+    const unsigned LeafBit = 1U << 31;
+
+    // Entries also store the distance to the child box, entries behind
+    // the closest hit found after they were pushed are skipped
+    struct entry
+    {
+        unsigned addr;
+        T        tnear;
+    };
+
+    RT result;
+
+    stack<32 * W, entry> st;
+    st.push({ 0, numeric_limits<T>::lowest() }); // root node
+
+    auto inv_dir = T(1.0) / ray.dir;
+
+    while (!st.empty())
+    {
+        auto e = st.pop();
+
+        if (!any( e.tnear < wide_bvh_cull_distance(result, max_t) ))
+        {
+            continue;
+        }
+
+        unsigned addr = e.addr;
+
+        if (addr & LeafBit)
+        {
+            addr &= ~LeafBit;
+
+            auto const& node = b.node(addr / W);
+            auto indices = node.get_indices(addr % W);
+
+            for (auto i = indices.first; i != indices.last; ++i)
+            {
+                auto prim = b.primitive(i);
+
+                auto hr = HR(isect(ray, prim), i);
+                auto closer = update_cond(hr, result, max_t);
+
+                if (!any(closer))
+                {
+                    continue;
+                }
+
+                update_if(result, hr, closer);
+
+                exit_traversal<Traversal> early_exit;
+                if (early_exit.check(result))
+                {
+                    return result;
+                }
+            }
+
+            continue;
+        }
+
+        auto const& node = b.node(addr);
+
+        unsigned order[W];
+        T tnear[W];
+        unsigned count = intersect_children(ray, inv_dir, node, result, max_t, order, tnear);
+
+        // Push far to near
+        for (unsigned k = count; k > 0; --k)
+        {
+            unsigned i = order[k - 1];
+            st.push({ node.is_leaf(i) ? (addr * W + i) | LeafBit : node.get_child(i), tnear[k - 1] });
+        }
+    }
+
     return result;
 
 }
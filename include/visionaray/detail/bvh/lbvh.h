@@ -8,6 +8,11 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include <visionaray/aligned_vector.h>
 #include <visionaray/morton.h>
@@ -16,6 +21,10 @@
 #include <intrin.h>
 #endif
 
+#include "../parallel_algorithm.h"
+#include "../parallel_for.h"
+#include "../range.h"
+#include "../thread_pool.h"
 #include "build_top_down.h"
 
 namespace visionaray
@@ -35,6 +44,18 @@ inline unsigned clz(unsigned val)
 #endif
 }
 
+VSNRAY_FUNC
+inline unsigned clz(unsigned long long val)
+{
+#if defined(__CUDA_ARCH__) && __CUDA_ARCH__ >= 200
+    return __clzll(val);
+#elif defined(_WIN32)
+    return static_cast<unsigned>(__lzcnt64(val));
+#else
+    return __builtin_clzll(val);
+#endif
+}
+
 } // detail
 
 struct lbvh_builder
@@ -98,14 +119,52 @@ struct lbvh_builder
         return result;
     }
 
+    enum
+    {
+        // Inputs with fewer primitives are processed on the calling thread
+        MinParallelSize = 1 << 12
+    };
+
+    // Number of threads used to build the tree (0: one per hardware thread)
+    unsigned num_threads = 0;
+
+    // Use 63-bit morton codes (21 bits per axis) instead of 30-bit codes
+    bool use_64bit_codes = false;
+
+    void set_num_threads(unsigned value)
+    {
+        num_threads = value;
+    }
+
+    void enable_64bit_codes(bool enable)
+    {
+        use_64bit_codes = enable;
+    }
+
+    // Starts a thread pool with num_threads threads for large inputs, pass a pool to the
+    // overload below to share it between builds
     template <typename Tree, typename P>
     Tree build(Tree /* */, P* primitives, size_t num_prims, int max_leaf_size = -1)
     {
-        Tree tree(primitives, num_prims);
+        unsigned nt = num_threads == 0 ? std::thread::hardware_concurrency() : num_threads;
 
-        detail::build_top_down(tree, *this, primitives, primitives + num_prims, max_leaf_size);
+        std::unique_ptr<thread_pool> pool;
 
-        return tree;
+        if (nt > 1 && num_prims >= MinParallelSize)
+        {
+            pool.reset(new thread_pool(nt));
+        }
+
+        return build_with_pool<Tree>(primitives, num_prims, max_leaf_size, pool.get());
+    }
+
+    // Builds with a thread pool owned by the caller, num_threads is ignored
+    template <typename Tree, typename P>
+    Tree build(Tree /* */, P* primitives, size_t num_prims, thread_pool& pool, int max_leaf_size = -1)
+    {
+        bool parallel = pool.num_threads > 1 && num_prims >= MinParallelSize;
+
+        return build_with_pool<Tree>(primitives, num_prims, max_leaf_size, parallel ? &pool : nullptr);
     }
 
     template <typename I>
@@ -218,6 +277,483 @@ struct lbvh_builder
 
     // TODO:
     bool use_spatial_splits;
+
+private:
+
+    //-------------------------------------------------------------------------
+    // Parallel construction
+    //
+    // cf. Karras (2012): Maximizing Parallelism in the Construction of BVHs,
+    // Octrees, and k-d Trees
+    //
+    // 1. Compute morton codes for the primitive centroids
+    // 2. Sort the primitives with a (parallel) radix sort
+    // 3. Determine the key range and split position of each inner node independently
+    // 4. Fit the bounding boxes in a bottom-up pass
+    // 5. Emit nodes; inner nodes with no more than max_leaf_size primitives become leaves
+    //
+    // The children of the i-th node that is not a leaf are stored at 2i+1 and 2i+2
+    //
+
+    template <typename Code>
+    struct morton_ref
+    {
+        Code code;
+        unsigned id;
+    };
+
+    struct karras_node
+    {
+        int first;  // First sorted primitive (inclusive)
+        int last;   // Last sorted primitive (inclusive)
+        int split;  // Left child covers [first..split], right child covers [split+1..last]
+        int parent; // Parent inner node, -1 for the root
+    };
+
+    // Calls func(range1d<int>) for n items, either in parallel or on the calling thread.
+    template <typename Func>
+    static void for_each_range(thread_pool* pool, int n, Func const& func)
+    {
+        if (n <= 0)
+        {
+            return;
+        }
+
+        if (pool == nullptr)
+        {
+            func(range1d<int>(0, n));
+        }
+        else
+        {
+            parallel_for(*pool, tiled_range1d<int>(0, n, div_up(n, static_cast<int>(pool->num_threads))), func);
+        }
+    }
+
+    // Length of the common prefix of the keys at i and j, -1 if j is out of range.
+    // Duplicate codes are disambiguated by their position in the sorted list.
+    template <typename Code>
+    static int common_prefix(morton_ref<Code> const* refs, int n, int i, int j)
+    {
+        if (j < 0 || j >= n)
+        {
+            return -1;
+        }
+
+        Code ci = refs[i].code;
+        Code cj = refs[j].code;
+
+        if (ci == cj)
+        {
+            return static_cast<int>(sizeof(Code) * 8 + detail::clz(static_cast<unsigned>(i ^ j)));
+        }
+
+        return static_cast<int>(detail::clz(ci ^ cj));
+    }
+
+    template <typename Code>
+    static karras_node determine_range(morton_ref<Code> const* refs, int n, int i)
+    {
+        // Direction of the range
+        int d = common_prefix(refs, n, i, i + 1) - common_prefix(refs, n, i, i - 1) >= 0 ? 1 : -1;
+
+        // Upper bound for the length of the range
+        int delta_min = common_prefix(refs, n, i, i - d);
+        int l_max = 2;
+
+        while (common_prefix(refs, n, i, i + l_max * d) > delta_min)
+        {
+            l_max *= 2;
+        }
+
+        // Find the other end using binary search
+        int l = 0;
+
+        for (int t = l_max / 2; t >= 1; t /= 2)
+        {
+            if (common_prefix(refs, n, i, i + (l + t) * d) > delta_min)
+            {
+                l += t;
+            }
+        }
+
+        int j = i + l * d;
+
+        // Find the split position using binary search
+        int delta_node = common_prefix(refs, n, i, j);
+        int s = 0;
+        int t = l;
+
+        do
+        {
+            t = (t + 1) / 2;
+
+            if (common_prefix(refs, n, i, i + (s + t) * d) > delta_node)
+            {
+                s += t;
+            }
+        }
+        while (t > 1);
+
+        karras_node result;
+        result.first = std::min(i, j);
+        result.last = std::max(i, j);
+        result.split = i + s * d + std::min(d, 0);
+        result.parent = -1;
+        return result;
+    }
+
+    // Builds on the calling thread if pool is nullptr
+    template <typename Tree, typename P>
+    Tree build_with_pool(P* primitives, size_t num_prims, int max_leaf_size, thread_pool* pool)
+    {
+        Tree tree(primitives, num_prims);
+
+        if (max_leaf_size <= 0)
+        {
+            max_leaf_size = 4;
+        }
+
+        if (use_64bit_codes)
+        {
+            build_impl<unsigned long long>(tree, primitives, num_prims, max_leaf_size, pool);
+        }
+        else
+        {
+            build_impl<unsigned>(tree, primitives, num_prims, max_leaf_size, pool);
+        }
+
+        return tree;
+    }
+
+    template <typename Code, typename Tree, typename P>
+    void build_impl(Tree& tree, P* primitives, size_t num_prims, int max_leaf_size, thread_pool* pool)
+    {
+        int n = static_cast<int>(num_prims);
+
+        tree.nodes().clear();
+
+        if (n == 0)
+        {
+            return;
+        }
+
+        // Primitive bounds and centroid bounds
+
+        aligned_vector<aabb> bounds(n);
+
+        int num_chunks = pool == nullptr ? 1 : static_cast<int>(pool->num_threads);
+        int chunk_size = div_up(n, num_chunks);
+
+        std::vector<aabb> chunk_bounds(num_chunks);
+
+        for (auto& cb : chunk_bounds)
+        {
+            cb.invalidate();
+        }
+
+        for_each_range(pool, n, [&](range1d<int> const& r)
+        {
+            auto& cb = chunk_bounds[r.begin() / chunk_size];
+
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                bounds[i] = get_bounds(primitives[i]);
+                cb.insert(bounds[i].center());
+            }
+        });
+
+        aabb centroid_bounds;
+        centroid_bounds.invalidate();
+
+        for (auto const& cb : chunk_bounds)
+        {
+            centroid_bounds.insert(cb);
+        }
+
+
+        // Morton codes
+
+        auto bits_per_axis = std::is_same<Code, unsigned>::value ? 10 : 21;
+        auto scale = static_cast<float>(1 << bits_per_axis);
+        auto size = centroid_bounds.size();
+
+        for (int d = 0; d < 3; ++d)
+        {
+            size[d] = size[d] > 0.0f ? size[d] : 1.0f;
+        }
+
+        aligned_vector<morton_ref<Code>> refs(n);
+
+        for_each_range(pool, n, [&](range1d<int> const& r)
+        {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                // Express centroid in [0..1] relative to bounding box,
+                // quantize to bits_per_axis bits
+                vec3 c = (bounds[i].center() - centroid_bounds.min) / size;
+                c = min(max(c * scale, vec3(0.0f)), vec3(scale - 1.0f));
+
+                auto x = static_cast<unsigned>(c.x);
+                auto y = static_cast<unsigned>(c.y);
+                auto z = static_cast<unsigned>(c.z);
+
+                refs[i].code = encode(x, y, z, Code{});
+                refs[i].id = static_cast<unsigned>(i);
+            }
+        });
+
+
+        // Sort
+
+        if (pool == nullptr)
+        {
+            std::stable_sort(
+                    refs.begin(),
+                    refs.end(),
+                    [](morton_ref<Code> const& a, morton_ref<Code> const& b) { return a.code < b.code; }
+                    );
+        }
+        else
+        {
+            aligned_vector<morton_ref<Code>> temp(n);
+
+            paralgo::radix_sort(
+                    *pool,
+                    refs.begin(),
+                    refs.end(),
+                    temp.begin(),
+                    [](morton_ref<Code> const& ref) { return ref.code; },
+                    bits_per_axis * 3
+                    );
+        }
+
+
+        // Primitive indices in sorted order
+
+        aligned_vector<unsigned> indices(n);
+
+        for_each_range(pool, n, [&](range1d<int> const& r)
+        {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                indices[i] = refs[i].id;
+            }
+        });
+
+        if (n <= max_leaf_size)
+        {
+            aabb root_bounds;
+            root_bounds.invalidate();
+
+            for (int i = 0; i < n; ++i)
+            {
+                root_bounds.insert(bounds[i]);
+            }
+
+            tree.nodes().resize(1);
+            tree.nodes()[0].set_leaf(root_bounds, 0, static_cast<unsigned>(n));
+
+            assign_primitives(tree, primitives, indices, pool, is_index_bvh<Tree>());
+            return;
+        }
+
+
+        // Hierarchy, n leaves and n-1 inner nodes
+
+        aligned_vector<karras_node> inner(n - 1);
+        std::vector<int> leaf_parents(n);
+
+        for_each_range(pool, n - 1, [&](range1d<int> const& r)
+        {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                inner[i] = determine_range(refs.data(), n, i);
+            }
+        });
+
+        // Parent pointers, each node has exactly one parent
+        for_each_range(pool, n - 1, [&](range1d<int> const& r)
+        {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                int s = inner[i].split;
+
+                if (s == inner[i].first)
+                {
+                    leaf_parents[s] = i;
+                }
+                else
+                {
+                    inner[s].parent = i;
+                }
+
+                if (s + 1 == inner[i].last)
+                {
+                    leaf_parents[s + 1] = i;
+                }
+                else
+                {
+                    inner[s + 1].parent = i;
+                }
+            }
+        });
+
+
+        // Bottom-up pass, the second thread to arrive at a node computes its bounds
+
+        aligned_vector<aabb> inner_bounds(n - 1);
+        std::unique_ptr<std::atomic<int>[]> visited(new std::atomic<int>[n - 1]);
+
+        for (int i = 0; i < n - 1; ++i)
+        {
+            visited[i] = 0;
+        }
+
+        auto child_bounds = [&](karras_node const& node, int child) -> aabb const&
+        {
+            int index = node.split + child;
+            bool is_leaf = child == 0 ? index == node.first : index == node.last;
+            return is_leaf ? bounds[refs[index].id] : inner_bounds[index];
+        };
+
+        for_each_range(pool, n, [&](range1d<int> const& r)
+        {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                int p = leaf_parents[i];
+
+                while (p >= 0 && visited[p].fetch_add(1) != 0)
+                {
+                    inner_bounds[p] = combine(child_bounds(inner[p], 0), child_bounds(inner[p], 1));
+                    p = inner[p].parent;
+                }
+            }
+        });
+
+
+        // Emit nodes
+
+        auto is_leaf = [&](karras_node const& node)
+        {
+            return node.last - node.first + 1 <= max_leaf_size;
+        };
+
+        // Position of each expanded inner node among all expanded inner nodes
+        std::vector<int> offsets(n - 1);
+        std::vector<int> chunk_offsets(num_chunks + 1, 0);
+
+        chunk_size = div_up(n - 1, num_chunks);
+
+        for_each_range(pool, n - 1, [&](range1d<int> const& r)
+        {
+            int count = 0;
+
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                offsets[i] = count;
+                count += is_leaf(inner[i]) ? 0 : 1;
+            }
+
+            chunk_offsets[r.begin() / chunk_size + 1] = count;
+        });
+
+        for (int c = 0; c < num_chunks; ++c)
+        {
+            chunk_offsets[c + 1] += chunk_offsets[c];
+        }
+
+        tree.nodes().resize(1 + 2 * chunk_offsets[num_chunks]);
+
+        auto& nodes = tree.nodes();
+
+        for_each_range(pool, n - 1, [&](range1d<int> const& r)
+        {
+            int offset = chunk_offsets[r.begin() / chunk_size];
+
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                auto const& node = inner[i];
+
+                if (is_leaf(node))
+                {
+                    continue;
+                }
+
+                unsigned first_child = 1 + 2 * (offset + offsets[i]);
+
+                if (i == 0)
+                {
+                    nodes[0].set_inner(inner_bounds[0], first_child);
+                }
+
+                for (int c = 0; c < 2; ++c)
+                {
+                    int index = node.split + c;
+                    auto& child = nodes[first_child + c];
+
+                    if (c == 0 ? index == node.first : index == node.last)
+                    {
+                        child.set_leaf(bounds[refs[index].id], index, 1);
+                    }
+                    else if (is_leaf(inner[index]))
+                    {
+                        auto const& sub = inner[index];
+                        child.set_leaf(inner_bounds[index], sub.first, sub.last - sub.first + 1);
+                    }
+                    else
+                    {
+                        child.set_inner(inner_bounds[index], 1 + 2 * (chunk_offsets[index / chunk_size] + offsets[index]));
+                    }
+                }
+            }
+        });
+
+        assign_primitives(tree, primitives, indices, pool, is_index_bvh<Tree>());
+    }
+
+    static unsigned encode(unsigned x, unsigned y, unsigned z, unsigned /* */)
+    {
+        return morton_encode3D(x, y, z);
+    }
+
+    static unsigned long long encode(unsigned x, unsigned y, unsigned z, unsigned long long /* */)
+    {
+        return morton_encode3D_64(x, y, z);
+    }
+
+    template <typename Tree, typename P>
+    static void assign_primitives(
+            Tree&                           tree,
+            P*                              primitives,
+            aligned_vector<unsigned> const& indices,
+            thread_pool*                    pool,
+            std::true_type                  /* is_index_bvh */
+            )
+    {
+        VSNRAY_UNUSED(primitives);
+        VSNRAY_UNUSED(pool);
+
+        tree.indices().assign(indices.begin(), indices.end());
+    }
+
+    template <typename Tree, typename P>
+    static void assign_primitives(
+            Tree&                           tree,
+            P*                              primitives,
+            aligned_vector<unsigned> const& indices,
+            thread_pool*                    pool,
+            std::false_type                 /* is_index_bvh */
+            )
+    {
+        // Store the primitives in sorted order
+        for_each_range(pool, static_cast<int>(indices.size()), [&](range1d<int> const& r)
+        {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                tree.primitives()[i] = primitives[indices[i]];
+            }
+        });
+    }
 };
 
 } // visionaray
@@ -0,0 +1,93 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_BVH_PACK_LEAVES_H
+#define VSNRAY_DETAIL_BVH_PACK_LEAVES_H 1
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include <visionaray/math/triangle.h>
+#include <visionaray/math/triangle_packet.h>
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Pack the triangles of each leaf of a binary BVH into triangle packets
+//
+// Each leaf with n triangles becomes a leaf with ceil(n / N) packets of N triangles
+// (N = PackedTree::primitive_type::Width), the inner nodes are copied unchanged. Building
+// the source BVH with max_leaf_size = N results in one packet per leaf. The packed BVH
+// can be collapsed into a wide BVH afterwards
+//
+// Parameters:
+//
+// [out] dst
+//      Binary bvh_t with basic_triangle_packet primitives
+//
+// [in] src
+//      Binary BVH (bvh_t or index_bvh_t) of triangles built with any of the builders
+//
+
+template <typename PackedTree, typename Tree>
+void pack_leaves(PackedTree& dst, Tree const& src)
+{
+    using packet_type = typename PackedTree::primitive_type;
+    using triangle_type = typename Tree::primitive_type;
+
+    enum { N = packet_type::Width };
+
+    static_assert(
+            std::is_same<packet_type, basic_triangle_packet<N>>::value,
+            "Destination must be a BVH of triangle packets"
+            );
+
+    static_assert(!is_index_bvh<PackedTree>::value, "Destination must not be an index BVH");
+
+    dst.clear(src.num_nodes());
+
+    auto& packets = dst.primitives();
+    auto& nodes = dst.nodes();
+
+    packets.clear();
+    nodes.resize(src.num_nodes());
+
+    std::vector<triangle_type> leaf(N);
+
+    for (size_t i = 0; i < src.num_nodes(); ++i)
+    {
+        auto const& n = src.node(i);
+
+        if (is_inner(n))
+        {
+            nodes[i] = n;
+            continue;
+        }
+
+        auto first_packet = static_cast<unsigned>(packets.size());
+        auto range = n.get_indices();
+
+        for (unsigned first = range.first; first < range.last; first += N)
+        {
+            unsigned count = std::min(static_cast<unsigned>(N), range.last - first);
+
+            for (unsigned j = 0; j < count; ++j)
+            {
+                leaf[j] = src.primitive(first + j);
+            }
+
+            packets.push_back(make_triangle_packet<N>(leaf.data(), count));
+        }
+
+        nodes[i].set_leaf(n.get_bounds(), first_packet, static_cast<unsigned>(packets.size()) - first_packet);
+    }
+}
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_BVH_PACK_LEAVES_H
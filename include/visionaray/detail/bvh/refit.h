@@ -0,0 +1,220 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_BVH_REFIT_H
+#define VSNRAY_DETAIL_BVH_REFIT_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <visionaray/math/aabb.h>
+
+#include "../parallel_for.h"
+#include "../range.h"
+#include "../thread_pool.h"
+#include "statistics.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+template <typename Tree>
+inline void refit_leaf(Tree& tree, size_t index)
+{
+    bvh_node& node = tree.nodes()[index];
+
+    aabb bounds;
+    bounds.invalidate();
+
+    for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+    {
+        bounds.insert(get_bounds(tree.primitive(i)));
+    }
+
+    node.set_leaf(bounds, node.get_first_primitive(), node.get_num_primitives());
+}
+
+template <typename Tree>
+inline void refit_inner(Tree& tree, size_t index)
+{
+    bvh_node& node = tree.nodes()[index];
+
+    aabb bounds = combine(
+            tree.node(node.get_child(0)).get_bounds(),
+            tree.node(node.get_child(1)).get_bounds()
+            );
+
+    node.set_inner(bounds, node.get_child(0));
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Refit a binary BVH after its primitives have moved
+//
+// Recomputes all bounding boxes bottom-up while keeping the tree topology. Update
+// the primitives in place before refitting: tree.primitives() for index BVHs, and
+// the (reordered, see prim_id) primitives stored in the tree for ordinary BVHs.
+// Refitting a BVH that was built with spatial splits yields valid, but unclipped
+// bounds. Wide BVHs are refitted by refitting the binary BVH and collapsing it again
+//
+// Neither version relies on the order in which nodes are stored (the LBVH e.g. does
+// not store children after their parents). The serial version visits the nodes in
+// reverse pre-order, so children are always fitted before their parents. In the
+// parallel version, leaves are fitted in parallel and the second thread to arrive
+// at an inner node combines the bounds of its children and proceeds to the parent
+//
+
+template <typename Tree>
+void refit(Tree& tree)
+{
+    if (tree.num_nodes() == 0)
+    {
+        return;
+    }
+
+    std::vector<unsigned> order;
+    order.reserve(tree.num_nodes());
+
+    std::vector<unsigned> stack(1, 0);
+
+    while (!stack.empty())
+    {
+        unsigned i = stack.back();
+        stack.pop_back();
+
+        order.push_back(i);
+
+        auto const& node = tree.node(i);
+
+        if (is_inner(node))
+        {
+            stack.push_back(node.get_child(0));
+            stack.push_back(node.get_child(1));
+        }
+    }
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        if (is_leaf(tree.node(*it)))
+        {
+            detail::refit_leaf(tree, *it);
+        }
+        else
+        {
+            detail::refit_inner(tree, *it);
+        }
+    }
+}
+
+template <typename Tree>
+void refit(Tree& tree, thread_pool& pool)
+{
+    unsigned n = static_cast<unsigned>(tree.num_nodes());
+
+    if (n == 0 || pool.num_threads <= 1)
+    {
+        refit(tree);
+        return;
+    }
+
+    unsigned tile_size = div_up(n, pool.num_threads * 4);
+
+    std::vector<unsigned> parents(n);
+    std::unique_ptr<std::atomic<int>[]> visited(new std::atomic<int>[n]);
+
+    parents[0] = ~0U;
+
+    parallel_for(pool, tiled_range1d<unsigned>(0, n, tile_size), [&](range1d<unsigned> const& r)
+    {
+        for (unsigned i = r.begin(); i != r.end(); ++i)
+        {
+            auto const& node = tree.node(i);
+
+            visited[i] = 0;
+
+            if (is_inner(node))
+            {
+                parents[node.get_child(0)] = i;
+                parents[node.get_child(1)] = i;
+            }
+        }
+    });
+
+    parallel_for(pool, tiled_range1d<unsigned>(0, n, tile_size), [&](range1d<unsigned> const& r)
+    {
+        for (unsigned i = r.begin(); i != r.end(); ++i)
+        {
+            if (is_inner(tree.node(i)))
+            {
+                continue;
+            }
+
+            detail::refit_leaf(tree, i);
+
+            unsigned p = parents[i];
+
+            while (p != ~0U && visited[p].fetch_add(1) != 0)
+            {
+                detail::refit_inner(tree, p);
+                p = parents[p];
+            }
+        }
+    });
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Refit a BVH, rebuild it with builder if the refit degraded its quality too much
+//
+// Rebuilds when sah_cost(tree) > max_cost_ratio * reference_cost. Pass the SAH cost
+// of the freshly built BVH as reference_cost, it is updated on each rebuild. Returns
+// true if the BVH was rebuilt. The BVH is rebuilt from tree.primitives(), which
+// requires an index BVH or a BVH that was built without spatial splits
+//
+
+template <typename Tree, typename Builder>
+bool refit_or_rebuild(Tree& tree, Builder& builder, float& reference_cost, float max_cost_ratio = 1.5f)
+{
+    refit(tree);
+
+    if (tree.num_nodes() == 0 || sah_cost(tree) <= max_cost_ratio * reference_cost)
+    {
+        return false;
+    }
+
+    tree = builder.build(Tree{}, tree.primitives().data(), tree.num_primitives());
+    reference_cost = sah_cost(tree);
+    return true;
+}
+
+template <typename Tree, typename Builder>
+bool refit_or_rebuild(
+        Tree&        tree,
+        thread_pool& pool,
+        Builder&     builder,
+        float&       reference_cost,
+        float        max_cost_ratio = 1.5f
+        )
+{
+    refit(tree, pool);
+
+    if (tree.num_nodes() == 0 || sah_cost(tree) <= max_cost_ratio * reference_cost)
+    {
+        return false;
+    }
+
+    tree = builder.build(Tree{}, tree.primitives().data(), tree.num_primitives());
+    reference_cost = sah_cost(tree);
+    return true;
+}
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_BVH_REFIT_H
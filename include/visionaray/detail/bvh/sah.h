@@ -7,14 +7,20 @@
 #define VSNRAY_DETAIL_BVH_SAH_H 1
 
 #include <cassert>
+#include <algorithm>
 #include <array>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
 #include <visionaray/math/aabb.h>
+#include <visionaray/math/indexed_triangle.h>
 #include <visionaray/math/sphere.h>
 #include <visionaray/math/triangle.h>
 
+#include "../parallel_for.h"
+#include "../range.h"
+#include "../thread_pool.h"
 #include "build_top_down.h"
 
 namespace visionaray
@@ -65,6 +71,12 @@ void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_triangle<Dim
     detail::split_edge(L, R, v2, v0, plane, axis);
 }
 
+template <typename T, typename P>
+void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_indexed_triangle_ref<T, P> const& prim)
+{
+    split_primitive(L, R, plane, axis, get_triangle(prim));
+}
+
 template <typename T, typename P>
 void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_sphere<T, P> const& prim)
 {
@@ -134,12 +146,15 @@ template <
     >
 void split_primitive(aabb& L, aabb& R, float plane, int axis, BVH const& bvh)
 {
-    VSNRAY_UNUSED(L);
-    VSNRAY_UNUSED(R);
     VSNRAY_UNUSED(plane);
     VSNRAY_UNUSED(axis);
     VSNRAY_UNUSED(bvh);
 
+    // The split builder is instantiated for BVHs of instances even if spatial
+    // splits are disabled, return empty boxes in release builds
+    L.invalidate();
+    R.invalidate();
+
     assert(0 && "not implemented");
 }
 
@@ -186,12 +201,53 @@ struct binned_sah_builder
 
     using prim_refs = aligned_vector<prim_ref>;
 
+    // Starts a thread pool with num_threads threads for large inputs, pass a pool to the
+    // overload below to share it between builds
     template <typename Tree, typename P>
     Tree build(Tree /* */, P* primitives, size_t num_prims, int max_leaf_size = -1)
+    {
+        unsigned nt = num_threads == 0 ? std::thread::hardware_concurrency() : num_threads;
+
+        if (nt > 1 && num_prims > MinTaskSize)
+        {
+            thread_pool pool(nt);
+
+            return build(Tree{}, primitives, num_prims, pool, max_leaf_size);
+        }
+        else
+        {
+            Tree tree(primitives, num_prims);
+
+            detail::build_top_down(tree, *this, primitives, primitives + num_prims, max_leaf_size);
+
+            return tree;
+        }
+    }
+
+    // Builds with a thread pool owned by the caller, num_threads is ignored
+    template <typename Tree, typename P>
+    Tree build(Tree /* */, P* primitives, size_t num_prims, thread_pool& pool, int max_leaf_size = -1)
     {
         Tree tree(primitives, num_prims);
 
-        detail::build_top_down(tree, *this, primitives, primitives + num_prims, max_leaf_size);
+        unsigned nt = pool.num_threads;
+
+        if (nt > 1 && num_prims > MinTaskSize)
+        {
+            detail::build_top_down_parallel(
+                    tree,
+                    *this,
+                    pool,
+                    primitives,
+                    primitives + num_prims,
+                    max_leaf_size,
+                    std::max(static_cast<int>(num_prims / (8 * nt)), static_cast<int>(MinTaskSize))
+                    );
+        }
+        else
+        {
+            detail::build_top_down(tree, *this, primitives, primitives + num_prims, max_leaf_size);
+        }
 
         return tree;
     }
@@ -213,9 +269,63 @@ struct binned_sah_builder
         }
     }
 
+    template <typename I>
+    static void init(prim_refs& refs, aabb& prim_bounds, aabb& cent_bounds, I first, I last, thread_pool& pool)
+    {
+        refs.resize(last - first);
+
+        prim_bounds.invalidate();
+        cent_bounds.invalidate();
+
+        int len = static_cast<int>(last - first);
+
+        if (len == 0)
+        {
+            return;
+        }
+
+        int chunk_size = div_up(len, static_cast<int>(pool.num_threads));
+
+        std::vector<aabb> chunk_prim_bounds(pool.num_threads);
+        std::vector<aabb> chunk_cent_bounds(pool.num_threads);
+
+        parallel_for(
+            pool,
+            tiled_range1d<int>(0, len, chunk_size),
+            [&](range1d<int> const& r)
+            {
+                auto& pb = chunk_prim_bounds[r.begin() / chunk_size];
+                auto& cb = chunk_cent_bounds[r.begin() / chunk_size];
+
+                pb.invalidate();
+                cb.invalidate();
+
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    refs[i].assign(first[i], i);
+
+                    pb.insert(refs[i].bounds);
+                    cb.insert(refs[i].bounds.center());
+                }
+            });
+
+        for (int i = 0; i < div_up(len, chunk_size); ++i)
+        {
+            prim_bounds.insert(chunk_prim_bounds[i]);
+            cent_bounds.insert(chunk_cent_bounds[i]);
+        }
+    }
+
     enum
     {
-        NumBins = 16
+        NumBins = 16,
+
+        // Subtrees with fewer primitive references are built on a single thread
+        MinTaskSize = 1 << 12,
+
+        // Nodes with at least this many primitive references are binned
+        // and partitioned in parallel
+        ParallelThreshold = 1 << 16
     };
 
     struct bin
@@ -429,6 +539,63 @@ struct binned_sah_builder
         return find_split(bins, leaf.prim_bounds);
     }
 
+    // Bins the primitive references of a leaf in parallel. Each thread bins a
+    // contiguous chunk of references, the partial results are merged afterwards.
+    template <typename Func>
+    static bin_list parallel_binning(prim_refs const& refs, leaf_info const& leaf, thread_pool& pool, Func func)
+    {
+        int len = static_cast<int>(refs.size()) - leaf.first;
+        int chunk_size = div_up(len, static_cast<int>(pool.num_threads));
+        int num_chunks = div_up(len, chunk_size);
+
+        std::vector<bin_list> chunk_bins(num_chunks);
+
+        parallel_for(
+            pool,
+            tiled_range1d<int>(leaf.first, static_cast<int>(refs.size()), chunk_size),
+            [&](range1d<int> const& r)
+            {
+                auto& bins = chunk_bins[(r.begin() - leaf.first) / chunk_size];
+
+                for (auto& b : bins)
+                {
+                    b.clear();
+                }
+
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    func(bins, refs[i]);
+                }
+            });
+
+        bin_list bins = chunk_bins[0];
+
+        for (int c = 1; c < num_chunks; ++c)
+        {
+            for (int i = 0; i < NumBins; ++i)
+            {
+                bins[i] = merge(bins[i], chunk_bins[c][i]);
+            }
+        }
+
+        return bins;
+    }
+
+    static split_result find_object_split(prim_refs& refs, leaf_info const& leaf, projection pr, thread_pool& pool)
+    {
+        auto bins = parallel_binning(
+                refs,
+                leaf,
+                pool,
+                [&](bin_list& b, prim_ref const& ref)
+                {
+                    project_object(b, ref, pr);
+                }
+                );
+
+        return find_split(bins, leaf.prim_bounds);
+    }
+
     // Partition the given list of objects
     static void perform_object_partition(
         leaf_infos& childs, split_result const& sr, prim_refs& refs, leaf_info const& leaf, projection pr)
@@ -451,6 +618,92 @@ struct binned_sah_builder
         childs[1].first = static_cast<int>(pivot - refs.begin());
     }
 
+    // Partition the given list of objects in parallel.
+    // Each thread counts the references in its chunk that go to the left leaf, the
+    // references are then scattered to their final positions using the prefix sums.
+    static void perform_object_partition(
+        leaf_infos& childs, split_result const& sr, prim_refs& refs, leaf_info const& leaf, projection pr,
+        thread_pool& pool)
+    {
+        childs[0].prim_bounds = sr.prim_bounds[0];
+        childs[0].cent_bounds = sr.cent_bounds[0];
+        childs[1].prim_bounds = sr.prim_bounds[1];
+        childs[1].cent_bounds = sr.cent_bounds[1];
+
+        auto is_left = [&](prim_ref const& x)
+        {
+            return pr.project_unsafe(x.bounds.center()) < sr.index;
+        };
+
+        int len = static_cast<int>(refs.size()) - leaf.first;
+        int chunk_size = div_up(len, static_cast<int>(pool.num_threads));
+        int num_chunks = div_up(len, chunk_size);
+
+        tiled_range1d<int> range(leaf.first, static_cast<int>(refs.size()), chunk_size);
+
+        std::vector<int> num_left(num_chunks);
+
+        parallel_for(
+            pool,
+            range,
+            [&](range1d<int> const& r)
+            {
+                int n = 0;
+
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    n += is_left(refs[i]) ? 1 : 0;
+                }
+
+                num_left[(r.begin() - leaf.first) / chunk_size] = n;
+            });
+
+        std::vector<int> left_offsets(num_chunks);
+        std::vector<int> right_offsets(num_chunks);
+
+        int total_left = 0;
+
+        for (int c = 0; c < num_chunks; ++c)
+        {
+            left_offsets[c] = total_left;
+            total_left += num_left[c];
+        }
+
+        for (int c = 0; c < num_chunks; ++c)
+        {
+            right_offsets[c] = total_left + c * chunk_size - left_offsets[c];
+        }
+
+        prim_refs temp(len);
+
+        parallel_for(
+            pool,
+            range,
+            [&](range1d<int> const& r)
+            {
+                int c = (r.begin() - leaf.first) / chunk_size;
+                int l = left_offsets[c];
+                int h = right_offsets[c];
+
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    if (is_left(refs[i]))
+                    {
+                        temp[l++] = refs[i];
+                    }
+                    else
+                    {
+                        temp[h++] = refs[i];
+                    }
+                }
+            });
+
+        std::copy(temp.begin(), temp.end(), refs.begin() + leaf.first);
+
+        childs[0].first = leaf.first;
+        childs[1].first = leaf.first + total_left;
+    }
+
     //--------------------------------------------------------------------------
     // spatial split
     //
@@ -527,6 +780,28 @@ struct binned_sah_builder
         return find_split(bins, leaf.prim_bounds);
     }
 
+    template <typename Data>
+    static split_result find_spatial_split(
+            prim_refs const&    refs,
+            leaf_info const&    leaf,
+            projection          pr,
+            Data const&         data,
+            thread_pool&        pool
+            )
+    {
+        auto bins = parallel_binning(
+                refs,
+                leaf,
+                pool,
+                [&](bin_list& b, prim_ref const& ref)
+                {
+                    split_object(b, ref, pr, data);
+                }
+                );
+
+        return find_split(bins, leaf.prim_bounds);
+    }
+
     template <typename Data>
     static void perform_spatial_split(
             leaf_infos&         childs,
@@ -657,6 +932,8 @@ struct binned_sah_builder
     float alpha = 1.0e-5f;
     // Whether to use spatial splits
     bool use_spatial_splits = false;
+    // Number of threads used to build the tree (0: one per hardware thread)
+    unsigned num_threads = 0;
 
     void set_alpha(float value)
     {
@@ -668,6 +945,11 @@ struct binned_sah_builder
         use_spatial_splits = enable;
     }
 
+    void set_num_threads(unsigned value)
+    {
+        num_threads = value;
+    }
+
     template <typename I>
     leaf_info init(I first, I last)
     {
@@ -681,6 +963,43 @@ struct binned_sah_builder
         return { prim_bounds, cent_bounds, 0 };
     }
 
+    template <typename I>
+    leaf_info init(I first, I last, thread_pool& pool)
+    {
+        aabb prim_bounds;
+        aabb cent_bounds;
+
+        init(refs, prim_bounds, cent_bounds, first, last, pool);
+
+        sa_threshold = alpha * safe_surface_area(prim_bounds);
+
+        return { prim_bounds, cent_bounds, 0 };
+    }
+
+    // Returns the number of primitive references in the given leaf.
+    int leaf_size(leaf_info const& leaf) const
+    {
+        return static_cast<int>(refs.size() - leaf.first);
+    }
+
+    // Moves the primitive references of the given leaf to a new builder so that
+    // the subtree can be built independently. Removes the references from the
+    // current list just like insert_indices() does.
+    void detach(binned_sah_builder& sub, leaf_info& sub_leaf, leaf_info const& leaf)
+    {
+        sub.sa_threshold = sa_threshold;
+        sub.alpha = alpha;
+        sub.use_spatial_splits = use_spatial_splits;
+        sub.num_threads = 1;
+
+        sub.refs.assign(refs.begin() + leaf.first, refs.end());
+
+        sub_leaf = leaf;
+        sub_leaf.first = 0;
+
+        refs.resize(leaf.first);
+    }
+
     // Inserts primitive indices into INDICES and removes them from the current list.
     template <typename Indices>
     int insert_indices(Indices& indices, leaf_info const& leaf)
@@ -704,6 +1023,19 @@ struct binned_sah_builder
     // method returns true. If the leaf should not be split, returns false.
     template <typename Data>
     bool split(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size)
+    {
+        return split_impl(childs, leaf, data, max_leaf_size, nullptr);
+    }
+
+    // Same as above, large nodes are binned and partitioned using the thread pool.
+    template <typename Data>
+    bool split(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size, thread_pool& pool)
+    {
+        return split_impl(childs, leaf, data, max_leaf_size, &pool);
+    }
+
+    template <typename Data>
+    bool split_impl(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size, thread_pool* pool)
     {
         // FIXME:
         // Create a leaf if max_depth is reached...
@@ -716,6 +1048,8 @@ struct binned_sah_builder
             return false;
         }
 
+        bool parallel = pool != nullptr && leaf_size >= ParallelThreshold;
+
         // Find the split axis (TODO: Test all axes...)
 
         // Using centroid bounds for object partitioning...
@@ -731,7 +1065,9 @@ struct binned_sah_builder
 
         projection pr(leaf.cent_bounds, static_cast<int>(axis));
 
-        auto sr = find_object_split(refs, leaf, pr);
+        auto sr = parallel
+                ? find_object_split(refs, leaf, pr, *pool)
+                : find_object_split(refs, leaf, pr);
 
         // Spatial split -------------------------------------------------------
 
@@ -754,7 +1090,9 @@ struct binned_sah_builder
 
                 projection pr2(leaf.prim_bounds, static_cast<int>(axis));
 
-                auto sr2 = find_spatial_split(refs, leaf, pr2, data);
+                auto sr2 = parallel
+                        ? find_spatial_split(refs, leaf, pr2, data, *pool)
+                        : find_spatial_split(refs, leaf, pr2, data);
 
                 if (sr2.cost < sr.cost /* && (sr2.count[0] + sr2.count[1] < 1.5 * leaf_size) */)
                 {
@@ -781,6 +1119,10 @@ struct binned_sah_builder
         {
             perform_spatial_split(childs, sr, refs, leaf, pr, data);
         }
+        else if (parallel)
+        {
+            perform_object_partition(childs, sr, refs, leaf, pr, *pool);
+        }
         else
         {
             perform_object_partition(childs, sr, refs, leaf, pr);
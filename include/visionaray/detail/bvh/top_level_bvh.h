@@ -0,0 +1,475 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_BVH_TOP_LEVEL_BVH_H
+#define VSNRAY_DETAIL_BVH_TOP_LEVEL_BVH_H 1
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <visionaray/math/aabb.h>
+#include <visionaray/math/matrix.h>
+#include <visionaray/aligned_vector.h>
+
+#include "../thread_pool.h"
+#include "refit.h"
+#include "sah.h"
+#include "statistics.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Top-level BVH over BVH instances that supports in-place updates
+//
+// Instances are identified by the id returned from add(). Ids of removed instances
+// are reused. The instance list (tree().primitives()) is indexed by id, so that the
+// underlying index BVH can be traversed like any other top-level BVH.
+//
+// Edits are applied to the tree topology immediately:
+//  - add() inserts a new leaf next to the leaf whose bounds grow the least
+//  - remove() drops the instance from its leaf, empty leaves are replaced by their sibling
+//  - set_transform() only marks the leaf as dirty
+// update() then refits the dirty paths (or the whole tree, if many instances changed)
+// and rebuilds the tree with the SAH builder if the SAH cost degraded by more than
+// max_cost_ratio, or if the edits left too many unreachable nodes behind.
+//
+// The forward transforms are kept in a compact side table of affine 3x4 matrices,
+// the instances themselves only store the inverse transform needed for traversal.
+//
+
+template <typename Inst>
+class top_level_bvh
+{
+public:
+
+    using instance_type  = Inst;
+    using tree_type      = index_bvh<Inst>;
+    using blas_ref       = decltype(std::declval<Inst>().get_ref());
+    using transform_type = matrix<3, 4, float>;
+
+    // Binary traversal uses a stack with 32 entries, trees that grow deeper
+    // due to insertions are rebuilt
+    enum { MaxDepth = 30 };
+
+public:
+
+    top_level_bvh() = default;
+
+    // Add an instance of a bottom-level BVH, returns the id of the instance
+    unsigned add(blas_ref const& ref, mat4 const& transform)
+    {
+        unsigned id = 0;
+
+        if (free_ids_.empty())
+        {
+            id = static_cast<unsigned>(tree_.primitives().size());
+            tree_.primitives().emplace_back(ref, transform);
+            transforms_.push_back(to_affine(transform));
+            leaf_of_.push_back(~0U);
+            active_.push_back(true);
+        }
+        else
+        {
+            id = free_ids_.back();
+            free_ids_.pop_back();
+            tree_.primitives()[id] = Inst(ref, transform);
+            transforms_[id] = to_affine(transform);
+            active_[id] = true;
+        }
+
+        ++num_instances_;
+
+        // Many insertions at once (including the initial ones): rebuild
+        if (tree_.num_nodes() == 0 || 4 * (num_edits_++) > num_instances_)
+        {
+            needs_rebuild_ = true;
+        }
+
+        if (!needs_rebuild_)
+        {
+            insert(id);
+        }
+
+        return id;
+    }
+
+    void remove(unsigned id)
+    {
+        assert(is_active(id));
+
+        if (!needs_rebuild_)
+        {
+            erase(id);
+        }
+
+        leaf_of_[id] = ~0U;
+        active_[id] = false;
+        free_ids_.push_back(id);
+        --num_instances_;
+    }
+
+    void set_transform(unsigned id, mat4 const& transform)
+    {
+        assert(is_active(id));
+
+        tree_.primitives()[id] = Inst(tree_.primitives()[id].get_ref(), transform);
+        transforms_[id] = to_affine(transform);
+
+        if (!needs_rebuild_)
+        {
+            dirty_.push_back(leaf_of_[id]);
+        }
+    }
+
+    mat4 transform(unsigned id) const
+    {
+        transform_type const& t = transforms_[id];
+
+        return mat4(
+                vec4(t(0), 0.0f),
+                vec4(t(1), 0.0f),
+                vec4(t(2), 0.0f),
+                vec4(t(3), 1.0f)
+                );
+    }
+
+    aligned_vector<transform_type> const& transforms() const
+    {
+        return transforms_;
+    }
+
+    bool is_active(unsigned id) const
+    {
+        return id < active_.size() && active_[id];
+    }
+
+    size_t num_instances() const
+    {
+        return num_instances_;
+    }
+
+    // Apply pending edits, returns true if the tree was rebuilt
+    bool update()
+    {
+        num_edits_ = 0;
+
+        if (needs_rebuild_ || 2 * num_dead_nodes_ > tree_.num_nodes())
+        {
+            rebuild();
+            return true;
+        }
+
+        if (dirty_.empty())
+        {
+            return false;
+        }
+
+        if (8 * dirty_.size() > tree_.num_nodes())
+        {
+            if (num_dead_nodes_ == 0)
+            {
+                refit(tree_, get_pool());
+            }
+            else
+            {
+                // Parent pointers of the unreachable nodes are stale,
+                // the serial version only visits nodes reachable from the root
+                refit(tree_);
+            }
+        }
+        else
+        {
+            for (unsigned n : dirty_)
+            {
+                for (; n != ~0U; n = parents_[n])
+                {
+                    if (is_leaf(tree_.node(n)))
+                    {
+                        detail::refit_leaf(tree_, n);
+                    }
+                    else
+                    {
+                        detail::refit_inner(tree_, n);
+                    }
+                }
+            }
+        }
+
+        dirty_.clear();
+
+        if (cost() > max_cost_ratio_ * reference_cost_)
+        {
+            rebuild();
+            return true;
+        }
+
+        return false;
+    }
+
+    tree_type const& tree() const
+    {
+        return tree_;
+    }
+
+    typename tree_type::bvh_ref ref() const
+    {
+        return tree_.ref();
+    }
+
+    void set_max_cost_ratio(float ratio)
+    {
+        max_cost_ratio_ = ratio;
+    }
+
+    void set_num_threads(unsigned num_threads)
+    {
+        num_threads_ = num_threads;
+        pool_.reset();
+    }
+
+private:
+
+    tree_type tree_;
+
+    // Forward transforms, indexed by instance id
+    aligned_vector<transform_type> transforms_;
+
+    // Leaf that references an instance, ~0U if the instance was removed
+    std::vector<unsigned> leaf_of_;
+
+    // Parent of each node, ~0U for the root
+    std::vector<unsigned> parents_;
+
+    // Nodes whose bounds need to be refitted
+    std::vector<unsigned> dirty_;
+
+    std::vector<bool> active_;
+    std::vector<unsigned> free_ids_;
+
+    size_t num_instances_ = 0;
+    size_t num_edits_ = 0;
+    size_t num_dead_nodes_ = 0;
+
+    bool needs_rebuild_ = true;
+
+    float reference_cost_ = 0.0f;
+    float max_cost_ratio_ = 1.5f;
+
+    unsigned num_threads_ = 0;
+    std::unique_ptr<thread_pool> pool_;
+
+
+    static transform_type to_affine(mat4 const& m)
+    {
+        transform_type result;
+        result(0) = m.col0.xyz();
+        result(1) = m.col1.xyz();
+        result(2) = m.col2.xyz();
+        result(3) = m.col3.xyz();
+        return result;
+    }
+
+    thread_pool& get_pool()
+    {
+        if (pool_ == nullptr)
+        {
+            unsigned nt = num_threads_ == 0 ? std::thread::hardware_concurrency() : num_threads_;
+            pool_.reset(new thread_pool(std::max(nt, 1U)));
+        }
+
+        return *pool_;
+    }
+
+    // SAH cost of the nodes reachable from the root
+    float cost() const
+    {
+        if (tree_.num_nodes() == 0)
+        {
+            return 0.0f;
+        }
+
+        float A_r = surface_area(tree_.node(0).get_bounds());
+        return A_r > 0.0f ? sah_cost(tree_, tree_.node(0)) / A_r : 0.0f;
+    }
+
+    void insert(unsigned id)
+    {
+        aabb bounds = get_bounds(tree_.primitives()[id]);
+
+        // Descend to the leaf whose surface area grows the least
+        unsigned n = 0;
+        unsigned depth = 0;
+
+        while (is_inner(tree_.node(n)))
+        {
+            unsigned c0 = tree_.node(n).get_child(0);
+            unsigned c1 = tree_.node(n).get_child(1);
+
+            aabb b0 = tree_.node(c0).get_bounds();
+            aabb b1 = tree_.node(c1).get_bounds();
+
+            float d0 = surface_area(combine(b0, bounds)) - surface_area(b0);
+            float d1 = surface_area(combine(b1, bounds)) - surface_area(b1);
+
+            n = d0 <= d1 ? c0 : c1;
+            ++depth;
+        }
+
+        // Turn the leaf into an inner node with the old leaf and a new leaf as children
+        auto first_child = static_cast<unsigned>(tree_.num_nodes());
+
+        bvh_node old_leaf = tree_.node(n);
+
+        bvh_node new_leaf;
+        new_leaf.set_leaf(bounds, static_cast<unsigned>(tree_.indices().size()), 1);
+        tree_.indices().push_back(id);
+
+        tree_.nodes().push_back(old_leaf);
+        tree_.nodes().push_back(new_leaf);
+        tree_.nodes()[n].set_inner(combine(old_leaf.get_bounds(), bounds), first_child);
+
+        parents_.push_back(n);
+        parents_.push_back(n);
+
+        for (auto i = old_leaf.get_indices().first; i != old_leaf.get_indices().last; ++i)
+        {
+            leaf_of_[tree_.indices()[i]] = first_child;
+        }
+
+        leaf_of_[id] = first_child + 1;
+
+        // The old leaf may be dirty (e.g. after set_transform()), its copy is now
+        std::replace(dirty_.begin(), dirty_.end(), n, first_child);
+        dirty_.push_back(first_child + 1);
+
+        if (depth + 1 > MaxDepth)
+        {
+            needs_rebuild_ = true;
+        }
+    }
+
+    void erase(unsigned id)
+    {
+        unsigned n = leaf_of_[id];
+        bvh_node& leaf = tree_.nodes()[n];
+
+        if (leaf.get_num_primitives() > 1)
+        {
+            // Swap with the last index of the leaf and shrink the leaf
+            auto first = leaf.get_indices().first;
+            auto last = leaf.get_indices().last;
+            auto it = std::find(tree_.indices().begin() + first, tree_.indices().begin() + last, id);
+            std::swap(*it, tree_.indices()[last - 1]);
+            aabb bounds = leaf.get_bounds();
+            leaf.set_leaf(bounds, first, leaf.get_num_primitives() - 1);
+            dirty_.push_back(n);
+            return;
+        }
+
+        if (n == 0)
+        {
+            // Removed the last instance
+            needs_rebuild_ = true;
+            return;
+        }
+
+        // Replace the parent by the sibling, the leaf and the sibling become unreachable
+        unsigned p = parents_[n];
+        auto const& parent = tree_.node(p);
+        unsigned s = parent.get_child(0) == n ? parent.get_child(1) : parent.get_child(0);
+
+        tree_.nodes()[p] = tree_.node(s);
+
+        auto const& node = tree_.node(p);
+
+        if (is_inner(node))
+        {
+            parents_[node.get_child(0)] = p;
+            parents_[node.get_child(1)] = p;
+        }
+        else
+        {
+            for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+            {
+                leaf_of_[tree_.indices()[i]] = p;
+            }
+        }
+
+        num_dead_nodes_ += 2;
+        dirty_.push_back(p);
+    }
+
+    void rebuild()
+    {
+        aligned_vector<Inst> active;
+        std::vector<unsigned> ids;
+
+        for (unsigned id = 0; id < leaf_of_.size(); ++id)
+        {
+            leaf_of_[id] = ~0U;
+
+            if (active_[id])
+            {
+                active.push_back(tree_.primitives()[id]);
+                ids.push_back(id);
+            }
+        }
+
+        tree_type tree;
+
+        if (!active.empty())
+        {
+            binned_sah_builder builder;
+            builder.enable_spatial_splits(false);
+
+            // Same pool as for the refits
+            tree = builder.build(tree_type{}, active.data(), active.size(), get_pool());
+
+            // Map indices into the list of active instances to instance ids
+            for (auto& i : tree.indices())
+            {
+                i = ids[i];
+            }
+        }
+
+        tree.primitives() = std::move(tree_.primitives());
+        tree_ = std::move(tree);
+
+        parents_.assign(tree_.num_nodes(), ~0U);
+
+        for (unsigned n = 0; n < tree_.num_nodes(); ++n)
+        {
+            auto const& node = tree_.node(n);
+
+            if (is_inner(node))
+            {
+                parents_[node.get_child(0)] = n;
+                parents_[node.get_child(1)] = n;
+            }
+            else
+            {
+                for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+                {
+                    leaf_of_[tree_.indices()[i]] = n;
+                }
+            }
+        }
+
+        dirty_.clear();
+        num_dead_nodes_ = 0;
+        needs_rebuild_ = false;
+        reference_cost_ = cost();
+    }
+};
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_BVH_TOP_LEVEL_BVH_H
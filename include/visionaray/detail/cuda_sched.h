@@ -38,10 +38,17 @@ public:
     template <typename K, typename SP>
     void frame(K kernel, SP sched_params, size_t smem = 0, cudaStream_t const& stream = 0);
 
+    // Number of the next frame, part of the keys of the random generators.
+    // Images rendered with the same frame number are reproducible
+    unsigned frame_num() const;
+    void set_frame_num(unsigned frame_num);
+
 private:
 
     vec2ui block_size_ = vec2ui(16, 16);
 
+    unsigned frame_num_ = 0;
+
 };
 
 } // visionaray
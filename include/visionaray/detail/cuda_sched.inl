@@ -18,35 +18,6 @@ namespace visionaray
 namespace detail
 {
 
-//-------------------------------------------------------------------------------------------------
-// RNG seed
-//
-
-// https://code.google.com/p/thrust/source/browse/examples/monte_carlo.cu
-
-VSNRAY_GPU_FUNC
-inline unsigned cuda_hash(unsigned a)
-{
-    a = (a + 0x7ed55d16) + (a << 12);
-    a = (a ^ 0xc761c23c) ^ (a >> 19);
-    a = (a + 0x165667b1) + (a << 5);
-    a = (a + 0xd3a2646c) ^ (a << 9);
-    a = (a + 0xfd7046c5) + (a << 3);
-    a = (a ^ 0xb55a4f09) ^ (a >> 16);
-    return a;
-}
-
-VSNRAY_GPU_FUNC
-inline unsigned cuda_seed()
-{
-    unsigned x = blockIdx.x * blockDim.x + threadIdx.x;
-    unsigned y = blockIdx.y * blockDim.y + threadIdx.y;
-    unsigned w = blockDim.x * gridDim.x;
-
-    return cuda_hash(tic(float{} /*TODO*/) + y * w + x);
-}
-
-
 //-------------------------------------------------------------------------------------------------
 // CUDA kernels
 //
@@ -64,6 +35,7 @@ __global__ void render(
         Rect            scissor_box,
         RTRef           rt_ref,
         K               kernel,
+        unsigned        frame_num,
         Args...         args
         )
 {
@@ -78,7 +50,9 @@ __global__ void render(
     auto gen = make_generator(
             typename R::scalar_type{},
             sample_params,
-            detail::cuda_seed()
+            detail::pixel_key(float{}, x, y),
+            0U,
+            frame_num
             );
 
     auto r = detail::make_primary_rays(
@@ -118,6 +92,7 @@ __global__ void render(
         Rect                            scissor_box,
         RTRef                           rt_ref,
         K                               kernel,
+        unsigned                        frame_num,
         Args...                         args
         )
 {
@@ -130,7 +105,7 @@ __global__ void render(
     }
 
     // TODO: support any sampler
-    random_generator<typename R::scalar_type> gen(detail::cuda_seed());
+    random_generator<typename R::scalar_type> gen(detail::pixel_key(float{}, x, y), 0U, frame_num);
 
     auto r = detail::make_primary_rays(
             R{},
@@ -205,6 +180,7 @@ template <typename R, typename K, typename SP>
 inline void cuda_sched_impl_frame(
         K                   kernel,
         SP                  sparams,
+        unsigned            frame_num,
         dim3 const&         block_size,
         size_t              smem,
         cudaStream_t const& stream
@@ -230,6 +206,7 @@ inline void cuda_sched_impl_frame(
             sparams.scissor_box,
             sparams.rt.ref(),
             kernel,
+            frame_num,
             sparams.rt.width(),
             sparams.rt.height(),
             sparams.cam
@@ -266,6 +243,7 @@ void cuda_sched<R>::frame(K kernel, SP sched_params, size_t smem, cudaStream_t c
     detail::cuda_sched_impl_frame<R>(
             kernel,
             sched_params,
+            frame_num_++,
             dim3(block_size_.x, block_size_.y),
             smem,
             stream
@@ -276,4 +254,16 @@ void cuda_sched<R>::frame(K kernel, SP sched_params, size_t smem, cudaStream_t c
     sched_params.cam.end_frame();
 }
 
+template <typename R>
+unsigned cuda_sched<R>::frame_num() const
+{
+    return frame_num_;
+}
+
+template <typename R>
+void cuda_sched<R>::set_frame_num(unsigned frame_num)
+{
+    frame_num_ = frame_num;
+}
+
 } // visionaray
@@ -1,6 +1,14 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <cstddef>
+#include <vector>
+
+#include <visionaray/math/constants.h>
+#include <visionaray/texture/texture.h>
+
+#include "color_conversion.h"
+
 namespace visionaray
 {
 
@@ -54,6 +62,89 @@ matrix<4, 4, T> environment_light<T, Texture>::world_to_light_transform() const
     return world_to_light_transform_;
 }
 
+template <typename T, typename Texture>
+template <typename U>
+VSNRAY_FUNC
+vector<2, U> environment_light<T, Texture>::tex_coord(vector<3, U> const& dir) const
+{
+    auto d = (matrix<4, 4, U>(world_to_light_transform_) * vector<4, U>(dir, U(0.0))).xyz();
+    d = normalize(d);
+
+    auto x = atan2(d.x, d.z);
+    x = select(x < U(0.0), x + constants::two_pi<U>(), x);
+    auto y = acos(clamp(d.y, U(-1.0), U(1.0)));
+
+    return vector<2, U>(x / constants::two_pi<U>(), y * constants::inv_pi<U>());
+}
+
+template <typename T, typename Texture>
+template <typename U>
+VSNRAY_FUNC
+vector<3, U> environment_light<T, Texture>::intensity(vector<3, U> const& dir) const
+{
+    auto tc = tex_coord(dir);
+    return (tex2D(texture_, tc) * vector<4, U>(to_rgba(scale_))).xyz();
+}
+
+template <typename T, typename Texture>
+VSNRAY_FUNC
+void environment_light<T, Texture>::set_distribution(distribution_2d_ref const& distribution)
+{
+    distribution_ = distribution;
+}
+
+template <typename T, typename Texture>
+VSNRAY_FUNC
+distribution_2d_ref const& environment_light<T, Texture>::distribution() const
+{
+    return distribution_;
+}
+
+template <typename T, typename Texture>
+template <typename Generator, typename U>
+VSNRAY_FUNC
+vector<3, U> environment_light<T, Texture>::sample(Generator& gen, U& pdf) const
+{
+    U u1 = gen.next();
+    U u2 = gen.next();
+    vector<2, U> u(u1, u2);
+
+    U map_pdf;
+    auto tc = distribution_.sample(u, map_pdf);
+
+    auto phi = tc.x * constants::two_pi<U>();
+    auto theta = tc.y * constants::pi<U>();
+    auto sin_theta = sin(theta);
+
+    vector<3, U> d(sin_theta * sin(phi), cos(theta), sin_theta * cos(phi));
+
+    // Map from [0,1)^2 to the sphere: dA = sin(theta) dtheta dphi / (2 pi^2)
+    pdf = select(
+        sin_theta > U(0.0),
+        map_pdf / (U(2.0) * constants::pi<U>() * constants::pi<U>() * sin_theta),
+        U(0.0)
+        );
+
+    return normalize((matrix<4, 4, U>(light_to_world_transform_) * vector<4, U>(d, U(0.0))).xyz());
+}
+
+template <typename T, typename Texture>
+template <typename U>
+VSNRAY_FUNC
+U environment_light<T, Texture>::pdf(vector<3, U> const& dir) const
+{
+    auto tc = tex_coord(dir);
+
+    auto d = normalize((matrix<4, 4, U>(world_to_light_transform_) * vector<4, U>(dir, U(0.0))).xyz());
+    auto sin_theta = sqrt(max(U(0.0), U(1.0) - d.y * d.y));
+
+    return select(
+        sin_theta > U(0.0),
+        distribution_.pdf(tc) / (U(2.0) * constants::pi<U>() * constants::pi<U>() * sin_theta),
+        U(0.0)
+        );
+}
+
 template <typename T, typename Texture>
 VSNRAY_FUNC
 environment_light<T, Texture>::operator bool() const
@@ -61,4 +152,31 @@ environment_light<T, Texture>::operator bool() const
     return static_cast<bool>(texture_);
 }
 
+
+//-------------------------------------------------------------------------------------------------
+// Sampling distribution
+//
+
+template <typename Texture>
+void make_environment_distribution(distribution_2d& dist, Texture const& tex)
+{
+    unsigned width = static_cast<unsigned>(tex.width());
+    unsigned height = static_cast<unsigned>(tex.height());
+
+    std::vector<float> func(width * height);
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+        float sin_theta = sin((y + 0.5f) / height * constants::pi<float>());
+
+        for (unsigned x = 0; x < width; ++x)
+        {
+            auto texel = vec4(tex(x, y));
+            func[y * width + x] = max(0.0f, rgb_to_luminance(texel.xyz())) * sin_theta;
+        }
+    }
+
+    dist.build(func.data(), width, height);
+}
+
 } // visionaray
@@ -9,17 +9,22 @@
 #include <visionaray/config.h>
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <functional>
 #include <iterator>
 #include <type_traits>
+#include <vector>
 
 #if VSNRAY_HAVE_TBB
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_reduce.h>
 #endif
 
+#include "../math/detail/math.h"
 #include "algorithm.h"
 #include "macros.h"
+#include "thread_pool.h"
 
 namespace visionaray
 {
@@ -167,6 +172,133 @@ void counting_sort(InputIt first, InputIt last, OutputIt out, Counts& counts, Ke
 
 #endif // VSNRAY_HAVE_TBB
 
+
+//-------------------------------------------------------------------------------------------------
+// radix_sort
+//
+// Stable LSD radix sort on unsigned integer keys, 8 bits per pass.
+// Each thread computes a digit histogram for a contiguous chunk of the input;
+// the items are then scattered to offsets derived from the histograms of all
+// chunks. Passes where all keys have the same digit are skipped.
+//
+// [in] POOL
+//      Thread pool that is used to process the chunks.
+//
+// [in,out] FIRST
+//      Start of the input sequence. On exit, contains the sorted sequence.
+//
+// [in,out] LAST
+//      End of the input sequence.
+//
+// [in,out] TEMP
+//      Start of a temporary sequence with at least (last - first) elements.
+//
+// [in] KEY
+//      Sort key function object, must return an unsigned integer.
+//
+// [in] NUM_BITS
+//      Number of (least significant) key bits to consider.
+//
+// Complexity: O(n * num_bits / 8)
+//
+
+template <typename RandIt, typename Key>
+void radix_sort(thread_pool& pool, RandIt first, RandIt last, RandIt temp, Key key, unsigned num_bits)
+{
+    static_assert(
+            std::is_unsigned<decltype(key(*first))>::value,
+            "radix_sort requires unsigned key type"
+            );
+
+    enum { Bits = 8, NumBuckets = 1 << Bits };
+
+    using histogram = std::array<size_t, NumBuckets>;
+
+    auto len = static_cast<size_t>(last - first);
+
+    if (len < 2)
+    {
+        return;
+    }
+
+    auto chunk_size = div_up(len, static_cast<size_t>(std::max(pool.num_threads, 1U)));
+    auto num_chunks = div_up(len, chunk_size);
+
+    std::vector<histogram> hist(num_chunks);
+
+    RandIt src = first;
+    RandIt dst = temp;
+
+    for (unsigned shift = 0; shift < num_bits; shift += Bits)
+    {
+        auto digit = [&](typename std::iterator_traits<RandIt>::value_type const& item)
+        {
+            return static_cast<size_t>((key(item) >> shift) & (NumBuckets - 1));
+        };
+
+        pool.run([&](long c)
+            {
+                auto& h = hist[c];
+                std::fill(h.begin(), h.end(), size_t(0));
+
+                auto b = c * chunk_size;
+                auto e = std::min(b + chunk_size, len);
+
+                for (auto i = b; i != e; ++i)
+                {
+                    ++h[digit(src[i])];
+                }
+            }, static_cast<long>(num_chunks));
+
+
+        // Turn histograms into scatter offsets
+
+        size_t offset = 0;
+        bool trivial = false;
+
+        for (size_t d = 0; d < NumBuckets; ++d)
+        {
+            size_t count = 0;
+
+            for (size_t c = 0; c < num_chunks; ++c)
+            {
+                auto h = hist[c][d];
+                hist[c][d] = offset + count;
+                count += h;
+            }
+
+            trivial |= count == len;
+            offset += count;
+        }
+
+        if (trivial)
+        {
+            // All keys have the same digit
+            continue;
+        }
+
+        pool.run([&](long c)
+            {
+                auto& h = hist[c];
+
+                auto b = c * chunk_size;
+                auto e = std::min(b + chunk_size, len);
+
+                for (auto i = b; i != e; ++i)
+                {
+                    dst[h[digit(src[i])]++] = std::move(src[i]);
+                }
+            }, static_cast<long>(num_chunks));
+
+        std::swap(src, dst);
+    }
+
+    if (src != first)
+    {
+        std::move(src, src + len, first);
+    }
+}
+
 } // namespace paralgo
 } // namespace visionaray
 
@@ -21,7 +21,13 @@ template <typename I, typename Func>
 void parallel_for(thread_pool& pool, range1d<I> const& range, Func const& func)
 {
     I len = range.length();
-    I tile_size = div_up(len, static_cast<I>(pool.num_threads));
+
+    if (len <= 0)
+    {
+        return;
+    }
+
+    I tile_size = div_up(len, static_cast<I>(pool.num_threads + 1));
     I num_tiles = div_up(len, tile_size);
 
     pool.run([=](long tile_index)
@@ -8,6 +8,8 @@
 
 #include <visionaray/get_area.h>
 #include <visionaray/get_surface.h>
+#include <visionaray/light_bvh.h>
+#include <visionaray/random_generator.h>
 #include <visionaray/result_record.h>
 #include <visionaray/sampling.h>
 #include <visionaray/spectrum.h>
@@ -23,16 +25,7 @@ template <typename Light, typename R, typename T = typename R::scalar_type>
 VSNRAY_FUNC
 vector<4, T> sample_environment_light(Light const& env_light, R ray)
 {
-    auto dir = (matrix<4, 4, T>(env_light.world_to_light_transform()) * vector<4, T>(ray.dir, T(0.0))).xyz();
-
-    auto x = atan2(dir.x, dir.z);
-    x = select(x < T(0.0), x + constants::two_pi<T>(), x);
-    auto y = acos(dir.y);
-
-    auto u = x / constants::two_pi<T>();
-    auto v = y * constants::inv_pi<T>();
-
-    vector<2, T> tc(u, v);
+    vector<2, T> tc = env_light.tex_coord(ray.dir);
 
     return tex2D(env_light.texture(), tc) * vector<4, T>(to_rgba(env_light.scale()));
 }
@@ -44,6 +37,424 @@ vector<4, T> sample_environment_light(std::nullptr_t*, R)
     return vector<4, T>(0.0);
 }
 
+//-------------------------------------------------------------------------------------------------
+// Importance sampling of the environment light
+//
+// Environment lights with a sampling distribution are also sampled with next event
+// estimation, without one paths only pick up the environment when they exit
+//
+
+template <typename Light>
+VSNRAY_FUNC
+inline bool can_sample_environment(Light const& env_light)
+{
+    return env_light && static_cast<bool>(env_light.distribution());
+}
+
+VSNRAY_FUNC
+inline bool can_sample_environment(std::nullptr_t*)
+{
+    return false;
+}
+
+// Returns the radiance arriving from the sampled direction dir
+template <typename Light, typename Generator, typename T = typename Generator::value_type>
+VSNRAY_FUNC
+inline vector<3, T> sample_environment(Light const& env_light, vector<3, T>& dir, Generator& gen, T& pdf)
+{
+    dir = env_light.sample(gen, pdf);
+    return env_light.intensity(dir);
+}
+
+template <typename Generator, typename T = typename Generator::value_type>
+VSNRAY_FUNC
+inline vector<3, T> sample_environment(std::nullptr_t*, vector<3, T>& dir, Generator& /* */, T& pdf)
+{
+    dir = vector<3, T>(0.0);
+    pdf = T(0.0);
+    return vector<3, T>(0.0);
+}
+
+template <typename Light, typename T>
+VSNRAY_FUNC
+inline T environment_pdf(Light const& env_light, vector<3, T> const& dir)
+{
+    return env_light.pdf(dir);
+}
+
+template <typename T>
+VSNRAY_FUNC
+inline T environment_pdf(std::nullptr_t*, vector<3, T> const& /* */)
+{
+    return T(0.0);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Light selection for next event estimation
+//
+// sample_light() selects a light for the shading point pos and samples it, pmf is the
+// probability that the light was selected. light_pmf() returns the probability that
+// the light hit by the ray with origin pos would have been selected at pos
+//
+
+// Uniform
+template <typename Lights, typename Generator, typename T = typename Generator::value_type>
+VSNRAY_FUNC
+inline light_sample<T> sample_light(
+        std::nullptr_t*     /* */,
+        Lights              begin,
+        Lights              end,
+        vector<3, T> const& /* */,
+        Generator&          gen,
+        T&                  pmf
+        )
+{
+    pmf = T(1.0f / static_cast<float>(end - begin));
+    return sample_random_light(begin, end, gen);
+}
+
+template <typename Lights, typename T, typename HR>
+VSNRAY_FUNC
+inline T light_pmf(
+        std::nullptr_t*     /* */,
+        Lights              begin,
+        Lights              end,
+        vector<3, T> const& /* */,
+        HR const&           /* */
+        )
+{
+    return T(1.0f / static_cast<float>(end - begin));
+}
+
+// Light BVH
+template <typename Lights, typename Generator, typename T = typename Generator::value_type>
+VSNRAY_FUNC
+inline light_sample<T> sample_light(
+        light_bvh_ref const&    bvh,
+        Lights                  begin,
+        Lights                  /* */,
+        vector<3, T> const&     pos,
+        Generator&              gen,
+        T&                      pmf
+        )
+{
+    return visionaray::sample_light(bvh, begin, pos, gen, pmf);
+}
+
+template <
+    typename Lights,
+    typename T,
+    typename HR,
+    typename = typename std::enable_if<!simd::is_simd_vector<T>::value>::type
+    >
+VSNRAY_FUNC
+inline T light_pmf(
+        light_bvh_ref const&    bvh,
+        Lights                  /* */,
+        Lights                  /* */,
+        vector<3, T> const&     pos,
+        HR const&               hit_rec
+        )
+{
+    int index = bvh.light_index(static_cast<unsigned>(hit_rec.geom_id), static_cast<unsigned>(hit_rec.prim_id));
+    return index >= 0 ? bvh.pmf(pos, static_cast<unsigned>(index)) : T(0.0);
+}
+
+template <
+    typename Lights,
+    typename T,
+    typename HR,
+    typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type,
+    typename = void
+    >
+VSNRAY_FUNC
+inline T light_pmf(
+        light_bvh_ref const&    bvh,
+        Lights                  /* */,
+        Lights                  /* */,
+        vector<3, T> const&     pos,
+        HR const&               hit_rec
+        )
+{
+    using float_array = simd::aligned_array_t<T>;
+    using int_array = simd::aligned_array_t<simd::int_type_t<T>>;
+
+    float_array x;
+    float_array y;
+    float_array z;
+    store(x, pos.x);
+    store(y, pos.y);
+    store(z, pos.z);
+
+    int_array geom_ids;
+    int_array prim_ids;
+    store(geom_ids, hit_rec.geom_id);
+    store(prim_ids, hit_rec.prim_id);
+
+    float_array pmfs;
+
+    for (size_t i = 0; i < simd::num_elements<T>::value; ++i)
+    {
+        int index = bvh.light_index(static_cast<unsigned>(geom_ids[i]), static_cast<unsigned>(prim_ids[i]));
+        pmfs[i] = index >= 0 ? bvh.pmf(vec3(x[i], y[i], z[i]), static_cast<unsigned>(index)) : 0.0f;
+    }
+
+    return T(pmfs);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Add the contribution of the environment (or the ambient color) to paths that exited
+//
+// last_specular and last_pdf describe the BRDF sample that generated ray (see shade())
+//
+
+template <typename Params, typename R, typename Mask1, typename Mask2, typename C>
+VSNRAY_FUNC
+inline void add_background(
+        Params const&                   params,
+        R const&                        ray,
+        unsigned                        bounce,
+        Mask1 const&                    exited,
+        Mask2 const&                    last_specular,
+        typename R::scalar_type const&  last_pdf,
+        C const&                        throughput,
+        C&                              intensity
+        )
+{
+    using S = typename R::scalar_type;
+
+    if (params.environment_map)
+    {
+        auto env = sample_environment_light(params.environment_map, ray);
+
+        S mis_weight(1.0);
+
+        if (bounce > 0 && can_sample_environment(params.environment_map))
+        {
+            mis_weight = select(
+                last_specular,
+                S(1.0),
+                power_heuristic(last_pdf, environment_pdf(params.environment_map, ray.dir))
+                );
+        }
+
+        intensity += select(
+            exited,
+            mis_weight * from_rgba(env) * throughput,
+            C(0.0)
+            );
+    }
+    else
+    {
+        intensity += select(
+            exited,
+            C(from_rgba(params.ambient_color)) * throughput,
+            C(0.0)
+            );
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Process one bounce of the paths that hit a surface
+//
+// Adds emission and direct light to intensity, updates throughput, applies Russian
+// roulette and sets up the continuation rays. Terminated paths are removed from
+// active_rays. last_pdf is the pdf of the BRDF sample that generated ray, it is
+// needed to weight emission that the ray hits. Shared by the megakernel and the
+// wavefront path tracer
+//
+
+template <
+    typename Params,
+    typename Intersector,
+    typename R,
+    typename HR,
+    typename Mask,
+    typename C,
+    typename Generator
+    >
+VSNRAY_FUNC
+inline void shade(
+        Params const&               params,
+        Intersector&                isect,
+        R&                          ray,
+        HR&                         hit_rec,
+        unsigned                    bounce,
+        Mask&                       active_rays,
+        Mask&                       last_specular,
+        typename R::scalar_type&    last_pdf,
+        C&                          intensity,
+        C&                          throughput,
+        Generator&                  gen
+        )
+{
+    using S = typename R::scalar_type;
+    using I = simd::int_type_t<S>;
+    using V = vector<3, S>;
+
+    V refl_dir(0.0);
+    V view_dir = -ray.dir;
+
+    hit_rec.isect_pos = ray.ori + ray.dir * hit_rec.t;
+
+    auto surf = get_surface(hit_rec, params);
+
+    S brdf_pdf(0.0);
+
+    // Remember the last type of surface interaction.
+    // If the last interaction was not diffuse, we have
+    // to include light from emissive surfaces.
+    I inter = 0;
+    auto src = surf.sample(view_dir, refl_dir, brdf_pdf, inter, gen);
+
+    auto zero_pdf = brdf_pdf <= S(0.0);
+
+    S light_pdf(0.0);
+    auto num_lights = params.lights.end - params.lights.begin;
+
+    if (num_lights > 0 && any(inter == surface_interaction::Emission))
+    {
+        auto A = detail::get_area(params, hit_rec);
+        auto ld = length(hit_rec.isect_pos - ray.ori);
+        auto L = normalize(hit_rec.isect_pos - ray.ori);
+        auto n = surf.geometric_normal;
+        auto ldotln = abs(dot(-L, n));
+        auto solid_angle = (ldotln * A) / (ld * ld);
+
+        light_pdf = select(
+            inter == surface_interaction::Emission,
+            S(1.0) / solid_angle,
+            S(0.0)
+            );
+    }
+
+    S mis_weight(1.0);
+
+    if (bounce > 0 && num_lights > 0)
+    {
+        // Light selection at the previous vertex used the origin of this ray
+        auto pmf = light_pmf(params.light_sampler, params.lights.begin, params.lights.end, ray.ori, hit_rec);
+
+        mis_weight = select(
+            !last_specular,
+            power_heuristic(last_pdf, light_pdf * pmf),
+            S(1.0)
+            );
+    }
+
+    intensity += select(
+        active_rays && inter == surface_interaction::Emission,
+        mis_weight * throughput * src,
+        C(0.0)
+        );
+
+    active_rays &= inter != surface_interaction::Emission;
+    active_rays &= !zero_pdf;
+
+    auto n = surf.shading_normal;
+#if 1
+    n = faceforward( n, view_dir, surf.geometric_normal );
+#endif
+
+    // Origin of the continuation ray, lights are also selected for this position so that
+    // light_pmf() at the next vertex returns the exact selection probability
+    auto next_ori = hit_rec.isect_pos + refl_dir * S(params.epsilon);
+
+    if (num_lights > 0)
+    {
+        S select_pmf(0.0);
+        auto ls = sample_light(params.light_sampler, params.lights.begin, params.lights.end, next_ori, gen, select_pmf);
+
+        auto ld = length(ls.pos - hit_rec.isect_pos);
+        auto L = normalize(ls.pos - hit_rec.isect_pos);
+
+        auto ln = select(ls.delta_light, -L, ls.normal);
+#if 1
+        ln = faceforward( ln, -L, ln );
+#endif
+        auto ldotn = dot(L, n);
+        auto ldotln = abs(dot(-L, ln));
+
+        R shadow_ray(
+            hit_rec.isect_pos + L * S(params.epsilon),
+            L
+            );
+
+        auto lhr = any_hit(shadow_ray, params.prims.begin, params.prims.end, ld - S(2.0f * params.epsilon), isect);
+
+        auto brdf_pdf = surf.pdf(view_dir, L, inter);
+
+        // TODO: inv_pi / dot(n, wi) factor only valid for plastic and matte
+        auto src = surf.shade(view_dir, L, ls.intensity) * constants::inv_pi<S>() / ldotn;
+        auto solid_angle = (ldotln * ls.area);
+        solid_angle = select(!ls.delta_light, solid_angle / (ld * ld), solid_angle);
+        auto light_pdf = S(1.0) / solid_angle;
+
+        S mis_weight = power_heuristic(light_pdf * select_pmf, brdf_pdf);
+
+        intensity += select(
+            active_rays && !lhr.hit && ldotn > S(0.0) && ldotln > S(0.0) && select_pmf > S(0.0),
+            mis_weight * throughput * src * (ldotn / (light_pdf * select_pmf)),
+            C(0.0)
+            );
+    }
+
+    if (can_sample_environment(params.environment_map))
+    {
+        V L;
+        S env_pdf(0.0);
+        auto Le = sample_environment(params.environment_map, L, gen, env_pdf);
+
+        auto ldotn = dot(L, n);
+
+        R shadow_ray(
+            hit_rec.isect_pos + L * S(params.epsilon),
+            L
+            );
+
+        auto lhr = any_hit(shadow_ray, params.prims.begin, params.prims.end, isect);
+
+        auto brdf_pdf = surf.pdf(view_dir, L, inter);
+
+        auto src = surf.shade(view_dir, L, Le) * constants::inv_pi<S>() / ldotn;
+
+        S mis_weight = power_heuristic(env_pdf, brdf_pdf);
+
+        intensity += select(
+            active_rays && !lhr.hit && ldotn > S(0.0) && env_pdf > S(0.0),
+            mis_weight * throughput * src * (ldotn / env_pdf),
+            C(0.0)
+            );
+    }
+
+    throughput *= src * (dot(n, refl_dir) / brdf_pdf);
+    throughput = select(zero_pdf, C(0.0), throughput);
+
+    if (bounce >= 2)
+    {
+        // Russian roulette
+        auto prob = max_element(throughput.samples());
+        auto terminate = gen.next() > prob;
+        active_rays &= !terminate;
+        throughput /= prob;
+    }
+
+    ray.ori = next_ori;
+    ray.dir = refl_dir;
+
+    last_pdf = brdf_pdf;
+
+    last_specular = inter == surface_interaction::SpecularReflection ||
+                    inter == surface_interaction::SpecularTransmission;
+}
+
+// Number of random numbers reserved for each bounce, bounces start at fixed
+// dimensions so that low-discrepancy generators use the same dimensions for the
+// same decisions in all paths
+enum { DimensionsPerBounce = 16 };
+
 template <typename Params>
 struct kernel
 {
@@ -58,12 +469,11 @@ struct kernel
             ) const
     {
         using S = typename R::scalar_type;
-        using I = simd::int_type_t<S>;
-        using V = typename result_record<S>::vec_type;
         using C = spectrum<S>;
 
         simd::mask_type_t<S> active_rays = true;
         simd::mask_type_t<S> last_specular = true;
+        S last_pdf(1.0);
 
         C intensity(0.0);
         C throughput(1.0);
@@ -76,30 +486,19 @@ struct kernel
             result.color = sample_environment_light(params.environment_map, ray);
         }
 
+        // Dimensions before were used by the pixel sampler and the camera
+        unsigned first_dim = detail::generator_dimension(gen);
+
         for (unsigned bounce = 0; bounce < params.num_bounces; ++bounce)
         {
+            detail::set_generator_dimension(gen, first_dim + bounce * DimensionsPerBounce);
+
             auto hit_rec = closest_hit(ray, params.prims.begin, params.prims.end, isect);
 
             // Handle rays that just exited
             auto exited = active_rays & !hit_rec.hit;
 
-            if (params.environment_map)
-            {
-                auto env = sample_environment_light(params.environment_map, ray);
-                intensity += select(
-                    exited,
-                    from_rgba(env) * throughput,
-                    C(0.0)
-                    );
-            }
-            else
-            {
-                intensity += select(
-                    exited,
-                    C(from_rgba(params.ambient_color)) * throughput,
-                    C(0.0)
-                    );
-            }
+            add_background(params, ray, bounce, exited, last_specular, last_pdf, throughput, intensity);
 
 
             // Exit if no ray is active anymore
@@ -119,126 +518,12 @@ struct kernel
 
 
             // Process the current bounce
+            shade(params, isect, ray, hit_rec, bounce, active_rays, last_specular, last_pdf, intensity, throughput, gen);
 
-            V refl_dir(0.0);
-            V view_dir = -ray.dir;
-
-            hit_rec.isect_pos = ray.ori + ray.dir * hit_rec.t;
-
-            auto surf = get_surface(hit_rec, params);
-
-            S brdf_pdf(0.0);
-
-            // Remember the last type of surface interaction.
-            // If the last interaction was not diffuse, we have
-            // to include light from emissive surfaces.
-            I inter = 0;
-            auto src = surf.sample(view_dir, refl_dir, brdf_pdf, inter, gen);
-
-            auto zero_pdf = brdf_pdf <= S(0.0);
-
-            S light_pdf(0.0);
-            auto num_lights = params.lights.end - params.lights.begin;
-
-            if (num_lights > 0 && any(inter == surface_interaction::Emission))
-            {
-                auto A = get_area(params.prims.begin, hit_rec);
-                auto ld = length(hit_rec.isect_pos - ray.ori);
-                auto L = normalize(hit_rec.isect_pos - ray.ori);
-                auto n = surf.geometric_normal;
-                auto ldotln = abs(dot(-L, n));
-                auto solid_angle = (ldotln * A) / (ld * ld);
-
-                light_pdf = select(
-                    inter == surface_interaction::Emission,
-                    S(1.0) / solid_angle,
-                    S(0.0)
-                    );
-            }
-
-            S mis_weight = select(
-                bounce > 0 && num_lights > 0 && !last_specular,
-                power_heuristic(brdf_pdf, light_pdf / static_cast<float>(num_lights)),
-                S(1.0)
-                );
-
-            intensity += select(
-                active_rays && inter == surface_interaction::Emission,
-                mis_weight * throughput * src,
-                C(0.0)
-                );
-
-            active_rays &= inter != surface_interaction::Emission;
-            active_rays &= !zero_pdf;
-
-            auto n = surf.shading_normal;
-#if 1
-            n = faceforward( n, view_dir, surf.geometric_normal );
-#endif
-
-            if (num_lights > 0)
-            {
-                auto ls = sample_random_light(params.lights.begin, params.lights.end, gen);
-
-                auto ld = length(ls.pos - hit_rec.isect_pos);
-                auto L = normalize(ls.pos - hit_rec.isect_pos);
-
-                auto ln = select(ls.delta_light, -L, ls.normal);
-#if 1
-                ln = faceforward( ln, -L, ln );
-#endif
-                auto ldotn = dot(L, n);
-                auto ldotln = abs(dot(-L, ln));
-
-                R shadow_ray(
-                    hit_rec.isect_pos + L * S(params.epsilon),
-                    L
-                    );
-
-                auto lhr = any_hit(shadow_ray, params.prims.begin, params.prims.end, ld - S(2.0f * params.epsilon), isect);
-
-                auto brdf_pdf = surf.pdf(view_dir, L, inter);
-                auto prob = max_element(throughput.samples());
-                brdf_pdf *= prob;
-
-                // TODO: inv_pi / dot(n, wi) factor only valid for plastic and matte
-                auto src = surf.shade(view_dir, L, ls.intensity) * constants::inv_pi<S>() / ldotn;
-                auto solid_angle = (ldotln * ls.area);
-                solid_angle = select(!ls.delta_light, solid_angle / (ld * ld), solid_angle);
-                auto light_pdf = S(1.0) / solid_angle;
-
-                S mis_weight = power_heuristic(light_pdf / static_cast<float>(num_lights), brdf_pdf);
-
-                intensity += select(
-                    active_rays && !lhr.hit && ldotn > S(0.0) && ldotln > S(0.0),
-                    mis_weight * throughput * src * (ldotn / light_pdf) * S(static_cast<float>(num_lights)),
-                    C(0.0)
-                    );
-            }
-
-            throughput *= src * (dot(n, refl_dir) / brdf_pdf);
-            throughput = select(zero_pdf, C(0.0), throughput);
-
-            if (bounce >= 2)
+            if (!any(active_rays))
             {
-                // Russian roulette
-                auto prob = max_element(throughput.samples());
-                auto terminate = gen.next() > prob;
-                active_rays &= !terminate;
-                throughput /= prob;
-
-                if (!any(active_rays))
-                {
-                    break;
-                }
+                break;
             }
-
-            ray.ori = hit_rec.isect_pos + refl_dir * S(params.epsilon);
-            ray.dir = refl_dir;
-
-            last_specular = inter == surface_interaction::SpecularReflection ||
-                            inter == surface_interaction::SpecularTransmission;
-
         }
 
         result.color = select( result.hit, to_rgba(intensity), result.color );
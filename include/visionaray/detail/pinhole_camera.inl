@@ -116,4 +116,26 @@ inline R pinhole_camera::primary_ray(R /* */, T const& x, T const& y, T const& w
     return r;
 }
 
+template <typename R, typename T>
+VSNRAY_FUNC
+inline ray_differential<T> pinhole_camera::primary_ray_differential(
+        R const&    ray,
+        T const&    width,
+        T const&    height
+        ) const
+{
+    // The unnormalized direction U * u + V * v + W has unit length along W,
+    // differentiate its normalization
+    auto s  = dot(ray.dir, vector<3, T>(W));
+    auto dx = vector<3, T>(U) * (T(2.0) / width);
+    auto dy = vector<3, T>(V) * (T(2.0) / height);
+
+    ray_differential<T> rd;
+    rd.ori_dx = vector<3, T>(T(0.0));
+    rd.ori_dy = vector<3, T>(T(0.0));
+    rd.dir_dx = (dx - ray.dir * dot(ray.dir, dx)) * s;
+    rd.dir_dy = (dy - ray.dir * dot(ray.dir, dy)) * s;
+    return rd;
+}
+
 } // visionaray
@@ -7,12 +7,14 @@
 #define VSNRAY_DETAIL_SCHED_COMMON_H 1
 
 #include <cstddef>
+#include <type_traits>
 #include <utility>
 
 #include <visionaray/array.h>
 #include <visionaray/packet_traits.h>
 #include <visionaray/pixel_format.h>
 #include <visionaray/pixel_sampler_types.h>
+#include <visionaray/random_generator.h>
 #include <visionaray/render_target.h>
 #include <visionaray/result_record.h>
 
@@ -25,6 +27,47 @@ namespace visionaray
 namespace detail
 {
 
+//-------------------------------------------------------------------------------------------------
+// Keys of the pixels covered by a ray packet at (x,y), used to key the random
+// generators. x is stored in the lower, y in the upper 16 bits, so that generators
+// can recover the pixel position (see blue_noise_generator)
+//
+
+template <
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<T>::value>::type
+    >
+VSNRAY_FUNC
+inline unsigned pixel_key(T /* */, int x, int y)
+{
+    return (static_cast<unsigned>(y) << 16) | (static_cast<unsigned>(x) & 0xFFFF);
+}
+
+template <
+    typename T,
+    typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type,
+    typename = void
+    >
+VSNRAY_FUNC
+inline array<unsigned, simd::num_elements<T>::value> pixel_key(T /* */, int x, int y)
+{
+    const int w = packet_size<T>::w;
+    const int h = packet_size<T>::h;
+
+    array<unsigned, simd::num_elements<T>::value> result;
+
+    for (int row = 0; row < h; ++row)
+    {
+        for (int col = 0; col < w; ++col)
+        {
+            result[row * w + col] = pixel_key(float{}, x + col, y + row);
+        }
+    }
+
+    return result;
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Invoke kernel
 //
@@ -637,6 +680,234 @@ inline void sample_pixel_impl(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Adaptive pixel sampler
+//
+
+// Kernels may return colors or result records
+template <typename S>
+VSNRAY_FUNC
+inline vector<4, S> result_color(vector<4, S> const& color)
+{
+    return color;
+}
+
+template <typename S>
+VSNRAY_FUNC
+inline vector<4, S> result_color(vector<3, S> const& color)
+{
+    return vector<4, S>(color, S(1.0));
+}
+
+template <typename S>
+VSNRAY_FUNC
+inline vector<4, S> result_color(result_record<S> const& result)
+{
+    return result.color;
+}
+
+// Colors of the individual pixels of a packet
+VSNRAY_FUNC
+inline array<vector<4, float>, 1> unpack_colors(vector<4, float> const& color)
+{
+    array<vector<4, float>, 1> result;
+    result[0] = color;
+    return result;
+}
+
+template <
+    typename S,
+    typename = typename std::enable_if<simd::is_simd_vector<S>::value>::type
+    >
+VSNRAY_FUNC
+inline auto unpack_colors(vector<4, S> const& color)
+    -> decltype(simd::unpack(color))
+{
+    return simd::unpack(color);
+}
+
+// Number of samples a pixel gets this frame, 0 if it has converged
+template <typename T>
+VSNRAY_FUNC
+inline unsigned adaptive_num_samples(
+        pixel_sampler::basic_pixel_statistics<T> const& stats,
+        pixel_sampler::basic_adaptive_type<T> const&    params
+        )
+{
+    unsigned n = stats.count;
+    unsigned k = 0;
+
+    if (params.max_total_samples > 0 && n >= params.max_total_samples)
+    {
+        return 0;
+    }
+
+    // Need at least two samples to estimate the variance
+    unsigned min_samples = params.min_samples > 2 ? params.min_samples : 2;
+
+    if (n < min_samples)
+    {
+        k = min_samples - n;
+    }
+    else
+    {
+        T lum = rgb_to_luminance(vector<3, T>(stats.mean[0], stats.mean[1], stats.mean[2]));
+
+        // Relative standard error of the mean, absolute error for dark pixels
+        T var = stats.m2 / (T(n - 1) * T(n));
+        T err = sqrt(var) / max(lum, T(1e-3));
+
+        if (err <= params.threshold)
+        {
+            return 0;
+        }
+
+        // The error decreases with 1/sqrt(n), estimate how many samples are still needed
+        T r = err / params.threshold;
+        T needed = T(n) * (r * r - T(1.0));
+
+        k = needed >= T(params.max_samples) ? params.max_samples : static_cast<unsigned>(ceil(needed));
+        k = k > 1 ? k : 1;
+    }
+
+    k = k < params.max_samples ? k : params.max_samples;
+
+    if (params.max_total_samples > 0 && n + k > params.max_total_samples)
+    {
+        k = params.max_total_samples - n;
+    }
+
+    return k;
+}
+
+// Add a sample to the running statistics (Welford's algorithm)
+template <typename T>
+VSNRAY_FUNC
+inline void adaptive_add_sample(
+        pixel_sampler::basic_pixel_statistics<T>&   stats,
+        vector<4, T> const&                         color
+        )
+{
+    T lum = rgb_to_luminance(color.xyz());
+    T old_lum = rgb_to_luminance(vector<3, T>(stats.mean[0], stats.mean[1], stats.mean[2]));
+
+    ++stats.count;
+
+    for (int c = 0; c < 4; ++c)
+    {
+        stats.mean[c] += (color[c] - stats.mean[c]) / T(stats.count);
+    }
+
+    T new_lum = rgb_to_luminance(vector<3, T>(stats.mean[0], stats.mean[1], stats.mean[2]));
+
+    stats.m2 += (lum - old_lum) * (lum - new_lum);
+}
+
+template <
+    typename K,
+    typename T,
+    typename R,
+    typename Generator,
+    pixel_format CF,
+    typename Camera
+    >
+VSNRAY_FUNC
+inline void sample_pixel_impl(
+        K                                       kernel,
+        pixel_sampler::basic_adaptive_type<T>   params,
+        R const&                                r,
+        Generator&                              gen,
+        render_target_ref<CF>                   rt_ref,
+        int                                     x,
+        int                                     y,
+        int                                     width,
+        int                                     height,
+        Camera const&                           cam
+        )
+{
+    using S = typename R::scalar_type;
+
+    const int w = packet_size<S>::w;
+    const int h = packet_size<S>::h;
+
+    // Sample counts of the pixels in the packet
+    unsigned num_samples[w * h];
+    unsigned max_samples = 0;
+
+    for (int row = 0; row < h; ++row)
+    {
+        for (int col = 0; col < w; ++col)
+        {
+            int idx = row * w + col;
+            num_samples[idx] = 0;
+
+            if (x + col < width && y + row < height)
+            {
+                auto const& stats = params.stats[(y + row) * width + (x + col)];
+                num_samples[idx] = adaptive_num_samples(stats, params);
+                max_samples = num_samples[idx] > max_samples ? num_samples[idx] : max_samples;
+            }
+        }
+    }
+
+    for (unsigned s = 0; s < max_samples; ++s)
+    {
+        // Reuse the jittered ray provided by the scheduler for the first sample,
+        // the other samples continue with a fresh sequence of the generator
+        if (s > 0)
+        {
+            detail::set_generator_sample(gen, s);
+        }
+
+        R ray = s == 0 ? r : make_primary_rays(R{}, pixel_sampler::jittered_type{}, gen, x, y, width, height, cam);
+
+        auto colors = unpack_colors(result_color(invoke_kernel(kernel, ray, gen, x, y)));
+
+        for (int row = 0; row < h; ++row)
+        {
+            for (int col = 0; col < w; ++col)
+            {
+                int idx = row * w + col;
+
+                if (s < num_samples[idx])
+                {
+                    adaptive_add_sample(params.stats[(y + row) * width + (x + col)], vector<4, T>(colors[idx]));
+                }
+            }
+        }
+    }
+
+    if (max_samples == 0)
+    {
+        return;
+    }
+
+    for (int row = 0; row < h; ++row)
+    {
+        for (int col = 0; col < w; ++col)
+        {
+            int idx = row * w + col;
+
+            if (num_samples[idx] > 0)
+            {
+                auto const& stats = params.stats[(y + row) * width + (x + col)];
+
+                pixel_access::store(
+                        pixel_format_constant<CF>{},
+                        pixel_format_constant<PF_RGBA32F>{},
+                        x + col,
+                        y + row,
+                        width,
+                        height,
+                        vector<4, T>(stats.mean[0], stats.mean[1], stats.mean[2], stats.mean[3]),
+                        rt_ref.color()
+                        );
+            }
+        }
+    }
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // SSAA pixel sampler
 //
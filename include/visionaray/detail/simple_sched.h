@@ -17,6 +17,15 @@ public:
     template <typename K, typename SP>
     void frame(K kernel, SP sched_params);
 
+    // Number of the next frame, part of the keys of the random generators.
+    // Images rendered with the same frame number are reproducible
+    unsigned frame_num() const;
+    void set_frame_num(unsigned frame_num);
+
+private:
+
+    unsigned frame_num_ = 0;
+
 };
 
 } // visionaray
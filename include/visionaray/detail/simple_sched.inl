@@ -20,6 +20,7 @@ void simple_sched<R>::frame(K kernel, SP sched_params)
 
     sched_params.rt.begin_frame();
 
+    unsigned frame_num = frame_num_++;
 
     auto scissor_box = sched_params.scissor_box;
 
@@ -34,13 +35,15 @@ void simple_sched<R>::frame(K kernel, SP sched_params)
 
             auto gen = make_generator(
                     typename R::scalar_type{},
-                    typename SP::pixel_sampler_type{},
-                    detail::tic(typename R::scalar_type{})
+                    sched_params.sample_params,
+                    detail::pixel_key(typename R::scalar_type{}, x, y),
+                    0U,
+                    frame_num
                     );
 
             auto r = detail::make_primary_rays(
                     R{},
-                    typename SP::pixel_sampler_type{},
+                    sched_params.sample_params,
                     gen,
                     x,
                     y,
@@ -51,7 +54,7 @@ void simple_sched<R>::frame(K kernel, SP sched_params)
 
             sample_pixel(
                     kernel,
-                    typename SP::pixel_sampler_type{},
+                    sched_params.sample_params,
                     r,
                     gen,
                     sched_params.rt.ref(),
@@ -70,4 +73,16 @@ void simple_sched<R>::frame(K kernel, SP sched_params)
     sched_params.cam.end_frame();
 }
 
+template <typename R>
+unsigned simple_sched<R>::frame_num() const
+{
+    return frame_num_;
+}
+
+template <typename R>
+void simple_sched<R>::set_frame_num(unsigned frame_num)
+{
+    frame_num_ = frame_num;
+}
+
 } // visionaray
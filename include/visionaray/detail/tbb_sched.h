@@ -59,6 +59,20 @@ struct tbb_sched_backend
             });
     }
 
+    template <typename Func>
+    void for_each_tile(tiled_range2d<int> const& tr, Func const& func)
+    {
+        tbb::parallel_for(
+            tbb::blocked_range2d<int>(
+                tr.rows().begin(), tr.rows().end(), tr.rows().tile_size(),
+                tr.cols().begin(), tr.cols().end(), tr.cols().tile_size()
+                ),
+            [=](tbb::blocked_range2d<int> const& r)
+            {
+                func(range2d<int>(r.rows().begin(), r.rows().end(), r.cols().begin(), r.cols().end()));
+            });
+    }
+
     tbb::task_scheduler_init init_;
 };
 
@@ -7,20 +7,31 @@
 #define VSNRAY_DETAIL_THREAD_POOL_H 1
 
 #include <atomic>
-#include <cassert>
+#include <chrono>
 #include <condition_variable>
-#include <functional>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <thread>
 
-#include "semaphore.h"
-
 namespace visionaray
 {
 
 //-------------------------------------------------------------------------------------------------
-// Thread pool
+// Work-stealing thread pool
+//
+// run(func, n) calls func(i) for i in [0..n) and returns when all calls have finished.
+// Each worker owns a deque of index ranges. Workers take ranges from the back of their
+// own deque, split them in halves, push the upper halves back and process the lower
+// ones, so that idle workers can steal large ranges from the front of the deques of
+// busy workers. The thread that calls run() helps processing the work items.
+//
+// run() may be called from inside a work item (nested parallelism). The calling worker
+// then pushes the new items onto its own deque and keeps processing (its own or
+// stolen) items until the nested call has finished.
+//
+// Idle workers spin for spin_time before they go to sleep, which reduces the wake-up
+// latency when run() is called repeatedly, e.g. once per frame.
 //
 
 class thread_pool
@@ -29,8 +40,6 @@ public:
 
     explicit thread_pool(unsigned num_threads)
     {
-        sync_params.start_threads = false;
-        sync_params.join_threads = false;
         reset(num_threads);
     }
 
@@ -43,25 +52,31 @@ public:
     {
         join_threads();
 
+        // One queue per worker, plus one for threads outside the pool
+        queues.reset(new queue[num_threads + 1]);
+
         threads.reset(new std::thread[num_threads]);
         this->num_threads = num_threads;
 
         for (unsigned i = 0; i < num_threads; ++i)
         {
-            threads[i] = std::thread([this](){ thread_loop(); });
+            threads[i] = std::thread([this, i](){ thread_loop(i); });
         }
     }
 
     void join_threads()
     {
-        if (num_threads == 0)
+        if (threads == nullptr)
         {
             return;
         }
 
-        sync_params.start_threads = true;
-        sync_params.join_threads = true;
-        sync_params.threads_start.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            joining = true;
+        }
+
+        sleep_cond.notify_all();
 
         for (unsigned i = 0; i < num_threads; ++i)
         {
@@ -71,31 +86,54 @@ public:
             }
         }
 
-        sync_params.start_threads = false;
-        sync_params.join_threads = false;
+        joining = false;
         threads.reset(nullptr);
+        num_threads = 0;
     }
 
     template <typename Func>
     void run(Func f, long queue_length)
     {
-        // Set worker function
-        func = f;
+        if (queue_length <= 0)
+        {
+            return;
+        }
 
-        // Set counters
-        sync_params.num_work_items = queue_length;
-        sync_params.work_item_counter = 0;
-        sync_params.work_items_finished_counter = 0;
+        job j;
+        j.invoke = [](void const* func, long i) { (*static_cast<Func const*>(func))(i); };
+        j.func = &f;
+        j.remaining = queue_length;
 
-        // Activate persistent threads
-        sync_params.start_threads = true;
-        sync_params.threads_start.notify_all();
+        unsigned q = current_queue();
 
-        // Wait for all threads to finish
-        sync_params.threads_ready.wait();
+        if (q == num_threads)
+        {
+            // Called from outside: hand one contiguous range to each worker
+            long n = static_cast<long>(num_threads) + 1;
+
+            for (long k = 0; k < n; ++k)
+            {
+                long first = queue_length * k / n;
+                long last = queue_length * (k + 1) / n;
 
-        // Idle w/o work
-        sync_params.start_threads = false;
+                if (first != last)
+                {
+                    push(static_cast<unsigned>(k), { &j, first, last });
+                }
+            }
+        }
+        else
+        {
+            push(q, { &j, 0, queue_length });
+        }
+
+        wait(j, q);
+    }
+
+    // Spin this long before idle workers go to sleep
+    void set_spin_time(std::chrono::microseconds t)
+    {
+        spin_time = t;
     }
 
     std::unique_ptr<std::thread[]> threads;
@@ -103,70 +141,213 @@ public:
 
 private:
 
-    using func_t = std::function<void(unsigned)>;
-    func_t func;
+    struct job
+    {
+        // Type-erased work item function, points to the functor passed to run()
+        void (*invoke)(void const*, long);
+        void const* func;
 
+        std::atomic<long>       remaining;
 
-    struct
-    {
         std::mutex              mutex;
-        std::condition_variable threads_start;
-        visionaray::semaphore   threads_ready;
+        std::condition_variable done_cond;
+        bool                    done = false;
+    };
+
+    struct task
+    {
+        job* j;
+        long first;
+        long last;
+    };
+
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    std::unique_ptr<queue[]> queues;
 
-        std::atomic<bool>       start_threads;
-        std::atomic<bool>       join_threads;
+    // Number of tasks in all queues
+    std::atomic<long> pending{0};
 
-        std::atomic<long>       num_work_items;
-        std::atomic<long>       work_item_counter;
-        std::atomic<long>       work_items_finished_counter;
-    } sync_params;
+    std::mutex              sleep_mutex;
+    std::condition_variable sleep_cond;
+    std::atomic<unsigned>   num_sleeping{0};
+    std::atomic<bool>       joining{false};
 
-    void thread_loop()
+    std::chrono::microseconds spin_time{100};
+
+
+    struct worker_info
     {
-        for (;;)
+        thread_pool const* pool;
+        unsigned queue;
+    };
+
+    static worker_info& this_worker()
+    {
+        static thread_local worker_info info = { nullptr, 0 };
+        return info;
+    }
+
+    unsigned current_queue() const
+    {
+        return this_worker().pool == this ? this_worker().queue : num_threads;
+    }
+
+    void push(unsigned q, task t)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queues[q].mutex);
+            queues[q].tasks.push_back(t);
+        }
+
+        ++pending;
+
+        if (num_sleeping > 0)
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            sleep_cond.notify_one();
+        }
+    }
+
+    // Take the most recently pushed (smallest) task from the back of our own queue
+    bool pop(unsigned q, task& t)
+    {
+        std::lock_guard<std::mutex> lock(queues[q].mutex);
+
+        if (queues[q].tasks.empty())
+        {
+            return false;
+        }
+
+        t = queues[q].tasks.back();
+        queues[q].tasks.pop_back();
+        --pending;
+        return true;
+    }
+
+    // Take the oldest (largest) task from the front of another queue
+    bool steal(unsigned q, task& t)
+    {
+        unsigned n = num_threads + 1;
+
+        for (unsigned k = 1; k < n; ++k)
+        {
+            unsigned victim = (q + k) % n;
+
+            std::lock_guard<std::mutex> lock(queues[victim].mutex);
+
+            if (!queues[victim].tasks.empty())
+            {
+                t = queues[victim].tasks.front();
+                queues[victim].tasks.pop_front();
+                --pending;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool try_execute(unsigned q)
+    {
+        task t;
+
+        if (!pop(q, t) && !steal(q, t))
+        {
+            return false;
+        }
+
+        while (t.last - t.first > 1)
+        {
+            long mid = t.first + (t.last - t.first) / 2;
+            push(q, { t.j, mid, t.last });
+            t.last = mid;
+        }
+
+        job& j = *t.j;
+
+        j.invoke(j.func, t.first);
+
+        if (j.remaining.fetch_sub(1) == 1)
+        {
+            // The job lives on the stack of the thread waiting for it,
+            // don't touch it anymore after releasing the lock
+            std::lock_guard<std::mutex> lock(j.mutex);
+            j.done = true;
+            j.done_cond.notify_all();
+        }
+
+        return true;
+    }
+
+    void wait(job& j, unsigned q)
+    {
+        bool is_worker = q != num_threads;
+
+        while (j.remaining > 0)
         {
-            // Wait until activated
+            if (try_execute(q))
             {
-                std::unique_lock<std::mutex> lock(sync_params.mutex);
-                sync_params.threads_start.wait(
-                        lock,
-                        [this]()
-                            -> std::atomic<bool> const&
-                        {
-                            return sync_params.start_threads;
-                        }
-                        );
+                continue;
             }
 
-            // Exit?
-            if (sync_params.join_threads)
+            if (is_worker)
             {
-                break;
+                // Never block inside a work item, others may depend on our queue
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lock(j.mutex);
+                j.done_cond.wait(lock, [&]() { return j.done; });
             }
+        }
+
+        std::unique_lock<std::mutex> lock(j.mutex);
+        j.done_cond.wait(lock, [&]() { return j.done; });
+    }
 
+    void thread_loop(unsigned q)
+    {
+        this_worker() = { this, q };
 
-            // Perform work in queue
-            for (;;)
+        for (;;)
+        {
+            if (try_execute(q))
             {
-                auto work_item = sync_params.work_item_counter.fetch_add(1);
+                continue;
+            }
 
-                if (work_item >= sync_params.num_work_items)
-                {
-                    break;
-                }
+            // Spin for a while before going to sleep
+            auto start = std::chrono::steady_clock::now();
 
-                func(work_item);
+            while (pending == 0 && !joining && std::chrono::steady_clock::now() - start < spin_time)
+            {
+                std::this_thread::yield();
+            }
 
-                auto finished = sync_params.work_items_finished_counter.fetch_add(1);
+            if (pending > 0)
+            {
+                continue;
+            }
 
-                if (finished >= sync_params.num_work_items - 1)
-                {
-                    assert(finished == sync_params.num_work_items - 1);
-                    sync_params.threads_ready.notify();
-                    break;
-                }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+
+            ++num_sleeping;
+            sleep_cond.wait(lock, [this]() { return pending > 0 || joining; });
+            --num_sleeping;
+
+            if (joining && pending == 0)
+            {
+                break;
             }
         }
+
+        this_worker() = { nullptr, 0 };
     }
 };
 
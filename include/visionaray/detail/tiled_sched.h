@@ -6,6 +6,14 @@
 #ifndef VSNRAY_DETAIL_TILED_SCHED_H
 #define VSNRAY_DETAIL_TILED_SCHED_H 1
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <vector>
+
+#include "../math/detail/math.h"
 #include "basic_sched.h"
 #include "parallel_for.h"
 #include "range.h"
@@ -14,10 +22,29 @@
 namespace visionaray
 {
 
+//-------------------------------------------------------------------------------------------------
+// Tile scheduling modes
+//
+//  fixed:    process fixed size tiles in scanline order
+//  adaptive: record the render time of each tile and process the tiles of the next
+//            frame longest-first, tiles that took considerably longer than the
+//            average tile are split into smaller sub-tiles
+//
+// Adaptive scheduling reduces the load imbalance at the end of a frame when tile
+// costs vary a lot (e.g. path tracing) and the camera moves only little per frame
+//
+
+enum class tiled_sched_mode
+{
+    fixed,
+    adaptive
+};
+
 struct tiled_sched_backend
 {
-    explicit tiled_sched_backend(unsigned num_threads)
+    explicit tiled_sched_backend(unsigned num_threads, tiled_sched_mode mode = tiled_sched_mode::fixed)
         : pool_(num_threads)
+        , mode_(mode)
     {
     }
 
@@ -26,6 +53,23 @@ struct tiled_sched_backend
         pool_.reset(num_threads);
     }
 
+    void reset(unsigned num_threads, tiled_sched_mode mode)
+    {
+        pool_.reset(num_threads);
+        set_mode(mode);
+    }
+
+    void set_mode(tiled_sched_mode mode)
+    {
+        mode_ = mode;
+        tile_costs_.clear();
+    }
+
+    tiled_sched_mode mode() const
+    {
+        return mode_;
+    }
+
     template <typename Func>
     void for_each_packet(
             tiled_range2d<int> const& tr,
@@ -34,6 +78,12 @@ struct tiled_sched_backend
             Func const& func
             )
     {
+        if (mode_ == tiled_sched_mode::adaptive)
+        {
+            for_each_packet_adaptive(tr, packet_width, packet_height, func);
+            return;
+        }
+
         visionaray::parallel_for(
             pool_,
             tr,
@@ -49,7 +99,146 @@ struct tiled_sched_backend
             });
     }
 
+    template <typename Func>
+    void for_each_tile(tiled_range2d<int> const& tr, Func const& func)
+    {
+        visionaray::parallel_for(pool_, tr, func);
+    }
+
     thread_pool pool_;
+
+private:
+
+    // Tile or sub-tile
+    struct work_item
+    {
+        range2d<int> r;
+        int tile;
+        double cost;
+    };
+
+    tiled_sched_mode mode_;
+
+    // Tile layout of the previous frame
+    std::array<int, 6> layout_ = {{ 0, 0, 0, 0, 0, 0 }};
+
+    // Render time of each tile in the previous frame
+    std::vector<double> tile_costs_;
+
+    std::vector<work_item> items_;
+    std::vector<double> item_times_;
+
+    // Split tiles until sub-tiles are expected to take at most SplitThreshold
+    // times as long as the average tile, use at most MaxSplit x MaxSplit sub-tiles
+    enum { SplitThreshold = 2, MaxSplit = 4 };
+
+    template <typename Func>
+    void for_each_packet_adaptive(
+            tiled_range2d<int> const& tr,
+            int packet_width,
+            int packet_height,
+            Func const& func
+            )
+    {
+        int x0 = tr.rows().begin();
+        int y0 = tr.cols().begin();
+        int tile_width = tr.rows().tile_size();
+        int tile_height = tr.cols().tile_size();
+        int num_tiles_x = div_up(tr.rows().length(), tile_width);
+        int num_tiles_y = div_up(tr.cols().length(), tile_height);
+        int num_tiles = num_tiles_x * num_tiles_y;
+
+        if (num_tiles <= 0)
+        {
+            return;
+        }
+
+        // Costs recorded with a different tile layout are meaningless
+        std::array<int, 6> layout = {{ x0, tr.rows().end(), tile_width, y0, tr.cols().end(), tile_height }};
+
+        if (layout != layout_ || tile_costs_.size() != static_cast<size_t>(num_tiles))
+        {
+            layout_ = layout;
+            tile_costs_.assign(num_tiles, 0.0);
+        }
+
+        double mean = std::accumulate(tile_costs_.begin(), tile_costs_.end(), 0.0) / num_tiles;
+
+        items_.clear();
+
+        for (int t = 0; t < num_tiles; ++t)
+        {
+            int first_x = (t % num_tiles_x) * tile_width + x0;
+            int last_x = std::min(first_x + tile_width, tr.rows().end());
+
+            int first_y = (t / num_tiles_x) * tile_height + y0;
+            int last_y = std::min(first_y + tile_height, tr.cols().end());
+
+            double cost = tile_costs_[t];
+
+            // Split hot tiles, sub-tiles are still multiples of the packet size
+            int s = 1;
+
+            while (s < MaxSplit
+                && cost > SplitThreshold * mean * s * s
+                && tile_width / (2 * s) >= packet_width
+                && tile_height / (2 * s) >= packet_height)
+            {
+                s *= 2;
+            }
+
+            int sub_width = round_up(div_up(tile_width, s), packet_width);
+            int sub_height = round_up(div_up(tile_height, s), packet_height);
+
+            for (int y = first_y; y < last_y; y += sub_height)
+            {
+                for (int x = first_x; x < last_x; x += sub_width)
+                {
+                    range2d<int> r(x, std::min(x + sub_width, last_x), y, std::min(y + sub_height, last_y));
+                    items_.push_back({ r, t, cost / (s * s) });
+                }
+            }
+        }
+
+        // Longest-first, ties (e.g. in the first frame) are processed in scanline order
+        std::stable_sort(
+                items_.begin(),
+                items_.end(),
+                [](work_item const& a, work_item const& b) { return a.cost > b.cost; }
+                );
+
+        item_times_.resize(items_.size());
+
+        // The pool may process the work items in any order,
+        // so hand out the items in sorted order from a shared counter
+        std::atomic<long> next(0);
+
+        pool_.run([&](long)
+            {
+                long i = next++;
+                auto const& r = items_[i].r;
+
+                auto start = std::chrono::steady_clock::now();
+
+                for (int y = r.cols().begin(); y < r.cols().end(); y += packet_height)
+                {
+                    for (int x = r.rows().begin(); x < r.rows().end(); x += packet_width)
+                    {
+                        func(x, y);
+                    }
+                }
+
+                item_times_[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            }, static_cast<long>(items_.size()));
+
+        std::fill(tile_costs_.begin(), tile_costs_.end(), 0.0);
+
+        for (size_t i = 0; i < items_.size(); ++i)
+        {
+            tile_costs_[items_[i].tile] += item_times_[i];
+        }
+    }
 };
 
 template <typename R>
@@ -0,0 +1,334 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_WAVEFRONT_PATHTRACING_INL
+#define VSNRAY_DETAIL_WAVEFRONT_PATHTRACING_INL 1
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include <visionaray/math/simd/type_traits.h>
+#include <visionaray/math/ray.h>
+#include <visionaray/array.h>
+#include <visionaray/result_record.h>
+#include <visionaray/spectrum.h>
+#include <visionaray/traverse.h>
+
+#include "pathtracing.inl"
+
+namespace visionaray
+{
+namespace pathtracing
+{
+
+//-------------------------------------------------------------------------------------------------
+// Wavefront path tracer
+//
+// Processes a stream of primary rays (e.g. all pixels of a screen tile) bounce by
+// bounce instead of tracing each packet to completion. Per bounce, the live paths
+// are kept in a queue and
+//  - regrouped into full SIMD packets of type R for intersection
+//  - compacted, paths that missed the scene are removed
+//  - sorted by the kind of material they hit (the alternative of generic
+//    materials) and then by geometry, so that the packets for shading run
+//    the same BRDF code and mostly read the same material
+//  - regrouped into full SIMD packets again for shading (see shade())
+// Unlike the megakernel, SIMD lanes don't idle when paths terminate early.
+//
+// Uses the same kernel_params as pathtracing::kernel. Schedulers derived from
+// basic_sched (tiled_sched, tbb_sched) detect stream kernels and pass them whole
+// tiles of primary rays. R must be a SIMD ray type
+//
+
+namespace detail
+{
+
+// Material kind for sorting, only generic materials (variants) have more than one
+
+template <typename M>
+inline auto material_kind(M const& mat, int /* prefer this overload */)
+    -> decltype(mat.which())
+{
+    return mat.which();
+}
+
+template <typename M>
+inline unsigned material_kind(M const& /* */, long)
+{
+    return 0;
+}
+
+template <typename M>
+inline unsigned material_kind(M const& mat)
+{
+    return material_kind(mat, 0);
+}
+
+} // detail
+
+template <typename Params>
+struct wavefront_kernel
+{
+    // Tells schedulers to call this kernel with streams of rays
+    using stream_kernel = void;
+
+    Params params;
+
+    template <typename Intersector, typename R, typename Generator>
+    void operator()(
+            Intersector&            isect,
+            R                       /* */,
+            ray const*              rays,
+            result_record<float>*   results,
+            size_t                  count,
+            Generator&              gen
+            ) const
+    {
+        using S = typename R::scalar_type;
+        using I = simd::int_type_t<S>;
+        using C = spectrum<S>;
+        using int_array = simd::aligned_array_t<I>;
+        using float_array = simd::aligned_array_t<S>;
+
+        static_assert(simd::is_simd_vector<S>::value, "Wavefront path tracer requires SIMD rays");
+
+        enum { N = simd::num_elements<S>::value };
+
+        using packed_hit_record = decltype(closest_hit(R{}, params.prims.begin, params.prims.end, isect));
+        using hit_record_type = typename decltype(simd::unpack(packed_hit_record{}))::value_type;
+
+        struct path
+        {
+            ray             r;
+            spectrum<float> throughput;
+            spectrum<float> intensity;
+            bool            last_specular;
+            float           last_pdf;
+        };
+
+        std::vector<path> paths(count);
+        std::vector<hit_record_type> hit_records(count);
+        std::vector<unsigned> queue(count);
+        std::vector<unsigned> material_kinds(count);
+        std::vector<unsigned> next_queue;
+        next_queue.reserve(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            paths[i] = { rays[i], spectrum<float>(1.0f), spectrum<float>(0.0f), true, 1.0f };
+            queue[i] = static_cast<unsigned>(i);
+
+            results[i] = result_record<float>();
+            results[i].color = params.bg_color;
+
+            if (params.environment_map)
+            {
+                results[i].color = sample_environment_light(params.environment_map, rays[i]);
+            }
+        }
+
+        // Lane i of the packet that starts at queue[first] is valid if first + i < queue.size()
+        auto valid_mask = [&](size_t first)
+        {
+            int_array valid;
+
+            for (int i = 0; i < N; ++i)
+            {
+                valid[i] = first + i < queue.size() ? 1 : 0;
+            }
+
+            return I(valid) != I(0);
+        };
+
+        // Path index for lane i, invalid lanes replicate the last valid path
+        auto path_index = [&](size_t first, int i)
+        {
+            return queue[std::min(first + i, queue.size() - 1)];
+        };
+
+        auto pack_spectra = [&](size_t first, spectrum<float> path::*member)
+        {
+            array<spectrum<float>, N> arr;
+
+            for (int i = 0; i < N; ++i)
+            {
+                arr[i] = paths[path_index(first, i)].*member;
+            }
+
+            return simd::pack(arr);
+        };
+
+        for (unsigned bounce = 0; bounce < params.num_bounces && !queue.empty(); ++bounce)
+        {
+            // Intersect
+
+            for (size_t first = 0; first < queue.size(); first += N)
+            {
+                array<ray, N> rs;
+                int_array last_spec;
+                float_array last_pdfs;
+
+                for (int i = 0; i < N; ++i)
+                {
+                    auto const& p = paths[path_index(first, i)];
+                    rs[i] = p.r;
+                    last_spec[i] = p.last_specular ? 1 : 0;
+                    last_pdfs[i] = p.last_pdf;
+                }
+
+                R r = simd::pack(rs);
+                C throughput = pack_spectra(first, &path::throughput);
+                C intensity = pack_spectra(first, &path::intensity);
+
+                auto hit_rec = closest_hit(r, params.prims.begin, params.prims.end, isect);
+
+                auto exited = valid_mask(first) & !hit_rec.hit;
+                auto last_specular = I(last_spec) != I(0);
+
+                add_background(params, r, bounce, exited, last_specular, S(last_pdfs), throughput, intensity);
+
+                auto hrs = simd::unpack(hit_rec);
+                auto its = simd::unpack(intensity.samples());
+
+                for (int i = 0; i < N && first + i < queue.size(); ++i)
+                {
+                    unsigned p = queue[first + i];
+                    hit_records[p] = hrs[i];
+                    paths[p].intensity = spectrum<float>(its[i]);
+                }
+            }
+
+
+            // Compact, first bounce determines hit and depth of the pixel
+
+            next_queue.clear();
+
+            for (unsigned p : queue)
+            {
+                if (!hit_records[p].hit)
+                {
+                    continue;
+                }
+
+                if (bounce == 0)
+                {
+                    results[p].hit = true;
+                    results[p].isect_pos = paths[p].r.ori + paths[p].r.dir * hit_records[p].t;
+                }
+
+                material_kinds[p] = detail::material_kind(params.materials[hit_records[p].geom_id]);
+
+                next_queue.push_back(p);
+            }
+
+            std::swap(queue, next_queue);
+
+
+            // Sort by material kind, then by geometry
+
+            std::stable_sort(
+                    queue.begin(),
+                    queue.end(),
+                    [&](unsigned a, unsigned b)
+                    {
+                        if (material_kinds[a] != material_kinds[b])
+                        {
+                            return material_kinds[a] < material_kinds[b];
+                        }
+
+                        return hit_records[a].geom_id < hit_records[b].geom_id;
+                    }
+                    );
+
+
+            // Shade
+
+            next_queue.clear();
+
+            for (size_t first = 0; first < queue.size(); first += N)
+            {
+                array<ray, N> rs;
+                array<hit_record_type, N> hrs;
+                int_array last_spec;
+                float_array last_pdfs;
+
+                for (int i = 0; i < N; ++i)
+                {
+                    auto const& p = paths[path_index(first, i)];
+                    rs[i] = p.r;
+                    hrs[i] = hit_records[path_index(first, i)];
+                    last_spec[i] = p.last_specular ? 1 : 0;
+                    last_pdfs[i] = p.last_pdf;
+                }
+
+                R r = simd::pack(rs);
+                auto hit_rec = simd::pack(hrs);
+                C throughput = pack_spectra(first, &path::throughput);
+                C intensity = pack_spectra(first, &path::intensity);
+
+                auto active = valid_mask(first);
+                auto last_specular = I(last_spec) != I(0);
+                S last_pdf(last_pdfs);
+
+                shade(params, isect, r, hit_rec, bounce, active, last_specular, last_pdf, intensity, throughput, gen);
+
+                auto new_rays = simd::unpack(r);
+                auto tps = simd::unpack(throughput.samples());
+                auto its = simd::unpack(intensity.samples());
+
+                int_array act;
+                store(act, convert_to_int(active));
+                store(last_spec, convert_to_int(last_specular));
+                store(last_pdfs, last_pdf);
+
+                for (int i = 0; i < N && first + i < queue.size(); ++i)
+                {
+                    unsigned p = queue[first + i];
+
+                    paths[p].r = new_rays[i];
+                    paths[p].throughput = spectrum<float>(tps[i]);
+                    paths[p].intensity = spectrum<float>(its[i]);
+                    paths[p].last_specular = last_spec[i] != 0;
+                    paths[p].last_pdf = last_pdfs[i];
+
+                    if (act[i])
+                    {
+                        next_queue.push_back(p);
+                    }
+                }
+            }
+
+            std::swap(queue, next_queue);
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (results[i].hit)
+            {
+                results[i].color = to_rgba(paths[i].intensity);
+            }
+        }
+    }
+
+    template <typename R, typename Generator>
+    void operator()(
+            R                       /* */,
+            ray const*              rays,
+            result_record<float>*   results,
+            size_t                  count,
+            Generator&              gen
+            ) const
+    {
+        default_intersector ignore;
+        (*this)(ignore, R{}, rays, results, count, gen);
+    }
+};
+
+} // pathtracing
+} // visionaray
+
+#endif // VSNRAY_DETAIL_WAVEFRONT_PATHTRACING_INL
@@ -0,0 +1,248 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DISTRIBUTION_2D_H
+#define VSNRAY_DISTRIBUTION_2D_H 1
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "detail/macros.h"
+#include "math/simd/type_traits.h"
+#include "math/vector.h"
+#include "aligned_vector.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Piecewise-constant 2D distribution reference, can be used on the device
+//
+// Samples [0,1)^2 with a density proportional to a function given on a width x height
+// grid. A row is chosen with the marginal CDF, the column with the conditional CDF of
+// that row. pdf() is the density w.r.t. area on [0,1)^2
+//
+
+struct distribution_2d_ref
+{
+    float const*    func;               // width * height
+    float const*    conditional_cdf;    // height * (width + 1)
+    float const*    marginal_cdf;       // height + 1
+    unsigned        width;
+    unsigned        height;
+    float           integral;
+
+    VSNRAY_FUNC explicit operator bool() const
+    {
+        return func != nullptr;
+    }
+
+    // Map u in [0,1)^2 to a sample, pdf is the density at the sample
+    VSNRAY_FUNC vec2 sample(vec2 const& u, float& pdf) const
+    {
+        float dy;
+        unsigned y = find_interval(marginal_cdf, height, u.y, dy);
+
+        float dx;
+        unsigned x = find_interval(conditional_cdf + y * (width + 1), width, u.x, dx);
+
+        pdf = func[y * width + x] / integral;
+
+        return vec2((x + dx) / width, (y + dy) / height);
+    }
+
+    template <
+        typename T,
+        typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type
+        >
+    VSNRAY_FUNC vector<2, T> sample(vector<2, T> const& u, T& pdf) const
+    {
+        using float_array = simd::aligned_array_t<T>;
+
+        float_array ux;
+        float_array uy;
+        store(ux, u.x);
+        store(uy, u.y);
+
+        float_array x;
+        float_array y;
+        float_array pdfs;
+
+        for (size_t i = 0; i < simd::num_elements<T>::value; ++i)
+        {
+            auto s = sample(vector<2, float>(ux[i], uy[i]), pdfs[i]);
+            x[i] = s.x;
+            y[i] = s.y;
+        }
+
+        pdf = T(pdfs);
+        return vector<2, T>(T(x), T(y));
+    }
+
+    VSNRAY_FUNC float pdf(vec2 const& p) const
+    {
+        int x = static_cast<int>(p.x * width);
+        int y = static_cast<int>(p.y * height);
+        x = x < 0 ? 0 : x >= static_cast<int>(width) ? width - 1 : x;
+        y = y < 0 ? 0 : y >= static_cast<int>(height) ? height - 1 : y;
+
+        return func[y * width + x] / integral;
+    }
+
+    template <
+        typename T,
+        typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type
+        >
+    VSNRAY_FUNC T pdf(vector<2, T> const& p) const
+    {
+        using float_array = simd::aligned_array_t<T>;
+
+        float_array x;
+        float_array y;
+        store(x, p.x);
+        store(y, p.y);
+
+        float_array pdfs;
+
+        for (size_t i = 0; i < simd::num_elements<T>::value; ++i)
+        {
+            pdfs[i] = pdf(vector<2, float>(x[i], y[i]));
+        }
+
+        return T(pdfs);
+    }
+
+private:
+
+    // Interval i with cdf[i] <= u < cdf[i + 1] and the offset of u within it
+    VSNRAY_FUNC static unsigned find_interval(float const* cdf, unsigned n, float u, float& offset)
+    {
+        unsigned first = 0;
+        unsigned last = n;
+
+        while (last - first > 1)
+        {
+            unsigned mid = (first + last) / 2;
+
+            if (cdf[mid] <= u)
+            {
+                first = mid;
+            }
+            else
+            {
+                last = mid;
+            }
+        }
+
+        float width = cdf[first + 1] - cdf[first];
+        offset = width > 0.0f ? (u - cdf[first]) / width : 0.0f;
+        offset = offset < 1.0f ? offset : 0.99999994f;
+
+        return first;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Piecewise-constant 2D distribution
+//
+// Owns the CDFs, build() on the host and pass ref() to the kernels. Functions that are
+// zero everywhere result in a uniform distribution
+//
+
+class distribution_2d
+{
+public:
+
+    using ref_type = distribution_2d_ref;
+
+    void build(float const* func, unsigned width, unsigned height)
+    {
+        func_.assign(func, func + width * height);
+        conditional_cdf_.resize(height * (width + 1));
+        marginal_cdf_.resize(height + 1);
+        width_ = width;
+        height_ = height;
+
+        std::vector<double> row_integrals(height);
+
+        for (unsigned y = 0; y < height; ++y)
+        {
+            row_integrals[y] = build_cdf(&func_[y * width], width, &conditional_cdf_[y * (width + 1)]);
+        }
+
+        std::vector<float> marginal_func(row_integrals.begin(), row_integrals.end());
+        integral_ = static_cast<float>(build_cdf(marginal_func.data(), height, marginal_cdf_.data()));
+
+        if (integral_ <= 0.0f)
+        {
+            std::fill(func_.begin(), func_.end(), 1.0f);
+            integral_ = 1.0f;
+        }
+    }
+
+    distribution_2d_ref ref() const
+    {
+        return {
+            func_.data(),
+            conditional_cdf_.data(),
+            marginal_cdf_.data(),
+            width_,
+            height_,
+            integral_
+            };
+    }
+
+    unsigned width() const
+    {
+        return width_;
+    }
+
+    unsigned height() const
+    {
+        return height_;
+    }
+
+private:
+
+    aligned_vector<float> func_;
+    aligned_vector<float> conditional_cdf_;
+    aligned_vector<float> marginal_cdf_;
+
+    unsigned width_ = 0;
+    unsigned height_ = 0;
+    float integral_ = 0.0f;
+
+    // Writes n + 1 CDF values, returns the integral of func over [0,1)
+    static double build_cdf(float const* func, unsigned n, float* cdf)
+    {
+        std::vector<double> sums(n + 1);
+        sums[0] = 0.0;
+
+        for (unsigned i = 0; i < n; ++i)
+        {
+            sums[i + 1] = sums[i] + func[i] / static_cast<double>(n);
+        }
+
+        double integral = sums[n];
+
+        for (unsigned i = 0; i <= n; ++i)
+        {
+            cdf[i] = integral > 0.0
+                ? static_cast<float>(sums[i] / integral)
+                : static_cast<float>(i) / n;
+        }
+
+        cdf[n] = 1.0f;
+
+        return integral;
+    }
+};
+
+} // visionaray
+
+#endif // VSNRAY_DISTRIBUTION_2D_H
@@ -8,6 +8,8 @@
 
 #include "detail/macros.h"
 #include "math/matrix.h"
+#include "math/vector.h"
+#include "distribution_2d.h"
 #include "spectrum.h"
 
 namespace visionaray
@@ -35,6 +37,26 @@ public:
     VSNRAY_FUNC matrix<4, 4, T> light_to_world_transform() const;
     VSNRAY_FUNC matrix<4, 4, T> world_to_light_transform() const;
 
+    // Texture coordinate for world space direction dir (latitude-longitude map)
+    template <typename U>
+    VSNRAY_FUNC vector<2, U> tex_coord(vector<3, U> const& dir) const;
+
+    // Radiance arriving from direction dir
+    template <typename U>
+    VSNRAY_FUNC vector<3, U> intensity(vector<3, U> const& dir) const;
+
+    // Distribution for importance sampling (see make_environment_distribution())
+    VSNRAY_FUNC void set_distribution(distribution_2d_ref const& distribution);
+    VSNRAY_FUNC distribution_2d_ref const& distribution() const;
+
+    // Sample a world space direction, pdf is w.r.t. solid angle. Requires a distribution
+    template <typename Generator, typename U = typename Generator::value_type>
+    VSNRAY_FUNC vector<3, U> sample(Generator& gen, U& pdf) const;
+
+    // Solid angle pdf of sample() for world space direction dir
+    template <typename U>
+    VSNRAY_FUNC U pdf(vector<3, U> const& dir) const;
+
     VSNRAY_FUNC operator bool() const;
 
 private:
@@ -44,8 +66,21 @@ private:
 
     matrix<4, 4, T> light_to_world_transform_;
     matrix<4, 4, T> world_to_light_transform_;
+
+    distribution_2d_ref distribution_ = {};
 };
 
+
+//-------------------------------------------------------------------------------------------------
+// Build the sampling distribution of an environment light from its texture on the host
+//
+// Texels are weighted by their luminance and by sin(theta), the area they cover on the
+// sphere. dist must outlive the environment light
+//
+
+template <typename Texture>
+void make_environment_distribution(distribution_2d& dist, Texture const& tex);
+
 } // visionaray
 
 #include "detail/environment_light.inl"
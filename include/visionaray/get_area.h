@@ -144,6 +144,73 @@ inline auto get_area(Primitives const& prims, HR const& hr)
     return T(result);
 }
 
+// BVH of indexed triangles, no SIMD
+template <
+    typename Primitives,
+    typename HR,
+    typename T,
+    typename Primitive = typename std::iterator_traits<Primitives>::value_type,
+    typename = typename std::enable_if<is_any_bvh<Primitive>::value>::type,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_area(Primitives const& prims, HR const& hr, vector<3, T> const* vertices)
+    -> decltype(area(std::declval<typename Primitive::primitive_type>(), vertices))
+{
+    // Find the BVH that contains prim_id
+    size_t num_primitives_total = 0;
+
+    size_t i = 0;
+    while (static_cast<size_t>(hr.prim_id) >= num_primitives_total + prims[i].num_primitives())
+    {
+        num_primitives_total += prims[i++].num_primitives();
+    }
+
+    return area(prims[i].primitive(hr.primitive_list_index), vertices);
+}
+
+// BVH of indexed triangles, SIMD
+template <
+    typename Primitives,
+    typename HR,
+    typename T,
+    typename Primitive = typename std::iterator_traits<Primitives>::value_type,
+    typename = typename std::enable_if<is_any_bvh<Primitive>::value>::type,
+    typename = typename std::enable_if<simd::is_simd_vector<typename HR::scalar_type>::value>::type,
+    typename = decltype(area(std::declval<typename Primitive::primitive_type>(), std::declval<vector<3, T> const*>()))
+    >
+VSNRAY_FUNC
+inline auto get_area(Primitives const& prims, HR const& hr, vector<3, T> const* vertices)
+    -> typename HR::scalar_type
+{
+    using S = typename HR::scalar_type;
+    using float_array = simd::aligned_array_t<S>;
+    using int_array = simd::aligned_array_t<simd::int_type_t<S>>;
+
+    int_array prim_id;
+    store(prim_id, hr.prim_id);
+
+    int_array primitive_list_index;
+    store(primitive_list_index, hr.primitive_list_index);
+
+    float_array result = {};
+
+    for (unsigned i = 0; i < simd::num_elements<S>::value; ++i)
+    {
+        // Find the BVH that contains prim_id[i]
+        size_t num_primitives_total = 0;
+
+        size_t j = 0;
+        while (static_cast<size_t>(prim_id[i]) >= num_primitives_total + prims[j].num_primitives())
+        {
+            num_primitives_total += prims[j++].num_primitives();
+        }
+        result[i] = area(prims[j].primitive(primitive_list_index[i]), vertices);
+    }
+
+    return S(result);
+}
+
 // BVH instance, no SIMD
 template <
     typename Primitives,
@@ -203,6 +270,41 @@ inline auto get_area(Primitives const& prims, HR const& hr, void* = nullptr)
     return T(result);
 }
 
+
+//-------------------------------------------------------------------------------------------------
+// Area of the primitive that was hit, passes the vertex buffer from the kernel params along
+// if the primitives need it (indexed triangles)
+//
+
+namespace detail
+{
+
+template <typename Params, typename HR>
+VSNRAY_FUNC
+inline auto get_area(Params const& params, HR const& hr, int /* prefer this overload */)
+    -> decltype(visionaray::get_area(params.prims.begin, hr, params.vertices))
+{
+    return visionaray::get_area(params.prims.begin, hr, params.vertices);
+}
+
+template <typename Params, typename HR>
+VSNRAY_FUNC
+inline auto get_area(Params const& params, HR const& hr, long)
+    -> decltype(visionaray::get_area(params.prims.begin, hr))
+{
+    return visionaray::get_area(params.prims.begin, hr);
+}
+
+template <typename Params, typename HR>
+VSNRAY_FUNC
+inline auto get_area(Params const& params, HR const& hr)
+    -> decltype(detail::get_area(params, hr, 0))
+{
+    return detail::get_area(params, hr, 0);
+}
+
+} // detail
+
 } // visionaray
 
 #endif // VSNRAY_GET_AREA_H
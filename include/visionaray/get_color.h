@@ -12,6 +12,7 @@
 
 #include "detail/macros.h"
 #include "math/simd/type_traits.h"
+#include "math/indexed_triangle.h"
 #include "math/triangle.h"
 #include "math/vector.h"
 #include "array.h"
@@ -96,6 +97,35 @@ inline auto get_color(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Get indexed triangle vertex color from array, colors are indexed with the vertex indices
+//
+
+template <
+    typename Colors,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_color(
+        Colors                              colors,
+        HR const&                           hr,
+        basic_indexed_triangle<T> const&    tri,
+        colors_per_vertex_binding           /* */
+        )
+    -> typename std::iterator_traits<Colors>::value_type
+{
+    return lerp(
+            colors[tri.index[0]],
+            colors[tri.index[1]],
+            colors[tri.index[2]],
+            hr.u,
+            hr.v
+            );
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Gather N face colors for SIMD ray
 //
@@ -11,6 +11,7 @@
 
 #include "detail/macros.h"
 #include "math/simd/type_traits.h"
+#include "math/indexed_triangle.h"
 #include "math/plane.h"
 #include "math/sphere.h"
 #include "math/triangle.h"
@@ -57,6 +58,23 @@ inline auto get_normal(
     return normals[hr.prim_id];
 }
 
+template <
+    typename Normals,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_normal(
+        Normals                             normals,
+        HR const&                           hr,
+        basic_indexed_triangle<T> const&    /* */
+        )
+    -> typename std::iterator_traits<Normals>::value_type
+{
+    return normals[hr.prim_id];
+}
+
 //-------------------------------------------------------------------------------------------------
 // Gather N face normals for SIMD ray
 //
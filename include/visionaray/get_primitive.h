@@ -9,6 +9,7 @@
 #include <type_traits>
 
 #include "detail/macros.h"
+#include "math/triangle_packet.h"
 #include "bvh.h"
 
 namespace visionaray
@@ -38,7 +39,9 @@ template <
     typename P = typename Params::primitive_type,
     typename = typename std::enable_if<is_any_bvh<P>::value>::type,
     typename = typename std::enable_if<
-                !is_any_bvh_inst<typename P::primitive_type>::value>::type // but not BVH of instances!
+                !is_any_bvh_inst<typename P::primitive_type>::value>::type, // but not BVH of instances!
+    typename = typename std::enable_if<
+                !is_triangle_packet<typename P::primitive_type>::value>::type // or of triangle packets!
     >
 VSNRAY_FUNC
 inline typename P::primitive_type const& get_primitive(Params const& params, HR const& hr)
@@ -69,6 +72,24 @@ inline auto get_primitive(Params const& params, HR const& hr)
     return params.prims.begin[0].primitive(hr.primitive_list_index).primitive(hr.primitive_list_index_inst);
 }
 
+// overload for BVHs of triangle packets, returns the triangle that was hit
+template <
+    typename Params,
+    typename HR,
+    typename Base = typename HR::base_type,
+    typename P = typename Params::primitive_type,
+    typename = typename std::enable_if<is_any_bvh<P>::value>::type, // is BVH ...
+    typename = typename std::enable_if<
+                is_triangle_packet<typename P::primitive_type>::value>::type, // ... of triangle packets!
+    typename X = void,
+    typename Y = void
+    >
+VSNRAY_FUNC
+inline basic_triangle<3, float> get_primitive(Params const& params, HR const& hr)
+{
+    return get_triangle(params.prims.begin[0].primitive(hr.primitive_list_index), hr.lane);
+}
+
 } // visionaray
 
 #endif // VSNRAY_GET_PRIMITIVE_H
@@ -12,6 +12,7 @@
 #include "detail/macros.h"
 #include "math/detail/math.h"
 #include "math/simd/type_traits.h"
+#include "math/indexed_triangle.h"
 #include "math/triangle.h"
 #include "get_normal.h"
 #include "prim_traits.h"
@@ -106,6 +107,36 @@ inline auto get_shading_normal(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// get_shading_normal for indexed triangles with normals_per_vertex_binding, the normals
+// are indexed with the vertex indices
+//
+
+template <
+    typename Normals,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_shading_normal(
+        Normals                             normals,
+        HR const&                           hr,
+        basic_indexed_triangle<T> const&    tri,
+        normals_per_vertex_binding          /* */
+        )
+    -> typename std::iterator_traits<Normals>::value_type
+{
+    return normalize( lerp(
+            normals[tri.index[0]],
+            normals[tri.index[1]],
+            normals[tri.index[2]],
+            hr.u,
+            hr.v
+            ) );
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // get_shading_normal for triangles with normals_per_vertex_binding for SIMD ray
 //
@@ -17,6 +17,7 @@
 #include "get_primitive.h"
 #include "get_shading_normal.h"
 #include "get_tex_coord.h"
+#include "ray_differential.h"
 #include "surface.h"
 
 namespace visionaray
@@ -121,6 +122,134 @@ inline typename Params::color_type get_tex_color(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Sample textures with ray differentials
+//
+
+// Only 2D textures on triangles select a mip level, sample others as usual
+template <typename HR, typename Params, typename T, typename Primitive, int Dim>
+VSNRAY_FUNC
+inline typename Params::color_type get_tex_color(
+        HR const&                           hr,
+        Params const&                       params,
+        basic_ray<T> const&                 ray,
+        ray_differential<T> const&          rd,
+        vector<3, T> const&                 n,
+        Primitive const&                    prim,
+        std::integral_constant<int, Dim>    dim
+        )
+{
+    VSNRAY_UNUSED(ray);
+    VSNRAY_UNUSED(rd);
+    VSNRAY_UNUSED(n);
+    VSNRAY_UNUSED(prim);
+
+    return get_tex_color(hr, params, dim);
+}
+
+template <typename HR, typename Params, typename T, typename U>
+VSNRAY_FUNC
+inline typename Params::color_type get_tex_color(
+        HR const&                           hr,
+        Params const&                       params,
+        basic_ray<T> const&                 ray,
+        ray_differential<T> const&          rd,
+        vector<3, T> const&                 n,
+        basic_triangle<3, U> const&         tri,
+        std::integral_constant<int, 2>      /* */
+        )
+{
+    using C = typename Params::color_type;
+    using TC = typename Params::tex_coords_type;
+
+    auto coord = get_tex_coord(params.tex_coords, hr, tri);
+
+    vector<3, T> dpdx;
+    vector<3, T> dpdy;
+    position_differentials(rd, ray, hr.t, n, dpdx, dpdy);
+
+    TC dtdx;
+    TC dtdy;
+    tex_coord_differentials(
+            tri,
+            params.tex_coords[hr.prim_id * 3],
+            params.tex_coords[hr.prim_id * 3 + 1],
+            params.tex_coords[hr.prim_id * 3 + 2],
+            dpdx,
+            dpdy,
+            dtdx,
+            dtdy
+            );
+
+    auto const& tex = params.textures[hr.geom_id];
+    return C(tex2DGrad(tex, coord, dtdx, dtdy));
+}
+
+
+template <typename HR, typename Params, typename T, typename U>
+VSNRAY_FUNC
+inline typename Params::color_type get_tex_color(
+        HR const&                           hr,
+        Params const&                       params,
+        basic_ray<T> const&                 ray,
+        ray_differential<T> const&          rd,
+        vector<3, T> const&                 n,
+        basic_indexed_triangle<U> const&    tri,
+        std::integral_constant<int, 2>      /* */
+        )
+{
+    using C = typename Params::color_type;
+    using TC = typename Params::tex_coords_type;
+
+    auto coord = get_tex_coord(params.tex_coords, hr, tri);
+
+    vector<3, T> dpdx;
+    vector<3, T> dpdy;
+    position_differentials(rd, ray, hr.t, n, dpdx, dpdy);
+
+    TC dtdx;
+    TC dtdy;
+    tex_coord_differentials(
+            get_triangle(tri, params.vertices),
+            params.tex_coords[tri.index[0]],
+            params.tex_coords[tri.index[1]],
+            params.tex_coords[tri.index[2]],
+            dpdx,
+            dpdy,
+            dtdx,
+            dtdy
+            );
+
+    auto const& tex = params.textures[hr.geom_id];
+    return C(tex2DGrad(tex, coord, dtdx, dtdy));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Geometric normal, from params.geometric_normals if present. Indexed triangles
+// fetch their vertices from params.vertices
+//
+
+template <typename HR, typename Params, typename P>
+VSNRAY_FUNC
+inline auto get_geometric_normal(HR const& hr, Params const& params, P const& prim)
+    -> decltype(params.geometric_normals ? get_normal(params.geometric_normals, hr, prim) : get_normal(hr, prim))
+{
+    auto const& gns = params.geometric_normals;
+
+    return gns ? get_normal(gns, hr, prim) : get_normal(hr, prim);
+}
+
+template <typename HR, typename Params, typename T>
+VSNRAY_FUNC
+inline vector<3, T> get_geometric_normal(HR const& hr, Params const& params, basic_indexed_triangle<T> const& tri)
+{
+    auto const& gns = params.geometric_normals;
+
+    return gns ? vector<3, T>(get_normal(gns, hr, tri)) : get_normal(hr, get_triangle(tri, params.vertices));
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // No SIMD
 //
@@ -142,10 +271,9 @@ inline auto get_surface_impl(HR const& hr, Params const& params)
 
     auto const& prim = get_primitive(params, hr);
 
-    auto const& gns = params.geometric_normals;
     auto const& sns = params.shading_normals;
 
-    auto gn    = gns ? get_normal(gns, hr, prim) : get_normal(hr, prim);
+    auto gn    = get_geometric_normal(hr, params, prim);
     auto sn    = sns ? get_shading_normal(sns, hr, prim, typename Params::normal_binding{}) : gn;
     auto color = params.colors ? get_color(params.colors, hr, prim, typename Params::color_binding{}) : C(1.0);
     auto tc    = params.tex_coords && params.textures ? get_tex_color(
@@ -158,6 +286,50 @@ inline auto get_surface_impl(HR const& hr, Params const& params)
 }
 
 
+// With ray differentials ---------------------------------
+
+template <
+    typename HR,
+    typename Params,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_surface_impl(
+        HR const&                   hr,
+        Params const&               params,
+        basic_ray<T> const&         ray,
+        ray_differential<T> const&  rd
+        )
+    -> surface<
+            typename Params::normal_type,
+            typename Params::color_type,
+            typename Params::material_type
+            >
+{
+    using C = typename Params::color_type;
+
+    auto const& prim = get_primitive(params, hr);
+
+    auto const& sns = params.shading_normals;
+
+    auto gn    = get_geometric_normal(hr, params, prim);
+    auto sn    = sns ? get_shading_normal(sns, hr, prim, typename Params::normal_binding{}) : gn;
+    auto color = params.colors ? get_color(params.colors, hr, prim, typename Params::color_binding{}) : C(1.0);
+    auto tc    = params.tex_coords && params.textures ? get_tex_color(
+                        hr,
+                        params,
+                        ray,
+                        rd,
+                        vector<3, T>(gn),
+                        prim,
+                        std::integral_constant<int, texture_dimensions<typename Params::texture_type>::value>{}
+                        ) : C(1.0);
+
+    return { gn, sn, color * tc, params.materials[hr.geom_id] };
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // SIMD
 //
@@ -188,6 +360,43 @@ inline auto get_surface_impl(HR const& hr, Params const& params)
     return simd::pack(surfs);
 }
 
+template <
+    typename HR,
+    typename Params,
+    typename T,
+    typename = typename std::enable_if<simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_surface_impl(
+        HR const&                   hr,
+        Params const&               params,
+        basic_ray<T> const&         ray,
+        ray_differential<T> const&  rd
+        )
+    -> typename simd_decl_surface<Params, typename HR::scalar_type>::type
+{
+    auto hrs = unpack(hr);
+    auto rays = unpack(ray);
+
+    auto ori_dx = unpack(rd.ori_dx);
+    auto ori_dy = unpack(rd.ori_dy);
+    auto dir_dx = unpack(rd.dir_dx);
+    auto dir_dy = unpack(rd.dir_dy);
+
+    typename simd_decl_surface<Params, T>::array_type surfs;
+
+    for (int i = 0; i < simd::num_elements<T>::value; ++i)
+    {
+        if (hrs[i].hit)
+        {
+            ray_differential<simd::element_type_t<T>> rdi = { ori_dx[i], ori_dy[i], dir_dx[i], dir_dy[i] };
+            surfs[i] = get_surface_impl(hrs[i], params, rays[i], rdi);
+        }
+    }
+
+    return simd::pack(surfs);
+}
+
 } // detail
 
 
@@ -199,6 +408,15 @@ inline auto get_surface(HR const& hr, Params const& p)
     return detail::get_surface_impl(hr, p);
 }
 
+// Select texture mip levels with the differentials of the ray that produced hr
+template <typename HR, typename Params, typename T>
+VSNRAY_FUNC
+inline auto get_surface(HR const& hr, Params const& p, basic_ray<T> const& ray, ray_differential<T> const& rd)
+    -> decltype(detail::get_surface_impl(hr, p, ray, rd))
+{
+    return detail::get_surface_impl(hr, p, ray, rd);
+}
+
 } // visionaray
 
 #endif // VSNRAY_SURFACE_H
@@ -14,6 +14,7 @@
 #include "math/detail/math.h"
 #include "math/simd/type_traits.h"
 #include "math/constants.h"
+#include "math/indexed_triangle.h"
 #include "math/sphere.h"
 #include "math/triangle.h"
 #include "math/vector.h"
@@ -62,6 +63,30 @@ inline auto get_tex_coord(TexCoords tex_coords, HR const& hr, basic_triangle<3,
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Indexed triangle, texture coordinates are indexed with the vertex indices
+//
+
+template <
+    typename TexCoords,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_tex_coord(TexCoords tex_coords, HR const& hr, basic_indexed_triangle<T> const& tri)
+    -> typename std::iterator_traits<TexCoords>::value_type
+{
+    return lerp(
+            tex_coords[tri.index[0]],
+            tex_coords[tri.index[1]],
+            tex_coords[tri.index[2]],
+            hr.u,
+            hr.v
+            );
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // SIMD triangle
 //
@@ -12,6 +12,8 @@
 
 #include "detail/macros.h"
 #include "detail/tags.h"
+#include "math/indexed_triangle.h"
+#include "math/vector.h"
 #include "bvh.h"
 
 namespace visionaray
@@ -127,6 +129,47 @@ struct default_intersector : basic_intersector<default_intersector>
 {
 };
 
+
+//-------------------------------------------------------------------------------------------------
+// Intersector for indexed triangles, provides the vertex buffer that the triangles refer to
+//
+// Usage:
+//
+//      indexed_triangle_intersector<float> isect(vertices.data());
+//      auto hr = closest_hit(ray, &bvh_ref, &bvh_ref + 1, isect);
+//
+
+template <typename T>
+class indexed_triangle_intersector : public basic_intersector<indexed_triangle_intersector<T>>
+{
+public:
+
+    using base_type = basic_intersector<indexed_triangle_intersector<T>>;
+    using base_type::operator();
+
+public:
+
+    indexed_triangle_intersector() = default;
+
+    VSNRAY_FUNC explicit indexed_triangle_intersector(vector<3, T> const* vertices)
+        : vertices_(vertices)
+    {
+    }
+
+    template <typename R, typename P>
+    VSNRAY_FUNC
+    auto operator()(R const& ray, basic_indexed_triangle<T, P> const& tri)
+        -> decltype( intersect(ray, tri, std::declval<vector<3, T> const*>()) )
+    {
+        return intersect(ray, tri, vertices_);
+    }
+
+private:
+
+    vector<3, T> const* vertices_ = nullptr;
+
+};
+
 } // visionaray
 
 #endif // VSNRAY_INTERSECTOR_H
@@ -32,7 +32,8 @@ template <
     typename Textures,
     typename Lights,
     typename Color,
-    typename EnvMap
+    typename EnvMap,
+    typename LightSampler
     >
 struct kernel_params
 {
@@ -72,6 +73,12 @@ struct kernel_params
     Color ambient_color;
 
     EnvMap environment_map;
+
+    // Selects lights for next event estimation, uniform if nullptr
+    LightSampler light_sampler;
+
+    // Vertex buffer of indexed triangles (see basic_indexed_triangle)
+    vector<3, float> const* vertices;
 };
 
 
@@ -105,7 +112,8 @@ auto make_kernel_params(
         std::nullptr_t*, // dummy texture type
         std::nullptr_t*, // dummy light type
         vec4,
-        std::nullptr_t*  // dummy env map type
+        std::nullptr_t*, // dummy env map type
+        std::nullptr_t*  // dummy light sampler type
         >
 {
     return {
@@ -121,7 +129,9 @@ auto make_kernel_params(
         epsilon,
         bg_color,
         ambient_color,
-        nullptr  // env map
+        nullptr, // env map
+        nullptr, // light sampler
+        nullptr  // vertices
         };
 }
 
@@ -155,7 +165,8 @@ auto make_kernel_params(
         std::nullptr_t*, // dummy texture type
         Lights,
         vec4,
-        std::nullptr_t*  // dummy env map type
+        std::nullptr_t*, // dummy env map type
+        std::nullptr_t*  // dummy light sampler type
         >
 {
     return {
@@ -171,7 +182,9 @@ auto make_kernel_params(
         epsilon,
         bg_color,
         ambient_color,
-        nullptr  // env map
+        nullptr, // env map
+        nullptr, // light sampler
+        nullptr  // vertices
         };
 }
 
@@ -211,7 +224,8 @@ auto make_kernel_params(
         std::nullptr_t*, // dummy texture type
         Lights,
         vec4,
-        std::nullptr_t*  // dummy env map type
+        std::nullptr_t*, // dummy env map type
+        std::nullptr_t*  // dummy light sampler type
         >
 {
     return {
@@ -227,7 +241,9 @@ auto make_kernel_params(
         epsilon,
         bg_color,
         ambient_color,
-        nullptr  // env map
+        nullptr, // env map
+        nullptr, // light sampler
+        nullptr  // vertices
         };
 }
 
@@ -271,7 +287,8 @@ auto make_kernel_params(
         Textures,
         Lights,
         vec4,
-        std::nullptr_t* // dummy env map type
+        std::nullptr_t*, // dummy env map type
+        std::nullptr_t*  // dummy light sampler type
         >
 {
     return {
@@ -287,7 +304,9 @@ auto make_kernel_params(
         epsilon,
         bg_color,
         ambient_color,
-        nullptr  // env map
+        nullptr, // env map
+        nullptr, // light sampler
+        nullptr  // vertices
         };
 }
 
@@ -336,7 +355,8 @@ auto make_kernel_params(
         Textures,
         Lights,
         vec4,
-        std::nullptr_t* // dummy env map type
+        std::nullptr_t*, // dummy env map type
+        std::nullptr_t*  // dummy light sampler type
         >
 {
     return {
@@ -352,7 +372,9 @@ auto make_kernel_params(
         epsilon,
         bg_color,
         ambient_color,
-        nullptr // env map
+        nullptr, // env map
+        nullptr, // light sampler
+        nullptr  // vertices
         };
 }
 
@@ -400,7 +422,8 @@ auto make_kernel_params(
         Textures,
         Lights,
         vec4,
-        EnvMap
+        EnvMap,
+        std::nullptr_t*  // dummy light sampler type
         >
 {
     return {
@@ -416,12 +439,157 @@ auto make_kernel_params(
         epsilon,
         vec4(), // dummy bgcolor
         vec4(), // ambient color
-        environment_map
+        environment_map,
+        nullptr, // light sampler
+        nullptr  // vertices
         };
 }
+
+
+//-------------------------------------------------------------------------------------------------
+// Replace the light sampler of a param struct, e.g. with a light_bvh_ref
+//
+
+template <
+    typename NormalBinding,
+    typename ColorBinding,
+    typename Primitives,
+    typename Normals,
+    typename TexCoords,
+    typename Materials,
+    typename Colors,
+    typename Textures,
+    typename Lights,
+    typename Color,
+    typename EnvMap,
+    typename LightSampler,
+    typename NewLightSampler
+    >
+auto with_light_sampler(
+        kernel_params<
+            NormalBinding,
+            ColorBinding,
+            Primitives,
+            Normals,
+            TexCoords,
+            Materials,
+            Colors,
+            Textures,
+            Lights,
+            Color,
+            EnvMap,
+            LightSampler
+            > const&                params,
+        NewLightSampler const&      light_sampler
+        )
+    -> kernel_params<
+        NormalBinding,
+        ColorBinding,
+        Primitives,
+        Normals,
+        TexCoords,
+        Materials,
+        Colors,
+        Textures,
+        Lights,
+        Color,
+        EnvMap,
+        NewLightSampler
+        >
+{
+    return {
+        { params.prims.begin, params.prims.end },
+        params.geometric_normals,
+        params.shading_normals,
+        params.tex_coords,
+        params.materials,
+        params.colors,
+        params.textures,
+        { params.lights.begin, params.lights.end },
+        params.num_bounces,
+        params.epsilon,
+        params.bg_color,
+        params.ambient_color,
+        params.environment_map,
+        light_sampler,
+        params.vertices
+        };
+}
+
+//-------------------------------------------------------------------------------------------------
+// Replace the environment map of a param struct
+//
+
+template <
+    typename NormalBinding,
+    typename ColorBinding,
+    typename Primitives,
+    typename Normals,
+    typename TexCoords,
+    typename Materials,
+    typename Colors,
+    typename Textures,
+    typename Lights,
+    typename Color,
+    typename EnvMap,
+    typename LightSampler,
+    typename NewEnvMap
+    >
+auto with_environment_map(
+        kernel_params<
+            NormalBinding,
+            ColorBinding,
+            Primitives,
+            Normals,
+            TexCoords,
+            Materials,
+            Colors,
+            Textures,
+            Lights,
+            Color,
+            EnvMap,
+            LightSampler
+            > const&                params,
+        NewEnvMap const&            environment_map
+        )
+    -> kernel_params<
+        NormalBinding,
+        ColorBinding,
+        Primitives,
+        Normals,
+        TexCoords,
+        Materials,
+        Colors,
+        Textures,
+        Lights,
+        Color,
+        NewEnvMap,
+        LightSampler
+        >
+{
+    return {
+        { params.prims.begin, params.prims.end },
+        params.geometric_normals,
+        params.shading_normals,
+        params.tex_coords,
+        params.materials,
+        params.colors,
+        params.textures,
+        { params.lights.begin, params.lights.end },
+        params.num_bounces,
+        params.epsilon,
+        params.bg_color,
+        params.ambient_color,
+        environment_map,
+        params.light_sampler,
+        params.vertices
+        };
+}
+
 } // visionaray
 
 #include "detail/pathtracing.inl"
+#include "detail/wavefront_pathtracing.inl"
 #include "detail/simple.inl"
 #include "detail/whitted.inl"
 
@@ -0,0 +1,904 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_LIGHT_BVH_H
+#define VSNRAY_LIGHT_BVH_H 1
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "detail/macros.h"
+#include "math/simd/type_traits.h"
+#include "math/aabb.h"
+#include "math/constants.h"
+#include "math/limits.h"
+#include "math/triangle.h"
+#include "math/vector.h"
+#include "aligned_vector.h"
+#include "area_light.h"
+#include "array.h"
+#include "generic_light.h"
+#include "light_sample.h"
+#include "point_light.h"
+#include "spot_light.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Spatial and directional bounds of the emission of a light or of a group of lights
+//
+// Normals of the emitters lie in the cone with axis and half angle theta_o, light is
+// emitted in directions up to theta_e beyond these normals. phi estimates the power
+//
+
+struct light_bounds
+{
+    aabb  bounds;
+    vec3  axis;
+    float cos_theta_o;
+    float cos_theta_e;
+    float phi;
+    bool  two_sided;
+};
+
+namespace detail
+{
+
+// Angle between unit vectors, accurate for small angles
+inline float angle_between(vec3 const& a, vec3 const& b)
+{
+    if (dot(a, b) < 0.0f)
+    {
+        return constants::pi<float>() - 2.0f * asin(min(1.0f, length(a + b) * 0.5f));
+    }
+    else
+    {
+        return 2.0f * asin(min(1.0f, length(b - a) * 0.5f));
+    }
+}
+
+// Rotate v about unit axis by angle (Rodrigues' rotation formula)
+inline vec3 rotate(vec3 const& v, vec3 const& axis, float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return v * c + cross(axis, v) * s + axis * dot(axis, v) * (1.0f - c);
+}
+
+// Smallest cone (axis, cos_theta) that contains both cones
+inline void merge_cones(
+        vec3 const& wa,
+        float       cos_a,
+        vec3 const& wb,
+        float       cos_b,
+        vec3&       w,
+        float&      cos_theta
+        )
+{
+    float theta_a = acos(clamp(cos_a, -1.0f, 1.0f));
+    float theta_b = acos(clamp(cos_b, -1.0f, 1.0f));
+    float theta_d = angle_between(wa, wb);
+
+    if (min(theta_d + theta_b, constants::pi<float>()) <= theta_a)
+    {
+        w = wa;
+        cos_theta = cos_a;
+        return;
+    }
+
+    if (min(theta_d + theta_a, constants::pi<float>()) <= theta_b)
+    {
+        w = wb;
+        cos_theta = cos_b;
+        return;
+    }
+
+    float theta_o = (theta_a + theta_d + theta_b) * 0.5f;
+
+    vec3 wr = cross(wa, wb);
+
+    if (theta_o >= constants::pi<float>() || dot(wr, wr) == 0.0f)
+    {
+        w = wa;
+        cos_theta = -1.0f;
+        return;
+    }
+
+    w = normalize(rotate(wa, normalize(wr), theta_o - theta_a));
+    cos_theta = cos(theta_o);
+}
+
+// Measure of the emitted directions, weights the surface area in the build heuristic
+inline float orientation_measure(float cos_theta_o, float cos_theta_e)
+{
+    float pi = constants::pi<float>();
+
+    float theta_o = acos(clamp(cos_theta_o, -1.0f, 1.0f));
+    float theta_e = acos(clamp(cos_theta_e, -1.0f, 1.0f));
+    float theta_w = min(theta_o + theta_e, pi);
+    float sin_theta_o = sqrt(max(0.0f, 1.0f - cos_theta_o * cos_theta_o));
+
+    return 2.0f * pi * (1.0f - cos_theta_o)
+         + pi / 2.0f * (2.0f * theta_w * sin_theta_o - cos(theta_o - 2.0f * theta_w)
+                        - 2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+template <typename T>
+inline float light_power(vector<3, T> const& intensity)
+{
+    return static_cast<float>(max_element(intensity));
+}
+
+} // detail
+
+inline light_bounds merge(light_bounds const& a, light_bounds const& b)
+{
+    if (a.phi == 0.0f)
+    {
+        return b;
+    }
+
+    if (b.phi == 0.0f)
+    {
+        return a;
+    }
+
+    light_bounds result;
+    result.bounds = combine(a.bounds, b.bounds);
+    detail::merge_cones(a.axis, a.cos_theta_o, b.axis, b.cos_theta_o, result.axis, result.cos_theta_o);
+    result.cos_theta_e = min(a.cos_theta_e, b.cos_theta_e);
+    result.phi = a.phi + b.phi;
+    result.two_sided = a.two_sided || b.two_sided;
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Light bounds of the built-in light types
+//
+// Attenuation is only used to estimate the power at unit distance, the light BVH
+// assumes quadratic falloff
+//
+
+template <typename T>
+inline light_bounds get_light_bounds(point_light<T> const& light)
+{
+    vector<3, T> pos = light.position();
+
+    light_bounds result;
+    result.bounds = aabb(vec3(pos), vec3(pos));
+    result.axis = vec3(0.0f, 0.0f, 1.0f);
+    result.cos_theta_o = -1.0f;
+    result.cos_theta_e = 0.0f;
+    result.phi = 4.0f * constants::pi<float>()
+               * detail::light_power(light.intensity(pos + vector<3, T>(T(1.0), T(0.0), T(0.0))));
+    result.two_sided = false;
+    return result;
+}
+
+template <typename T>
+inline light_bounds get_light_bounds(spot_light<T> const& light)
+{
+    vector<3, T> pos = light.position();
+
+    light_bounds result;
+    result.bounds = aabb(vec3(pos), vec3(pos));
+    result.axis = normalize(vec3(light.spot_direction()));
+    result.cos_theta_o = static_cast<float>(cos(light.spot_cutoff()));
+    result.cos_theta_e = 1.0f;
+    result.phi = 4.0f * constants::pi<float>()
+               * detail::light_power(light.intensity(pos + light.spot_direction()));
+    result.two_sided = false;
+    return result;
+}
+
+// Area lights emit from both sides (see pathtracing::shade())
+template <typename T, typename U, typename P>
+inline light_bounds get_light_bounds(area_light<T, basic_triangle<3, U, P>> const& light)
+{
+    auto const& tri = light.geometry();
+    vec3 n = cross(vec3(tri.e1), vec3(tri.e2));
+
+    light_bounds result;
+    result.bounds = aabb(get_bounds(tri));
+    result.axis = length(n) > 0.0f ? normalize(n) : vec3(0.0f, 0.0f, 1.0f);
+    result.cos_theta_o = 1.0f;
+    result.cos_theta_e = 0.0f;
+    result.phi = 2.0f * constants::pi<float>() * static_cast<float>(area(tri))
+               * detail::light_power(light.intensity(vector<3, T>(tri.v1)));
+    result.two_sided = true;
+    return result;
+}
+
+// Other geometry emits in all directions
+template <typename T, typename Geometry>
+inline light_bounds get_light_bounds(area_light<T, Geometry> const& light)
+{
+    auto const& geom = light.geometry();
+
+    light_bounds result;
+    result.bounds = aabb(get_bounds(geom));
+    result.axis = vec3(0.0f, 0.0f, 1.0f);
+    result.cos_theta_o = -1.0f;
+    result.cos_theta_e = 0.0f;
+    result.phi = constants::pi<float>() * static_cast<float>(area(geom))
+               * detail::light_power(light.intensity(light.position()));
+    result.two_sided = false;
+    return result;
+}
+
+namespace detail
+{
+
+struct light_bounds_visitor
+{
+    using return_type = light_bounds;
+
+    template <typename X>
+    return_type operator()(X const& ref) const
+    {
+        return get_light_bounds(ref);
+    }
+};
+
+} // detail
+
+template <typename ...Ts>
+inline light_bounds get_light_bounds(generic_light<Ts...> const& light)
+{
+    return apply_visitor(detail::light_bounds_visitor(), light);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Primitive that emits the light, used to find area lights hit by rays. Primitives
+// are identified by geom_id and prim_id, prim_ids are only unique per geometry
+//
+
+template <typename L>
+inline bool get_light_primitive(L const& /* */, unsigned& /* */, unsigned& /* */)
+{
+    return false;
+}
+
+template <typename T, typename Geometry>
+inline bool get_light_primitive(area_light<T, Geometry> const& light, unsigned& geom_id, unsigned& prim_id)
+{
+    geom_id = static_cast<unsigned>(light.geometry().geom_id);
+    prim_id = static_cast<unsigned>(light.geometry().prim_id);
+    return true;
+}
+
+namespace detail
+{
+
+struct light_primitive_visitor
+{
+    using return_type = bool;
+
+    unsigned& geom_id;
+    unsigned& prim_id;
+
+    template <typename X>
+    return_type operator()(X const& ref) const
+    {
+        return get_light_primitive(ref, geom_id, prim_id);
+    }
+};
+
+} // detail
+
+template <typename ...Ts>
+inline bool get_light_primitive(generic_light<Ts...> const& light, unsigned& geom_id, unsigned& prim_id)
+{
+    return apply_visitor(detail::light_primitive_visitor{ geom_id, prim_id }, light);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Light BVH node
+//
+// Inner nodes store the first child directly after the node, child_or_light is the
+// index of the second child. Leaves store a single light
+//
+
+struct VSNRAY_ALIGN(16) light_bvh_node
+{
+    float bbox_min[3];
+    float phi;
+    float bbox_max[3];
+    float cos_theta_o;
+    float axis[3];
+    float cos_theta_e;
+    unsigned child_or_light;
+    unsigned flags;
+
+    enum { Leaf = 1, TwoSided = 2 };
+
+    VSNRAY_FUNC bool is_leaf() const { return (flags & Leaf) != 0; }
+
+    // Estimate of the light arriving at p from the lights below the node
+    VSNRAY_FUNC float importance(vec3 const& p) const
+    {
+        vec3 bmin(bbox_min[0], bbox_min[1], bbox_min[2]);
+        vec3 bmax(bbox_max[0], bbox_max[1], bbox_max[2]);
+
+        vec3 pc = (bmin + bmax) * 0.5f;
+        float d2 = dot(p - pc, p - pc);
+        float r2 = dot(bmax - bmin, bmax - bmin) * 0.25f;
+
+        // Keep the importance bounded for points close to the lights
+        float d2_clamped = max(d2, sqrt(r2));
+
+        auto cos_sub_clamped = [](float sin_a, float cos_a, float sin_b, float cos_b)
+        {
+            return cos_a > cos_b ? 1.0f : cos_a * cos_b + sin_a * sin_b;
+        };
+
+        auto sin_sub_clamped = [](float sin_a, float cos_a, float sin_b, float cos_b)
+        {
+            return cos_a > cos_b ? 0.0f : sin_a * cos_b - cos_a * sin_b;
+        };
+
+        // Angle between axis and p
+        float cos_theta_w = 1.0f;
+
+        if (d2 > 0.0f)
+        {
+            vec3 wi = (p - pc) / sqrt(d2);
+            cos_theta_w = dot(vec3(axis[0], axis[1], axis[2]), wi);
+            cos_theta_w = (flags & TwoSided) ? abs(cos_theta_w) : cos_theta_w;
+        }
+
+        float sin_theta_w = sqrt(max(0.0f, 1.0f - cos_theta_w * cos_theta_w));
+
+        // Half angle of the bounding sphere seen from p
+        float cos_theta_b = d2 < r2 ? -1.0f : sqrt(max(0.0f, 1.0f - r2 / d2));
+        float sin_theta_b = sqrt(max(0.0f, 1.0f - cos_theta_b * cos_theta_b));
+
+        float sin_theta_o = sqrt(max(0.0f, 1.0f - cos_theta_o * cos_theta_o));
+
+        // Smallest angle between p and any emitter normal
+        float cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        float sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        float cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+
+        // Strict, lights with theta_e = 0 (spot lights) still emit inside their cone
+        if (cos_theta_p < cos_theta_e)
+        {
+            return 0.0f;
+        }
+
+        return phi * cos_theta_p / d2_clamped;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Light BVH reference, can be used on the device
+//
+
+struct light_bvh_ref
+{
+    struct prim_light
+    {
+        unsigned geom_id;
+        unsigned prim_id;
+        unsigned light;
+
+        VSNRAY_FUNC bool less(unsigned gid, unsigned pid) const
+        {
+            return geom_id < gid || (geom_id == gid && prim_id < pid);
+        }
+    };
+
+    light_bvh_node const*   nodes;
+    unsigned                num_nodes;
+
+    // Path from the root to each light, one bit per level, 1 means second child
+    uint64_t const*         bit_trails;
+    unsigned                num_lights;
+
+    // Sorted by (geom_id, prim_id)
+    prim_light const*       prim_lights;
+    unsigned                num_prim_lights;
+
+    enum : uint64_t { NotInTree = ~uint64_t(0) };
+
+    // Select a light with probability proportional to its importance at p, u in [0,1).
+    // Returns the light index and its probability in pmf, or -1 if no light contributes
+    VSNRAY_FUNC int sample(vec3 const& p, float u, float& pmf) const
+    {
+        pmf = 0.0f;
+
+        if (num_nodes == 0)
+        {
+            return -1;
+        }
+
+        unsigned index = 0;
+        float prob = 1.0f;
+
+        for (;;)
+        {
+            auto const& node = nodes[index];
+
+            if (node.is_leaf())
+            {
+                if (index > 0 || node.importance(p) > 0.0f)
+                {
+                    pmf = prob;
+                    return static_cast<int>(node.child_or_light);
+                }
+
+                return -1;
+            }
+
+            float i0 = nodes[index + 1].importance(p);
+            float i1 = nodes[node.child_or_light].importance(p);
+
+            if (i0 == 0.0f && i1 == 0.0f)
+            {
+                return -1;
+            }
+
+            // Same expressions as in pmf(), the probabilities must match exactly for MIS
+            float p0 = i0 / (i0 + i1);
+            float p1 = i1 / (i0 + i1);
+
+            if (u < p0)
+            {
+                index = index + 1;
+                u = min(u / p0, 1.0f - numeric_limits<float>::epsilon() * 0.5f);
+                prob *= p0;
+            }
+            else
+            {
+                index = node.child_or_light;
+                u = min((u - p0) / p1, 1.0f - numeric_limits<float>::epsilon() * 0.5f);
+                prob *= p1;
+            }
+        }
+    }
+
+    // Probability that sample() selects light at p
+    VSNRAY_FUNC float pmf(vec3 const& p, unsigned light) const
+    {
+        if (light >= num_lights || bit_trails[light] == NotInTree)
+        {
+            return 0.0f;
+        }
+
+        uint64_t trail = bit_trails[light];
+        unsigned index = 0;
+        float prob = 1.0f;
+
+        for (;;)
+        {
+            auto const& node = nodes[index];
+
+            if (node.is_leaf())
+            {
+                return index > 0 || node.importance(p) > 0.0f ? prob : 0.0f;
+            }
+
+            float i0 = nodes[index + 1].importance(p);
+            float i1 = nodes[node.child_or_light].importance(p);
+
+            if (i0 == 0.0f && i1 == 0.0f)
+            {
+                return 0.0f;
+            }
+
+            if (trail & 1)
+            {
+                prob *= i1 / (i0 + i1);
+                index = node.child_or_light;
+            }
+            else
+            {
+                prob *= i0 / (i0 + i1);
+                index = index + 1;
+            }
+
+            trail >>= 1;
+        }
+    }
+
+    // Index of the area light that emits from primitive (geom_id, prim_id), or -1
+    VSNRAY_FUNC int light_index(unsigned geom_id, unsigned prim_id) const
+    {
+        unsigned first = 0;
+        unsigned last = num_prim_lights;
+
+        while (first < last)
+        {
+            unsigned mid = first + (last - first) / 2;
+
+            if (prim_lights[mid].less(geom_id, prim_id))
+            {
+                first = mid + 1;
+            }
+            else
+            {
+                last = mid;
+            }
+        }
+
+        return first < num_prim_lights
+            && prim_lights[first].geom_id == geom_id
+            && prim_lights[first].prim_id == prim_id
+                ? static_cast<int>(prim_lights[first].light)
+                : -1;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Light BVH
+//
+// Hierarchy over a list of lights that selects lights in proportion to an estimate of
+// their contribution at a shading point: power over squared distance, and zero if the
+// point is outside the emission cone. Built top-down with the surface area orientation
+// heuristic (Conty Estevez and Kulla 2018, pbrt-v4). The importance ignores the surface
+// normal at the shading point, so that pmf() can be evaluated exactly from the origin of
+// a continuation ray, e.g. for MIS when the ray hits an area light
+//
+
+class light_bvh
+{
+public:
+
+    using ref_type = light_bvh_ref;
+
+    template <typename Light>
+    void build(Light const* lights, size_t count)
+    {
+        nodes_.clear();
+        bit_trails_.assign(count, light_bvh_ref::NotInTree);
+        prim_lights_.clear();
+
+        std::vector<std::pair<unsigned, light_bounds>> bounded;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto lb = get_light_bounds(lights[i]);
+
+            if (lb.phi > 0.0f)
+            {
+                bounded.emplace_back(static_cast<unsigned>(i), lb);
+            }
+
+            unsigned geom_id = 0;
+            unsigned prim_id = 0;
+
+            if (get_light_primitive(lights[i], geom_id, prim_id))
+            {
+                prim_lights_.push_back({ geom_id, prim_id, static_cast<unsigned>(i) });
+            }
+        }
+
+        std::sort(
+                prim_lights_.begin(),
+                prim_lights_.end(),
+                [](light_bvh_ref::prim_light const& a, light_bvh_ref::prim_light const& b)
+                {
+                    return a.less(b.geom_id, b.prim_id);
+                }
+                );
+
+        if (!bounded.empty())
+        {
+            nodes_.reserve(2 * bounded.size() - 1);
+            build_recursive(bounded, 0, bounded.size(), 0, 0);
+        }
+    }
+
+    light_bvh_ref ref() const
+    {
+        return {
+            nodes_.data(),
+            static_cast<unsigned>(nodes_.size()),
+            bit_trails_.data(),
+            static_cast<unsigned>(bit_trails_.size()),
+            prim_lights_.data(),
+            static_cast<unsigned>(prim_lights_.size())
+            };
+    }
+
+    size_t num_nodes() const
+    {
+        return nodes_.size();
+    }
+
+    light_bvh_node const& node(size_t index) const
+    {
+        return nodes_[index];
+    }
+
+private:
+
+    enum { NumBuckets = 12 };
+
+    aligned_vector<light_bvh_node> nodes_;
+    aligned_vector<uint64_t> bit_trails_;
+    aligned_vector<light_bvh_ref::prim_light> prim_lights_;
+
+    static light_bvh_node make_node(light_bounds const& lb, unsigned child_or_light, bool leaf)
+    {
+        light_bvh_node node;
+        std::memcpy(node.bbox_min, &lb.bounds.min, sizeof(node.bbox_min));
+        std::memcpy(node.bbox_max, &lb.bounds.max, sizeof(node.bbox_max));
+        std::memcpy(node.axis, &lb.axis, sizeof(node.axis));
+        node.phi = lb.phi;
+        node.cos_theta_o = lb.cos_theta_o;
+        node.cos_theta_e = lb.cos_theta_e;
+        node.child_or_light = child_or_light;
+        node.flags = (leaf ? light_bvh_node::Leaf : 0) | (lb.two_sided ? light_bvh_node::TwoSided : 0);
+        return node;
+    }
+
+    static float cost(light_bounds const& lb, aabb const& parent, int axis)
+    {
+        vec3 size = parent.size();
+        float kr = max_element(size) / max(size[axis], numeric_limits<float>::min());
+
+        vec3 s = lb.bounds.size();
+        float area = 2.0f * (s.x * s.y + s.y * s.z + s.z * s.x);
+
+        return lb.phi * detail::orientation_measure(lb.cos_theta_o, lb.cos_theta_e) * kr * area;
+    }
+
+    light_bounds build_recursive(
+            std::vector<std::pair<unsigned, light_bounds>>& lights,
+            size_t                                          first,
+            size_t                                          last,
+            uint64_t                                        trail,
+            unsigned                                        depth
+            )
+    {
+        size_t index = nodes_.size();
+
+        if (last - first == 1)
+        {
+            auto const& l = lights[first];
+            nodes_.push_back(make_node(l.second, l.first, true));
+            bit_trails_[l.first] = trail;
+            return l.second;
+        }
+
+        aabb bounds;
+        aabb centroid_bounds;
+        bounds.invalidate();
+        centroid_bounds.invalidate();
+
+        for (size_t i = first; i < last; ++i)
+        {
+            bounds = combine(bounds, lights[i].second.bounds);
+            centroid_bounds.insert(lights[i].second.bounds.center());
+        }
+
+        auto bucket = [&](light_bounds const& lb, int axis)
+        {
+            float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+            int b = static_cast<int>(NumBuckets * (lb.bounds.center()[axis] - centroid_bounds.min[axis]) / extent);
+            return clamp(b, 0, NumBuckets - 1);
+        };
+
+        float min_cost = numeric_limits<float>::max();
+        int min_bucket = -1;
+        int min_axis = -1;
+
+        // Bit trails have 64 bits, make sure median splits can still reach all leaves
+        unsigned log2_count = 0;
+
+        while ((size_t(1) << log2_count) < last - first)
+        {
+            ++log2_count;
+        }
+
+        bool use_sah = depth + log2_count < 63;
+
+        for (int axis = 0; axis < 3 && use_sah; ++axis)
+        {
+            if (centroid_bounds.max[axis] == centroid_bounds.min[axis])
+            {
+                continue;
+            }
+
+            light_bounds buckets[NumBuckets];
+
+            for (auto& b : buckets)
+            {
+                b.phi = 0.0f;
+            }
+
+            for (size_t i = first; i < last; ++i)
+            {
+                auto& b = buckets[bucket(lights[i].second, axis)];
+                b = merge(b, lights[i].second);
+            }
+
+            for (int split = 0; split < NumBuckets - 1; ++split)
+            {
+                light_bounds b0;
+                light_bounds b1;
+                b0.phi = 0.0f;
+                b1.phi = 0.0f;
+
+                for (int i = 0; i <= split; ++i)
+                {
+                    b0 = merge(b0, buckets[i]);
+                }
+
+                for (int i = split + 1; i < NumBuckets; ++i)
+                {
+                    b1 = merge(b1, buckets[i]);
+                }
+
+                if (b0.phi == 0.0f || b1.phi == 0.0f)
+                {
+                    continue;
+                }
+
+                float c = cost(b0, bounds, axis) + cost(b1, bounds, axis);
+
+                if (c > 0.0f && c < min_cost)
+                {
+                    min_cost = c;
+                    min_bucket = split;
+                    min_axis = axis;
+                }
+            }
+        }
+
+        size_t mid = first;
+
+        if (min_axis >= 0)
+        {
+            mid = std::partition(
+                    lights.begin() + first,
+                    lights.begin() + last,
+                    [&](std::pair<unsigned, light_bounds> const& l)
+                    {
+                        return bucket(l.second, min_axis) <= min_bucket;
+                    }
+                    ) - lights.begin();
+        }
+
+        if (mid == first || mid == last)
+        {
+            int axis = static_cast<int>(max_index(centroid_bounds.size()));
+            mid = (first + last) / 2;
+
+            std::nth_element(
+                    lights.begin() + first,
+                    lights.begin() + mid,
+                    lights.begin() + last,
+                    [&](std::pair<unsigned, light_bounds> const& a, std::pair<unsigned, light_bounds> const& b)
+                    {
+                        return a.second.bounds.center()[axis] < b.second.bounds.center()[axis];
+                    }
+                    );
+        }
+
+        nodes_.emplace_back();
+
+        auto b0 = build_recursive(lights, first, mid, trail, depth + 1);
+        unsigned second = static_cast<unsigned>(nodes_.size());
+        auto b1 = build_recursive(lights, mid, last, trail | (uint64_t(1) << depth), depth + 1);
+
+        auto lb = merge(b0, b1);
+        nodes_[index] = make_node(lb, second, false);
+        return lb;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Select a light with the light BVH and sample it, pmf is the selection probability
+//
+
+template <
+    typename Lights,
+    typename Generator,
+    typename T = typename Generator::value_type,
+    typename = typename std::enable_if<!simd::is_simd_vector<T>::value>::type
+    >
+VSNRAY_FUNC
+inline light_sample<T> sample_light(
+        light_bvh_ref const&    bvh,
+        Lights                  lights,
+        vector<3, T> const&     pos,
+        Generator&              gen,
+        T&                      pmf
+        )
+{
+    int index = bvh.sample(pos, gen.next(), pmf);
+
+    if (index < 0)
+    {
+        light_sample<T> result = {};
+        return result;
+    }
+
+    return lights[index].sample(gen);
+}
+
+template <
+    typename Lights,
+    typename Generator,
+    typename T = typename Generator::value_type,
+    typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type,
+    typename = void
+    >
+VSNRAY_FUNC
+inline light_sample<T> sample_light(
+        light_bvh_ref const&    bvh,
+        Lights                  lights,
+        vector<3, T> const&     pos,
+        Generator&              gen,
+        T&                      pmf
+        )
+{
+    using float_array = simd::aligned_array_t<T>;
+
+    enum { N = simd::num_elements<T>::value };
+
+    float_array u;
+    store(u, gen.next());
+
+    float_array x;
+    float_array y;
+    float_array z;
+    store(x, pos.x);
+    store(y, pos.y);
+    store(z, pos.z);
+
+    light_sample<T> result;
+
+    array<vector<3, float>, N> poss;
+    array<vector<3, float>, N> intensities;
+    array<vector<3, float>, N> normals;
+    float_array pmfs;
+    float* area = reinterpret_cast<float*>(&result.area);
+    int* delta_light = reinterpret_cast<int*>(&result.delta_light);
+
+    for (int i = 0; i < N; ++i)
+    {
+        int index = bvh.sample(vec3(x[i], y[i], z[i]), u[i], pmfs[i]);
+
+        light_sample<float> ls = {};
+
+        if (index >= 0)
+        {
+            ls = lights[index].sample(gen.get_generator(i));
+        }
+
+        poss[i] = ls.pos;
+        intensities[i] = ls.intensity;
+        normals[i] = ls.normal;
+        area[i] = ls.area;
+        delta_light[i] = ls.delta_light ? 0xFFFFFFFF : 0x00000000;
+    }
+
+    result.pos = simd::pack(poss);
+    result.intensity = simd::pack(intensities);
+    result.normal = simd::pack(normals);
+    pmf = T(pmfs);
+
+    return result;
+}
+
+} // visionaray
+
+#endif // VSNRAY_LIGHT_BVH_H
@@ -0,0 +1,481 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MACROCELL_GRID_H
+#define VSNRAY_MACROCELL_GRID_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "detail/macros.h"
+#include "detail/parallel_for.h"
+#include "detail/range.h"
+#include "detail/thread_pool.h"
+#include "math/detail/math.h"
+#include "math/limits.h"
+#include "math/ray.h"
+#include "math/vector.h"
+#include "texture/texture.h"
+#include "aligned_vector.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Macrocell grid for empty space skipping in 3D volumes
+//
+// The volume is divided into cells of cell_size^3 voxels. Each cell stores the range of
+// voxel values that trilinear reconstruction can produce inside the cell (i.e. including
+// the voxels one beyond its boundary), and, for a given transfer function, the max.
+// opacity and the max. variation of any channel over that range.
+//
+// Cells with zero max. opacity can be skipped, cells over which the transfer function
+// is nearly constant can be sampled with larger steps (see macrocell_step()). When the
+// transfer function changes, only the opacities are updated, optionally only for cells
+// whose value range overlaps the values that changed.
+//
+// Grids operate in texture space, rays are transformed into [0,1]^3 by the caller. The
+// ray parameter t is invariant under that (affine) transformation.
+//
+
+struct macrocell
+{
+    float value_min;
+    float value_max;
+    float opacity_max;
+    float variation;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Non-owning view for traversal, e.g. on the GPU
+//
+
+class macrocell_grid_ref
+{
+public:
+
+    macrocell_grid_ref() = default;
+
+    VSNRAY_FUNC
+    macrocell_grid_ref(macrocell const* cells, vector<3, int> const& dims, vector<3, float> const& cell_extent)
+        : cells_(cells)
+        , dims_(dims)
+        , cell_extent_(cell_extent)
+    {
+    }
+
+    VSNRAY_FUNC vector<3, int> const& dims() const { return dims_; }
+
+    // Size of a cell in texture space
+    VSNRAY_FUNC vector<3, float> const& cell_extent() const { return cell_extent_; }
+
+    VSNRAY_FUNC macrocell const& operator()(int x, int y, int z) const
+    {
+        return cells_[(z * dims_.y + y) * dims_.x + x];
+    }
+
+private:
+
+    macrocell const* cells_ = nullptr;
+    vector<3, int> dims_;
+    vector<3, float> cell_extent_;
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Owning grid
+//
+
+class macrocell_grid
+{
+public:
+
+    using ref_type = macrocell_grid_ref;
+
+public:
+
+    // Voxel value ranges of volume, num_threads = 0 uses one thread per hardware thread
+    template <typename T>
+    void build(texture_ref<T, 3> const& volume, int cell_size = 8, unsigned num_threads = 0);
+
+    // Same, with a thread pool owned by the caller, e.g. to share it between rebuilds
+    template <typename T>
+    void build(texture_ref<T, 3> const& volume, int cell_size, thread_pool& pool);
+
+    // Opacities from a post-classification transfer function, voxel values are lookup
+    // coordinates
+    void update_opacity(texture_ref<vec4, 1> const& transfunc);
+
+    // Same, only for cells with values in [value_lo..value_hi]
+    void update_opacity(texture_ref<vec4, 1> const& transfunc, float value_lo, float value_hi);
+
+    ref_type ref() const
+    {
+        return ref_type(cells_.data(), dims_, cell_extent_);
+    }
+
+    vector<3, int> const& dims() const { return dims_; }
+
+    macrocell const& operator()(int x, int y, int z) const
+    {
+        return cells_[(z * dims_.y + y) * dims_.x + x];
+    }
+
+    // Fraction of cells with zero max. opacity
+    float empty_fraction() const;
+
+private:
+
+    aligned_vector<macrocell> cells_;
+    vector<3, int> dims_;
+    vector<3, float> cell_extent_;
+
+    // Builds on the calling thread if pool is nullptr
+    template <typename T>
+    void build_impl(texture_ref<T, 3> const& volume, int cell_size, thread_pool* pool);
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Implementation
+//
+
+namespace detail
+{
+
+// Range min. and max. queries over transfer function bins in O(1) (sparse table)
+class tf_range_table
+{
+public:
+
+    explicit tf_range_table(texture_ref<vec4, 1> const& transfunc)
+        : size_(static_cast<int>(transfunc.width()))
+    {
+        int num_levels = 1;
+        while ((1 << num_levels) <= size_)
+        {
+            ++num_levels;
+        }
+
+        min_.resize(num_levels);
+        max_.resize(num_levels);
+
+        min_[0].assign(transfunc.data(), transfunc.data() + size_);
+        max_[0].assign(transfunc.data(), transfunc.data() + size_);
+
+        for (int l = 1; l < num_levels; ++l)
+        {
+            int n = size_ - (1 << l) + 1;
+            min_[l].resize(n);
+            max_[l].resize(n);
+
+            for (int i = 0; i < n; ++i)
+            {
+                min_[l][i] = min(min_[l - 1][i], min_[l - 1][i + (1 << (l - 1))]);
+                max_[l][i] = max(max_[l - 1][i], max_[l - 1][i + (1 << (l - 1))]);
+            }
+        }
+    }
+
+    // Bins that linear or nearest lookups with coordinates in [lo..hi] interpolate
+    void query(float lo, float hi, vec4& min_result, vec4& max_result) const
+    {
+        int first = clamp(static_cast<int>(floor(lo * size_ - 0.5f)), 0, size_ - 1);
+        int last  = clamp(static_cast<int>(ceil(hi * size_ - 0.5f)), 0, size_ - 1);
+
+        int l = 0;
+        while ((2 << l) <= last - first + 1)
+        {
+            ++l;
+        }
+
+        min_result = min(min_[l][first], min_[l][last - (1 << l) + 1]);
+        max_result = max(max_[l][first], max_[l][last - (1 << l) + 1]);
+    }
+
+private:
+
+    int size_;
+    std::vector<std::vector<vec4>> min_;
+    std::vector<std::vector<vec4>> max_;
+
+};
+
+} // detail
+
+
+template <typename T>
+inline void macrocell_grid::build(texture_ref<T, 3> const& volume, int cell_size, unsigned num_threads)
+{
+    unsigned nt = num_threads == 0 ? std::thread::hardware_concurrency() : num_threads;
+
+    if (nt > 1 && div_up(static_cast<int>(volume.depth()), cell_size) > 1)
+    {
+        thread_pool pool(nt);
+        build_impl(volume, cell_size, &pool);
+    }
+    else
+    {
+        build_impl(volume, cell_size, nullptr);
+    }
+}
+
+template <typename T>
+inline void macrocell_grid::build(texture_ref<T, 3> const& volume, int cell_size, thread_pool& pool)
+{
+    build_impl(volume, cell_size, pool.num_threads > 1 ? &pool : nullptr);
+}
+
+template <typename T>
+inline void macrocell_grid::build_impl(texture_ref<T, 3> const& volume, int cell_size, thread_pool* pool)
+{
+    vector<3, int> vol_dims(
+            static_cast<int>(volume.width()),
+            static_cast<int>(volume.height()),
+            static_cast<int>(volume.depth())
+            );
+
+    dims_ = vector<3, int>(
+            div_up(vol_dims.x, cell_size),
+            div_up(vol_dims.y, cell_size),
+            div_up(vol_dims.z, cell_size)
+            );
+
+    cell_extent_ = vector<3, float>(static_cast<float>(cell_size)) / vector<3, float>(vol_dims);
+
+    cells_.resize(dims_.x * dims_.y * dims_.z);
+
+    auto build_slab = [&](int cz)
+    {
+        for (int cy = 0; cy < dims_.y; ++cy)
+        {
+            for (int cx = 0; cx < dims_.x; ++cx)
+            {
+                // Voxels trilinear reconstruction reads inside the cell
+                vector<3, int> lo = max(vector<3, int>(cx, cy, cz) * cell_size - 1, vector<3, int>(0));
+                vector<3, int> hi = min(vector<3, int>(cx + 1, cy + 1, cz + 1) * cell_size + 1, vol_dims);
+
+                float vmin =  numeric_limits<float>::max();
+                float vmax = -numeric_limits<float>::max();
+
+                for (int z = lo.z; z < hi.z; ++z)
+                {
+                    for (int y = lo.y; y < hi.y; ++y)
+                    {
+                        auto row = volume.data() + (static_cast<size_t>(z) * vol_dims.y + y) * vol_dims.x;
+
+                        for (int x = lo.x; x < hi.x; ++x)
+                        {
+                            float v = static_cast<float>(row[x]);
+                            vmin = min(vmin, v);
+                            vmax = max(vmax, v);
+                        }
+                    }
+                }
+
+                auto& cell = cells_[(cz * dims_.y + cy) * dims_.x + cx];
+                cell.value_min = vmin;
+                cell.value_max = vmax;
+
+                // Not classified yet: nothing can be skipped
+                cell.opacity_max = 1.0f;
+                cell.variation = 1.0f;
+            }
+        }
+    };
+
+    if (pool != nullptr && dims_.z > 1)
+    {
+        parallel_for(*pool, tiled_range1d<int>(0, dims_.z, 1), [&](range1d<int> const& r)
+        {
+            for (int cz = r.begin(); cz != r.end(); ++cz)
+            {
+                build_slab(cz);
+            }
+        });
+    }
+    else
+    {
+        for (int cz = 0; cz < dims_.z; ++cz)
+        {
+            build_slab(cz);
+        }
+    }
+}
+
+inline void macrocell_grid::update_opacity(texture_ref<vec4, 1> const& transfunc)
+{
+    update_opacity(transfunc, -numeric_limits<float>::max(), numeric_limits<float>::max());
+}
+
+inline void macrocell_grid::update_opacity(texture_ref<vec4, 1> const& transfunc, float value_lo, float value_hi)
+{
+    detail::tf_range_table table(transfunc);
+
+    for (auto& cell : cells_)
+    {
+        if (cell.value_max < value_lo || cell.value_min > value_hi)
+        {
+            continue;
+        }
+
+        vec4 tf_min;
+        vec4 tf_max;
+        table.query(cell.value_min, cell.value_max, tf_min, tf_max);
+
+        vec4 var = tf_max - tf_min;
+
+        cell.opacity_max = tf_max.w;
+        cell.variation = max(max(var.x, var.y), max(var.z, var.w));
+    }
+}
+
+inline float macrocell_grid::empty_fraction() const
+{
+    size_t num_empty = 0;
+
+    for (auto const& cell : cells_)
+    {
+        if (cell.opacity_max <= 0.0f)
+        {
+            ++num_empty;
+        }
+    }
+
+    return cells_.empty() ? 0.0f : static_cast<float>(num_empty) / cells_.size();
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Traverse the cells along a texture space ray with 3D-DDA, cf. Amanatides and Woo (1987):
+// A Fast Voxel Traversal Algorithm for Ray Tracing
+//
+// Calls func(t0, t1, cell) for each non-empty cell intersected in [tmin..tmax], in front-
+// to-back order. func returns false to stop the traversal (e.g. early ray termination).
+//
+
+template <typename Func>
+VSNRAY_FUNC
+inline void traverse_macrocells(
+        macrocell_grid_ref const&   grid,
+        basic_ray<float> const&     ray,
+        float                       tmin,
+        float                       tmax,
+        Func                        func
+        )
+{
+    // Clip against the unit cube
+    vec3 inv_dir = 1.0f / ray.dir;
+    vec3 t1 = (vec3(0.0f) - ray.ori) * inv_dir;
+    vec3 t2 = (vec3(1.0f) - ray.ori) * inv_dir;
+
+    vec3 tnear = min(t1, t2);
+    vec3 tfar  = max(t1, t2);
+
+    tmin = max(tmin, max(tnear.x, max(tnear.y, tnear.z)));
+    tmax = min(tmax, min(tfar.x, min(tfar.y, tfar.z)));
+
+    if (tmin >= tmax)
+    {
+        return;
+    }
+
+    auto const& dims = grid.dims();
+    auto const& extent = grid.cell_extent();
+
+    vec3 pos = (ray.ori + ray.dir * tmin) / extent;
+
+    vector<3, int> cell(
+            clamp(static_cast<int>(pos.x), 0, dims.x - 1),
+            clamp(static_cast<int>(pos.y), 0, dims.y - 1),
+            clamp(static_cast<int>(pos.z), 0, dims.z - 1)
+            );
+
+    vector<3, int> step;
+    vec3 t_next;
+    vec3 t_delta;
+
+    for (int d = 0; d < 3; ++d)
+    {
+        if (ray.dir[d] > 0.0f)
+        {
+            step[d] = 1;
+            t_next[d] = ((cell[d] + 1) * extent[d] - ray.ori[d]) * inv_dir[d];
+            t_delta[d] = extent[d] * inv_dir[d];
+        }
+        else if (ray.dir[d] < 0.0f)
+        {
+            step[d] = -1;
+            t_next[d] = (cell[d] * extent[d] - ray.ori[d]) * inv_dir[d];
+            t_delta[d] = -extent[d] * inv_dir[d];
+        }
+        else
+        {
+            step[d] = 0;
+            t_next[d] = numeric_limits<float>::max();
+            t_delta[d] = numeric_limits<float>::max();
+        }
+    }
+
+    float t = tmin;
+
+    for (;;)
+    {
+        int axis = t_next.x < t_next.y
+                 ? (t_next.x < t_next.z ? 0 : 2)
+                 : (t_next.y < t_next.z ? 1 : 2);
+
+        float t_exit = min(t_next[axis], tmax);
+
+        auto const& c = grid(cell.x, cell.y, cell.z);
+
+        if (c.opacity_max > 0.0f && t_exit > t)
+        {
+            if (!func(t, t_exit, c))
+            {
+                return;
+            }
+        }
+
+        if (t_exit >= tmax)
+        {
+            return;
+        }
+
+        t = t_exit;
+        cell[axis] += step[axis];
+
+        if (cell[axis] < 0 || cell[axis] >= dims[axis])
+        {
+            return;
+        }
+
+        t_next[axis] += t_delta[axis];
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Step size for a cell: base_step where the transfer function varies by more than
+// tolerance over the cell's values, up to max_scale * base_step where it is constant
+//
+
+VSNRAY_FUNC
+inline float macrocell_step(macrocell const& cell, float base_step, float max_scale, float tolerance = 0.01f)
+{
+    return cell.variation <= tolerance / max_scale
+        ? base_step * max_scale
+        : base_step * clamp(tolerance / cell.variation, 1.0f, max_scale);
+}
+
+} // visionaray
+
+#endif // VSNRAY_MACROCELL_GRID_H
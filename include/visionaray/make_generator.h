@@ -10,6 +10,7 @@
 
 #include "detail/macros.h"
 #include "pixel_sampler_types.h"
+#include "qmc_generator.h"
 #include "random_generator.h"
 
 namespace visionaray
@@ -45,6 +46,48 @@ struct make_generator_impl<T, pixel_sampler::basic_jittered_blend_type<U>>
     using generator_type = random_generator<T>;
 };
 
+template <typename T, typename U>
+struct make_generator_impl<T, pixel_sampler::basic_adaptive_type<U>>
+{
+    using generator_type = random_generator<T>;
+};
+
+
+// Low-discrepancy samplers -------------------------------
+
+template <typename T, typename Sequence>
+struct sequence_generator;
+
+template <typename T>
+struct sequence_generator<T, pixel_sampler::sobol_sequence>
+{
+    using type = sobol_generator<T>;
+};
+
+template <typename T>
+struct sequence_generator<T, pixel_sampler::halton_sequence>
+{
+    using type = halton_generator<T>;
+};
+
+template <typename T>
+struct sequence_generator<T, pixel_sampler::blue_noise_sequence>
+{
+    using type = blue_noise_generator<T>;
+};
+
+template <typename T, typename Sequence>
+struct make_generator_impl<T, pixel_sampler::ld_jittered_type<Sequence>>
+{
+    using generator_type = typename sequence_generator<T, Sequence>::type;
+};
+
+template <typename T, typename U, typename Sequence>
+struct make_generator_impl<T, pixel_sampler::basic_ld_jittered_blend_type<U, Sequence>>
+{
+    using generator_type = typename sequence_generator<T, Sequence>::type;
+};
+
 } // detail
 
 
@@ -55,6 +55,12 @@ class basic_sphere;
 template <size_t Dim, typename T, typename P = unsigned>
 class basic_triangle;
 
+template <typename T, typename P = unsigned>
+class basic_indexed_triangle;
+
+template <typename T, typename P = unsigned>
+class basic_indexed_triangle_ref;
+
 template <typename Layout, typename T>
 class rectangle;
 
@@ -0,0 +1,173 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MATH_INDEXED_TRIANGLE_H
+#define VSNRAY_MATH_INDEXED_TRIANGLE_H 1
+
+#include "aabb.h"
+#include "config.h"
+#include "intersect.h"
+#include "primitive.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Triangle that references its vertices by index in a vertex buffer shared by a whole mesh
+//
+// Only the indices are stored, the vertex buffer is passed to the functions below that
+// need the vertex positions. BVHs are built from basic_indexed_triangle_ref's (see below)
+// and traversed with an indexed_triangle_intersector. Attribute arrays (shading normals,
+// texture coordinates, colors) are indexed with the same vertex indices, so shared
+// vertices are stored only once.
+//
+
+template <typename T, typename P>
+class basic_indexed_triangle : public primitive<P>
+{
+public:
+
+    using scalar_type =  T;
+    using vec_type    =  vector<3, T>;
+
+public:
+
+    basic_indexed_triangle() = default;
+
+    MATH_FUNC basic_indexed_triangle(unsigned i1, unsigned i2, unsigned i3)
+        : index{ i1, i2, i3 }
+    {
+    }
+
+    unsigned index[3];
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Indexed triangle and the vertex buffer it refers to
+//
+// BVH builders only see the primitives, so they are passed these when building trees
+// over indexed triangles. The trees store the plain indexed triangles, e.g.:
+//
+//      aligned_vector<basic_indexed_triangle_ref<float>> refs;
+//      for (auto const& t : triangles) refs.emplace_back(t, vertices.data());
+//      auto tree = builder.build(index_bvh<basic_indexed_triangle<float>>{}, refs.data(), refs.size());
+//
+
+template <typename T, typename P>
+class basic_indexed_triangle_ref
+{
+public:
+
+    using triangle_type = basic_indexed_triangle<T, P>;
+    using vec_type      = vector<3, T>;
+
+public:
+
+    basic_indexed_triangle_ref() = default;
+
+    MATH_FUNC basic_indexed_triangle_ref(triangle_type const& triangle, vec_type const* vertices)
+        : triangle(triangle)
+        , vertices(vertices)
+    {
+    }
+
+    MATH_FUNC operator triangle_type() const
+    {
+        return triangle;
+    }
+
+    triangle_type triangle;
+    vec_type const* vertices;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Geometric functions
+//
+
+// Triangle with vertices fetched from the vertex buffer
+template <typename T, typename P>
+MATH_FUNC
+inline basic_triangle<3, T, P> get_triangle(
+        basic_indexed_triangle<T, P> const& t,
+        vector<3, T> const*                 vertices
+        )
+{
+    auto v1 = vertices[t.index[0]];
+
+    basic_triangle<3, T, P> result(v1, vertices[t.index[1]] - v1, vertices[t.index[2]] - v1);
+    result.prim_id = t.prim_id;
+    result.geom_id = t.geom_id;
+    return result;
+}
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_triangle<3, T, P> get_triangle(basic_indexed_triangle_ref<T, P> const& ref)
+{
+    return get_triangle(ref.triangle, ref.vertices);
+}
+
+template <typename T, typename P>
+MATH_FUNC
+inline T area(basic_indexed_triangle<T, P> const& t, vector<3, T> const* vertices)
+{
+    return area(get_triangle(t, vertices));
+}
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_aabb<T> get_bounds(basic_indexed_triangle<T, P> const& t, vector<3, T> const* vertices)
+{
+    basic_aabb<T> bounds;
+
+    bounds.invalidate();
+    bounds.insert(vertices[t.index[0]]);
+    bounds.insert(vertices[t.index[1]]);
+    bounds.insert(vertices[t.index[2]]);
+
+    return bounds;
+}
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_aabb<T> get_bounds(basic_indexed_triangle_ref<T, P> const& ref)
+{
+    return get_bounds(ref.triangle, ref.vertices);
+}
+
+template <typename T, typename P, typename Generator, typename U = typename Generator::value_type>
+MATH_FUNC
+inline vector<3, U> sample_surface(
+        basic_indexed_triangle<T, P> const& t,
+        vector<3, T> const*                 vertices,
+        Generator&                          gen
+        )
+{
+    return sample_surface(get_triangle(t, vertices), gen);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// ray / indexed triangle
+//
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect(
+        R const&                                    ray,
+        basic_indexed_triangle<U, unsigned> const&  tri,
+        vector<3, U> const*                         vertices
+        )
+{
+    return intersect(ray, get_triangle(tri, vertices));
+}
+
+} // MATH_NAMESPACE
+
+#endif // VSNRAY_MATH_INDEXED_TRIANGLE_H
@@ -14,6 +14,7 @@
 #include "constants.h"
 #include "coordinates.h"
 #include "fixed.h"
+#include "indexed_triangle.h"
 #include "intersect.h"
 #include "io.h"
 #include "limits.h"
@@ -28,6 +29,7 @@
 #include "snorm.h"
 #include "sphere.h"
 #include "triangle.h"
+#include "triangle_packet.h"
 #include "unorm.h"
 #include "vector.h"
 
@@ -0,0 +1,245 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MATH_TRIANGLE_PACKET_H
+#define VSNRAY_MATH_TRIANGLE_PACKET_H 1
+
+#include <cstddef>
+#include <type_traits>
+
+#include "simd/type_traits.h"
+#include "aabb.h"
+#include "config.h"
+#include "intersect.h"
+#include "limits.h"
+#include "ray.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Packet of N triangles stored as SoA
+//
+// Leaf primitive for BVHs (see pack_leaves()) that lets a single ray test N triangles
+// with one N-wide Moeller-Trumbore test. Unused lanes are degenerate (zero edges at the
+// first vertex of lane 0), they are never hit and do not change the bounds.
+//
+
+template <size_t N>
+struct VSNRAY_ALIGN(32) basic_triangle_packet
+{
+    enum { Width = N };
+
+    float v1_x[N];
+    float v1_y[N];
+    float v1_z[N];
+    float e1_x[N];
+    float e1_y[N];
+    float e1_z[N];
+    float e2_x[N];
+    float e2_y[N];
+    float e2_z[N];
+
+    unsigned prim_id[N];
+    unsigned geom_id[N];
+
+    // Number of valid lanes
+    unsigned count;
+};
+
+using triangle4 = basic_triangle_packet<4>;
+using triangle8 = basic_triangle_packet<8>;
+
+template <typename T>
+struct is_triangle_packet : std::false_type {};
+
+template <size_t N>
+struct is_triangle_packet<basic_triangle_packet<N>> : std::true_type {};
+
+
+//-------------------------------------------------------------------------------------------------
+// Hit record, additionally stores the lane of the triangle that was hit
+//
+
+template <typename R>
+struct hit_record_triangle_packet : hit_record<R, primitive<unsigned>>
+{
+    int lane = 0;
+};
+
+template <typename R, typename Cond>
+MATH_FUNC
+inline void update_if(
+        hit_record_triangle_packet<R>&          dst,
+        hit_record_triangle_packet<R> const&    src,
+        Cond const&                             cond
+        )
+{
+    dst.hit        |= cond;
+    dst.t           = select( cond, src.t, dst.t );
+    dst.prim_id     = select( cond, src.prim_id, dst.prim_id );
+    dst.geom_id     = select( cond, src.geom_id, dst.geom_id );
+    dst.u           = select( cond, src.u, dst.u );
+    dst.v           = select( cond, src.v, dst.v );
+    dst.lane        = cond ? src.lane : dst.lane;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Pack count <= N triangles
+//
+
+template <size_t N, typename P>
+inline basic_triangle_packet<N> make_triangle_packet(basic_triangle<3, float, P> const* triangles, size_t count)
+{
+    basic_triangle_packet<N> result;
+
+    result.count = static_cast<unsigned>(count);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        auto const& t = triangles[i < count ? i : 0];
+        vec3 e1 = i < count ? t.e1 : vec3(0.0f);
+        vec3 e2 = i < count ? t.e2 : vec3(0.0f);
+
+        result.v1_x[i] = t.v1.x;
+        result.v1_y[i] = t.v1.y;
+        result.v1_z[i] = t.v1.z;
+        result.e1_x[i] = e1.x;
+        result.e1_y[i] = e1.y;
+        result.e1_z[i] = e1.z;
+        result.e2_x[i] = e2.x;
+        result.e2_y[i] = e2.y;
+        result.e2_z[i] = e2.z;
+
+        result.prim_id[i] = t.prim_id;
+        result.geom_id[i] = t.geom_id;
+    }
+
+    return result;
+}
+
+// Triangle in lane
+template <size_t N>
+MATH_FUNC
+inline basic_triangle<3, float> get_triangle(basic_triangle_packet<N> const& packet, int lane)
+{
+    basic_triangle<3, float> result(
+            vec3(packet.v1_x[lane], packet.v1_y[lane], packet.v1_z[lane]),
+            vec3(packet.e1_x[lane], packet.e1_y[lane], packet.e1_z[lane]),
+            vec3(packet.e2_x[lane], packet.e2_y[lane], packet.e2_z[lane])
+            );
+
+    result.prim_id = packet.prim_id[lane];
+    result.geom_id = packet.geom_id[lane];
+
+    return result;
+}
+
+template <size_t N>
+MATH_FUNC
+inline aabb get_bounds(basic_triangle_packet<N> const& packet)
+{
+    aabb bounds;
+    bounds.invalidate();
+
+    for (unsigned i = 0; i < packet.count; ++i)
+    {
+        bounds.insert(get_bounds(get_triangle(packet, i)));
+    }
+
+    return bounds;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// ray / triangle packet
+//
+// Returns the closest hit with t >= 0 over all lanes, ties go to the lower lane like
+// for triangles tested one after another
+//
+
+template <size_t N>
+inline hit_record_triangle_packet<basic_ray<float>> intersect(
+        basic_ray<float> const&             ray,
+        basic_triangle_packet<N> const&     packet
+        )
+{
+    using F = simd::float_from_simd_width_t<N>;
+    using V = vector<3, F>;
+
+    hit_record_triangle_packet<basic_ray<float>> result;
+    result.t = -1.0f;
+
+    V dir(ray.dir);
+    V e1(F(packet.e1_x), F(packet.e1_y), F(packet.e1_z));
+    V e2(F(packet.e2_x), F(packet.e2_y), F(packet.e2_z));
+
+    V s1 = cross(dir, e2);
+    F div = dot(s1, e1);
+
+    auto hit = div != F(0.0f);
+
+    if (!any(hit))
+    {
+        return result;
+    }
+
+    F inv_div = F(1.0f) / div;
+
+    V d = V(ray.ori) - V(F(packet.v1_x), F(packet.v1_y), F(packet.v1_z));
+    F b1 = dot(d, s1) * inv_div;
+
+    hit &= b1 >= F(0.0f) && b1 <= F(1.0f);
+
+    if (!any(hit))
+    {
+        return result;
+    }
+
+    V s2 = cross(d, e1);
+    F b2 = dot(dir, s2) * inv_div;
+    F t = dot(e2, s2) * inv_div;
+
+    hit &= b2 >= F(0.0f) && b1 + b2 <= F(1.0f) && t >= F(0.0f);
+
+    if (!any(hit))
+    {
+        return result;
+    }
+
+    VSNRAY_ALIGN(32) float ts[N];
+    store(ts, select(hit, t, F(numeric_limits<float>::max())));
+
+    int lane = 0;
+
+    for (int i = 1; i < static_cast<int>(N); ++i)
+    {
+        if (ts[i] < ts[lane])
+        {
+            lane = i;
+        }
+    }
+
+    VSNRAY_ALIGN(32) float us[N];
+    VSNRAY_ALIGN(32) float vs[N];
+    store(us, b1);
+    store(vs, b2);
+
+    result.hit = true;
+    result.t = ts[lane];
+    result.u = us[lane];
+    result.v = vs[lane];
+    result.prim_id = packet.prim_id[lane];
+    result.geom_id = packet.geom_id[lane];
+    result.lane = lane;
+    return result;
+}
+
+} // MATH_NAMESPACE
+
+#endif // VSNRAY_MATH_TRIANGLE_PACKET_H
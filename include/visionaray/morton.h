@@ -45,6 +45,25 @@ inline unsigned morton_encode3D(unsigned x, unsigned y, unsigned z)
     return separate_bits(x) | (separate_bits(y) << 1) | (separate_bits(z) << 2); 
 }
 
+// 64-bit version, 21 bits per axis ----------------------
+
+VSNRAY_FUNC
+inline unsigned long long morton_encode3D_64(unsigned x, unsigned y, unsigned z)
+{
+    auto separate_bits = [](unsigned long long n)
+    {
+        n &= 0x00000000001FFFFFull;
+        n = (n ^ (n << 32)) & 0x001F00000000FFFFull;
+        n = (n ^ (n << 16)) & 0x001F0000FF0000FFull;
+        n = (n ^ (n <<  8)) & 0x100F00F00F00F00Full;
+        n = (n ^ (n <<  4)) & 0x10C30C30C30C30C3ull;
+        n = (n ^ (n <<  2)) & 0x1249249249249249ull;
+        return n;
+    };
+
+    return separate_bits(x) | (separate_bits(y) << 1) | (separate_bits(z) << 2);
+}
+
 VSNRAY_FUNC
 inline vec2ui morton_decode2D(unsigned index)
 {
@@ -77,6 +96,23 @@ inline vec3ui morton_decode3D(unsigned index)
     return { compact_bits(index), compact_bits(index >> 1), compact_bits(index >> 2) };
 }
 
+VSNRAY_FUNC
+inline vec3ui morton_decode3D_64(unsigned long long index)
+{
+    auto compact_bits = [](unsigned long long n)
+    {
+        n &= 0x1249249249249249ull;
+        n = (n ^ (n >>  2)) & 0x10C30C30C30C30C3ull;
+        n = (n ^ (n >>  4)) & 0x100F00F00F00F00Full;
+        n = (n ^ (n >>  8)) & 0x001F0000FF0000FFull;
+        n = (n ^ (n >> 16)) & 0x001F00000000FFFFull;
+        n = (n ^ (n >> 32)) & 0x00000000001FFFFFull;
+        return static_cast<unsigned>(n);
+    };
+
+    return { compact_bits(index), compact_bits(index >> 1), compact_bits(index >> 2) };
+}
+
 } // visionaray
 
 #endif // VSNRAY_MORTON_H
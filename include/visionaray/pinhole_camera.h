@@ -11,6 +11,7 @@
 #include "math/matrix.h"
 #include "math/rectangle.h"
 #include "math/vector.h"
+#include "ray_differential.h"
 
 namespace visionaray
 {
@@ -86,6 +87,12 @@ public:
     VSNRAY_FUNC
     R primary_ray(R /* */, T const& x, T const& y, T const& width, T const& height) const;
 
+    // Derivatives of a primary ray w.r.t. the pixel position. Rays of derived cameras
+    // (thin_lens_camera) obtain those of the pinhole ray through the same pixel.
+    template <typename R, typename T = typename R::scalar_type>
+    VSNRAY_FUNC
+    ray_differential<T> primary_ray_differential(R const& ray, T const& width, T const& height) const;
+
 private:
 
     mat4 view_;
@@ -53,6 +53,63 @@ struct basic_jittered_blend_type : jittered_type
 
 using jittered_blend_type = basic_jittered_blend_type<float>;
 
+// Sequences for the low-discrepancy samplers (see qmc_generator.h)
+struct sobol_sequence {};       // Owen-scrambled Sobol
+struct halton_sequence {};      // Halton with random digit permutations
+struct blue_noise_sequence {};  // Sobol, dithered over the pixels with a blue noise mask
+
+// Jittered pixel positions, all random numbers are taken from a low-discrepancy
+// sequence. Progressive rendering takes the n-th point of the sequence in frame n
+template <typename Sequence>
+struct ld_jittered_type : jittered_type {};
+
+// Low-discrepancy jittered and successive blending
+template <typename T, typename Sequence>
+struct basic_ld_jittered_blend_type : basic_jittered_blend_type<T> {};
+
+template <typename Sequence>
+using ld_jittered_blend_type = basic_ld_jittered_blend_type<float, Sequence>;
+
+// Running statistics of a single pixel, used by the adaptive sampler.
+// Zero-initialized statistics denote a pixel without samples
+template <typename T>
+struct basic_pixel_statistics
+{
+    T mean[4];          // Mean RGBA color
+    T m2;               // Sum of squared deviations of the luminance from its mean
+    unsigned count;     // Number of samples
+};
+
+using pixel_statistics = basic_pixel_statistics<float>;
+
+// Progressive, adaptive sampling with jittered pixel positions
+//
+// Tracks the running mean and variance of each pixel in stats (width x height
+// entries) and stores the mean in the color buffer. Each frame, pixels get more
+// samples the farther their estimated relative error is above threshold, pixels
+// whose relative error dropped below threshold are skipped. Reset the statistics
+// to zero to restart, e.g. after the camera moved. Only the color buffer is written
+template <typename T>
+struct basic_adaptive_type : jittered_type
+{
+    basic_pixel_statistics<T>* stats = nullptr;
+
+    // Relative standard error of the luminance at which a pixel has converged
+    T threshold = T(0.01);
+
+    // Samples before a pixel may be considered converged, the variance
+    // estimate of only a few samples may be far too small
+    unsigned min_samples = 8;
+
+    // Max. samples per pixel and frame
+    unsigned max_samples = 16;
+
+    // Stop sampling after that many samples, even if not converged (0: no limit)
+    unsigned max_total_samples = 0;
+};
+
+using adaptive_type = basic_adaptive_type<float>;
+
 } // pixel_sampler
 } // visionaray
 
@@ -8,6 +8,7 @@
 
 #include <cstddef>
 
+#include <visionaray/math/indexed_triangle.h>
 #include <visionaray/math/plane.h>
 #include <visionaray/math/sphere.h>
 #include <visionaray/math/triangle.h>
@@ -75,6 +76,12 @@ struct scalar_type<basic_triangle<Dim, T, P>>
     using type = T;
 };
 
+template <typename T, typename P>
+struct scalar_type<basic_indexed_triangle<T, P>>
+{
+    using type = T;
+};
+
 //-------------------------------------------------------------------------------------------------
 // Number of vertices
 //
@@ -95,6 +102,12 @@ struct num_vertices<basic_triangle<Dim, T, P>>
     enum { value = 3 };
 };
 
+template <typename T, typename P>
+struct num_vertices<basic_indexed_triangle<T, P>>
+{
+    enum { value = 3 };
+};
+
 
 //-------------------------------------------------------------------------------------------------
 // Number of precalculated normals
@@ -0,0 +1,455 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_QMC_GENERATOR_H
+#define VSNRAY_QMC_GENERATOR_H 1
+
+#include <cstddef>
+#include <type_traits>
+
+#include "detail/macros.h"
+#include "math/simd/type_traits.h"
+#include "array.h"
+#include "random_generator.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Bit manipulation and scrambling
+//
+
+VSNRAY_FUNC
+inline unsigned reverse_bits(unsigned x)
+{
+#if defined(__CUDA_ARCH__)
+    return __brev(x);
+#else
+    x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+    x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+    x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+    x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+    return (x >> 16) | (x << 16);
+#endif
+}
+
+VSNRAY_FUNC
+inline unsigned hash_combine(unsigned seed, unsigned value)
+{
+    return hash32(seed ^ (hash32(value) + 0x9E3779B9U + (seed << 6) + (seed >> 2)));
+}
+
+// Owen scrambling of the bits of x, after Burley: Practical Hash-based Owen
+// Scrambling, JCGT 2020. Each bit is flipped depending on the bits above it
+VSNRAY_FUNC
+inline unsigned nested_uniform_scramble(unsigned x, unsigned seed)
+{
+    x = reverse_bits(x);
+
+    // Laine-Karras permutation, flips bits depending on the bits below them
+    x += seed;
+    x ^= x * 0x6C50B47CU;
+    x ^= x * 0xB82F1E52U;
+    x ^= x * 0xC7AFE638U;
+    x ^= x * 0x8D22F6E6U;
+
+    return reverse_bits(x);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Owen-scrambled Sobol sequence
+//
+// Burley's variant: the first two Sobol dimensions (a (0,2)-sequence) are used
+// for each pair of dimensions, the point index is shuffled per pair so that the
+// pairs are decorrelated. The result is a 0.32 fixed point number
+//
+
+VSNRAY_FUNC
+inline unsigned sobol_owen(unsigned index, unsigned dim, unsigned seed)
+{
+    unsigned pair_seed = hash_combine(seed, dim >> 1);
+
+    index = nested_uniform_scramble(index, pair_seed);
+
+    unsigned result = 0;
+
+    if ((dim & 1) == 0)
+    {
+        // Van der Corput
+        result = reverse_bits(index);
+    }
+    else
+    {
+        // Direction numbers of the primitive polynomial x + 1
+        unsigned v = 0x80000000U;
+
+        for (; index != 0; index >>= 1)
+        {
+            if (index & 1)
+            {
+                result ^= v;
+            }
+
+            v ^= v >> 1;
+        }
+    }
+
+    return nested_uniform_scramble(result, hash_combine(pair_seed, dim & 1));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Halton sequence with random digit permutations
+//
+// Digit k of dimension d is permuted with (a * digit + c) mod base, a and c are
+// derived from seed, d and k. Dimensions beyond the first 32 primes reuse the
+// bases and shuffle the point index instead
+//
+
+VSNRAY_FUNC
+inline float halton_permuted(unsigned index, unsigned dim, unsigned seed)
+{
+    const unsigned primes[] = {
+            2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,  41,  43,  47,  53,
+           59,  61,  67,  71,  73,  79,  83,  89,  97, 101, 103, 107, 109, 113, 127, 131
+            };
+
+    const unsigned num_primes = sizeof(primes) / sizeof(primes[0]);
+
+    unsigned base = primes[dim % num_primes];
+    unsigned dim_seed = hash_combine(seed, dim);
+
+    if (dim >= num_primes)
+    {
+        index = nested_uniform_scramble(index, hash_combine(dim_seed, 0xFFFFFFFFU));
+    }
+
+    float inv_base = 1.0f / base;
+    float inv_bi = inv_base;
+    float result = 0.0f;
+
+    // Also permute the zero digits beyond the highest digit of index,
+    // until they no longer affect the float result
+    for (unsigned k = 0; inv_bi > 1.0f / 16777216.0f; ++k)
+    {
+        unsigned h = hash_combine(dim_seed, k);
+        unsigned a = 1 + h % (base - 1);
+        unsigned c = (h >> 16) % base;
+
+        unsigned digit = index % base;
+        result += ((a * digit + c) % base) * inv_bi;
+
+        index /= base;
+        inv_bi *= inv_base;
+    }
+
+    // Rounding may produce 1.0
+    return result < 1.0f ? result : 0.99999994f;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Offset of pixel (x,y) in a blue noise dither mask, 0.32 fixed point
+//
+// Uses Roberts' R2 sequence over the pixel grid, neighboring pixels get offsets
+// that are far apart, so the error of the dithered samples is distributed
+// mostly at high frequencies. Each dimension uses a differently shifted mask
+//
+
+VSNRAY_FUNC
+inline unsigned blue_noise_offset(unsigned x, unsigned y, unsigned dim, unsigned seed)
+{
+    unsigned h = hash_combine(seed, dim);
+
+    x += h & 0xFFFF;
+    y += h >> 16;
+
+    // 2^32 / plastic number, 2^32 / plastic number^2
+    return x * 3242174889U + y * 2447445414U;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// SIMD generators are made up of one scalar generator per lane
+//
+
+template <typename Generator, typename T>
+class lane_generators
+{
+public:
+
+    using value_type = T;
+
+public:
+
+    typedef Generator generator_type;
+
+    enum { N = simd::num_elements<T>::value };
+
+    lane_generators() = default;
+
+    VSNRAY_FUNC lane_generators(array<unsigned, N> const& seed)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            generators_[i] = generator_type(seed[i]);
+        }
+    }
+
+    VSNRAY_FUNC lane_generators(array<unsigned, N> const& pixel, unsigned sample, unsigned frame, unsigned seed = 0)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            generators_[i] = generator_type(pixel[i], sample, frame, seed);
+        }
+    }
+
+    VSNRAY_FUNC value_type next()
+    {
+        simd::aligned_array_t<value_type> arr;
+
+        for (int i = 0; i < N; ++i)
+        {
+            arr[i] = generators_[i].next();
+        }
+
+        return value_type(arr);
+    }
+
+    VSNRAY_FUNC unsigned dimension() const
+    {
+        return generators_[0].dimension();
+    }
+
+    VSNRAY_FUNC void set_dimension(unsigned dim)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            generators_[i].set_dimension(dim);
+        }
+    }
+
+    VSNRAY_FUNC generator_type& get_generator(size_t i)
+    {
+        return generators_[i];
+    }
+
+private:
+
+    array<generator_type, N> generators_;
+
+};
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Low-discrepancy generators
+//
+// Drop-in replacements for random_generator. A generator produces one point of
+// a low-discrepancy sequence, each call to next() returns the next dimension of
+// that point. The point index is sample + frame, the pixel selects a scramble
+// (or, for the blue noise generator, a dither offset). Progressive rendering with
+// one sample per pixel and frame thus successively takes the points of the
+// sequence. Kernels should draw the same decisions from the same dimensions,
+// e.g. pathtracing::kernel starts each bounce at a fixed dimension.
+//
+//  - sobol_generator:
+//      Owen-scrambled Sobol, scrambled per pixel
+//
+//  - halton_generator:
+//      Halton with random digit permutations, permuted per pixel
+//
+//  - blue_noise_generator:
+//      Owen-scrambled Sobol, the same for all pixels but toroidally shifted per
+//      pixel by a blue noise dither mask. Relies on the pixel keys generated by
+//      detail::pixel_key() to recover the pixel position
+//
+
+template <typename T, typename = void>
+class sobol_generator
+{
+public:
+
+    using value_type = T;
+
+public:
+
+    sobol_generator() = default;
+
+    VSNRAY_FUNC sobol_generator(unsigned seed)
+        : seed_(detail::hash32(seed))
+    {
+    }
+
+    VSNRAY_FUNC sobol_generator(unsigned pixel, unsigned sample, unsigned frame, unsigned seed = 0)
+        : seed_(detail::hash_combine(detail::hash32(seed), pixel))
+        , index_(sample + frame)
+    {
+    }
+
+    VSNRAY_FUNC T next()
+    {
+        return detail::unorm_from_bits<T>(detail::sobol_owen(index_, dim_++, seed_));
+    }
+
+    VSNRAY_FUNC unsigned dimension() const
+    {
+        return dim_;
+    }
+
+    VSNRAY_FUNC void set_dimension(unsigned dim)
+    {
+        dim_ = dim;
+    }
+
+private:
+
+    unsigned seed_  = 0;
+    unsigned index_ = 0;
+    unsigned dim_   = 0;
+
+};
+
+template <typename T, typename = void>
+class halton_generator
+{
+public:
+
+    using value_type = T;
+
+public:
+
+    halton_generator() = default;
+
+    VSNRAY_FUNC halton_generator(unsigned seed)
+        : seed_(detail::hash32(seed))
+    {
+    }
+
+    VSNRAY_FUNC halton_generator(unsigned pixel, unsigned sample, unsigned frame, unsigned seed = 0)
+        : seed_(detail::hash_combine(detail::hash32(seed), pixel))
+        , index_(sample + frame)
+    {
+    }
+
+    VSNRAY_FUNC T next()
+    {
+        return T(detail::halton_permuted(index_, dim_++, seed_));
+    }
+
+    VSNRAY_FUNC unsigned dimension() const
+    {
+        return dim_;
+    }
+
+    VSNRAY_FUNC void set_dimension(unsigned dim)
+    {
+        dim_ = dim;
+    }
+
+private:
+
+    unsigned seed_  = 0;
+    unsigned index_ = 0;
+    unsigned dim_   = 0;
+
+};
+
+template <typename T, typename = void>
+class blue_noise_generator
+{
+public:
+
+    using value_type = T;
+
+public:
+
+    blue_noise_generator() = default;
+
+    VSNRAY_FUNC blue_noise_generator(unsigned seed)
+        : seed_(detail::hash32(seed))
+    {
+    }
+
+    VSNRAY_FUNC blue_noise_generator(unsigned pixel, unsigned sample, unsigned frame, unsigned seed = 0)
+        : seed_(detail::hash32(seed))
+        , index_(sample + frame)
+        , x_(pixel & 0xFFFF)
+        , y_(pixel >> 16)
+    {
+    }
+
+    VSNRAY_FUNC T next()
+    {
+        unsigned bits = detail::sobol_owen(index_, dim_, seed_);
+        bits += detail::blue_noise_offset(x_, y_, dim_, seed_);
+        ++dim_;
+
+        return detail::unorm_from_bits<T>(bits);
+    }
+
+    VSNRAY_FUNC unsigned dimension() const
+    {
+        return dim_;
+    }
+
+    VSNRAY_FUNC void set_dimension(unsigned dim)
+    {
+        dim_ = dim;
+    }
+
+private:
+
+    unsigned seed_  = 0;
+    unsigned index_ = 0;
+    unsigned x_     = 0;
+    unsigned y_     = 0;
+    unsigned dim_   = 0;
+
+};
+
+
+// SIMD versions ------------------------------------------
+
+template <typename T>
+class sobol_generator<T, typename std::enable_if<simd::is_simd_vector<T>::value>::type>
+    : public detail::lane_generators<sobol_generator<float>, T>
+{
+public:
+
+    using detail::lane_generators<sobol_generator<float>, T>::lane_generators;
+
+    sobol_generator() = default;
+};
+
+template <typename T>
+class halton_generator<T, typename std::enable_if<simd::is_simd_vector<T>::value>::type>
+    : public detail::lane_generators<halton_generator<float>, T>
+{
+public:
+
+    using detail::lane_generators<halton_generator<float>, T>::lane_generators;
+
+    halton_generator() = default;
+};
+
+template <typename T>
+class blue_noise_generator<T, typename std::enable_if<simd::is_simd_vector<T>::value>::type>
+    : public detail::lane_generators<blue_noise_generator<float>, T>
+{
+public:
+
+    using detail::lane_generators<blue_noise_generator<float>, T>::lane_generators;
+
+    blue_noise_generator() = default;
+};
+
+} // visionaray
+
+#endif // VSNRAY_QMC_GENERATOR_H
@@ -6,72 +6,152 @@
 #ifndef VSNRAY_RANDOM_GENERATOR_H
 #define VSNRAY_RANDOM_GENERATOR_H 1
 
-#include <chrono>
 #include <cstddef>
 #include <type_traits>
 
-#if defined(__CUDACC__)
-#include <thrust/random.h>
-#else
-#include <random>
-#endif
-
 #include "math/simd/type_traits.h"
 #include "array.h"
 
 namespace visionaray
 {
-namespace detail
-{
 
 //-------------------------------------------------------------------------------------------------
-// TODO: move to a better place
+// Integer helpers for the counter-based generators below
 //
 
-#if defined(__CUDA_ARCH__)
-template <
-    typename T,
-    typename = typename std::enable_if<std::is_floating_point<T>::value>::type
-    >
-VSNRAY_GPU_FUNC
-inline unsigned tic(T /* */)
+namespace detail
 {
-    return clock64();
+
+// Logical shift, the SIMD int types may shift arithmetically
+VSNRAY_FUNC
+inline unsigned shift_right(unsigned x, int n)
+{
+    return x >> n;
 }
-#else
+
 template <
-    typename T,
-    typename = typename std::enable_if<std::is_floating_point<T>::value>::type
+    typename I,
+    typename = typename std::enable_if<simd::is_simd_vector<I>::value>::type
     >
 VSNRAY_FUNC
-inline unsigned tic(T /* */)
+inline I shift_right(I const& x, int n)
+{
+    return (x >> n) & I((1 << (32 - n)) - 1);
+}
+
+// Chris Wellons' lowbias32 hash, only uses constant shifts and 32-bit
+// multiplications, so it vectorizes with any of the SIMD int types
+template <typename I>
+VSNRAY_FUNC
+inline I hash32(I x)
+{
+    x = x ^ shift_right(x, 16);
+    x = x * I(static_cast<int>(0x7FEB352DU));
+    x = x ^ shift_right(x, 15);
+    x = x * I(static_cast<int>(0x846CA68BU));
+    x = x ^ shift_right(x, 16);
+    return x;
+}
+
+// Uniformly distributed in [0..1), uses the upper 24 bits
+template <typename T>
+VSNRAY_FUNC
+inline T unorm_from_bits(unsigned bits)
+{
+    return T(bits >> 8) * T(1.0f / 16777216.0f);
+}
+
+template <typename T, typename I>
+VSNRAY_FUNC
+inline T unorm_from_bits(I const& bits)
+{
+    return convert_to_float(shift_right(bits, 8)) * T(1.0f / 16777216.0f);
+}
+
+// High and low 32 bits of the 64-bit product a * b
+VSNRAY_FUNC
+inline void mulhilo(unsigned a, unsigned b, unsigned& hi, unsigned& lo)
 {
-    auto t = std::chrono::high_resolution_clock::now();
-    return t.time_since_epoch().count();
+    unsigned long long p = static_cast<unsigned long long>(a) * b;
+    hi = static_cast<unsigned>(p >> 32);
+    lo = static_cast<unsigned>(p);
 }
-#endif
 
+// The SIMD int types only have a 32-bit multiplication, the high word is
+// assembled from the products of the 16-bit halves
 template <
-    typename T,
-    typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type
+    typename I,
+    typename = typename std::enable_if<simd::is_simd_vector<I>::value>::type
     >
-VSNRAY_FUNC array<unsigned, simd::num_elements<T>::value> tic(T /* */)
+VSNRAY_FUNC
+inline void mulhilo(I const& a, I const& b, I& hi, I& lo)
 {
-    array<unsigned, simd::num_elements<T>::value> result;
+    I mask(0xFFFF);
+
+    I al = a & mask;
+    I ah = shift_right(a, 16);
+    I bl = b & mask;
+    I bh = shift_right(b, 16);
+
+    I ll = al * bl;
+    I lh = al * bh;
+    I hl = ah * bl;
+    I hh = ah * bh;
 
-    for (int i = 0; i < simd::num_elements<T>::value; ++i)
+    I mid = shift_right(ll, 16) + (lh & mask) + (hl & mask);
+
+    hi = hh + shift_right(lh, 16) + shift_right(hl, 16) + shift_right(mid, 16);
+    lo = a * b;
+}
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+template <typename I>
+VSNRAY_FUNC
+inline array<I, 4> philox4x32(array<I, 4> ctr, array<I, 2> key)
+{
+    for (int round = 0; round < 10; ++round)
     {
-        result[i] = tic(float{});
+        if (round > 0)
+        {
+            key[0] = key[0] + I(static_cast<int>(0x9E3779B9U));
+            key[1] = key[1] + I(static_cast<int>(0xBB67AE85U));
+        }
+
+        I hi0;
+        I lo0;
+        I hi1;
+        I lo1;
+        mulhilo(I(static_cast<int>(0xD2511F53U)), ctr[0], hi0, lo0);
+        mulhilo(I(static_cast<int>(0xCD9E8D57U)), ctr[2], hi1, lo1);
+
+        ctr[0] = hi1 ^ ctr[1] ^ key[0];
+        ctr[1] = lo1;
+        ctr[2] = hi0 ^ ctr[3] ^ key[1];
+        ctr[3] = lo0;
     }
 
-    return result;
+    return ctr;
 }
 
 } // detail
 
 
 //-------------------------------------------------------------------------------------------------
-// random_generator classes, uses a standard pseudo RNG to generate samples
+// random_generator classes
+//
+// Counter-based generators: the n-th number that a generator returns is word
+// n % 4 of the Philox4x32-10 block cipher applied to the counter
+// (n / 4, sample, frame) under the key (pixel, seed). Every sample can thus be
+// reproduced independently of which thread renders it, and different
+// (pixel, sample, frame, dimension) tuples never share a counter. The last
+// block is cached, so the cipher only runs for every fourth number. The sample index can be changed after
+// construction, samplers that trace several samples per pixel with the same
+// generator use this to start a fresh sequence for each sample.
+//
+// The SIMD generators encrypt all lanes at once. Each lane has its own key
+// (usually one pixel of a ray packet), get_generator() returns the scalar
+// generator of a single lane, it shares the dimension counter with the SIMD
+// generator.
 //
 
 template <typename T, typename = void>
@@ -83,31 +163,79 @@ public:
 
 public:
 
-#if defined(__CUDACC__)
-    typedef thrust::default_random_engine rand_engine;
-    typedef thrust::uniform_real_distribution<T> uniform_dist;
-#else
-    typedef std::default_random_engine rand_engine;
-    typedef std::uniform_real_distribution<T> uniform_dist;
-#endif
-
     random_generator() = default;
 
+    // Generator with an arbitrary seed
     VSNRAY_FUNC random_generator(unsigned seed)
-        : rng_(rand_engine(seed))
-        , dist_(uniform_dist(0, 1))
+        : seed_(seed)
+        , stream_(1)
+    {
+    }
+
+    // Generator for one sample of a pixel
+    VSNRAY_FUNC random_generator(unsigned pixel, unsigned sample, unsigned frame, unsigned seed = 0)
+        : pixel_(pixel)
+        , seed_(seed)
+        , sample_(sample)
+        , frame_(frame)
     {
     }
 
     VSNRAY_FUNC T next()
     {
-        return dist_(rng_);
+        if (block_index_ != dim_ / 4)
+        {
+            fill_block();
+        }
+
+        return detail::unorm_from_bits<T>(block_[dim_++ % 4]);
+    }
+
+    // Index of the next number
+    VSNRAY_FUNC unsigned dimension() const
+    {
+        return dim_;
+    }
+
+    VSNRAY_FUNC void set_dimension(unsigned dim)
+    {
+        dim_ = dim;
+    }
+
+    // Continue with the first number of another sample
+    VSNRAY_FUNC void set_sample(unsigned sample)
+    {
+        sample_ = sample;
+        dim_ = 0;
+        block_index_ = ~0U;
     }
 
 private:
 
-    rand_engine  rng_;
-    uniform_dist dist_;
+    template <typename, typename>
+    friend class random_generator;
+
+    VSNRAY_FUNC void fill_block()
+    {
+        block_ = detail::philox4x32(
+                array<unsigned, 4>{{ dim_ / 4, sample_, frame_, stream_ }},
+                array<unsigned, 2>{{ pixel_, seed_ }}
+                );
+
+        block_index_ = dim_ / 4;
+    }
+
+    unsigned pixel_  = 0;
+    unsigned seed_   = 0;
+    unsigned sample_ = 0;
+    unsigned frame_  = 0;
+    // Separates seeded generators from pixel generators
+    unsigned stream_ = 0;
+    unsigned dim_    = 0;
+
+    // Cipher output for the counter dim_ / 4
+    array<unsigned, 4> block_;
+    unsigned block_index_ = ~0U;
 
 };
 
@@ -122,6 +250,8 @@ public:
 
     typedef random_generator<float> generator_type;
 
+    random_generator() = default;
+
     VSNRAY_FUNC random_generator(array<unsigned, simd::num_elements<value_type>::value> const& seed)
     {
         for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
@@ -130,16 +260,66 @@ public:
         }
     }
 
+    VSNRAY_FUNC random_generator(
+            array<unsigned, simd::num_elements<value_type>::value> const& pixel,
+            unsigned sample,
+            unsigned frame,
+            unsigned seed = 0
+            )
+    {
+        for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
+        {
+            generators_[i] = generator_type(pixel[i], sample, frame, seed);
+        }
+    }
+
     VSNRAY_FUNC value_type next()
     {
-        simd::aligned_array_t<value_type> arr;
+        using I = simd::int_type_t<value_type>;
+
+        bool fill = false;
+
+        for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
+        {
+            fill |= generators_[i].block_index_ != generators_[i].dim_ / 4;
+        }
+
+        if (fill)
+        {
+            fill_blocks();
+        }
+
+        simd::aligned_array_t<I> bits;
 
         for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
         {
-            arr[i] = generators_[i].next();
+            auto& g = generators_[i];
+            bits[i] = static_cast<int>(g.block_[g.dim_++ % 4]);
         }
 
-        return value_type(arr);
+        return detail::unorm_from_bits<value_type>(I(bits));
+    }
+
+    // Index of the next number of the first lane
+    VSNRAY_FUNC unsigned dimension() const
+    {
+        return generators_[0].dimension();
+    }
+
+    VSNRAY_FUNC void set_dimension(unsigned dim)
+    {
+        for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
+        {
+            generators_[i].set_dimension(dim);
+        }
+    }
+
+    VSNRAY_FUNC void set_sample(unsigned sample)
+    {
+        for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
+        {
+            generators_[i].set_sample(sample);
+        }
     }
 
     // TODO: maybe don't have a random_generatorN at all?
@@ -150,10 +330,127 @@ public:
 
 private:
 
+    // Encrypts the current counters of all lanes at once
+    VSNRAY_FUNC void fill_blocks()
+    {
+        using I = simd::int_type_t<value_type>;
+
+        simd::aligned_array_t<I> ctr[4];
+        simd::aligned_array_t<I> key[2];
+
+        for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
+        {
+            auto const& g = generators_[i];
+            ctr[0][i] = static_cast<int>(g.dim_ / 4);
+            ctr[1][i] = static_cast<int>(g.sample_);
+            ctr[2][i] = static_cast<int>(g.frame_);
+            ctr[3][i] = static_cast<int>(g.stream_);
+            key[0][i] = static_cast<int>(g.pixel_);
+            key[1][i] = static_cast<int>(g.seed_);
+        }
+
+        auto block = detail::philox4x32(
+                array<I, 4>{{ I(ctr[0]), I(ctr[1]), I(ctr[2]), I(ctr[3]) }},
+                array<I, 2>{{ I(key[0]), I(key[1]) }}
+                );
+
+        for (int w = 0; w < 4; ++w)
+        {
+            store(ctr[w], block[w]);
+        }
+
+        for (int i = 0; i < simd::num_elements<value_type>::value; ++i)
+        {
+            auto& g = generators_[i];
+
+            for (int w = 0; w < 4; ++w)
+            {
+                g.block_[w] = static_cast<unsigned>(ctr[w][i]);
+            }
+
+            g.block_index_ = g.dim_ / 4;
+        }
+    }
+
     array<generator_type, simd::num_elements<value_type>::value> generators_;
 
 };
 
+
+
+//-------------------------------------------------------------------------------------------------
+// Query and set the dimension and the sample index of generators that support
+// this, no-ops otherwise
+//
+
+namespace detail
+{
+
+template <typename Generator>
+VSNRAY_FUNC
+inline auto generator_dimension(Generator const& gen, int /* prefer this overload */)
+    -> decltype(gen.dimension())
+{
+    return gen.dimension();
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline unsigned generator_dimension(Generator const& /* */, long)
+{
+    return 0;
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline unsigned generator_dimension(Generator const& gen)
+{
+    return generator_dimension(gen, 0);
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline auto set_generator_dimension(Generator& gen, unsigned dim, int /* prefer this overload */)
+    -> decltype(gen.set_dimension(dim))
+{
+    gen.set_dimension(dim);
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline void set_generator_dimension(Generator& /* */, unsigned /* */, long)
+{
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline void set_generator_dimension(Generator& gen, unsigned dim)
+{
+    set_generator_dimension(gen, dim, 0);
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline auto set_generator_sample(Generator& gen, unsigned sample, int /* prefer this overload */)
+    -> decltype(gen.set_sample(sample))
+{
+    gen.set_sample(sample);
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline void set_generator_sample(Generator& /* */, unsigned /* */, long)
+{
+}
+
+template <typename Generator>
+VSNRAY_FUNC
+inline void set_generator_sample(Generator& gen, unsigned sample)
+{
+    set_generator_sample(gen, sample, 0);
+}
+
+} // detail
 } // visionaray
 
 #endif // VSNRAY_RANDOM_GENERATOR_H
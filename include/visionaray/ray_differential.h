@@ -0,0 +1,100 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_RAY_DIFFERENTIAL_H
+#define VSNRAY_RAY_DIFFERENTIAL_H 1
+
+#include "detail/macros.h"
+#include "math/ray.h"
+#include "math/triangle.h"
+#include "math/vector.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Ray differentials, cf. Igehy (1999): Tracing Ray Differentials
+//
+// Derivatives of a ray's origin and direction w.r.t. the screen space position. Primary
+// rays obtain them from the camera (see pinhole_camera::primary_ray_differential()).
+// At a hit point they are transferred to derivatives of the position and then of the
+// texture coordinates, which select the mip level (see tex2DGrad()).
+//
+
+template <typename T>
+struct ray_differential
+{
+    vector<3, T> ori_dx;
+    vector<3, T> ori_dy;
+    vector<3, T> dir_dx;
+    vector<3, T> dir_dy;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Derivatives of the hit position of ray with distance t on a surface with normal n
+//
+
+template <typename T>
+VSNRAY_FUNC
+inline void position_differentials(
+        ray_differential<T> const&  rd,
+        basic_ray<T> const&         ray,
+        T const&                    t,
+        vector<3, T> const&         n,
+        vector<3, T>&               dpdx,
+        vector<3, T>&               dpdy
+        )
+{
+    // Avoid division by zero at grazing angles
+    T dn = dot(ray.dir, n);
+    dn = select(dn >= T(0.0), max(dn, T(1e-6f)), min(dn, T(-1e-6f)));
+
+    auto px = rd.ori_dx + rd.dir_dx * t;
+    auto py = rd.ori_dy + rd.dir_dy * t;
+
+    dpdx = px - ray.dir * (dot(px, n) / dn);
+    dpdy = py - ray.dir * (dot(py, n) / dn);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Derivatives of the texture coordinates on a triangle with per vertex texture
+// coordinates tc1, tc2, tc3, given derivatives of the position on the triangle
+//
+
+template <typename T, typename TexCoord>
+VSNRAY_FUNC
+inline void tex_coord_differentials(
+        basic_triangle<3, T> const& tri,
+        TexCoord const&             tc1,
+        TexCoord const&             tc2,
+        TexCoord const&             tc3,
+        vector<3, T> const&         dpdx,
+        vector<3, T> const&         dpdy,
+        TexCoord&                   dtdx,
+        TexCoord&                   dtdy
+        )
+{
+    // Express dpdx and dpdy in the basis of the triangle edges
+    T a = dot(tri.e1, tri.e1);
+    T b = dot(tri.e1, tri.e2);
+    T c = dot(tri.e2, tri.e2);
+
+    T det = a * c - b * b;
+    T inv_det = select(det != T(0.0), T(1.0) / det, T(0.0));
+
+    T dudx = (c * dot(tri.e1, dpdx) - b * dot(tri.e2, dpdx)) * inv_det;
+    T dvdx = (a * dot(tri.e2, dpdx) - b * dot(tri.e1, dpdx)) * inv_det;
+    T dudy = (c * dot(tri.e1, dpdy) - b * dot(tri.e2, dpdy)) * inv_det;
+    T dvdy = (a * dot(tri.e2, dpdy) - b * dot(tri.e1, dpdy)) * inv_det;
+
+    dtdx = (tc2 - tc1) * dudx + (tc3 - tc1) * dvdx;
+    dtdy = (tc2 - tc1) * dudy + (tc3 - tc1) * dvdy;
+}
+
+} // visionaray
+
+#endif // VSNRAY_RAY_DIFFERENTIAL_H
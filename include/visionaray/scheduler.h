@@ -103,6 +103,42 @@ public:
 
 };
 
+// Intersectors that cull per screen tile (see tile_culling_intersector)
+template <typename SP>
+class sched_params_has_tile_culling
+{
+private:
+
+    template <typename U>
+    static std::true_type  test(typename std::decay<decltype(std::declval<U>().intersector)>::type::tile_culling*);
+
+    template <typename U>
+    static std::false_type test(...);
+
+public:
+
+    using type = decltype( test<typename std::decay<SP>::type>(nullptr) );
+
+};
+
+// Stream kernels are called with whole tiles of primary rays (see pathtracing::wavefront_kernel)
+template <typename K>
+class is_stream_kernel
+{
+private:
+
+    template <typename U>
+    static std::true_type  test(typename U::stream_kernel*);
+
+    template <typename U>
+    static std::false_type test(...);
+
+public:
+
+    using type = decltype( test<typename std::decay<K>::type>(nullptr) );
+
+};
+
 } // detail
 
 
@@ -0,0 +1,533 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_TEXTURE_BRICKED_TEXTURE_H
+#define VSNRAY_TEXTURE_BRICKED_TEXTURE_H 1
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <visionaray/math/detail/math.h>
+#include <visionaray/math/vector.h>
+#include <visionaray/aligned_vector.h>
+
+#include "detail/filter/common.h"
+#include "detail/texture_common.h"
+#include "texture.h"
+
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Bricked texture
+//
+// Sparse 3D texture that stores voxels in bricks of brick_size^3 voxels (brick_size is a
+// power of two, typically 8 or 16). An index table maps each brick either to a dense
+// brick in a brick pool, or, if all of its voxels are equal, to a single constant value.
+// Constant bricks (e.g. empty space) occupy no pool memory, so the memory footprint of
+// sparse volumes is proportional to the number of non-uniform bricks.
+//
+// Lookups whose filter footprint lies within a single brick read the brick directly,
+// lookups straddling brick borders gather the footprint first. Bricks have no border
+// voxels, all filter modes are supported.
+//
+// Example:
+//
+//  bricked_texture<float> tex(2048, 2048, 2048, 16);
+//  tex.set_brick(bx, by, bz, voxels); // for each non-empty brick
+//  auto value = tex3D(bricked_texture<float>::ref_type(tex), coord);
+//
+
+template <typename T>
+class bricked_texture_ref : public texture_params_base<3>
+{
+public:
+
+    using value_type = T;
+    enum { dimensions = 3 };
+
+    // Index table entry of constant bricks
+    enum : uint32_t { Constant = 0xFFFFFFFF };
+
+public:
+
+    bricked_texture_ref() = default;
+
+    size_t width() const { return size_.x; }
+    size_t height() const { return size_.y; }
+    size_t depth() const { return size_.z; }
+
+    vector<3, int> const& size() const { return size_; }
+
+    int brick_size() const { return 1 << brick_shift_; }
+    int brick_shift() const { return brick_shift_; }
+
+    vector<3, int> const& num_bricks() const { return num_bricks_; }
+
+    // Index table entry, Constant or index into the brick pool
+    uint32_t brick_entry(vector<3, int> const& brick) const
+    {
+        return index_[linear_brick_index(brick)];
+    }
+
+    T const* brick_data(uint32_t entry) const
+    {
+        return pool_ + (static_cast<size_t>(entry) << (3 * brick_shift_));
+    }
+
+    T const& constant_value(vector<3, int> const& brick) const
+    {
+        return constants_[linear_brick_index(brick)];
+    }
+
+    // Voxel at (x, y, z), no bounds checking
+    T const& value(int x, int y, int z) const
+    {
+        vector<3, int> brick(x >> brick_shift_, y >> brick_shift_, z >> brick_shift_);
+        size_t b = linear_brick_index(brick);
+        uint32_t entry = index_[b];
+
+        if (entry == Constant)
+        {
+            return constants_[b];
+        }
+
+        int mask = brick_size() - 1;
+        int local = ((((z & mask) << brick_shift_) + (y & mask)) << brick_shift_) + (x & mask);
+
+        return brick_data(entry)[local];
+    }
+
+protected:
+
+    vector<3, int> size_;
+    vector<3, int> num_bricks_;
+    int brick_shift_ = 0;
+
+    uint32_t const* index_ = nullptr;
+    T const* constants_ = nullptr;
+    T const* pool_ = nullptr;
+
+    size_t linear_brick_index(vector<3, int> const& brick) const
+    {
+        return (static_cast<size_t>(brick.z) * num_bricks_.y + brick.y) * num_bricks_.x + brick.x;
+    }
+
+};
+
+
+template <typename T>
+class bricked_texture : public bricked_texture_ref<T>
+{
+public:
+
+    using ref_type = bricked_texture_ref<T>;
+
+public:
+
+    bricked_texture() = default;
+
+    // All bricks are initially constant with value background
+    bricked_texture(size_t w, size_t h, size_t d, size_t brick_size = 16, T const& background = T())
+    {
+        assert(brick_size > 0 && (brick_size & (brick_size - 1)) == 0);
+
+        while ((size_t(1) << this->brick_shift_) < brick_size)
+        {
+            ++this->brick_shift_;
+        }
+
+        this->size_ = vector<3, int>(static_cast<int>(w), static_cast<int>(h), static_cast<int>(d));
+        this->num_bricks_ = vector<3, int>(
+                div_up(this->size_.x, static_cast<int>(brick_size)),
+                div_up(this->size_.y, static_cast<int>(brick_size)),
+                div_up(this->size_.z, static_cast<int>(brick_size))
+                );
+
+        size_t n = static_cast<size_t>(this->num_bricks_.x) * this->num_bricks_.y * this->num_bricks_.z;
+
+        owned_index_.resize(n, ref_type::Constant);
+        owned_constants_.resize(n, background);
+
+        this->set_address_mode(Clamp);
+        this->set_filter_mode(Linear);
+
+        update_pointers();
+    }
+
+    bricked_texture(bricked_texture const& rhs)
+        : ref_type(rhs)
+        , owned_index_(rhs.owned_index_)
+        , owned_constants_(rhs.owned_constants_)
+        , owned_pool_(rhs.owned_pool_)
+        , free_(rhs.free_)
+        , compress_uniform_(rhs.compress_uniform_)
+    {
+        update_pointers();
+    }
+
+    bricked_texture(bricked_texture&& rhs)
+        : ref_type(rhs)
+        , owned_index_(std::move(rhs.owned_index_))
+        , owned_constants_(std::move(rhs.owned_constants_))
+        , owned_pool_(std::move(rhs.owned_pool_))
+        , free_(std::move(rhs.free_))
+        , compress_uniform_(rhs.compress_uniform_)
+    {
+        update_pointers();
+    }
+
+    bricked_texture& operator=(bricked_texture rhs)
+    {
+        ref_type::operator=(rhs);
+        owned_index_ = std::move(rhs.owned_index_);
+        owned_constants_ = std::move(rhs.owned_constants_);
+        owned_pool_ = std::move(rhs.owned_pool_);
+        free_ = std::move(rhs.free_);
+        compress_uniform_ = rhs.compress_uniform_;
+        update_pointers();
+        return *this;
+    }
+
+    // Store bricks whose voxels are all equal as constants (default: true)
+    void set_compress_uniform_bricks(bool compress)
+    {
+        compress_uniform_ = compress;
+    }
+
+    bool get_compress_uniform_bricks() const
+    {
+        return compress_uniform_;
+    }
+
+    // Set brick (bx, by, bz) from brick_size^3 voxels, x varies fastest. Voxels of
+    // bricks at the border that lie outside the texture are ignored
+    void set_brick(size_t bx, size_t by, size_t bz, T const* voxels)
+    {
+        size_t n = size_t(1) << (3 * this->brick_shift_);
+        vector<3, int> brick(static_cast<int>(bx), static_cast<int>(by), static_cast<int>(bz));
+
+        if (compress_uniform_)
+        {
+            vector<3, int> first = brick * this->brick_size();
+            vector<3, int> extent = min(first + this->brick_size(), this->size_) - first;
+
+            if (is_uniform(voxels, extent))
+            {
+                set_constant_brick(bx, by, bz, voxels[0]);
+                return;
+            }
+        }
+
+        size_t b = this->linear_brick_index(brick);
+
+        if (owned_index_[b] == ref_type::Constant)
+        {
+            owned_index_[b] = allocate_brick();
+        }
+
+        std::copy(voxels, voxels + n, owned_pool_.begin() + owned_index_[b] * n);
+    }
+
+    // Set all voxels of brick (bx, by, bz) to value
+    void set_constant_brick(size_t bx, size_t by, size_t bz, T const& value)
+    {
+        vector<3, int> brick(static_cast<int>(bx), static_cast<int>(by), static_cast<int>(bz));
+        size_t b = this->linear_brick_index(brick);
+
+        if (owned_index_[b] != ref_type::Constant)
+        {
+            free_.push_back(owned_index_[b]);
+            owned_index_[b] = ref_type::Constant;
+        }
+
+        owned_constants_[b] = value;
+    }
+
+    // Set all bricks from dense voxel data of size width x height x depth
+    void reset(T const* data)
+    {
+        int bs = this->brick_size();
+        aligned_vector<T> voxels(size_t(1) << (3 * this->brick_shift_));
+
+        for (int bz = 0; bz < this->num_bricks_.z; ++bz)
+        {
+            for (int by = 0; by < this->num_bricks_.y; ++by)
+            {
+                for (int bx = 0; bx < this->num_bricks_.x; ++bx)
+                {
+                    // Voxels outside the texture replicate the border
+                    for (int z = 0; z < bs; ++z)
+                    {
+                        for (int y = 0; y < bs; ++y)
+                        {
+                            for (int x = 0; x < bs; ++x)
+                            {
+                                size_t xx = min(bx * bs + x, this->size_.x - 1);
+                                size_t yy = min(by * bs + y, this->size_.y - 1);
+                                size_t zz = min(bz * bs + z, this->size_.z - 1);
+
+                                voxels[(z * bs + y) * bs + x] = data[(zz * this->size_.y + yy) * this->size_.x + xx];
+                            }
+                        }
+                    }
+
+                    set_brick(bx, by, bz, voxels.data());
+                }
+            }
+        }
+
+        compact();
+    }
+
+    // Release pool memory of bricks that were replaced by constants
+    void compact()
+    {
+        if (free_.empty())
+        {
+            return;
+        }
+
+        size_t n = size_t(1) << (3 * this->brick_shift_);
+        size_t num_dense = owned_pool_.size() / n - free_.size();
+
+        aligned_vector<T> pool(num_dense * n);
+        uint32_t next = 0;
+
+        for (auto& entry : owned_index_)
+        {
+            if (entry != ref_type::Constant)
+            {
+                std::copy(owned_pool_.begin() + entry * n, owned_pool_.begin() + (entry + 1) * n, pool.begin() + next * n);
+                entry = next++;
+            }
+        }
+
+        owned_pool_ = std::move(pool);
+        free_.clear();
+        update_pointers();
+    }
+
+    // Number of bricks stored densely
+    size_t num_dense_bricks() const
+    {
+        return owned_pool_.size() / (size_t(1) << (3 * this->brick_shift_)) - free_.size();
+    }
+
+    // Memory occupied by the brick pool, the index table and the constants
+    size_t size_in_bytes() const
+    {
+        return owned_pool_.size() * sizeof(T) + owned_index_.size() * sizeof(uint32_t) + owned_constants_.size() * sizeof(T);
+    }
+
+private:
+
+    aligned_vector<uint32_t> owned_index_;
+    aligned_vector<T> owned_constants_;
+    aligned_vector<T> owned_pool_;
+
+    // Unused pool bricks
+    std::vector<uint32_t> free_;
+
+    bool compress_uniform_ = true;
+
+    void update_pointers()
+    {
+        this->index_ = owned_index_.data();
+        this->constants_ = owned_constants_.data();
+        this->pool_ = owned_pool_.data();
+    }
+
+    uint32_t allocate_brick()
+    {
+        if (!free_.empty())
+        {
+            uint32_t result = free_.back();
+            free_.pop_back();
+            return result;
+        }
+
+        size_t n = size_t(1) << (3 * this->brick_shift_);
+        uint32_t result = static_cast<uint32_t>(owned_pool_.size() / n);
+
+        owned_pool_.resize(owned_pool_.size() + n);
+        update_pointers();
+
+        return result;
+    }
+
+    // Bitwise comparison of the voxels in [0..extent)
+    bool is_uniform(T const* voxels, vector<3, int> const& extent) const
+    {
+        int bs = this->brick_size();
+
+        for (int z = 0; z < extent.z; ++z)
+        {
+            for (int y = 0; y < extent.y; ++y)
+            {
+                for (int x = 0; x < extent.x; ++x)
+                {
+                    if (std::memcmp(&voxels[(z * bs + y) * bs + x], voxels, sizeof(T)) != 0)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+};
+
+
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Sample a bricked texture
+//
+// If the filter footprint lies within a single brick, the brick is sampled like an
+// ordinary texture of size brick_size^3. Otherwise the footprint is gathered into a
+// block of 4^3 voxels (enough for the cubic filters) that is sampled instead.
+//
+
+template <typename T>
+inline auto tex3D_bricked(bricked_texture_ref<T> const& tex, vector<3, float> const& coord)
+    -> decltype( tex3D_impl_expand_types(
+            std::declval<T const*>(),
+            coord,
+            vector<3, int>(),
+            tex.get_filter_mode(),
+            tex.get_address_mode()
+            ) )
+{
+    auto const& size = tex.size();
+    auto const& address_mode = tex.get_address_mode();
+    auto filter_mode = tex.get_filter_mode();
+
+    std::array<tex_address_mode, 3> const clamp_mode = {{ Clamp, Clamp, Clamp }};
+
+    // Texel space position, clamping like the texture filters do for samples at the edge
+    vector<3, float> texel;
+
+    for (int d = 0; d < 3; ++d)
+    {
+        if (address_mode[d] == Wrap || address_mode[d] == Mirror)
+        {
+            texel[d] = map_tex_coord(coord[d], size[d], address_mode[d]) * size[d];
+        }
+        else
+        {
+            texel[d] = clamp(coord[d] * size[d], 0.5f, size[d] - 0.5f);
+        }
+    }
+
+    // Filter footprint [first..last]
+    vector<3, int> base(floor(texel - 0.5f));
+    vector<3, int> first;
+    vector<3, int> last;
+
+    if (filter_mode == Nearest)
+    {
+        first = min(vector<3, int>(texel), size - 1);
+        last = first;
+    }
+    else if (filter_mode == Linear)
+    {
+        first = base;
+        last = base + 1;
+    }
+    else
+    {
+        first = base - 1;
+        last = base + 2;
+    }
+
+    int shift = tex.brick_shift();
+    vector<3, int> brick(first.x >> shift, first.y >> shift, first.z >> shift);
+
+    if (all(first >= vector<3, int>(0)) && all(last < size)
+     && brick.x == (last.x >> shift) && brick.y == (last.y >> shift) && brick.z == (last.z >> shift))
+    {
+        uint32_t entry = tex.brick_entry(brick);
+
+        if (entry == bricked_texture_ref<T>::Constant)
+        {
+            return tex3D_impl_expand_types(
+                    &tex.constant_value(brick),
+                    vector<3, float>(0.5f),
+                    vector<3, int>(1),
+                    Nearest,
+                    clamp_mode
+                    );
+        }
+
+        int bs = tex.brick_size();
+
+        return tex3D_impl_expand_types(
+                tex.brick_data(entry),
+                (texel - vector<3, float>(brick * bs)) / static_cast<float>(bs),
+                vector<3, int>(bs),
+                filter_mode,
+                clamp_mode
+                );
+    }
+
+    // Gather the footprint relative to base - 1, the filters read no other voxels
+    T block[4 * 4 * 4];
+
+    vector<3, int> origin = base - 1;
+    vector<3, int> lo = first - origin;
+    vector<3, int> hi = last - origin;
+
+    for (int z = lo.z; z <= hi.z; ++z)
+    {
+        int zz = static_cast<int>(map_texel_index(origin.z + z, size.z, address_mode[2]));
+
+        for (int y = lo.y; y <= hi.y; ++y)
+        {
+            int yy = static_cast<int>(map_texel_index(origin.y + y, size.y, address_mode[1]));
+
+            for (int x = lo.x; x <= hi.x; ++x)
+            {
+                int xx = static_cast<int>(map_texel_index(origin.x + x, size.x, address_mode[0]));
+                block[(z * 4 + y) * 4 + x] = tex.value(xx, yy, zz);
+            }
+        }
+    }
+
+    return tex3D_impl_expand_types(
+            static_cast<T const*>(block),
+            (texel - vector<3, float>(origin)) / 4.0f,
+            vector<3, int>(4),
+            filter_mode,
+            clamp_mode
+            );
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Texture access functions
+//
+
+template <typename T>
+inline auto tex3D(bricked_texture_ref<T> const& tex, vector<3, float> const& coord)
+    -> decltype( detail::tex3D_bricked(tex, coord) )
+{
+    return detail::tex3D_bricked(tex, coord);
+}
+
+} // visionaray
+
+#endif // VSNRAY_TEXTURE_BRICKED_TEXTURE_H
@@ -76,6 +76,32 @@ inline vector<Dim, F> map_tex_coord(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Map a texel index outside [0..size) according to the address mode
+//
+
+inline size_t map_texel_index(ptrdiff_t i, ptrdiff_t size, tex_address_mode mode)
+{
+    switch (mode)
+    {
+
+    case Wrap:
+        return static_cast<size_t>(((i % size) + size) % size);
+
+    case Mirror:
+    {
+        ptrdiff_t m = ((i % (2 * size)) + 2 * size) % (2 * size);
+        return static_cast<size_t>(m < size ? m : 2 * size - 1 - m);
+    }
+
+    case Clamp:
+        // fall-through
+    default:
+        return static_cast<size_t>(clamp(i, ptrdiff_t(0), size - 1));
+    }
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Functions to map 1D index to texture coordinates
 //
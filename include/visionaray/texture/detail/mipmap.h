@@ -0,0 +1,185 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_TEXTURE_DETAIL_MIPMAP_H
+#define VSNRAY_TEXTURE_DETAIL_MIPMAP_H 1
+
+#include <cstddef>
+
+#include <visionaray/detail/parallel_for.h>
+#include <visionaray/detail/range.h>
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/math/detail/math.h>
+#include <visionaray/math/vector.h>
+
+#include "texture_common.h"
+
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Mip pyramid layout
+//
+// Level l has size max(1, w >> l) x max(1, h >> l), the pyramid ends with a 1x1 level.
+//
+
+inline size_t mip_level_count(size_t width, size_t height)
+{
+    size_t n = 1;
+
+    while ((width >> n) > 0 || (height >> n) > 0)
+    {
+        ++n;
+    }
+
+    return n;
+}
+
+inline vector<2, size_t> mip_level_size(size_t width, size_t height, size_t level)
+{
+    return vector<2, size_t>(
+            max(size_t(1), width >> level),
+            max(size_t(1), height >> level)
+            );
+}
+
+// Offset of level l > 0 into the mip data (levels 1..n)
+inline size_t mip_level_offset(size_t width, size_t height, size_t level)
+{
+    size_t offset = 0;
+
+    for (size_t l = 1; l < level; ++l)
+    {
+        auto s = mip_level_size(width, height, l);
+        offset += s.x * s.y;
+    }
+
+    return offset;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Texel types are averaged in floating point
+//
+
+template <typename T>
+struct mip_accum_type
+{
+    using type = float;
+};
+
+template <size_t Dim, typename T>
+struct mip_accum_type<vector<Dim, T>>
+{
+    using type = vector<Dim, float>;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Box filter rows [first_row..last_row) of the next mip level
+//
+// Each destination texel averages the source texels it covers. Source levels with odd
+// size are handled by letting the last destination texel cover three texels. sRGB
+// textures are averaged in linear space.
+//
+
+template <typename T>
+inline void downsample_rows(
+        T const*        src,
+        size_t          src_width,
+        size_t          src_height,
+        T*              dst,
+        size_t          dst_width,
+        size_t          dst_height,
+        size_t          first_row,
+        size_t          last_row,
+        tex_color_space color_space
+        )
+{
+    using A = typename mip_accum_type<T>::type;
+
+    for (size_t y = first_row; y != last_row; ++y)
+    {
+        size_t y0 = y * src_height / dst_height;
+        size_t y1 = max(y0 + 1, (y + 1) * src_height / dst_height);
+
+        for (size_t x = 0; x < dst_width; ++x)
+        {
+            size_t x0 = x * src_width / dst_width;
+            size_t x1 = max(x0 + 1, (x + 1) * src_width / dst_width);
+
+            A sum(0.0f);
+
+            for (size_t yy = y0; yy != y1; ++yy)
+            {
+                for (size_t xx = x0; xx != x1; ++xx)
+                {
+                    sum += apply_color_conversion(A(src[yy * src_width + xx]), color_space);
+                }
+            }
+
+            sum /= static_cast<float>((y1 - y0) * (x1 - x0));
+
+            dst[y * dst_width + x] = T(apply_inverse_color_conversion(sum, color_space));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Build mip levels 1..num_levels from level 0
+//
+// Levels are built one after another, the rows of large levels are distributed over
+// the threads of pool. Without a pool, all levels are built by the calling thread.
+//
+
+// Levels smaller than that are built by the calling thread
+static const size_t MinParallelMipTexels = 128 * 128;
+
+template <typename T>
+inline void build_mip_levels(
+        T const*        data,
+        size_t          width,
+        size_t          height,
+        T*              mip_data,
+        size_t          num_levels,
+        tex_color_space color_space,
+        thread_pool*    pool
+        )
+{
+    T const* src = data;
+    auto src_size = mip_level_size(width, height, 0);
+
+    for (size_t l = 1; l < num_levels; ++l)
+    {
+        T* dst = mip_data + mip_level_offset(width, height, l);
+        auto dst_size = mip_level_size(width, height, l);
+
+        if (pool != nullptr && pool->num_threads > 1 && dst_size.x * dst_size.y >= MinParallelMipTexels)
+        {
+            size_t tile_size = div_up(dst_size.y, static_cast<size_t>(pool->num_threads * 4));
+
+            parallel_for(*pool, tiled_range1d<size_t>(0, dst_size.y, tile_size), [&](range1d<size_t> const& r)
+            {
+                downsample_rows(src, src_size.x, src_size.y, dst, dst_size.x, dst_size.y, r.begin(), r.end(), color_space);
+            });
+        }
+        else
+        {
+            downsample_rows(src, src_size.x, src_size.y, dst, dst_size.x, dst_size.y, 0, dst_size.y, color_space);
+        }
+
+        src = dst;
+        src_size = dst_size;
+    }
+}
+
+} // detail
+} // visionaray
+
+#endif // VSNRAY_TEXTURE_DETAIL_MIPMAP_H
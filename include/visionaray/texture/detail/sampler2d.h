@@ -8,6 +8,7 @@
 
 #include <array>
 #include <cstddef>
+#include <cstring>
 #include <type_traits>
 #include <utility>
 
@@ -224,6 +225,292 @@ inline auto tex2D_impl(Tex const& tex, vector<2, FloatT> coord)
             ), tex.get_color_space());
 }
 
+
+
+//-------------------------------------------------------------------------------------------------
+// Sample one mip level, no color conversion
+//
+
+template <typename Tex, typename FloatT>
+inline auto tex2D_level(Tex const& tex, vector<2, FloatT> const& coord, size_t level)
+    -> decltype( tex2D_impl_expand_types(
+            tex.data(),
+            coord,
+            vector<2, decltype(convert_to_int(std::declval<FloatT>()))>(),
+            tex.get_filter_mode(),
+            tex.get_address_mode()
+            ) )
+{
+    using I = simd::int_type_t<FloatT>;
+
+    auto size = tex.level_size(level);
+
+    vector<2, I> texsize(
+            static_cast<int>(size.x),
+            static_cast<int>(size.y)
+            );
+
+    return tex2D_impl_expand_types(
+            tex.level_data(level),
+            coord,
+            texsize,
+            tex.get_filter_mode(),
+            tex.get_address_mode()
+            );
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// tex2DLod() dispatch function
+//
+// Nearest filtering selects the nearest mip level, all other filter modes blend the
+// two levels around lod (trilinear filtering with filter mode Linear).
+//
+
+// non-simd lod
+
+template <
+    typename Tex,
+    typename FloatT,
+    typename = typename std::enable_if<!simd::is_simd_vector<FloatT>::value>::type
+    >
+inline auto tex2D_lod_impl(Tex const& tex, vector<2, FloatT> const& coord, FloatT lod)
+    -> decltype( tex2D_impl(tex, coord) )
+{
+    static_assert(Tex::dimensions == 2, "Incompatible texture type");
+
+    int num_levels = static_cast<int>(tex.num_levels());
+
+    if (num_levels <= 1)
+    {
+        return tex2D_impl(tex, coord);
+    }
+
+    lod = clamp(lod, FloatT(0.0), FloatT(num_levels - 1));
+
+    if (tex.get_filter_mode() == Nearest)
+    {
+        int level = static_cast<int>(lod + FloatT(0.5));
+        return apply_color_conversion(tex2D_level(tex, coord, level), tex.get_color_space());
+    }
+
+    int level = static_cast<int>(lod);
+    FloatT frac = lod - FloatT(level);
+
+    auto result = tex2D_level(tex, coord, level);
+
+    if (frac > FloatT(0.0))
+    {
+        result = lerp(result, tex2D_level(tex, coord, level + 1), frac);
+    }
+
+    return apply_color_conversion(result, tex.get_color_space());
+}
+
+
+// simd lod, lanes may access different levels, each level in use is sampled once
+
+template <
+    typename Tex,
+    typename FloatT,
+    typename = typename std::enable_if<simd::is_simd_vector<FloatT>::value>::type,
+    typename = void
+    >
+inline auto tex2D_lod_impl(Tex const& tex, vector<2, FloatT> const& coord, FloatT lod)
+    -> decltype( tex2D_impl(tex, coord) )
+{
+    static_assert(Tex::dimensions == 2, "Incompatible texture type");
+
+    using I = simd::int_type_t<FloatT>;
+    using return_type = decltype( tex2D_level(tex, coord, 0) );
+
+    int num_levels = static_cast<int>(tex.num_levels());
+
+    if (num_levels <= 1)
+    {
+        return tex2D_impl(tex, coord);
+    }
+
+    lod = clamp(lod, FloatT(0.0), FloatT(static_cast<float>(num_levels - 1)));
+
+    if (tex.get_filter_mode() == Nearest)
+    {
+        lod = floor(lod + FloatT(0.5));
+    }
+
+    FloatT lo = floor(lod);
+    FloatT frac = lod - lo;
+    I level = convert_to_int(lo);
+
+    // Range of levels over all lanes
+    simd::aligned_array_t<I> levels;
+    store(levels, level);
+
+    int first = levels[0];
+    int last = levels[0];
+
+    for (int i = 1; i < simd::num_elements<I>::value; ++i)
+    {
+        first = min(first, levels[i]);
+        last = max(last, levels[i]);
+    }
+
+    return_type result(FloatT(0.0));
+
+    for (int l = first; l <= last + 1 && l < num_levels; ++l)
+    {
+        auto w = select(level == I(l), FloatT(1.0) - frac, FloatT(0.0))
+               + select(level == I(l - 1), frac, FloatT(0.0));
+
+        if (!any(w > FloatT(0.0)))
+        {
+            continue;
+        }
+
+        result += tex2D_level(tex, coord, static_cast<size_t>(l)) * w;
+    }
+
+    return apply_color_conversion(result, tex.get_color_space());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// log2() for level selection, x >= 1
+//
+// Exponent plus a cubic for the mantissa (max. error 0.001, exact for powers of two).
+// That is accurate enough to select a level, std::log2() and longer polynomials add
+// noticeable latency to each lookup.
+//
+
+inline float lod_log2(float x)
+{
+    unsigned bits = 0;
+    std::memcpy(&bits, &x, sizeof(bits));
+
+    float e = static_cast<float>(static_cast<int>(bits >> 23) - 127);
+
+    bits = (bits & 0x007FFFFFU) | 0x3F800000U;
+
+    float m = 0.0f;
+    std::memcpy(&m, &bits, sizeof(m));
+    m -= 1.0f;
+
+    return e + m * (1.4208645f + m * (-0.5772507f + m * 0.1563862f));
+}
+
+template <
+    typename FloatT,
+    typename = typename std::enable_if<simd::is_simd_vector<FloatT>::value>::type
+    >
+inline FloatT lod_log2(FloatT const& x)
+{
+    using I = simd::int_type_t<FloatT>;
+
+    I bits = reinterpret_as_int(x);
+
+    // x >= 1, the arithmetic shift is fine
+    FloatT e = convert_to_float((bits >> 23) - I(127));
+
+    FloatT m = reinterpret_as_float((bits & I(0x007FFFFF)) | I(0x3F800000)) - FloatT(1.0);
+
+    return e + m * (FloatT(1.4208645f) + m * (FloatT(-0.5772507f) + m * FloatT(0.1563862f)));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// tex2DGrad() dispatch function
+//
+// ddx and ddy are the derivatives of the texture coordinates w.r.t. screen space x and
+// y. The level is chosen so that the longer one covers about one texel. Textures with
+// max. anisotropy > 1 are sampled with up to that many probes along the longer axis
+// instead, at the level of the shorter axis (or of longer axis / max. anisotropy).
+//
+
+// Up to max_probes lookups along the major axis of the footprint
+
+template <typename Tex, typename FloatT>
+inline auto tex2D_aniso_impl(
+        Tex const&                  tex,
+        vector<2, FloatT> const&    coord,
+        vector<2, FloatT> const&    ddx,
+        vector<2, FloatT> const&    ddy,
+        FloatT const&               len2_x,
+        FloatT const&               len2_y,
+        int                         max_probes
+        )
+    -> decltype( tex2D_impl(tex, coord) )
+{
+    using return_type = decltype( tex2D_impl(tex, coord) );
+
+    FloatT len_x = sqrt(len2_x);
+    FloatT len_y = sqrt(len2_y);
+
+    FloatT major = max(len_x, len_y);
+    FloatT minor = min(len_x, len_y);
+
+    FloatT num_probes = ceil(major / max(minor, FloatT(1e-6f)));
+    num_probes = clamp(num_probes, FloatT(1.0), FloatT(static_cast<float>(max_probes)));
+
+    FloatT lod = lod_log2(max(major / num_probes, FloatT(1.0)));
+
+    auto major_x = len_x >= len_y;
+    vector<2, FloatT> axis(
+            select(major_x, ddx.x, ddy.x),
+            select(major_x, ddx.y, ddy.y)
+            );
+
+    return_type result(FloatT(0.0));
+
+    for (int i = 0; i < max_probes; ++i)
+    {
+        auto active = FloatT(static_cast<float>(i)) < num_probes;
+
+        if (!any(active))
+        {
+            break;
+        }
+
+        FloatT offset = (FloatT(static_cast<float>(i)) + FloatT(0.5)) / num_probes - FloatT(0.5);
+        FloatT w = select(active, FloatT(1.0) / num_probes, FloatT(0.0));
+
+        result += tex2D_lod_impl(tex, coord + axis * offset, lod) * w;
+    }
+
+    return result;
+}
+
+template <typename Tex, typename FloatT>
+inline auto tex2D_grad_impl(
+        Tex const&                  tex,
+        vector<2, FloatT> const&    coord,
+        vector<2, FloatT> const&    ddx,
+        vector<2, FloatT> const&    ddy
+        )
+    -> decltype( tex2D_impl(tex, coord) )
+{
+    static_assert(Tex::dimensions == 2, "Incompatible texture type");
+
+    vector<2, FloatT> texsize(
+            FloatT(static_cast<float>(static_cast<int>(tex.width()))),
+            FloatT(static_cast<float>(static_cast<int>(tex.height())))
+            );
+
+    vector<2, FloatT> dx = ddx * texsize;
+    vector<2, FloatT> dy = ddy * texsize;
+
+    FloatT len2_x = dot(dx, dx);
+    FloatT len2_y = dot(dy, dy);
+
+    if (tex.get_max_anisotropy() > 1.0f)
+    {
+        int max_probes = static_cast<int>(ceil(tex.get_max_anisotropy()));
+        return tex2D_aniso_impl(tex, coord, ddx, ddy, len2_x, len2_y, max_probes);
+    }
+
+    // log2 of the squared length, avoids the square root
+    return tex2D_lod_impl(tex, coord, FloatT(0.5) * lod_log2(max(max(len2_x, len2_y), FloatT(1.0))));
+}
+
 } // detail
 } // visionaray
 
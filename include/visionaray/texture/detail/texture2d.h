@@ -7,7 +7,11 @@
 #define VSNRAY_TEXTURE_DETAIL_TEXTURE2D_H 1
 
 #include <cstddef>
+#include <thread>
 
+#include <visionaray/detail/thread_pool.h>
+
+#include "mipmap.h"
 #include "texture_common.h"
 
 
@@ -40,6 +44,7 @@ public:
         : Base(rhs)
         , width_(rhs.width())
         , height_(rhs.height())
+        , num_levels_(rhs.num_levels())
     {
     }
 
@@ -62,6 +67,52 @@ public:
     size_t width() const { return width_; }
     size_t height() const { return height_; }
 
+
+    // Mip levels -----------------------------------------
+
+    // Build the mip pyramid from level 0. reset() drops the pyramid, call again
+    // afterwards. Large textures are downsampled with num_threads threads (0 means
+    // one per hardware thread)
+    void build_mipmaps(unsigned num_threads = 0)
+    {
+        unsigned nt = num_threads == 0 ? std::thread::hardware_concurrency() : num_threads;
+
+        if (nt > 1 && (width_ / 2) * (height_ / 2) >= detail::MinParallelMipTexels)
+        {
+            thread_pool pool(nt);
+            build_mipmaps_impl(&pool);
+        }
+        else
+        {
+            build_mipmaps_impl(nullptr);
+        }
+    }
+
+    // Same, with a thread pool owned by the caller, e.g. to share it between textures
+    void build_mipmaps(thread_pool& pool)
+    {
+        build_mipmaps_impl(&pool);
+    }
+
+    // 1 if no mip pyramid was built
+    size_t num_levels() const
+    {
+        return base_type::mip_data() != nullptr ? num_levels_ : 1;
+    }
+
+    vector<2, size_t> level_size(size_t level) const
+    {
+        return detail::mip_level_size(width_, height_, level);
+    }
+
+    value_type const* level_data(size_t level) const
+    {
+        return level == 0
+            ? base_type::data()
+            : base_type::mip_data() + detail::mip_level_offset(width_, height_, level)
+            ;
+    }
+
     operator bool() const
     {
         return static_cast<bool>(static_cast<Base>(*this)) && width_ > 0 && height_ > 0;
@@ -71,6 +122,28 @@ private:
 
     size_t width_;
     size_t height_;
+    size_t num_levels_ = 1;
+
+    void build_mipmaps_impl(thread_pool* pool)
+    {
+        num_levels_ = detail::mip_level_count(width_, height_);
+
+        auto last = detail::mip_level_size(width_, height_, num_levels_ - 1);
+
+        base_type::mip_data_.resize(
+                detail::mip_level_offset(width_, height_, num_levels_ - 1) + last.x * last.y
+                );
+
+        detail::build_mip_levels(
+                base_type::data(),
+                width_,
+                height_,
+                base_type::mip_data_.data(),
+                num_levels_,
+                base_type::get_color_space(),
+                pool
+                );
+    }
 
 };
 
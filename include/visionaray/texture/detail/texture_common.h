@@ -91,12 +91,25 @@ public:
         return normalized_coords_;
     }
 
+    // Max. number of probes along the major axis of the pixel footprint,
+    // only considered by lookups with gradients (tex2DGrad())
+    void set_max_anisotropy(float max_aniso)
+    {
+        max_anisotropy_ = max_aniso;
+    }
+
+    float get_max_anisotropy() const
+    {
+        return max_anisotropy_;
+    }
+
 protected:
 
     std::array<tex_address_mode, Dim> address_mode_;
     tex_filter_mode                   filter_mode_;
     tex_color_space                   color_space_ = RGB;
     bool                              normalized_coords_ = true;
+    float                             max_anisotropy_ = 1.0f;
 
 };
 
@@ -118,9 +131,11 @@ public:
     {
     }
 
+    // Drops the mip levels, they are out of date
     void reset(T const* data)
     {
         std::copy( data, data + data_.size(), data_.begin() );
+        aligned_vector<T>().swap(mip_data_);
     }
 
     void reset(
@@ -175,6 +190,12 @@ public:
         return data_.data();
     }
 
+    // Mip levels 1..n, stored consecutively, nullptr if there are none
+    value_type const* mip_data() const
+    {
+        return mip_data_.data();
+    }
+
     operator bool() const
     {
         return data_.size() != 0;
@@ -183,6 +204,7 @@ public:
 protected:
 
     aligned_vector<T> data_;
+    aligned_vector<T> mip_data_;
 
 };
 
@@ -207,12 +229,15 @@ public:
     texture_ref_base(texture_base<T, Dim> const& tex)
         : base_type(tex)
         , data_(tex.data())
+        , mip_data_(tex.mip_data())
     {
     }
 
+    // Drops the mip levels, they belong to the old data
     void reset(T const* data)
     {
         data_ = data;
+        mip_data_ = nullptr;
     }
 
     T const* data() const
@@ -220,6 +245,11 @@ public:
         return data_;
     }
 
+    T const* mip_data() const
+    {
+        return mip_data_;
+    }
+
     operator bool() const
     {
         return data_ != nullptr;
@@ -228,6 +258,7 @@ public:
 protected:
 
     T const* data_;
+    T const* mip_data_ = nullptr;
 
 };
 
@@ -320,6 +351,52 @@ inline vector<4, T> apply_color_conversion(vector<4, T> const& t, tex_color_spac
     }
 }
 
+template <typename T>
+VSNRAY_FUNC
+inline T apply_inverse_color_conversion(T const& t, tex_color_space const& color_space)
+{
+    VSNRAY_UNUSED(color_space);
+
+    return t;
+}
+
+template <typename T>
+VSNRAY_FUNC
+inline vector<3, T> apply_inverse_color_conversion(vector<3, T> const& t, tex_color_space const& color_space)
+{
+    if (color_space == sRGB)
+    {
+        return vector<3, T>(
+                pow(t.x, T(1.0 / 2.2)),
+                pow(t.y, T(1.0 / 2.2)),
+                pow(t.z, T(1.0 / 2.2))
+                );
+    }
+    else
+    {
+        return t;
+    }
+}
+
+template <typename T>
+VSNRAY_FUNC
+inline vector<4, T> apply_inverse_color_conversion(vector<4, T> const& t, tex_color_space const& color_space)
+{
+    if (color_space == sRGB)
+    {
+        return vector<4, T>(
+                pow(t.x, T(1.0 / 2.2)),
+                pow(t.y, T(1.0 / 2.2)),
+                pow(t.z, T(1.0 / 2.2)),
+                t.w
+                );
+    }
+    else
+    {
+        return t;
+    }
+}
+
 } // visionaray
 
 #endif // VSNRAY_TEXTURE_DETAIL_TEXTURE_COMMON_H
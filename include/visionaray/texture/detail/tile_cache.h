@@ -0,0 +1,428 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_TEXTURE_DETAIL_TILE_CACHE_H
+#define VSNRAY_TEXTURE_DETAIL_TILE_CACHE_H 1
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <visionaray/math/detail/math.h>
+#include <visionaray/math/vector.h>
+#include <visionaray/aligned_vector.h>
+
+#include "../forward.h"
+#include "filter/common.h"
+#include "mipmap.h"
+
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Layout of a tiled texture
+//
+// Each mip level is split into tile_size x tile_size tiles. Tiles are stored with a border
+// of tile_border texels on each side that replicates the neighboring texels according to
+// the address mode, so that any filter can sample a tile without accessing its neighbors.
+//
+
+struct tiled_texture_layout
+{
+    // Cubic filters read two texels to each side
+    enum { tile_border = 2 };
+
+    size_t width = 0;
+    size_t height = 0;
+    size_t num_levels = 1;
+    size_t tile_size = 64;
+    std::array<tex_address_mode, 2> address_mode = {{ Wrap, Wrap }};
+
+    size_t padded_tile_size() const
+    {
+        return tile_size + 2 * tile_border;
+    }
+
+    size_t texels_per_tile() const
+    {
+        return padded_tile_size() * padded_tile_size();
+    }
+
+    vector<2, size_t> level_size(size_t level) const
+    {
+        return detail::mip_level_size(width, height, level);
+    }
+
+    vector<2, size_t> num_tiles(size_t level) const
+    {
+        auto size = level_size(level);
+        return vector<2, size_t>(div_up(size.x, tile_size), div_up(size.y, tile_size));
+    }
+
+    // Index of the first tile of level over all levels
+    size_t first_tile(size_t level) const
+    {
+        size_t result = 0;
+
+        for (size_t l = 0; l < level; ++l)
+        {
+            auto n = num_tiles(l);
+            result += n.x * n.y;
+        }
+
+        return result;
+    }
+
+    size_t total_tiles() const
+    {
+        return first_tile(num_levels);
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Interface to load tiles on demand, e.g. from disk
+//
+
+template <typename T>
+class tile_loader
+{
+public:
+
+    virtual ~tile_loader() = default;
+
+    virtual tiled_texture_layout const& layout() const = 0;
+
+    // Write tile (tile_x, tile_y) of level, including its border, to dst
+    virtual void load_tile(size_t level, size_t tile_x, size_t tile_y, T* dst) = 0;
+};
+
+
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Copy tile (tile_x, tile_y) including its border from a mip level in memory
+//
+
+template <typename T>
+inline void copy_padded_tile(
+        T const*                    level_data,
+        tiled_texture_layout const& layout,
+        size_t                      level,
+        size_t                      tile_x,
+        size_t                      tile_y,
+        T*                          dst
+        )
+{
+    auto size = layout.level_size(level);
+    auto padded = layout.padded_tile_size();
+
+    ptrdiff_t x0 = static_cast<ptrdiff_t>(tile_x * layout.tile_size) - tiled_texture_layout::tile_border;
+    ptrdiff_t y0 = static_cast<ptrdiff_t>(tile_y * layout.tile_size) - tiled_texture_layout::tile_border;
+
+    std::vector<size_t> xx(padded);
+
+    for (size_t x = 0; x < padded; ++x)
+    {
+        xx[x] = map_texel_index(x0 + x, size.x, layout.address_mode[0]);
+    }
+
+    for (size_t y = 0; y < padded; ++y)
+    {
+        T const* row = level_data + map_texel_index(y0 + y, size.y, layout.address_mode[1]) * size.x;
+
+        for (size_t x = 0; x < padded; ++x)
+        {
+            dst[y * padded + x] = row[xx[x]];
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Fixed size cache of texture tiles
+//
+// The cache holds a fixed number of tile slots. A page table maps each tile of the
+// texture to the slot it is resident in (slot + 1), to Loading while a thread loads
+// it, or to 0 if it is not resident.
+//
+// Hits are lock-free: a reader pins the slot, re-checks the page table entry and reads
+// the tile. Misses select a victim slot with the clock algorithm (an approximation of
+// LRU where hits only set a reference bit) under a mutex, and load the tile after the
+// mutex was released, so that misses on different tiles load in parallel. Threads that
+// miss on a tile that is being loaded wait until it is published. Slots that are pinned
+// are never evicted.
+//
+
+template <typename T>
+class tile_cache
+{
+public:
+
+    tile_cache(std::shared_ptr<tile_loader<T>> loader, size_t size_in_bytes)
+        : loader_(loader)
+        , layout_(loader->layout())
+    {
+        size_t tile_bytes = layout_.texels_per_tile() * sizeof(T);
+
+        num_slots_ = max(size_t(1), min(size_in_bytes / tile_bytes, layout_.total_tiles()));
+
+        slots_.resize(num_slots_ * layout_.texels_per_tile());
+
+        page_table_.reset(new std::atomic<uint32_t>[layout_.total_tiles()]);
+        pins_.reset(new std::atomic<uint32_t>[num_slots_]);
+        referenced_.reset(new std::atomic<uint8_t>[num_slots_]);
+        slot_pages_.resize(num_slots_, Empty);
+
+        levels_.resize(layout_.num_levels);
+
+        for (size_t l = 0; l < layout_.num_levels; ++l)
+        {
+            auto size = layout_.level_size(l);
+            levels_[l].size = vector<2, int>(static_cast<int>(size.x), static_cast<int>(size.y));
+            levels_[l].num_tiles_x = layout_.num_tiles(l).x;
+            levels_[l].first_tile = layout_.first_tile(l);
+        }
+
+        for (size_t i = 0; i < layout_.total_tiles(); ++i)
+        {
+            page_table_[i].store(0, std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < num_slots_; ++i)
+        {
+            pins_[i].store(0, std::memory_order_relaxed);
+            referenced_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    tiled_texture_layout const& layout() const
+    {
+        return layout_;
+    }
+
+    size_t num_slots() const
+    {
+        return num_slots_;
+    }
+
+    size_t size_in_bytes() const
+    {
+        return slots_.size() * sizeof(T);
+    }
+
+    // Number of tiles loaded so far
+    size_t num_loads() const
+    {
+        return num_loads_.load(std::memory_order_relaxed);
+    }
+
+    // Make tile resident and pin it, returns the slot index
+    uint32_t acquire(size_t level, size_t tile_x, size_t tile_y)
+    {
+        size_t page = levels_[level].first_tile + tile_y * levels_[level].num_tiles_x + tile_x;
+
+        for (;;)
+        {
+            uint32_t entry = page_table_[page].load(std::memory_order_acquire);
+
+            if (entry == Loading)
+            {
+                std::this_thread::yield();
+            }
+            else if (entry != 0)
+            {
+                uint32_t slot = entry - 1;
+
+                pins_[slot].fetch_add(1);
+
+                // The slot may have been evicted before it was pinned
+                if (page_table_[page].load() == entry)
+                {
+                    if (referenced_[slot].load(std::memory_order_relaxed) == 0)
+                    {
+                        referenced_[slot].store(1, std::memory_order_relaxed);
+                    }
+
+                    return slot;
+                }
+
+                pins_[slot].fetch_sub(1, std::memory_order_release);
+            }
+            else
+            {
+                load(page, level, tile_x, tile_y);
+            }
+        }
+    }
+
+    void release(uint32_t slot)
+    {
+        pins_[slot].fetch_sub(1, std::memory_order_release);
+    }
+
+    T const* slot_data(uint32_t slot) const
+    {
+        return slots_.data() + slot * layout_.texels_per_tile();
+    }
+
+    // Evict all tiles, no tile may be pinned
+    void clear()
+    {
+        std::unique_lock<std::mutex> l(mutex_);
+
+        for (size_t i = 0; i < num_slots_; ++i)
+        {
+            assert(pins_[i].load() == 0);
+
+            if (slot_pages_[i] != Empty)
+            {
+                page_table_[slot_pages_[i]].store(0);
+                slot_pages_[i] = Empty;
+            }
+
+            referenced_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Size of level, e.g. to locate tiles
+    vector<2, int> level_size(size_t level) const
+    {
+        return levels_[level].size;
+    }
+
+private:
+
+    enum : size_t { Empty = size_t(-1) };
+
+    // Page table entry of a tile that is being loaded
+    enum : uint32_t { Loading = uint32_t(-1) };
+
+    struct level_info
+    {
+        vector<2, int> size;
+        size_t num_tiles_x;
+        size_t first_tile;
+    };
+
+    std::shared_ptr<tile_loader<T>> loader_;
+    tiled_texture_layout layout_;
+    std::vector<level_info> levels_;
+
+    size_t num_slots_;
+    aligned_vector<T> slots_;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> page_table_;
+    std::unique_ptr<std::atomic<uint32_t>[]> pins_;
+    std::unique_ptr<std::atomic<uint8_t>[]> referenced_;
+
+    // Guarded by mutex_
+    std::vector<size_t> slot_pages_;
+    size_t clock_hand_ = 0;
+
+    std::atomic<size_t> num_loads_{0};
+    std::mutex mutex_;
+
+    void load(size_t page, size_t level, size_t tile_x, size_t tile_y)
+    {
+        size_t slot = 0;
+
+        // Reserve a slot, it stays pinned until the tile was published
+        {
+            std::unique_lock<std::mutex> l(mutex_);
+
+            // Another thread may have loaded the tile, or be loading it, in the meantime
+            if (page_table_[page].load(std::memory_order_relaxed) != 0)
+            {
+                return;
+            }
+
+            slot = evict();
+
+            pins_[slot].fetch_add(1);
+            slot_pages_[slot] = page;
+            page_table_[page].store(Loading);
+        }
+
+        try
+        {
+            loader_->load_tile(level, tile_x, tile_y, slots_.data() + slot * layout_.texels_per_tile());
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> l(mutex_);
+
+            slot_pages_[slot] = Empty;
+            page_table_[page].store(0);
+            pins_[slot].fetch_sub(1, std::memory_order_release);
+            throw;
+        }
+
+        ++num_loads_;
+
+        referenced_[slot].store(1, std::memory_order_relaxed);
+        page_table_[page].store(static_cast<uint32_t>(slot + 1), std::memory_order_release);
+        pins_[slot].fetch_sub(1, std::memory_order_release);
+    }
+
+    // Find a free slot, requires the mutex
+    size_t evict()
+    {
+        for (size_t n = 1; ; ++n)
+        {
+            size_t slot = clock_hand_;
+            clock_hand_ = (clock_hand_ + 1) % num_slots_;
+
+            if (slot_pages_[slot] == Empty)
+            {
+                return slot;
+            }
+
+            if (referenced_[slot].load(std::memory_order_relaxed) != 0)
+            {
+                referenced_[slot].store(0, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (pins_[slot].load() != 0)
+            {
+                // All slots pinned by other threads, wait until they are released
+                if (n % (2 * num_slots_) == 0)
+                {
+                    std::this_thread::yield();
+                }
+
+                continue;
+            }
+
+            size_t page = slot_pages_[slot];
+
+            page_table_[page].store(0);
+
+            // A reader pinned the slot before seeing the cleared entry, keep it
+            if (pins_[slot].load() != 0)
+            {
+                page_table_[page].store(static_cast<uint32_t>(slot + 1));
+                continue;
+            }
+
+            slot_pages_[slot] = Empty;
+            return slot;
+        }
+    }
+};
+
+} // detail
+} // visionaray
+
+#endif // VSNRAY_TEXTURE_DETAIL_TILE_CACHE_H
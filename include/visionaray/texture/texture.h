@@ -48,6 +48,37 @@ inline auto tex2D(Tex const& tex, vector<2, FloatT> const& coord)
 }
 
 
+// Sample mip level lod, fractional levels are blended
+template <typename Tex, typename FloatT>
+inline auto tex2DLod(Tex const& tex, vector<2, FloatT> const& coord, FloatT const& lod)
+    -> decltype( detail::tex2D_lod_impl(tex, coord, lod) )
+{
+    static_assert(Tex::dimensions == 2, "Incompatible texture type");
+
+    assert(tex.get_normalized_coords() && "Unnormalized coordinates on CPU not implemented yet");
+
+    return detail::tex2D_lod_impl( tex, coord, lod );
+}
+
+
+// Select the mip level from the screen space derivatives of coord
+template <typename Tex, typename FloatT>
+inline auto tex2DGrad(
+        Tex const&                  tex,
+        vector<2, FloatT> const&    coord,
+        vector<2, FloatT> const&    ddx,
+        vector<2, FloatT> const&    ddy
+        )
+    -> decltype( detail::tex2D_grad_impl(tex, coord, ddx, ddy) )
+{
+    static_assert(Tex::dimensions == 2, "Incompatible texture type");
+
+    assert(tex.get_normalized_coords() && "Unnormalized coordinates on CPU not implemented yet");
+
+    return detail::tex2D_grad_impl( tex, coord, ddx, ddy );
+}
+
+
 template <typename Tex, typename FloatT>
 inline auto tex3D(Tex const& tex, vector<3, FloatT> const& coord)
     -> decltype( detail::tex3D_impl(tex, coord) )
@@ -0,0 +1,339 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_TEXTURE_TILED_TEXTURE_H
+#define VSNRAY_TEXTURE_TILED_TEXTURE_H 1
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include <visionaray/math/detail/math.h>
+#include <visionaray/math/vector.h>
+
+#include "detail/tile_cache.h"
+#include "texture.h"
+
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Tiled texture
+//
+// 2D texture whose tiles (and mip level tiles) are loaded on demand by a tile_loader into
+// a cache of fixed size. Resident memory is bounded by the cache size, independent of
+// the size of the texture. Once the cache is full, the least recently used tiles are
+// evicted. Lookups of resident tiles are lock-free.
+//
+// The address mode is part of the tile layout of the loader, filter mode and color space
+// can be set as usual. Tiled textures are sampled with scalar coordinates, get_surface()
+// samples SIMD hit records lane by lane.
+//
+// Example:
+//
+//  auto loader = std::make_shared<texture_tile_loader<T>>(tex);
+//  tiled_texture<T> tiled(loader, 64 * 1024 * 1024);
+//  auto color = tex2D(tiled_texture<T>::ref_type(tiled), coord);
+//
+
+template <typename T>
+class tiled_texture_ref
+{
+public:
+
+    using value_type = T;
+    enum { dimensions = 2 };
+
+public:
+
+    tiled_texture_ref() = default;
+
+    explicit tiled_texture_ref(detail::tile_cache<T>* cache)
+        : cache_(cache)
+    {
+    }
+
+    void set_filter_mode(tex_filter_mode mode)
+    {
+        filter_mode_ = mode;
+    }
+
+    tex_filter_mode get_filter_mode() const
+    {
+        return filter_mode_;
+    }
+
+    void set_color_space(tex_color_space color_space)
+    {
+        color_space_ = color_space;
+    }
+
+    tex_color_space get_color_space() const
+    {
+        return color_space_;
+    }
+
+    std::array<tex_address_mode, 2> const& get_address_mode() const
+    {
+        return cache_->layout().address_mode;
+    }
+
+    bool get_normalized_coords() const
+    {
+        return true;
+    }
+
+    size_t width() const { return cache_->layout().width; }
+    size_t height() const { return cache_->layout().height; }
+    size_t num_levels() const { return cache_->layout().num_levels; }
+
+    detail::tile_cache<T>* cache() const
+    {
+        return cache_;
+    }
+
+protected:
+
+    detail::tile_cache<T>* cache_ = nullptr;
+    tex_filter_mode filter_mode_ = Linear;
+    tex_color_space color_space_ = RGB;
+
+};
+
+
+template <typename T>
+class tiled_texture : public tiled_texture_ref<T>
+{
+public:
+
+    using ref_type = tiled_texture_ref<T>;
+
+public:
+
+    tiled_texture(std::shared_ptr<tile_loader<T>> loader, size_t cache_size_in_bytes)
+        : owned_cache_(new detail::tile_cache<T>(loader, cache_size_in_bytes))
+    {
+        this->cache_ = owned_cache_.get();
+    }
+
+    tiled_texture(tiled_texture&& rhs) = default;
+    tiled_texture& operator=(tiled_texture&& rhs) = default;
+
+    tiled_texture_layout const& layout() const
+    {
+        return owned_cache_->layout();
+    }
+
+    // Memory occupied by resident tiles (the cache is allocated upfront)
+    size_t cache_size_in_bytes() const
+    {
+        return owned_cache_->size_in_bytes();
+    }
+
+    // Number of tiles loaded since construction
+    size_t num_tile_loads() const
+    {
+        return owned_cache_->num_loads();
+    }
+
+    // Evict all tiles, must not be called while rendering
+    void clear_cache()
+    {
+        owned_cache_->clear();
+    }
+
+private:
+
+    std::unique_ptr<detail::tile_cache<T>> owned_cache_;
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Tile loader reading from a texture in memory, e.g. to test or to convert to a file
+//
+
+template <typename T>
+class texture_tile_loader : public tile_loader<T>
+{
+public:
+
+    // Uses all mip levels of tex, tex must outlive the loader
+    explicit texture_tile_loader(texture_ref<T, 2> const& tex, size_t tile_size = 64)
+        : tex_(tex)
+    {
+        layout_.width = tex.width();
+        layout_.height = tex.height();
+        layout_.num_levels = tex.num_levels();
+        layout_.tile_size = tile_size;
+        layout_.address_mode = tex.get_address_mode();
+    }
+
+    tiled_texture_layout const& layout() const
+    {
+        return layout_;
+    }
+
+    void load_tile(size_t level, size_t tile_x, size_t tile_y, T* dst)
+    {
+        detail::copy_padded_tile(tex_.level_data(level), layout_, level, tile_x, tile_y, dst);
+    }
+
+private:
+
+    texture_ref<T, 2> tex_;
+    tiled_texture_layout layout_;
+
+};
+
+
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Sample one level of a tiled texture, no color conversion
+//
+// The tile containing coord is pinned and sampled like an ordinary texture of size
+// padded_tile_size^2. The tile border covers the filter footprint.
+//
+
+template <typename T>
+inline auto tex2D_tiled_level(
+        tiled_texture_ref<T> const& tex,
+        vector<2, float>            coord,
+        size_t                      level
+        )
+    -> decltype( tex2D_impl_expand_types(
+            std::declval<T const*>(),
+            coord,
+            vector<2, int>(),
+            tex.get_filter_mode(),
+            tex.get_address_mode()
+            ) )
+{
+    auto& cache = *tex.cache();
+    auto const& layout = cache.layout();
+
+    auto size = cache.level_size(level);
+    int tile_size = static_cast<int>(layout.tile_size);
+    int padded = static_cast<int>(layout.padded_tile_size());
+
+    // Texel space position, clamping like the texture filters do for samples at the edge
+    vector<2, float> texel;
+
+    for (int d = 0; d < 2; ++d)
+    {
+        if (layout.address_mode[d] == Wrap || layout.address_mode[d] == Mirror)
+        {
+            texel[d] = map_tex_coord(coord[d], size[d], layout.address_mode[d]) * size[d];
+        }
+        else
+        {
+            texel[d] = clamp(coord[d] * size[d], 0.5f, size[d] - 0.5f);
+        }
+    }
+
+    vector<2, int> tile(
+            min(static_cast<int>(texel.x), size.x - 1) / tile_size,
+            min(static_cast<int>(texel.y), size.y - 1) / tile_size
+            );
+
+    vector<2, float> local = (texel - vector<2, float>(tile * tile_size) + float(tiled_texture_layout::tile_border))
+                           / static_cast<float>(padded);
+
+    auto slot = cache.acquire(level, tile.x, tile.y);
+
+    auto result = tex2D_impl_expand_types(
+            cache.slot_data(slot),
+            local,
+            vector<2, int>(padded),
+            tex.get_filter_mode(),
+            std::array<tex_address_mode, 2>{{ Clamp, Clamp }}
+            );
+
+    cache.release(slot);
+
+    return result;
+}
+
+
+// Same as tex2D_lod_impl(), only the levels that are accessed are loaded
+
+template <typename T>
+inline auto tex2D_tiled_lod(tiled_texture_ref<T> const& tex, vector<2, float> const& coord, float lod)
+    -> decltype( tex2D_tiled_level(tex, coord, 0) )
+{
+    int num_levels = static_cast<int>(tex.num_levels());
+
+    lod = clamp(lod, 0.0f, static_cast<float>(num_levels - 1));
+
+    if (tex.get_filter_mode() == Nearest)
+    {
+        int level = static_cast<int>(lod + 0.5f);
+        return apply_color_conversion(tex2D_tiled_level(tex, coord, level), tex.get_color_space());
+    }
+
+    int level = static_cast<int>(lod);
+    float frac = lod - static_cast<float>(level);
+
+    auto result = tex2D_tiled_level(tex, coord, level);
+
+    if (frac > 0.0f)
+    {
+        result = lerp(result, tex2D_tiled_level(tex, coord, level + 1), frac);
+    }
+
+    return apply_color_conversion(result, tex.get_color_space());
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Texture access functions
+//
+
+template <typename T>
+inline auto tex2D(tiled_texture_ref<T> const& tex, vector<2, float> const& coord)
+    -> decltype( detail::tex2D_tiled_level(tex, coord, 0) )
+{
+    return apply_color_conversion(detail::tex2D_tiled_level(tex, coord, 0), tex.get_color_space());
+}
+
+template <typename T>
+inline auto tex2DLod(tiled_texture_ref<T> const& tex, vector<2, float> const& coord, float lod)
+    -> decltype( detail::tex2D_tiled_level(tex, coord, 0) )
+{
+    return detail::tex2D_tiled_lod(tex, coord, lod);
+}
+
+// Isotropic, the level is chosen so that the longer derivative covers about one texel
+template <typename T>
+inline auto tex2DGrad(
+        tiled_texture_ref<T> const& tex,
+        vector<2, float> const&     coord,
+        vector<2, float> const&     ddx,
+        vector<2, float> const&     ddy
+        )
+    -> decltype( detail::tex2D_tiled_level(tex, coord, 0) )
+{
+    vector<2, float> texsize(
+            static_cast<float>(tex.width()),
+            static_cast<float>(tex.height())
+            );
+
+    vector<2, float> dx = ddx * texsize;
+    vector<2, float> dy = ddy * texsize;
+
+    float len2 = max(max(dot(dx, dx), dot(dy, dy)), 1.0f);
+
+    return detail::tex2D_tiled_lod(tex, coord, 0.5f * detail::lod_log2(len2));
+}
+
+} // visionaray
+
+#endif // VSNRAY_TEXTURE_TILED_TEXTURE_H
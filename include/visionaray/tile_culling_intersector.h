@@ -0,0 +1,338 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_TILE_CULLING_INTERSECTOR_H
+#define VSNRAY_TILE_CULLING_INTERSECTOR_H 1
+
+#include <cstddef>
+#include <type_traits>
+
+#include "detail/range.h"
+#include "detail/tags.h"
+#include "math/simd/type_traits.h"
+#include "math/aabb.h"
+#include "math/limits.h"
+#include "math/ray.h"
+#include "math/vector.h"
+#include "bvh.h"
+#include "intersector.h"
+#include "pinhole_camera.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Bundle of rays with a common origin, the directions are bounded by intervals.
+// Directions are scaled so that their projection onto the central view direction
+// is one, the directions of the rays through a screen tile then lie in the convex
+// hull of the four corner directions.
+//
+// Boxes are culled against the whole bundle with interval arithmetic, cf.
+// Boulos et al. (2006): Geometric and Arithmetic Culling Methods for Entire Ray Packets
+//
+
+struct ray_bundle
+{
+    vec3 ori;
+    vec3 view_dir;
+    vec3 dir_min;
+    vec3 dir_max;
+};
+
+// Rays through the pixels of tile r, only pinhole cameras are supported
+template <typename Camera>
+inline bool make_ray_bundle(Camera const& /* */, range2d<int> const& /* */, int /* */, int /* */, ray_bundle& /* */)
+{
+    return false;
+}
+
+inline bool make_ray_bundle(
+        pinhole_camera const&   cam,
+        range2d<int> const&     r,
+        int                     width,
+        int                     height,
+        ray_bundle&             bundle
+        )
+{
+    bundle.ori = cam.eye();
+    bundle.view_dir = normalize(cam.center() - cam.eye());
+    bundle.dir_min = vec3(numeric_limits<float>::max());
+    bundle.dir_max = vec3(numeric_limits<float>::lowest());
+
+    // Jittered samples lie within half a pixel of the pixel centers,
+    // extend the tile by another pixel for robustness
+    float xs[] = { r.rows().begin() - 1.5f, r.rows().end() + 0.5f };
+    float ys[] = { r.cols().begin() - 1.5f, r.cols().end() + 0.5f };
+
+    for (float y : ys)
+    {
+        for (float x : xs)
+        {
+            auto corner = cam.primary_ray(ray{}, x, y, static_cast<float>(width), static_cast<float>(height));
+
+            float s = dot(corner.dir, bundle.view_dir);
+
+            if (s <= 0.0f)
+            {
+                return false;
+            }
+
+            bundle.dir_min = min(bundle.dir_min, corner.dir / s);
+            bundle.dir_max = max(bundle.dir_max, corner.dir / s);
+        }
+    }
+
+    return true;
+}
+
+// Check if any ray of the bundle may intersect the box, tnear is a lower bound
+// for the distance to the box in the parameter space of the scaled directions
+inline bool intersect_bundle(ray_bundle const& bundle, aabb const& box, float& tnear)
+{
+    float tmin = 0.0f;
+    float tmax = numeric_limits<float>::max();
+
+    for (int a = 0; a < 3; ++a)
+    {
+        // No bounds if the direction interval contains zero
+        if (bundle.dir_min[a] <= 0.0f && bundle.dir_max[a] >= 0.0f)
+        {
+            continue;
+        }
+
+        float inv_lo = 1.0f / bundle.dir_max[a];
+        float inv_hi = 1.0f / bundle.dir_min[a];
+
+        float t1 = (box.min[a] - bundle.ori[a]) * inv_lo;
+        float t2 = (box.min[a] - bundle.ori[a]) * inv_hi;
+        float t3 = (box.max[a] - bundle.ori[a]) * inv_lo;
+        float t4 = (box.max[a] - bundle.ori[a]) * inv_hi;
+
+        tmin = max(tmin, min(min(t1, t2), min(t3, t4)));
+        tmax = min(tmax, max(max(t1, t2), max(t3, t4)));
+    }
+
+    tnear = tmin;
+    return tmin <= tmax;
+}
+
+// Check if all rays of a packet belong to the bundle
+template <typename R>
+inline bool contains(ray_bundle const& bundle, R const& r)
+{
+    using T = typename R::scalar_type;
+    using V = vector<3, T>;
+
+    auto s = dot(r.dir, V(bundle.view_dir));
+    auto d = r.dir / s;
+
+    return all( s > T(0.0) )
+        && all( r.ori.x == T(bundle.ori.x) && r.ori.y == T(bundle.ori.y) && r.ori.z == T(bundle.ori.z) )
+        && all( d.x >= T(bundle.dir_min.x) && d.y >= T(bundle.dir_min.y) && d.z >= T(bundle.dir_min.z) )
+        && all( d.x <= T(bundle.dir_max.x) && d.y <= T(bundle.dir_max.y) && d.z <= T(bundle.dir_max.z) );
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Intersector that culls the nodes of a BVH for whole screen tiles
+//
+// Schedulers call cull_tile() once per tile, before the packets of that tile are
+// rendered. The BVH is traversed with a bundle that contains all primary rays of
+// the tile, and the subtrees that the bundle may intersect are recorded front to
+// back (at most MaxRoots of them). Packet traversal then starts at these subtrees
+// instead of at the root node. Tiles that don't see the BVH at all skip traversal.
+//
+// Only ray packets that are contained in the tile's bundle (i.e. primary rays)
+// use the culled subtrees, other rays (shadow rays, secondary rays) traverse the
+// whole BVH. Culling is disabled for cameras other than pinhole_camera.
+//
+// Usage:
+//
+//      tile_culling_intersector<bvh_ref> isect(bvh.ref());
+//      auto sparams = make_sched_params(pixel_sampler::uniform_type{}, cam, rt, isect);
+//      sched.frame(kernel, sparams);
+//
+//-------------------------------------------------------------------------------------------------
+
+template <typename BVH>
+class tile_culling_intersector : public basic_intersector<tile_culling_intersector<BVH>>
+{
+public:
+
+    using base_type = basic_intersector<tile_culling_intersector<BVH>>;
+    using base_type::operator();
+
+    // Schedulers call cull_tile() if this type is present
+    using tile_culling = void;
+
+    enum { MaxRoots = detail::MaxPacketRoots };
+
+public:
+
+    tile_culling_intersector() = default;
+
+    explicit tile_culling_intersector(BVH const& bvh)
+        : bvh_(bvh)
+    {
+    }
+
+    template <typename Camera>
+    void cull_tile(Camera const& cam, range2d<int> const& r, int width, int height)
+    {
+        culled_ = false;
+        num_roots_ = 0;
+
+        if (bvh_.num_nodes() == 0 || !detail::make_ray_bundle(cam, r, width, height, bundle_))
+        {
+            return;
+        }
+
+        culled_ = true;
+
+        float tnear = 0.0f;
+
+        if (!detail::intersect_bundle(bundle_, bvh_.node(0).get_bounds(), tnear))
+        {
+            return;
+        }
+
+        roots_[num_roots_++] = 0;
+
+        // Replace inner nodes by those children that the bundle may intersect,
+        // near child first, for as long as there is room
+        unsigned i = 0;
+
+        while (i < num_roots_)
+        {
+            auto const& node = bvh_.node(roots_[i]);
+
+            if (is_leaf(node))
+            {
+                ++i;
+                continue;
+            }
+
+            unsigned first = node.get_child(0);
+
+            float t1 = 0.0f;
+            float t2 = 0.0f;
+
+            bool b1 = detail::intersect_bundle(bundle_, bvh_.node(first).get_bounds(), t1);
+            bool b2 = detail::intersect_bundle(bundle_, bvh_.node(first + 1).get_bounds(), t2);
+
+            if (b1 && b2)
+            {
+                if (num_roots_ == MaxRoots)
+                {
+                    ++i;
+                    continue;
+                }
+
+                for (unsigned j = num_roots_; j > i + 1; --j)
+                {
+                    roots_[j] = roots_[j - 1];
+                }
+
+                ++num_roots_;
+
+                roots_[i]     = t1 <= t2 ? first : first + 1;
+                roots_[i + 1] = t1 <= t2 ? first + 1 : first;
+            }
+            else if (b1 || b2)
+            {
+                roots_[i] = b1 ? first : first + 1;
+            }
+            else
+            {
+                for (unsigned j = i + 1; j < num_roots_; ++j)
+                {
+                    roots_[j - 1] = roots_[j];
+                }
+
+                --num_roots_;
+            }
+        }
+    }
+
+    // Subtrees that the current tile may intersect, only valid if culled()
+    unsigned const* roots() const { return roots_; }
+    unsigned num_roots() const { return num_roots_; }
+
+    // False if the camera is not supported or no tile was culled yet
+    bool culled() const { return culled_; }
+
+
+    // BVH any hit ----------------------------------------
+
+    template <
+        typename R,
+        typename Cond,
+        typename = typename std::enable_if<simd::is_simd_vector<typename R::scalar_type>::value>::type
+        >
+    auto operator()(
+            detail::any_hit_tag                         /* */,
+            std::integral_constant<size_t, 1>           /* */,
+            R const&                                    ray,
+            BVH const&                                  b,
+            typename R::scalar_type                     max_t,
+            Cond                                        update_cond = Cond()
+            )
+        -> decltype( intersect<detail::AnyHit>(ray, b, std::declval<tile_culling_intersector&>(), max_t, update_cond) )
+    {
+        return intersect_culled<detail::AnyHit>(ray, b, max_t, update_cond);
+    }
+
+
+    // BVH closest hit ------------------------------------
+
+    template <
+        typename R,
+        typename Cond,
+        typename = typename std::enable_if<simd::is_simd_vector<typename R::scalar_type>::value>::type
+        >
+    auto operator()(
+            detail::closest_hit_tag                     /* */,
+            std::integral_constant<size_t, 1>           /* */,
+            R const&                                    ray,
+            BVH const&                                  b,
+            typename R::scalar_type                     max_t,
+            Cond                                        update_cond = Cond()
+            )
+        -> decltype( intersect<detail::ClosestHit>(ray, b, std::declval<tile_culling_intersector&>(), max_t, update_cond) )
+    {
+        return intersect_culled<detail::ClosestHit>(ray, b, max_t, update_cond);
+    }
+
+private:
+
+    BVH bvh_;
+
+    detail::ray_bundle bundle_;
+
+    unsigned roots_[MaxRoots];
+    unsigned num_roots_ = 0;
+
+    bool culled_ = false;
+
+    template <detail::traversal_type Traversal, typename R, typename T, typename Cond>
+    auto intersect_culled(R const& ray, BVH const& b, T max_t, Cond update_cond)
+        -> decltype( intersect<Traversal>(ray, b, std::declval<tile_culling_intersector&>(), max_t, update_cond) )
+    {
+        if (culled_ && b == bvh_ && detail::contains(bundle_, ray))
+        {
+            return detail::intersect_packet<Traversal, 1>(ray, b, *this, roots_, num_roots_, max_t, update_cond);
+        }
+
+        return intersect<Traversal>(ray, b, *this, max_t, update_cond);
+    }
+};
+
+} // visionaray
+
+#endif // VSNRAY_TILE_CULLING_INTERSECTOR_H
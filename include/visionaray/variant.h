@@ -160,6 +160,12 @@ public:
             : nullptr;
     }
 
+    // 1-based index of the stored alternative in Ts...
+    VSNRAY_FUNC unsigned which() const
+    {
+        return type_index_;
+    }
+
 private:
 
     unsigned                        type_index_;
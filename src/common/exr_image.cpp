@@ -73,6 +73,11 @@ static void store_rgba32f(
 }
 #endif // VSNRAY_COMMON_HAVE_OPENEXR
 
+exr_image::exr_image(size_t width, size_t height, pixel_format format, uint8_t const* data)
+    : image_base(width, height, format, data)
+{
+}
+
 bool exr_image::load(std::string const& filename)
 {
 #if VSNRAY_COMMON_HAVE_OPENEXR
@@ -124,4 +129,64 @@ bool exr_image::load(std::string const& filename)
 #endif
 }
 
+bool exr_image::save(std::string const& filename, file_base::save_options const& options)
+{
+#if VSNRAY_COMMON_HAVE_OPENEXR
+    VSNRAY_UNUSED(options);
+
+    if (format_ != PF_RGB32F && format_ != PF_RGBA32F)
+    {
+        std::cerr << "Error: unsupported pixel format\n";
+        return false;
+    }
+
+    try
+    {
+        Imf::Array2D<Imf::Rgba> pixels(height_, width_);
+
+        for (size_t y = 0; y < height_; ++y)
+        {
+            for (size_t x = 0; x < width_; ++x)
+            {
+                vec4 rgba(1.0f);
+
+                if (format_ == PF_RGBA32F)
+                {
+                    rgba = reinterpret_cast<vec4 const*>(data())[y * width_ + x];
+                }
+                else
+                {
+                    rgba.xyz() = reinterpret_cast<vec3 const*>(data())[y * width_ + x];
+                }
+
+                pixels[y][x] = Imf::Rgba(rgba.x, rgba.y, rgba.z, rgba.w);
+            }
+        }
+
+        Imf::RgbaOutputFile file(
+                filename.c_str(),
+                static_cast<int>(width_),
+                static_cast<int>(height_),
+                format_ == PF_RGBA32F ? Imf::WRITE_RGBA : Imf::WRITE_RGB
+                );
+
+        file.setFrameBuffer(&pixels[0][0], 1, width_);
+        file.writePixels(static_cast<int>(height_));
+
+        return true;
+    }
+    catch(Iex::BaseExc& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+
+        return false;
+    }
+#else
+    VSNRAY_UNUSED(filename);
+    VSNRAY_UNUSED(options);
+
+    return false;
+#endif
+}
+
 } // visionaray
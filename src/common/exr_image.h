@@ -6,6 +6,8 @@
 #ifndef VSNRAY_COMMON_EXR_IMAGE_H
 #define VSNRAY_COMMON_EXR_IMAGE_H 1
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "image_base.h"
@@ -17,7 +19,16 @@ class exr_image : public image_base
 {
 public:
 
+    // Default constructor.
+    exr_image() = default;
+
+    // Construct image from width, height, format, and data (data is copied).
+    exr_image(size_t width, size_t height, pixel_format format, uint8_t const* data);
+
     bool load(std::string const& filename);
+
+    // Save exr image, data must be PF_RGB32F or PF_RGBA32F. Options: { tba. }
+    bool save(std::string const& filename, save_options const& options);
 };
 
 } // visionaray
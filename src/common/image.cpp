@@ -273,6 +273,14 @@ bool image::save(std::string const& filename, file_base::save_options const& opt
 
     switch (it)
     {
+#if VSNRAY_COMMON_HAVE_OPENEXR
+    case EXR:
+    {
+        exr_image exr(width(), height(), format(), data());
+        return exr.save(fn, options);
+    }
+#endif // VSNRAY_COMMON_HAVE_OPENEXR
+
 #if VSNRAY_COMMON_HAVE_PNG
     case PNG:
     {
@@ -0,0 +1,167 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_COMMON_MAPPED_FILE_H
+#define VSNRAY_COMMON_MAPPED_FILE_H 1
+
+#include <cstddef>
+#include <string>
+
+#include <visionaray/detail/platform.h>
+
+#if defined(VSNRAY_OS_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// RAII wrapper for read-only memory mapped files
+//
+// Pages are loaded on first access, so opening is cheap even for very large files
+//
+
+class mapped_file
+{
+public:
+
+    mapped_file() = default;
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+   ~mapped_file()
+    {
+        close();
+    }
+
+    // Returns false if the file cannot be opened or is empty
+    bool open(std::string const& filename)
+    {
+        close();
+
+#if defined(VSNRAY_OS_WIN32)
+        file_ = CreateFileA(
+                filename.c_str(),
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr
+                );
+
+        LARGE_INTEGER size;
+
+        if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (mapping_ == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        data_ = static_cast<char const*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        size_ = static_cast<size_t>(size.QuadPart);
+#else
+        fd_ = ::open(filename.c_str(), O_RDONLY);
+
+        struct stat st;
+
+        if (fd_ < 0 || fstat(fd_, &st) != 0 || st.st_size == 0)
+        {
+            close();
+            return false;
+        }
+
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+
+        data_ = addr != MAP_FAILED ? static_cast<char const*>(addr) : nullptr;
+        size_ = static_cast<size_t>(st.st_size);
+#endif
+
+        if (data_ == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+#if defined(VSNRAY_OS_WIN32)
+        if (data_ != nullptr)
+        {
+            UnmapViewOfFile(data_);
+        }
+
+        if (mapping_ != nullptr)
+        {
+            CloseHandle(mapping_);
+        }
+
+        if (file_ != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file_);
+        }
+
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = nullptr;
+#else
+        if (data_ != nullptr)
+        {
+            munmap(const_cast<char*>(data_), size_);
+        }
+
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+        }
+
+        fd_ = -1;
+#endif
+
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    char const* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool good() const { return data_ != nullptr; }
+
+private:
+
+#if defined(VSNRAY_OS_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+
+    char const* data_ = nullptr;
+    size_t size_ = 0;
+
+};
+
+} // visionaray
+
+#endif // VSNRAY_COMMON_MAPPED_FILE_H
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include <visionaray/math/forward.h>
+#include <visionaray/math/indexed_triangle.h>
 #include <visionaray/math/triangle.h>
 #include <visionaray/math/unorm.h>
 #include <visionaray/math/vector.h>
@@ -36,21 +37,25 @@ class model : public file_base
 {
 public:
 
-    using material_type     = sg::obj_material;
-
-    using triangle_type     = basic_triangle<3, float>;
-    using normal_type       = vector<3, float>;
-    using tex_coord_type    = vector<2, float>;
-    using color_type        = vector<3, float>;
-    using texture_type      = texture<vector<4, unorm<8>>, 2>;
-
-    using triangle_list     = aligned_vector<triangle_type>;
-    using normal_list       = aligned_vector<normal_type>;
-    using tex_coord_list    = aligned_vector<tex_coord_type>;
-    using color_list        = aligned_vector<color_type>;
-    using mat_list          = aligned_vector<material_type>;
-    using tex_map           = std::map<std::string, texture_type>;
-    using tex_list          = aligned_vector<typename texture_type::ref_type>;
+    using material_type             = sg::obj_material;
+
+    using triangle_type             = basic_triangle<3, float>;
+    using indexed_triangle_type     = basic_indexed_triangle<float>;
+    using vertex_type               = vector<3, float>;
+    using normal_type               = vector<3, float>;
+    using tex_coord_type            = vector<2, float>;
+    using color_type                = vector<3, float>;
+    using texture_type              = texture<vector<4, unorm<8>>, 2>;
+
+    using triangle_list             = aligned_vector<triangle_type>;
+    using indexed_triangle_list     = aligned_vector<indexed_triangle_type>;
+    using vertex_list               = aligned_vector<vertex_type>;
+    using normal_list               = aligned_vector<normal_type>;
+    using tex_coord_list            = aligned_vector<tex_coord_type>;
+    using color_list                = aligned_vector<color_type>;
+    using mat_list                  = aligned_vector<material_type>;
+    using tex_map                   = std::map<std::string, texture_type>;
+    using tex_list                  = aligned_vector<typename texture_type::ref_type>;
 
 public:
 
@@ -70,17 +75,24 @@ public:
     // Scene graph
     std::shared_ptr<sg::node> scene_graph = nullptr;
 
+    // Set before loading: loaders that support it (obj) store triangles with shared
+    // vertices in indexed_primitives instead of filling primitives. Shading normals
+    // and texture coordinates are then stored per vertex
+    bool load_indexed = false;
+
     // These lists will be filled if the file format is so simple
     // that no scene graph is required (i.e. scene_graph == nullptr)
-    triangle_list   primitives;
-    normal_list     shading_normals;
-    normal_list     geometric_normals;
-    tex_coord_list  tex_coords;
-    color_list      colors;
-    mat_list        materials;
-    tex_map         texture_map;
-    tex_list        textures;
-    aabb            bbox;
+    triangle_list         primitives;
+    indexed_triangle_list indexed_primitives;
+    vertex_list           vertices;
+    normal_list           shading_normals;
+    normal_list           geometric_normals;
+    tex_coord_list        tex_coords;
+    color_list            colors;
+    mat_list              materials;
+    tex_map               texture_map;
+    tex_list              textures;
+    aabb                  bbox;
 };
 
 } // visionaray
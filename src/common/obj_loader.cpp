@@ -7,6 +7,7 @@
 #include <iostream>
 #include <ostream>
 #include <map>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/algorithm/string.hpp>
@@ -132,6 +133,118 @@ static void store_faces(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Store obj faces as indexed triangles, obj vertices with the same position, texture
+// coordinate and normal indices become a single model vertex
+//
+
+struct vertex_key
+{
+    int vertex_index;
+    int tex_coord_index;
+    int normal_index;
+
+    bool operator==(vertex_key const& rhs) const
+    {
+        return vertex_index == rhs.vertex_index
+            && tex_coord_index == rhs.tex_coord_index
+            && normal_index == rhs.normal_index;
+    }
+};
+
+struct vertex_key_hash
+{
+    size_t operator()(vertex_key const& key) const
+    {
+        size_t h = std::hash<int>()(key.vertex_index);
+        h = h * 31 + std::hash<int>()(key.tex_coord_index);
+        h = h * 31 + std::hash<int>()(key.normal_index);
+        return h;
+    }
+};
+
+// Maps obj vertices to model vertices, obj indices are local to a file
+using vertex_map = std::unordered_map<vertex_key, unsigned, vertex_key_hash>;
+
+static unsigned store_vertex(
+        model&                  result,
+        vertex_map&             map,
+        vertex_vector const&    vertices,
+        tex_coord_vector const& tex_coords,
+        normal_vector const&    normals,
+        face_index_t const&     face,
+        vec3 const&             face_normal
+        )
+{
+    vertex_key key = {
+            remap_index(face.vertex_index, static_cast<int>(vertices.size())),
+            face.tex_coord_index ? remap_index(*face.tex_coord_index, static_cast<int>(tex_coords.size())) : -1,
+            face.normal_index ? remap_index(*face.normal_index, static_cast<int>(normals.size())) : -1
+            };
+
+    auto it = map.find(key);
+
+    if (it != map.end())
+    {
+        return it->second;
+    }
+
+    auto index = static_cast<unsigned>(result.vertices.size());
+
+    result.vertices.push_back(vertices[key.vertex_index]);
+    result.tex_coords.push_back(key.tex_coord_index >= 0 ? tex_coords[key.tex_coord_index] : vec2(0.0f));
+    result.shading_normals.push_back(key.normal_index >= 0 ? normals[key.normal_index] : face_normal);
+
+    map.insert({ key, index });
+
+    return index;
+}
+
+static void store_indexed_faces(
+        model&                  result,
+        vertex_map&             map,
+        vertex_vector const&    vertices,
+        tex_coord_vector const& tex_coords,
+        normal_vector const&    normals,
+        face_vector const&      faces
+        )
+{
+    auto vertices_size = static_cast<int>(vertices.size());
+    size_t last = 2;
+    auto i1 = remap_index(faces[0].vertex_index, vertices_size);
+
+    while (last != faces.size())
+    {
+        auto i2 = remap_index(faces[last - 1].vertex_index, vertices_size);
+        auto i3 = remap_index(faces[last].vertex_index, vertices_size);
+
+        vec3 n = cross(vertices[i2] - vertices[i1], vertices[i3] - vertices[i1]);
+
+        if (length(n) == 0.0f)
+        {
+            std::cerr << "Warning: rejecting degenerate triangle: zero-based indices: ("
+                      << i1 << ' ' << i2 << ' ' << i3 << ")\n";
+        }
+        else
+        {
+            n = normalize(n);
+
+            model::indexed_triangle_type tri(
+                    store_vertex(result, map, vertices, tex_coords, normals, faces[0], n),
+                    store_vertex(result, map, vertices, tex_coords, normals, faces[last - 1], n),
+                    store_vertex(result, map, vertices, tex_coords, normals, faces[last], n)
+                    );
+            tri.prim_id = static_cast<unsigned>(result.indexed_primitives.size());
+            tri.geom_id = result.materials.size() == 0 ? 0 : static_cast<unsigned>(result.materials.size() - 1);
+            result.indexed_primitives.push_back(tri);
+            result.geometric_normals.push_back(n);
+        }
+
+        ++last;
+    }
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // aabb of a list of triangles
 //
@@ -311,6 +424,9 @@ void load_obj(std::vector<std::string> const& filenames, model& mod)
 
     size_t geom_id = 0;
 
+    // Indexed triangles store a shading normal per vertex if any file has normals
+    bool has_normals = false;
+
     obj_grammar grammar;
 
     // containers for parsing
@@ -330,6 +446,7 @@ void load_obj(std::vector<std::string> const& filenames, model& mod)
         tex_coord_vector tex_coords;
         normal_vector    normals;
         face_vector      faces;
+        vertex_map       indexed_vertices;
 
         while (it != text.cend())
         {
@@ -479,7 +596,14 @@ void load_obj(std::vector<std::string> const& filenames, model& mod)
             }
             else if ( qi::phrase_parse(it, text.cend(), grammar.r_face, qi::blank, faces) )
             {
-                store_faces(mod, vertices, tex_coords, normals, faces);
+                if (mod.load_indexed)
+                {
+                    store_indexed_faces(mod, indexed_vertices, vertices, tex_coords, normals, faces);
+                }
+                else
+                {
+                    store_faces(mod, vertices, tex_coords, normals, faces);
+                }
             }
             else if ( qi::phrase_parse(it, text.cend(), grammar.r_unhandled, qi::blank) )
             {
@@ -490,6 +614,8 @@ void load_obj(std::vector<std::string> const& filenames, model& mod)
             }
         }
 
+        has_normals |= !normals.empty();
+
         // See that there is a material for each geometry
         for (size_t i = mod.materials.size(); i <= geom_id; ++i)
         {
@@ -503,6 +629,24 @@ void load_obj(std::vector<std::string> const& filenames, model& mod)
         }
     }
 
+    if (mod.load_indexed)
+    {
+        // Without normals in the files the list stays empty (and unallocated) like
+        // for plain triangles, the renderers then shade with geometric normals
+        if (!has_normals)
+        {
+            model::normal_list().swap(mod.shading_normals);
+        }
+
+        // Geometric normals were stored with the triangles
+        for (auto const& v : mod.vertices)
+        {
+            mod.bbox.insert(v);
+        }
+
+        return;
+    }
+
     // Calculate geometric normals
     for (auto const& tri : mod.primitives)
     {
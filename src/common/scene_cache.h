@@ -0,0 +1,442 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_COMMON_SCENE_CACHE_H
+#define VSNRAY_COMMON_SCENE_CACHE_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <list>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <visionaray/texture/texture.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/array_ref.h>
+#include <visionaray/bvh.h>
+
+#include "mapped_file.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Binary scene cache
+//
+// Stores arrays of trivially copyable types (primitives, attributes, materials, BVH nodes,
+// texels, ...) in sections that are identified by a user defined id. The file is memory
+// mapped when opened, section data is used in place and is not parsed or copied. Layout:
+//
+//  char[8]     magic "VSNRSCNC"
+//  uint64[3]   version, key, num sections
+//  uint64[4][] section table: id, element size, element count, offset
+//  ...         section data, each section starts at a multiple of 64 bytes
+//
+// key is chosen by the application (e.g. a hash over the source files and the build
+// options), caches with a different key or version are rejected by open()
+//
+
+static uint64_t const scene_cache_version = 1;
+
+namespace detail
+{
+
+static char const scene_cache_magic[8] = { 'V', 'S', 'N', 'R', 'S', 'C', 'N', 'C' };
+
+static size_t const scene_cache_alignment = 64;
+
+static size_t const scene_cache_header_size = sizeof(scene_cache_magic) + 3 * sizeof(uint64_t);
+
+inline uint64_t scene_cache_align(uint64_t offset)
+{
+    return (offset + scene_cache_alignment - 1) / scene_cache_alignment * scene_cache_alignment;
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Write scene caches
+//
+
+class scene_cache_writer
+{
+public:
+
+    // Append count elements to section id, data must stay valid until write() was called
+    template <typename T>
+    void append(uint64_t id, T const* data, size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Type must be trivially copyable");
+
+        auto& s = get_section(id, sizeof(T));
+        s.count += count;
+        s.chunks.push_back({ reinterpret_cast<char const*>(data), count * sizeof(T) });
+    }
+
+    template <typename Container>
+    void append(uint64_t id, Container const& cont)
+    {
+        append(id, cont.data(), cont.size());
+    }
+
+    // Same as append(), but the writer stores a copy of the data
+    template <typename T>
+    void append_copy(uint64_t id, T const* data, size_t count)
+    {
+        auto bytes = reinterpret_cast<char const*>(data);
+        copies_.emplace_back(bytes, bytes + count * sizeof(T));
+
+        append(id, reinterpret_cast<T const*>(copies_.back().data()), count);
+    }
+
+    // Write to a temporary file first so that readers never map incomplete caches
+    bool write(std::string const& filename, uint64_t key) const
+    {
+        std::string tmp = filename + ".tmp";
+        std::ofstream file(tmp, std::ios::binary);
+
+        if (!file.good())
+        {
+            return false;
+        }
+
+        std::vector<uint64_t> table;
+        uint64_t offset = detail::scene_cache_header_size + sections_.size() * 4 * sizeof(uint64_t);
+
+        for (auto const& s : sections_)
+        {
+            offset = detail::scene_cache_align(offset);
+
+            table.push_back(s.id);
+            table.push_back(s.element_size);
+            table.push_back(s.count);
+            table.push_back(offset);
+
+            offset += s.element_size * s.count;
+        }
+
+        uint64_t header[] = { scene_cache_version, key, sections_.size() };
+
+        file.write(detail::scene_cache_magic, sizeof(detail::scene_cache_magic));
+        file.write(reinterpret_cast<char const*>(header), sizeof(header));
+        file.write(reinterpret_cast<char const*>(table.data()), table.size() * sizeof(uint64_t));
+
+        char const padding[detail::scene_cache_alignment] = {};
+
+        for (size_t i = 0; i < sections_.size(); ++i)
+        {
+            auto pos = static_cast<uint64_t>(file.tellp());
+            file.write(padding, static_cast<std::streamsize>(table[i * 4 + 3] - pos));
+
+            for (auto const& c : sections_[i].chunks)
+            {
+                file.write(c.data, static_cast<std::streamsize>(c.size));
+            }
+        }
+
+        bool good = file.good();
+        file.close();
+
+        std::remove(filename.c_str());
+
+        return good && std::rename(tmp.c_str(), filename.c_str()) == 0;
+    }
+
+private:
+
+    struct chunk
+    {
+        char const* data;
+        size_t size;
+    };
+
+    struct section
+    {
+        uint64_t id;
+        uint64_t element_size;
+        uint64_t count;
+        std::vector<chunk> chunks;
+    };
+
+    std::vector<section> sections_;
+
+    // Data passed to append_copy(), list elements are never relocated
+    std::list<std::vector<char>> copies_;
+
+    section& get_section(uint64_t id, size_t element_size)
+    {
+        for (auto& s : sections_)
+        {
+            if (s.id == id)
+            {
+                assert(s.element_size == element_size);
+                return s;
+            }
+        }
+
+        sections_.push_back({ id, element_size, 0, {} });
+        return sections_.back();
+    }
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Memory mapped scene cache
+//
+
+class scene_cache
+{
+public:
+
+    // Returns false if the file does not exist, is damaged, or has a different version or key
+    bool open(std::string const& filename, uint64_t key)
+    {
+        close();
+
+        if (!file_.open(filename) || file_.size() < detail::scene_cache_header_size)
+        {
+            close();
+            return false;
+        }
+
+        uint64_t header[3];
+        std::memcpy(header, file_.data() + sizeof(detail::scene_cache_magic), sizeof(header));
+
+        uint64_t num_sections = header[2];
+
+        if (std::memcmp(file_.data(), detail::scene_cache_magic, sizeof(detail::scene_cache_magic)) != 0
+         || header[0] != scene_cache_version
+         || header[1] != key
+         || num_sections > (file_.size() - detail::scene_cache_header_size) / (4 * sizeof(uint64_t)))
+        {
+            close();
+            return false;
+        }
+
+        sections_.resize(num_sections);
+
+        for (size_t i = 0; i < sections_.size(); ++i)
+        {
+            auto& s = sections_[i];
+            std::memcpy(
+                    &s,
+                    file_.data() + detail::scene_cache_header_size + i * sizeof(section),
+                    sizeof(section)
+                    );
+
+            if (s.offset % detail::scene_cache_alignment != 0
+             || s.offset > file_.size()
+             || (s.element_size > 0 && s.count > (file_.size() - s.offset) / s.element_size))
+            {
+                close();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        file_.close();
+        sections_.clear();
+    }
+
+    bool good() const
+    {
+        return file_.good();
+    }
+
+    bool has(uint64_t id) const
+    {
+        return find(id) != nullptr;
+    }
+
+    // Section data in the mapped file, empty if there is no section id of type T
+    template <typename T>
+    const_array_ref<T> get(uint64_t id) const
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Type must be trivially copyable");
+
+        auto s = find(id);
+
+        if (s == nullptr || s->element_size != sizeof(T) || s->count == 0)
+        {
+            return {};
+        }
+
+        return { reinterpret_cast<T const*>(file_.data() + s->offset), static_cast<size_t>(s->count) };
+    }
+
+private:
+
+    struct section
+    {
+        uint64_t id;
+        uint64_t element_size;
+        uint64_t count;
+        uint64_t offset;
+    };
+
+    mapped_file file_;
+    std::vector<section> sections_;
+
+    section const* find(uint64_t id) const
+    {
+        for (auto const& s : sections_)
+        {
+            if (s.id == id)
+            {
+                return &s;
+            }
+        }
+
+        return nullptr;
+    }
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// BVHs, stored as primitives (section id), nodes (id + 1) and indices (id + 2)
+//
+
+template <typename PV, typename NV>
+void add_bvh(scene_cache_writer& writer, uint64_t id, bvh_t<PV, NV> const& bvh)
+{
+    writer.append(id,     bvh.primitives());
+    writer.append(id + 1, bvh.nodes());
+}
+
+template <typename PV, typename NV, typename IV>
+void add_bvh(scene_cache_writer& writer, uint64_t id, index_bvh_t<PV, NV, IV> const& bvh)
+{
+    writer.append(id,     bvh.primitives());
+    writer.append(id + 1, bvh.nodes());
+    writer.append(id + 2, bvh.indices());
+}
+
+// References the BVH in the mapped file, the cache must stay open while it is used
+template <typename P, typename N = bvh_node>
+bvh_ref_t<P, N> get_bvh_ref(scene_cache const& cache, uint64_t id)
+{
+    auto prims = cache.get<P>(id);
+    auto nodes = cache.get<N>(id + 1);
+
+    return { prims.begin(), prims.end(), nodes.begin(), nodes.end() };
+}
+
+template <typename P, typename N = bvh_node>
+index_bvh_ref_t<P, N> get_index_bvh_ref(scene_cache const& cache, uint64_t id)
+{
+    auto prims = cache.get<P>(id);
+    auto nodes = cache.get<N>(id + 1);
+    auto indices = cache.get<unsigned>(id + 2);
+
+    return { prims.begin(), prims.end(), nodes.begin(), nodes.end(), indices.begin(), indices.end() };
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// 2D textures, stored as descriptions (section id) and texels (id + 1)
+//
+// Textures that share their texels are stored once, mip levels are not stored
+//
+
+struct scene_cache_texture
+{
+    uint64_t width;
+    uint64_t height;
+    uint64_t address_mode[2];
+    uint64_t filter_mode;
+    uint64_t color_space;
+    uint64_t first_texel;
+};
+
+template <typename T>
+void add_textures(scene_cache_writer& writer, uint64_t id, texture_ref<T, 2> const* textures, size_t count)
+{
+    std::vector<scene_cache_texture> descs(count);
+    std::map<T const*, uint64_t> stored;
+    uint64_t num_texels = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const& tex = textures[i];
+        auto& desc = descs[i];
+
+        bool valid = tex.data() != nullptr;
+
+        desc.width           = valid ? tex.width() : 0;
+        desc.height          = valid ? tex.height() : 0;
+        desc.address_mode[0] = static_cast<uint64_t>(tex.get_address_mode(0));
+        desc.address_mode[1] = static_cast<uint64_t>(tex.get_address_mode(1));
+        desc.filter_mode     = static_cast<uint64_t>(tex.get_filter_mode());
+        desc.color_space     = static_cast<uint64_t>(tex.get_color_space());
+
+        if (!valid)
+        {
+            desc.first_texel = 0;
+            continue;
+        }
+
+        auto it = stored.find(tex.data());
+
+        if (it != stored.end())
+        {
+            desc.first_texel = it->second;
+            continue;
+        }
+
+        desc.first_texel = num_texels;
+        stored.insert({ tex.data(), num_texels });
+
+        writer.append(id + 1, tex.data(), desc.width * desc.height);
+        num_texels += desc.width * desc.height;
+    }
+
+    writer.append_copy(id, descs.data(), descs.size());
+}
+
+// References the texels in the mapped file, the cache must stay open while the textures are used
+template <typename T>
+aligned_vector<texture_ref<T, 2>> get_textures(scene_cache const& cache, uint64_t id)
+{
+    auto descs = cache.get<scene_cache_texture>(id);
+    auto texels = cache.get<T>(id + 1);
+
+    aligned_vector<texture_ref<T, 2>> result;
+
+    for (auto const& desc : descs)
+    {
+        bool valid = desc.width * desc.height > 0
+                  && desc.first_texel <= texels.size()
+                  && desc.width * desc.height <= texels.size() - desc.first_texel;
+
+        texture_ref<T, 2> tex(valid ? desc.width : 0, valid ? desc.height : 0);
+        tex.reset(valid ? texels.data() + desc.first_texel : nullptr);
+        tex.set_address_mode(0, static_cast<tex_address_mode>(desc.address_mode[0]));
+        tex.set_address_mode(1, static_cast<tex_address_mode>(desc.address_mode[1]));
+        tex.set_filter_mode(static_cast<tex_filter_mode>(desc.filter_mode));
+        tex.set_color_space(static_cast<tex_color_space>(desc.color_space));
+
+        result.push_back(tex);
+    }
+
+    return result;
+}
+
+} // visionaray
+
+#endif // VSNRAY_COMMON_SCENE_CACHE_H
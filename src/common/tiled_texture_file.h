@@ -0,0 +1,169 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_COMMON_TILED_TEXTURE_FILE_H
+#define VSNRAY_COMMON_TILED_TEXTURE_FILE_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <visionaray/texture/texture.h>
+#include <visionaray/texture/tiled_texture.h>
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Tiled texture files
+//
+// Stores all mip levels of a 2D texture as padded tiles (see tiled_texture_layout) so that
+// a tiled_texture can load each tile with a single read. Layout:
+//
+//  char[8]     magic "VSNRTTX1"
+//  uint64[7]   texel size, width, height, num levels, tile size, address mode s, t
+//  T[]         padded tiles, level by level and row by row within each level
+//
+
+namespace detail
+{
+
+static char const tiled_texture_magic[8] = { 'V', 'S', 'N', 'R', 'T', 'T', 'X', '1' };
+
+static size_t const tiled_texture_header_size = sizeof(tiled_texture_magic) + 7 * sizeof(uint64_t);
+
+} // detail
+
+
+// Write all mip levels of tex, call tex.build_mipmaps() before to include the pyramid
+template <typename T>
+bool write_tiled_texture_file(std::string const& filename, texture_ref<T, 2> const& tex, size_t tile_size = 64)
+{
+    std::ofstream file(filename, std::ios::binary);
+
+    if (!file.good())
+    {
+        return false;
+    }
+
+    texture_tile_loader<T> loader(tex, tile_size);
+    auto const& layout = loader.layout();
+
+    uint64_t header[] = {
+            sizeof(T),
+            layout.width,
+            layout.height,
+            layout.num_levels,
+            layout.tile_size,
+            static_cast<uint64_t>(layout.address_mode[0]),
+            static_cast<uint64_t>(layout.address_mode[1])
+            };
+
+    file.write(detail::tiled_texture_magic, sizeof(detail::tiled_texture_magic));
+    file.write(reinterpret_cast<char const*>(header), sizeof(header));
+
+    std::vector<T> tile(layout.texels_per_tile());
+
+    for (size_t l = 0; l < layout.num_levels; ++l)
+    {
+        auto num_tiles = layout.num_tiles(l);
+
+        for (size_t y = 0; y < num_tiles.y; ++y)
+        {
+            for (size_t x = 0; x < num_tiles.x; ++x)
+            {
+                loader.load_tile(l, x, y, tile.data());
+                file.write(reinterpret_cast<char const*>(tile.data()), tile.size() * sizeof(T));
+            }
+        }
+    }
+
+    return file.good();
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Load tiles from a tiled texture file
+//
+// The tile cache calls load_tile() from several threads, reads are serialized.
+// load_tile() throws std::runtime_error if the tile cannot be read, e.g. because
+// the file was truncated.
+//
+
+template <typename T>
+class tiled_texture_file_loader : public tile_loader<T>
+{
+public:
+
+    // Returns false if the file cannot be read or stores a different texel type
+    bool open(std::string const& filename)
+    {
+        file_.open(filename, std::ios::binary);
+
+        char magic[sizeof(detail::tiled_texture_magic)];
+        uint64_t header[7];
+
+        file_.read(magic, sizeof(magic));
+        file_.read(reinterpret_cast<char*>(header), sizeof(header));
+
+        if (!file_.good()
+         || std::memcmp(magic, detail::tiled_texture_magic, sizeof(magic)) != 0
+         || header[0] != sizeof(T))
+        {
+            file_.close();
+            return false;
+        }
+
+        layout_.width           = header[1];
+        layout_.height          = header[2];
+        layout_.num_levels      = header[3];
+        layout_.tile_size       = header[4];
+        layout_.address_mode[0] = static_cast<tex_address_mode>(header[5]);
+        layout_.address_mode[1] = static_cast<tex_address_mode>(header[6]);
+
+        return true;
+    }
+
+    tiled_texture_layout const& layout() const
+    {
+        return layout_;
+    }
+
+    void load_tile(size_t level, size_t tile_x, size_t tile_y, T* dst)
+    {
+        size_t tile = layout_.first_tile(level) + tile_y * layout_.num_tiles(level).x + tile_x;
+        size_t tile_bytes = layout_.texels_per_tile() * sizeof(T);
+
+        std::unique_lock<std::mutex> l(mutex_);
+
+        // Reset the error state of a previous read
+        file_.clear();
+
+        file_.seekg(static_cast<std::streamoff>(detail::tiled_texture_header_size + tile * tile_bytes));
+        file_.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(tile_bytes));
+
+        if (!file_.good())
+        {
+            throw std::runtime_error("Error reading tile from tiled texture file");
+        }
+    }
+
+private:
+
+    std::ifstream file_;
+    std::mutex mutex_;
+    tiled_texture_layout layout_;
+
+};
+
+} // visionaray
+
+#endif // VSNRAY_COMMON_TILED_TEXTURE_FILE_H
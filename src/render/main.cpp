@@ -0,0 +1,906 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <common/config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <Support/CmdLine.h>
+#include <Support/CmdLineUtil.h>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/io.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/area_light.h>
+#include <visionaray/array_ref.h>
+#include <visionaray/bvh.h>
+#include <visionaray/cpu_buffer_rt.h>
+#include <visionaray/generic_light.h>
+#include <visionaray/generic_material.h>
+#include <visionaray/intersector.h>
+#include <visionaray/kernels.h>
+#include <visionaray/material.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/point_light.h>
+#include <visionaray/scheduler.h>
+
+#include <common/image.h>
+#include <common/make_materials.h>
+#include <common/model.h>
+#include <common/scene_cache.h>
+#include <common/timer.h>
+
+using namespace visionaray;
+using namespace support;
+
+
+//-------------------------------------------------------------------------------------------------
+// Types
+//
+
+using ray_type                = basic_ray<simd::float4>;
+using primitive_type          = model::triangle_type;
+using indexed_primitive_type  = model::indexed_triangle_type;
+using texture_ref_type        = model::texture_type::ref_type;
+using area_light_type         = area_light<float, primitive_type>;
+using light_type              = generic_light<point_light<float>, area_light_type>;
+using material_type           = generic_material<
+        emissive<float>,
+        glass<float>,
+        matte<float>,
+        mirror<float>,
+        plastic<float>
+        >;
+
+enum algorithm { Simple, Whitted, Pathtracing };
+
+enum bvh_build_strategy
+{
+    Binned = 0, // Binned SAH builder, no spatial splits
+    Split,      // Split BVH, also binned and with SAH
+    LBVH,       // LBVH builder on the CPU
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Command line options
+//
+
+struct options
+{
+    std::set<std::string>   filenames;
+    std::string             output          = "image.png";
+    std::string             camera;
+    std::string             cache;
+    int                     width           = 800;
+    int                     height          = 800;
+    unsigned                spp             = 64;
+    unsigned                bounces         = 0;
+    unsigned                num_threads     = std::thread::hardware_concurrency();
+    algorithm               algo            = Pathtracing;
+    bvh_build_strategy      build_strategy  = Binned;
+    bool                    headlight       = true;
+    bool                    srgb            = true;
+    bool                    indexed         = false;
+};
+
+static bool parse_cmd_line(int argc, char** argv, options& opts)
+{
+    std::vector<std::shared_ptr<cl::OptionBase>> cl_options;
+
+    cl_options.emplace_back( cl::makeOption<std::set<std::string>&>(
+        cl::Parser<>(),
+        "filenames",
+        cl::Desc("Input files in wavefront obj format"),
+        cl::Positional,
+        cl::OneOrMore,
+        cl::init(opts.filenames)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<std::string&>(
+        cl::Parser<>(),
+        "o",
+        cl::Desc("Output image (.exr, .png, .pnm), exr images are written in linear RGB"),
+        cl::ArgRequired,
+        cl::init(opts.output)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<std::string&>(
+        cl::Parser<>(),
+        "camera",
+        cl::Desc("Text file with camera parameters"),
+        cl::ArgRequired,
+        cl::init(opts.camera)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<std::string&>(
+        cl::Parser<>(),
+        "cache",
+        cl::Desc("Scene cache file, written after the BVH was built and memory mapped by later runs"),
+        cl::ArgRequired,
+        cl::init(opts.cache)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<int&>(
+        cl::Parser<>(),
+        "width",
+        cl::Desc("Image width"),
+        cl::ArgRequired,
+        cl::init(opts.width)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<int&>(
+        cl::Parser<>(),
+        "height",
+        cl::Desc("Image height"),
+        cl::ArgRequired,
+        cl::init(opts.height)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<unsigned&>(
+        cl::Parser<>(),
+        "spp",
+        cl::Desc("Number of samples per pixel"),
+        cl::ArgRequired,
+        cl::init(opts.spp)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<unsigned&>(
+        cl::Parser<>(),
+        "bounces",
+        cl::Desc("Number of bounces for recursive ray tracing"),
+        cl::ArgRequired,
+        cl::init(opts.bounces)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<unsigned&>(
+        cl::Parser<>(),
+        "threads",
+        cl::Desc("Number of render threads"),
+        cl::ArgRequired,
+        cl::init(opts.num_threads)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<algorithm&>({
+            { "simple",             Simple,         "Simple ray casting kernel" },
+            { "whitted",            Whitted,        "Whitted style ray tracing kernel" },
+            { "pathtracing",        Pathtracing,    "Pathtracing global illumination kernel" }
+        },
+        "algorithm",
+        cl::Desc("Rendering algorithm"),
+        cl::ArgRequired,
+        cl::init(opts.algo)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<bvh_build_strategy&>({
+            { "default",            Binned,         "Binned SAH" },
+            { "split",              Split,          "Binned SAH with spatial splits" },
+            { "lbvh",               LBVH,           "LBVH (CPU)" }
+        },
+        "bvh",
+        cl::Desc("BVH build strategy"),
+        cl::ArgRequired,
+        cl::init(opts.build_strategy)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<bool&>(
+        cl::Parser<>(),
+        "headlight",
+        cl::Desc("Activate headlight"),
+        cl::ArgRequired,
+        cl::init(opts.headlight)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<bool&>(
+        cl::Parser<>(),
+        "srgb",
+        cl::Desc("Convert to sRGB before writing 8-bit images"),
+        cl::ArgRequired,
+        cl::init(opts.srgb)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<bool&>(
+        cl::Parser<>(),
+        "indexed",
+        cl::Desc("Store triangles with shared vertices (obj files only)"),
+        cl::ArgDisallowed,
+        cl::init(opts.indexed)
+        ) );
+
+    cl::CmdLine cmd;
+
+    for (auto& opt : cl_options)
+    {
+        cmd.add(*opt);
+    }
+
+    try
+    {
+        auto args = std::vector<std::string>(argv + 1, argv + argc);
+        cl::expandWildcards(args);
+        cl::expandResponseFiles(args, cl::TokenizeUnix());
+
+        cmd.parse(args);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        std::cout << cmd.help(argv[0]) << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Map obj material to generic material, same mapping as the viewer
+//
+
+static material_type map_material(sg::obj_material const& mat)
+{
+    if (length(mat.ce) > 0.0f)
+    {
+        emissive<float> em;
+        em.ce() = from_rgb(mat.ce);
+        em.ls() = 1.0f;
+        return em;
+    }
+    else if (mat.illum == 1)
+    {
+        matte<float> ma;
+        ma.ca() = from_rgb(mat.ca);
+        ma.cd() = from_rgb(mat.cd);
+        ma.ka() = 1.0f;
+        ma.kd() = 1.0f;
+        return ma;
+    }
+    else if (mat.illum == 3)
+    {
+        mirror<float> mi;
+        mi.cr() = from_rgb(mat.cs);
+        mi.kr() = 1.0f;
+        mi.ior() = spectrum<float>(0.0f);
+        mi.absorption() = spectrum<float>(0.0f);
+        return mi;
+    }
+    else if (mat.illum == 4 && mat.transmission > 0.0f)
+    {
+        glass<float> gl;
+        gl.ct() = from_rgb(mat.cd);
+        gl.kt() = 1.0f;
+        gl.cr() = from_rgb(mat.cs);
+        gl.kr() = 1.0f;
+        gl.ior() = from_rgb(mat.ior);
+        return gl;
+    }
+    else
+    {
+        plastic<float> pl;
+        pl.ca() = from_rgb(mat.ca);
+        pl.cd() = from_rgb(mat.cd);
+        pl.cs() = from_rgb(mat.cs);
+        pl.ka() = 1.0f;
+        pl.kd() = 1.0f;
+        pl.ks() = 1.0f;
+        pl.specular_exp() = mat.specular_exp;
+        return pl;
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// I/O utility for camera lookat only, same file format as the viewer
+//
+
+std::istream& operator>>(std::istream& in, pinhole_camera& cam)
+{
+    vec3 eye;
+    vec3 center;
+    vec3 up;
+
+    in >> eye >> std::ws >> center >> std::ws >> up >> std::ws;
+
+    if (in)
+    {
+        cam.look_at(eye, center, up);
+    }
+
+    return in;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Scene data, either references the loaded model and the BVH or the mapped scene cache
+//
+
+template <typename Primitive>
+struct scene_data
+{
+    using bvh_type = index_bvh<Primitive>;
+    using bvh_ref  = typename bvh_type::bvh_ref;
+
+    bvh_ref                             bvh;
+    const_array_ref<Primitive>          primitives;
+    const_array_ref<vec3>               vertices; // Indexed triangles only
+    const_array_ref<vec3>               geometric_normals;
+    const_array_ref<vec3>               shading_normals;
+    const_array_ref<vec2>               tex_coords;
+    const_array_ref<material_type>      materials;
+    aligned_vector<texture_ref_type>    textures;
+    aabb                                bbox;
+};
+
+enum cache_section : uint64_t
+{
+    CacheBounds = 0,
+    CacheGeometricNormals,
+    CacheShadingNormals,
+    CacheTexCoords,
+    CacheMaterials,
+    CacheVertices,
+    CacheTextures = 100, // + 1
+    CacheBVH = 200       // + 2
+};
+
+// Hash over the input files and everything else that affects the cached data. Changes to
+// files that are referenced by the input files (e.g. obj material libraries) are not detected
+template <typename Primitive>
+static uint64_t cache_key(options const& opts)
+{
+    // FNV-1a
+    uint64_t key = 14695981039346656037ULL;
+
+    auto hash = [&](void const* data, size_t size)
+    {
+        auto bytes = static_cast<unsigned char const*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            key = (key ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+
+    for (auto const& filename : opts.filenames)
+    {
+        boost::system::error_code ec;
+
+        uint64_t file_size = boost::filesystem::file_size(filename, ec);
+        int64_t write_time = static_cast<int64_t>(boost::filesystem::last_write_time(filename, ec));
+
+        hash(filename.data(), filename.size());
+        hash(&file_size, sizeof(file_size));
+        hash(&write_time, sizeof(write_time));
+    }
+
+    uint64_t layout[] = {
+            static_cast<uint64_t>(opts.build_strategy),
+            static_cast<uint64_t>(opts.indexed),
+            sizeof(Primitive),
+            sizeof(typename scene_data<Primitive>::bvh_type::node_type),
+            sizeof(vec3),
+            sizeof(material_type)
+            };
+
+    hash(layout, sizeof(layout));
+
+    return key;
+}
+
+template <typename Primitive, typename BVH>
+static bool write_cache(std::string const& filename, uint64_t key, scene_data<Primitive> const& scene, BVH const& bvh)
+{
+    scene_cache_writer writer;
+
+    writer.append(CacheBounds, &scene.bbox, 1);
+    writer.append(CacheVertices, scene.vertices);
+    writer.append(CacheGeometricNormals, scene.geometric_normals);
+    writer.append(CacheShadingNormals, scene.shading_normals);
+    writer.append(CacheTexCoords, scene.tex_coords);
+    writer.append(CacheMaterials, scene.materials);
+    add_textures(writer, CacheTextures, scene.textures.data(), scene.textures.size());
+    add_bvh(writer, CacheBVH, bvh);
+
+    return writer.write(filename, key);
+}
+
+// The scene references the mapped file, the cache must stay open while rendering
+template <typename Primitive>
+static bool read_cache(scene_cache const& cache, scene_data<Primitive>& scene)
+{
+    auto bbox = cache.get<aabb>(CacheBounds);
+
+    if (bbox.size() != 1)
+    {
+        return false;
+    }
+
+    scene.bvh               = get_index_bvh_ref<Primitive>(cache, CacheBVH);
+    scene.primitives        = cache.get<Primitive>(CacheBVH);
+    scene.vertices          = cache.get<vec3>(CacheVertices);
+    scene.geometric_normals = cache.get<vec3>(CacheGeometricNormals);
+    scene.shading_normals   = cache.get<vec3>(CacheShadingNormals);
+    scene.tex_coords        = cache.get<vec2>(CacheTexCoords);
+    scene.materials         = cache.get<material_type>(CacheMaterials);
+    scene.textures          = get_textures<texture_ref_type::value_type>(cache, CacheTextures);
+    scene.bbox              = bbox[0];
+
+    return scene.bvh.num_nodes() > 0;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers for triangles and indexed triangles
+//
+
+template <typename Builder>
+static void build_bvh(Builder& builder, model const& mod, index_bvh<primitive_type>& bvh)
+{
+    bvh = builder.build(index_bvh<primitive_type>{}, mod.primitives.data(), mod.primitives.size());
+}
+
+// The builder needs the vertices, the BVH only stores the indices
+template <typename Builder>
+static void build_bvh(Builder& builder, model const& mod, index_bvh<indexed_primitive_type>& bvh)
+{
+    aligned_vector<basic_indexed_triangle_ref<float>> refs;
+    refs.reserve(mod.indexed_primitives.size());
+
+    for (auto const& prim : mod.indexed_primitives)
+    {
+        refs.emplace_back(prim, mod.vertices.data());
+    }
+
+    bvh = builder.build(index_bvh<indexed_primitive_type>{}, refs.data(), refs.size());
+}
+
+static primitive_type get_area_light_triangle(primitive_type const& prim, vec3 const* /* vertices */)
+{
+    return prim;
+}
+
+static primitive_type get_area_light_triangle(indexed_primitive_type const& prim, vec3 const* vertices)
+{
+    return get_triangle(prim, vertices);
+}
+
+static default_intersector make_intersector(scene_data<primitive_type> const& /* scene */)
+{
+    return {};
+}
+
+static indexed_triangle_intersector<float> make_intersector(scene_data<indexed_primitive_type> const& scene)
+{
+    return indexed_triangle_intersector<float>(scene.vertices.data());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Render spp frames and blend them
+//
+
+template <template <typename> class Kernel, typename KParams, typename Intersector, typename RT>
+static void render_frames(
+        KParams const&              kparams,
+        Intersector&                isect,
+        tiled_sched<ray_type>&      sched,
+        pinhole_camera const&       cam,
+        RT&                         rt,
+        unsigned                    spp
+        )
+{
+    Kernel<KParams> kernel;
+    kernel.params = kparams;
+
+    for (unsigned frame = 0; frame < spp; ++frame)
+    {
+        float alpha = 1.0f / (frame + 1);
+
+        pixel_sampler::jittered_blend_type blend_params;
+        blend_params.sfactor = alpha;
+        blend_params.dfactor = 1.0f - alpha;
+
+        sched.frame(kernel, make_sched_params(blend_params, cam, rt, isect));
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Write the color buffer, 8-bit formats are converted to sRGB if requested
+//
+
+template <typename RT>
+static bool write_image(RT const& rt, std::string const& filename, bool srgb)
+{
+    int width  = rt.width();
+    int height = rt.height();
+
+    auto const* color = rt.color();
+
+    std::string ext = boost::filesystem::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    // Flip so that origin is (top|left)
+    if (ext == ".exr")
+    {
+        std::vector<vec4> rgba(width * height);
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                rgba[(height - y - 1) * width + x] = color[y * width + x];
+            }
+        }
+
+        image img(
+            width,
+            height,
+            PF_RGBA32F,
+            reinterpret_cast<uint8_t const*>(rgba.data())
+            );
+
+        return img.save(filename, {});
+    }
+    else
+    {
+        std::vector<vector<3, unorm<8>>> rgb(width * height);
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                vec3 c = clamp(color[y * width + x].xyz(), vec3(0.0f), vec3(1.0f));
+
+                if (srgb)
+                {
+                    c = vec3(powf(c.x, 1 / 2.2f), powf(c.y, 1 / 2.2f), powf(c.z, 1 / 2.2f));
+                }
+
+                rgb[(height - y - 1) * width + x] = vector<3, unorm<8>>(c);
+            }
+        }
+
+        image img(
+            width,
+            height,
+            PF_RGB8,
+            reinterpret_cast<uint8_t const*>(rgb.data())
+            );
+
+        image::save_option opt1({"binary", true});
+        return img.save(filename, {opt1});
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Timing report
+//
+
+struct phase_timings
+{
+    double load         = 0.0;
+    double bvh_build    = 0.0;
+    double cache        = 0.0;
+    double render       = 0.0;
+    double write        = 0.0;
+};
+
+static void print_timings(phase_timings const& t, options const& opts, size_t num_prims, bool cached)
+{
+    double num_samples = static_cast<double>(opts.width) * opts.height * opts.spp;
+    double total = t.load + t.bvh_build + t.cache + t.render + t.write;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Timings:\n";
+    std::cout << "  load      " << std::setw(10) << t.load << " s" << (cached ? " (scene cache)" : "") << '\n';
+
+    if (!cached)
+    {
+        std::cout << "  bvh build " << std::setw(10) << t.bvh_build << " s ("
+                  << num_prims / t.bvh_build * 1e-6 << " Mprims/s)\n";
+    }
+
+    if (!cached && !opts.cache.empty())
+    {
+        std::cout << "  cache     " << std::setw(10) << t.cache << " s\n";
+    }
+
+    std::cout << "  render    " << std::setw(10) << t.render << " s ("
+              << num_samples / t.render * 1e-6 << " Msamples/s, "
+              << opts.spp << " spp)\n";
+    std::cout << "  write     " << std::setw(10) << t.write << " s\n";
+    std::cout << "  total     " << std::setw(10) << total << " s\n";
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Load or map the scene and render it, Primitive is either a triangle or an indexed triangle
+//
+
+template <typename Primitive>
+static int render(options const& opts)
+{
+    phase_timings timings;
+    timer t;
+
+    model mod;
+    mod.load_indexed = opts.indexed;
+
+    typename scene_data<Primitive>::bvh_type bvh;
+    aligned_vector<material_type> materials;
+
+    scene_cache cache;
+    scene_data<Primitive> scene;
+
+    uint64_t key = opts.cache.empty() ? 0 : cache_key<Primitive>(opts);
+    bool cached = !opts.cache.empty() && cache.open(opts.cache, key) && read_cache(cache, scene);
+
+
+    // Map the scene cache, or load the scene and build the BVH
+
+    if (cached)
+    {
+        std::cout << "Mapped scene cache: " << opts.cache << '\n';
+
+        timings.load = t.elapsed();
+    }
+    else
+    {
+        cache.close();
+
+        std::cout << "Loading model...\n";
+
+        if (!mod.load(std::vector<std::string>(opts.filenames.begin(), opts.filenames.end())))
+        {
+            std::cerr << "Failed loading model\n";
+            return EXIT_FAILURE;
+        }
+
+        if (mod.scene_graph != nullptr)
+        {
+            std::cerr << "Scene graph formats are not supported, use a flat format (e.g. obj or ply)\n";
+            return EXIT_FAILURE;
+        }
+
+        timings.load = t.elapsed();
+
+
+        std::cout << "Creating BVH...\n";
+
+        t.reset();
+
+        if (opts.build_strategy == LBVH)
+        {
+            lbvh_builder builder;
+
+            build_bvh(builder, mod, bvh);
+        }
+        else
+        {
+            binned_sah_builder builder;
+            builder.enable_spatial_splits(opts.build_strategy == Split);
+
+            build_bvh(builder, mod, bvh);
+        }
+
+        timings.bvh_build = t.elapsed();
+
+
+        materials = make_materials(
+                material_type{},
+                mod.materials,
+                [](aligned_vector<material_type>& cont, model::material_type mat)
+                {
+                    cont.emplace_back(map_material(mat));
+                }
+                );
+
+        scene.bvh               = bvh.ref();
+        scene.primitives        = { bvh.primitives().data(), bvh.primitives().size() };
+        scene.vertices          = { mod.vertices.data(), mod.vertices.size() };
+        scene.geometric_normals = { mod.geometric_normals.data(), mod.geometric_normals.size() };
+        scene.shading_normals   = { mod.shading_normals.data(), mod.shading_normals.size() };
+        scene.tex_coords        = { mod.tex_coords.data(), mod.tex_coords.size() };
+        scene.materials         = { materials.data(), materials.size() };
+        scene.textures          = mod.textures;
+        scene.bbox              = mod.bbox;
+
+
+        if (!opts.cache.empty())
+        {
+            t.reset();
+
+            if (write_cache(opts.cache, key, scene, bvh))
+            {
+                std::cout << "Scene cache saved to file: " << opts.cache << '\n';
+            }
+            else
+            {
+                std::cerr << "Error saving scene cache to file: " << opts.cache << '\n';
+            }
+
+            timings.cache = t.elapsed();
+        }
+    }
+
+
+    // Lights and camera
+
+    pinhole_camera cam;
+    cam.perspective(
+            45.0f * constants::degrees_to_radians<float>(),
+            opts.width / static_cast<float>(opts.height),
+            0.001f,
+            1000.0f
+            );
+    cam.set_viewport(0, 0, opts.width, opts.height);
+
+    std::ifstream file(opts.camera);
+    if (file.good() && file >> cam)
+    {
+        cam.set_viewport(0, 0, opts.width, opts.height);
+    }
+    else
+    {
+        if (!opts.camera.empty())
+        {
+            std::cerr << "Error reading camera from file: " << opts.camera << ", using default view\n";
+        }
+
+        cam.view_all(scene.bbox);
+    }
+
+    aligned_vector<light_type> lights;
+
+    if (opts.headlight)
+    {
+        point_light<float> headlight;
+        headlight.set_cl(vec3(1.0f, 1.0f, 1.0f));
+        headlight.set_kl(1.0f);
+        headlight.set_position(cam.eye());
+        headlight.set_constant_attenuation(1.0f);
+        headlight.set_linear_attenuation(0.0f);
+        headlight.set_quadratic_attenuation(0.0f);
+        lights.push_back(headlight);
+    }
+
+    // Emissive triangles become area lights
+    for (auto const& prim : scene.primitives)
+    {
+        auto em = scene.materials[prim.geom_id].template as<emissive<float>>();
+
+        if (em != nullptr)
+        {
+            area_light_type light(get_area_light_triangle(prim, scene.vertices.data()));
+            light.set_cl(to_rgb(em->ce()));
+            light.set_kl(em->ls());
+            lights.push_back(light);
+        }
+    }
+
+
+    // Render
+
+    std::cout << "Rendering " << opts.width << 'x' << opts.height << ", " << opts.spp << " spp...\n";
+
+    aligned_vector<typename scene_data<Primitive>::bvh_ref> primitives;
+    primitives.push_back(scene.bvh);
+
+    auto diagonal = scene.bbox.max - scene.bbox.min;
+    auto bounces  = opts.bounces ? opts.bounces : opts.algo == Pathtracing ? 10U : 4U;
+    auto epsilon  = std::max(1E-3f, length(diagonal) * 1E-5f);
+
+    auto kparams = make_kernel_params(
+            normals_per_vertex_binding{},
+            primitives.data(),
+            primitives.data() + primitives.size(),
+            scene.geometric_normals.data(),
+            scene.shading_normals.data(),
+            scene.tex_coords.data(),
+            scene.materials.data(),
+            scene.textures.data(),
+            lights.data(),
+            lights.data() + lights.size(),
+            bounces,
+            epsilon,
+            vec4(0.0f),
+            vec4(0.0f)
+            );
+    kparams.vertices = scene.vertices.data();
+
+    auto isect = make_intersector(scene);
+
+    tiled_sched<ray_type> sched(std::max(1U, opts.num_threads));
+
+    cpu_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(opts.width, opts.height);
+    rt.clear_color_buffer();
+
+    t.reset();
+
+    switch (opts.algo)
+    {
+    case Simple:
+        render_frames<simple::kernel>(kparams, isect, sched, cam, rt, opts.spp);
+        break;
+
+    case Whitted:
+        render_frames<whitted::kernel>(kparams, isect, sched, cam, rt, opts.spp);
+        break;
+
+    case Pathtracing:
+        render_frames<pathtracing::kernel>(kparams, isect, sched, cam, rt, opts.spp);
+        break;
+    }
+
+    timings.render = t.elapsed();
+
+
+    // Write the image
+
+    t.reset();
+
+    if (!write_image(rt, opts.output, opts.srgb))
+    {
+        std::cerr << "Error saving image to file: " << opts.output << '\n';
+        return EXIT_FAILURE;
+    }
+
+    timings.write = t.elapsed();
+
+    std::cout << "Image saved to file: " << opts.output << "\n\n";
+
+    print_timings(timings, opts, scene.primitives.size(), cached);
+
+    return EXIT_SUCCESS;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// main
+//
+
+int main(int argc, char** argv)
+{
+    options opts;
+
+    if (!parse_cmd_line(argc, argv, opts))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (opts.width <= 0 || opts.height <= 0 || opts.spp == 0)
+    {
+        std::cerr << "Image size and number of samples must be positive\n";
+        return EXIT_FAILURE;
+    }
+
+    if (opts.indexed)
+    {
+        return render<indexed_primitive_type>(opts);
+    }
+    else
+    {
+        return render<primitive_type>(opts);
+    }
+}
@@ -46,6 +46,7 @@
 #include <visionaray/aligned_vector.h>
 #include <visionaray/area_light.h>
 #include <visionaray/bvh.h>
+#include <visionaray/distribution_2d.h>
 #include <visionaray/environment_light.h>
 #include <visionaray/generic_material.h>
 #include <visionaray/kernels.h>
@@ -490,6 +491,7 @@ struct renderer : viewer_type
     std::string                                 env_map_filename;
     visionaray::texture<vec4, 2>                env_map;
     host_environment_light                      env_light;
+    distribution_2d                             env_distribution;
 #ifdef __CUDACC__
     visionaray::cuda_texture<vec4, 2>           device_env_map;
     device_environment_light                    device_env_light;
@@ -1434,6 +1436,13 @@ void renderer::build_scene()
 #endif
     }
 
+    // Importance sampling for the environment light (host only)
+    if (env_map)
+    {
+        make_environment_distribution(env_distribution, env_map);
+        env_light.set_distribution(env_distribution.ref());
+    }
+
 //  std::cout << t.elapsed() << std::endl;
 }
 
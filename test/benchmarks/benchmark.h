@@ -0,0 +1,149 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_BENCHMARKS_BENCHMARK_H
+#define VSNRAY_BENCHMARKS_BENCHMARK_H 1
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <common/timer.h>
+
+
+namespace visionaray
+{
+namespace benchmark
+{
+
+//-------------------------------------------------------------------------------------------------
+// Result of a single benchmark
+//
+// Throughput is reported in million items (rays, primitives, texels) per second,
+// computed from the median of the timed repetitions
+//
+
+struct result
+{
+    std::string name;
+    std::string unit;
+    size_t      items   = 0;
+    double      median  = 0.0;
+    double      min     = 0.0;
+    double      max     = 0.0;
+
+    double throughput() const
+    {
+        return median > 0.0 ? items / median * 1e-6 : 0.0;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Passed to the benchmark functions, times the benchmarked code
+//
+
+class state
+{
+public:
+
+    explicit state(std::string name, int repetitions)
+        : repetitions_(repetitions)
+    {
+        result_.name = std::move(name);
+    }
+
+    // Run func once to warm up caches, then time it repetitions times.
+    // Each invocation of func processes num_items items of type unit
+    template <typename Func>
+    void measure(size_t num_items, std::string unit, Func func)
+    {
+        func();
+
+        std::vector<double> times(repetitions_);
+
+        for (auto& t : times)
+        {
+            timer tm;
+            func();
+            t = tm.elapsed();
+        }
+
+        std::sort(times.begin(), times.end());
+
+        result_.unit   = std::move(unit);
+        result_.items  = num_items;
+        result_.median = times[times.size() / 2];
+        result_.min    = times.front();
+        result_.max    = times.back();
+    }
+
+    result const& get_result() const
+    {
+        return result_;
+    }
+
+private:
+
+    int repetitions_;
+    result result_;
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Registry of all benchmarks, benchmarks register themselves during static initialization
+//
+
+struct benchmark_info
+{
+    std::string name;
+    std::function<void(state&)> func;
+};
+
+inline std::vector<benchmark_info>& registry()
+{
+    static std::vector<benchmark_info> benchmarks;
+    return benchmarks;
+}
+
+struct registrar
+{
+    registrar(std::string name, std::function<void(state&)> func)
+    {
+        registry().push_back({ std::move(name), std::move(func) });
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+inline unsigned hardware_threads()
+{
+    return std::max(1U, std::thread::hardware_concurrency());
+}
+
+// Prevent the compiler from optimizing away results that are otherwise unused
+template <typename T>
+inline void do_not_optimize(T const& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile char const* sink;
+    sink = reinterpret_cast<char const volatile*>(&value);
+#endif
+}
+
+} // benchmark
+} // visionaray
+
+#endif // VSNRAY_BENCHMARKS_BENCHMARK_H
@@ -0,0 +1,64 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <string>
+
+#include <visionaray/bvh.h>
+
+#include "benchmark.h"
+#include "scene.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+
+
+//-------------------------------------------------------------------------------------------------
+// BVH construction, reported in million primitives per second
+//
+
+static void enable_spatial_splits(lbvh_builder&, bool)
+{
+}
+
+static void enable_spatial_splits(binned_sah_builder& builder, bool enable)
+{
+    builder.enable_spatial_splits(enable);
+}
+
+template <typename Builder>
+static void build(state& s, aligned_vector<triangle_type> const& triangles, unsigned num_threads, bool spatial_splits = false)
+{
+    Builder builder;
+    builder.set_num_threads(num_threads);
+    enable_spatial_splits(builder, spatial_splits);
+
+    s.measure(triangles.size(), "Mprims/s", [&]()
+    {
+        auto tree = builder.build(index_bvh<triangle_type>{}, triangles.data(), triangles.size());
+        do_not_optimize(tree);
+    });
+}
+
+static aligned_vector<triangle_type> const& terrain()
+{
+    static auto triangles = make_terrain(512);
+    return triangles;
+}
+
+static aligned_vector<triangle_type> const& soup()
+{
+    static auto triangles = make_triangle_soup(500000);
+    return triangles;
+}
+
+
+static registrar reg[] = {
+    { "bvh_build/lbvh/terrain/serial",     [](state& s) { build<lbvh_builder>(s, terrain(), 1); } },
+    { "bvh_build/lbvh/terrain/parallel",   [](state& s) { build<lbvh_builder>(s, terrain(), hardware_threads()); } },
+    { "bvh_build/lbvh/soup/parallel",      [](state& s) { build<lbvh_builder>(s, soup(), hardware_threads()); } },
+    { "bvh_build/sah/terrain/serial",      [](state& s) { build<binned_sah_builder>(s, terrain(), 1); } },
+    { "bvh_build/sah/terrain/parallel",    [](state& s) { build<binned_sah_builder>(s, terrain(), hardware_threads()); } },
+    { "bvh_build/sah/soup/parallel",       [](state& s) { build<binned_sah_builder>(s, soup(), hardware_threads()); } },
+    { "bvh_build/sbvh/soup/parallel",      [](state& s) { build<binned_sah_builder>(s, soup(), hardware_threads(), true); } },
+    };
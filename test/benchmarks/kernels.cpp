@@ -0,0 +1,101 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <string>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/kernels.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+#include <visionaray/tile_culling_intersector.h>
+
+#include "benchmark.h"
+#include "scene.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+
+
+//-------------------------------------------------------------------------------------------------
+// Built-in kernels rendering the terrain scene with tiled_sched, reported in
+// million primary rays (i.e. samples) per second
+//
+
+template <typename T, template <typename> class Kernel>
+static void render(state& s)
+{
+    auto& scene = get_kernel_scene();
+    auto kparams = scene.kernel_params();
+
+    Kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    tiled_sched<basic_ray<T>> sched(hardware_threads());
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(scene.width, scene.height);
+
+    auto sparams = make_sched_params(pixel_sampler::jittered_blend_type{}, scene.cam, rt);
+
+    s.measure(scene.width * scene.height, "Mrays/s", [&]()
+    {
+        sched.frame(kernel, sparams);
+    });
+}
+
+// Same with BVH nodes culled per screen tile
+template <typename T, template <typename> class Kernel>
+static void render_tile_culling(state& s)
+{
+    auto& scene = get_kernel_scene();
+    auto kparams = scene.kernel_params();
+
+    Kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    tiled_sched<basic_ray<T>> sched(hardware_threads());
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(scene.width, scene.height);
+
+    tile_culling_intersector<kernel_scene::bvh_ref> isect(scene.tree.ref());
+
+    auto sparams = make_sched_params(pixel_sampler::jittered_blend_type{}, scene.cam, rt, isect);
+
+    s.measure(scene.width * scene.height, "Mrays/s", [&]()
+    {
+        sched.frame(kernel, sparams);
+    });
+}
+
+
+#define VSNRAY_KERNEL_BENCHMARKS(T)                                                                         \
+    { "kernels/simple/" #T,             [](state& s) { render<T, simple::kernel>(s); } },                   \
+    { "kernels/whitted/" #T,            [](state& s) { render<T, whitted::kernel>(s); } },                  \
+    { "kernels/pathtracing/" #T,        [](state& s) { render<T, pathtracing::kernel>(s); } }
+
+// The wavefront path tracer requires SIMD rays
+#define VSNRAY_WAVEFRONT_BENCHMARKS(T)                                                                      \
+    { "kernels/pathtracing_wavefront/" #T, [](state& s) { render<T, pathtracing::wavefront_kernel>(s); } }
+
+#define VSNRAY_TILE_CULLING_BENCHMARKS(T)                                                                   \
+    { "kernels/simple_tile_culling/" #T, [](state& s) { render_tile_culling<T, simple::kernel>(s); } },     \
+    { "kernels/whitted_tile_culling/" #T, [](state& s) { render_tile_culling<T, whitted::kernel>(s); } }
+
+using simd::float4;
+using simd::float8;
+using simd::float16;
+
+static registrar reg[] = {
+    VSNRAY_KERNEL_BENCHMARKS(float),
+    VSNRAY_KERNEL_BENCHMARKS(float4),
+    VSNRAY_KERNEL_BENCHMARKS(float8),
+    VSNRAY_KERNEL_BENCHMARKS(float16),
+    VSNRAY_WAVEFRONT_BENCHMARKS(float4),
+    VSNRAY_WAVEFRONT_BENCHMARKS(float8),
+    VSNRAY_WAVEFRONT_BENCHMARKS(float16),
+    VSNRAY_TILE_CULLING_BENCHMARKS(float4),
+    VSNRAY_TILE_CULLING_BENCHMARKS(float8),
+    };
@@ -0,0 +1,265 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <Support/CmdLine.h>
+#include <Support/CmdLineUtil.h>
+
+#include <visionaray/math/simd/intrinsics.h>
+#include <visionaray/version.h>
+
+#include "benchmark.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+using namespace support;
+
+
+//-------------------------------------------------------------------------------------------------
+// Command line
+//
+
+struct options
+{
+    std::vector<std::string> filters;
+    std::string json_file;
+    int repetitions = 5;
+    bool list = false;
+};
+
+static bool parse_cmd_line(int argc, char** argv, options& opts)
+{
+    std::vector<std::shared_ptr<cl::OptionBase>> cl_options;
+
+    cl_options.emplace_back( cl::makeOption<std::vector<std::string>&>(
+        cl::Parser<>(),
+        "filter",
+        cl::Desc("Only run benchmarks whose name contains the given string, may be repeated"),
+        cl::ArgRequired,
+        cl::ZeroOrMore,
+        cl::init(opts.filters)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<std::string&>(
+        cl::Parser<>(),
+        "json",
+        cl::Desc("Write results to file in JSON format"),
+        cl::ArgRequired,
+        cl::init(opts.json_file)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<int&>(
+        cl::Parser<>(),
+        "repetitions",
+        cl::Desc("Number of timed runs per benchmark"),
+        cl::ArgRequired,
+        cl::init(opts.repetitions)
+        ) );
+
+    cl_options.emplace_back( cl::makeOption<bool&>(
+        cl::Parser<>(),
+        "list",
+        cl::Desc("List benchmarks and exit"),
+        cl::ArgDisallowed,
+        cl::init(opts.list)
+        ) );
+
+    cl::CmdLine cmd;
+
+    for (auto& opt : cl_options)
+    {
+        cmd.add(*opt);
+    }
+
+    try
+    {
+        auto args = std::vector<std::string>(argv + 1, argv + argc);
+        cl::expandResponseFiles(args, cl::TokenizeUnix());
+
+        cmd.parse(args);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        std::cout << cmd.help(argv[0]) << '\n';
+        return false;
+    }
+
+    opts.repetitions = std::max(1, opts.repetitions);
+
+    return true;
+}
+
+static bool matches(std::string const& name, std::vector<std::string> const& filters)
+{
+    if (filters.empty())
+    {
+        return true;
+    }
+
+    for (auto const& f : filters)
+    {
+        if (name.find(f) != std::string::npos)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Output
+//
+
+static char const* simd_isa()
+{
+#if VSNRAY_SIMD_ISA_GE(VSNRAY_SIMD_ISA_AVX512F)
+    return "AVX512F";
+#elif VSNRAY_SIMD_ISA_GE(VSNRAY_SIMD_ISA_AVX2)
+    return "AVX2";
+#elif VSNRAY_SIMD_ISA_GE(VSNRAY_SIMD_ISA_AVX)
+    return "AVX";
+#elif VSNRAY_SIMD_ISA_GE(VSNRAY_SIMD_ISA_SSE2)
+    return "SSE";
+#elif VSNRAY_SIMD_ISA_GE(VSNRAY_SIMD_ISA_NEON)
+    return "NEON";
+#else
+    return "none";
+#endif
+}
+
+static std::string json_escape(std::string const& str)
+{
+    std::string result;
+
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+        }
+
+        result += c;
+    }
+
+    return result;
+}
+
+static bool write_json(std::string const& filename, std::vector<result> const& results)
+{
+    std::ofstream file(filename);
+
+    if (!file.good())
+    {
+        return false;
+    }
+
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    file << std::setprecision(9);
+
+    file << "{\n";
+    file << "  \"version\": \"" << VSNRAY_VERSION_MAJOR << '.' << VSNRAY_VERSION_MINOR << '.' << VSNRAY_VERSION_PATCH << "\",\n";
+    file << "  \"date\": \"" << date << "\",\n";
+    file << "  \"simd_isa\": \"" << simd_isa() << "\",\n";
+    file << "  \"hardware_threads\": " << hardware_threads() << ",\n";
+    file << "  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        auto const& r = results[i];
+
+        file << "    {\n";
+        file << "      \"name\": \"" << json_escape(r.name) << "\",\n";
+        file << "      \"unit\": \"" << r.unit << "\",\n";
+        file << "      \"items\": " << r.items << ",\n";
+        file << "      \"median_seconds\": " << r.median << ",\n";
+        file << "      \"min_seconds\": " << r.min << ",\n";
+        file << "      \"max_seconds\": " << r.max << ",\n";
+        file << "      \"throughput\": " << r.throughput() << "\n";
+        file << "    }" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+
+    file << "  ]\n";
+    file << "}\n";
+
+    return file.good();
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// main
+//
+
+int main(int argc, char** argv)
+{
+    options opts;
+
+    if (!parse_cmd_line(argc, argv, opts))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (opts.list)
+    {
+        for (auto const& b : registry())
+        {
+            std::cout << b.name << '\n';
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "SIMD ISA: " << simd_isa() << ", hardware threads: " << hardware_threads() << "\n\n";
+    std::cout << std::left << std::setw(48) << "Benchmark"
+              << std::right << std::setw(14) << "Median [ms]"
+              << std::setw(14) << "Min [ms]"
+              << std::setw(20) << "Throughput" << '\n';
+    std::cout << std::string(96, '-') << '\n';
+
+    std::vector<result> results;
+
+    for (auto const& b : registry())
+    {
+        if (!matches(b.name, opts.filters))
+        {
+            continue;
+        }
+
+        state s(b.name, opts.repetitions);
+        b.func(s);
+
+        auto const& r = s.get_result();
+        results.push_back(r);
+
+        std::cout << std::left << std::setw(48) << r.name
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(14) << r.median * 1000.0
+                  << std::setw(14) << r.min * 1000.0
+                  << std::setw(11) << r.throughput() << ' ' << std::left << r.unit
+                  << std::right << std::endl;
+    }
+
+    if (!opts.json_file.empty() && !write_json(opts.json_file, results))
+    {
+        std::cerr << "Cannot write " << opts.json_file << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,337 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_BENCHMARKS_SCENE_H
+#define VSNRAY_BENCHMARKS_SCENE_H 1
+
+#include <cmath>
+#include <cstddef>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/kernels.h>
+#include <visionaray/material.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/point_light.h>
+#include <visionaray/random_generator.h>
+
+
+namespace visionaray
+{
+namespace benchmark
+{
+
+//-------------------------------------------------------------------------------------------------
+// Procedural scenes
+//
+// All scenes are generated from fixed seeds, so that results are comparable
+// between runs, machines and releases
+//
+
+using triangle_type = basic_triangle<3, float>;
+
+
+// Heightfield with n x n quads over [-1,1]^2, 2n^2 triangles -----
+
+inline vec3 terrain_vertex(int n, int i, int j)
+{
+    float x = i / static_cast<float>(n) * 2.0f - 1.0f;
+    float z = j / static_cast<float>(n) * 2.0f - 1.0f;
+
+    return vec3(
+            x,
+            0.15f * std::sin(7.0f * x) * std::cos(5.0f * z)
+                + 0.05f * std::sin(23.0f * x + 17.0f * z)
+                + 0.02f * std::cos(61.0f * z - 37.0f * x),
+            z
+            );
+}
+
+inline aligned_vector<triangle_type> make_terrain(int n)
+{
+    auto height = [n](int i, int j)
+    {
+        return terrain_vertex(n, i, j);
+    };
+
+    aligned_vector<triangle_type> triangles;
+    triangles.reserve(2 * n * n);
+
+    for (int j = 0; j < n; ++j)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            vec3 v00 = height(i,     j);
+            vec3 v10 = height(i + 1, j);
+            vec3 v01 = height(i,     j + 1);
+            vec3 v11 = height(i + 1, j + 1);
+
+            triangles.emplace_back(v00, v01 - v00, v11 - v00);
+            triangles.emplace_back(v00, v11 - v00, v10 - v00);
+        }
+    }
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i].prim_id = static_cast<unsigned>(i);
+        triangles[i].geom_id = 0;
+    }
+
+    return triangles;
+}
+
+
+// Same heightfield with (n+1)^2 shared vertices ----------
+
+inline aligned_vector<basic_indexed_triangle<float>> make_indexed_terrain(int n, aligned_vector<vec3>& vertices)
+{
+    vertices.resize((n + 1) * (n + 1));
+
+    for (int j = 0; j <= n; ++j)
+    {
+        for (int i = 0; i <= n; ++i)
+        {
+            vertices[j * (n + 1) + i] = terrain_vertex(n, i, j);
+        }
+    }
+
+    auto index = [n](int i, int j)
+    {
+        return static_cast<unsigned>(j * (n + 1) + i);
+    };
+
+    aligned_vector<basic_indexed_triangle<float>> triangles;
+    triangles.reserve(2 * n * n);
+
+    for (int j = 0; j < n; ++j)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            triangles.emplace_back(index(i, j), index(i, j + 1), index(i + 1, j + 1));
+            triangles.emplace_back(index(i, j), index(i + 1, j + 1), index(i + 1, j));
+        }
+    }
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i].prim_id = static_cast<unsigned>(i);
+        triangles[i].geom_id = 0;
+    }
+
+    return triangles;
+}
+
+// Small random triangles distributed in [-1,1]^3 ---------
+
+inline aligned_vector<triangle_type> make_triangle_soup(size_t count, unsigned seed = 0)
+{
+    random_generator<float> gen(seed);
+
+    auto rand = [&](float lo, float hi) { return lo + gen.next() * (hi - lo); };
+
+    aligned_vector<triangle_type> triangles(count);
+
+    float size = 2.0f / std::cbrt(static_cast<float>(count));
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        vec3 v1(rand(-1.0f, 1.0f), rand(-1.0f, 1.0f), rand(-1.0f, 1.0f));
+        vec3 e1(rand(-size, size), rand(-size, size), rand(-size, size));
+        vec3 e2(rand(-size, size), rand(-size, size), rand(-size, size));
+
+        triangles[i] = triangle_type(v1, e1, e2);
+        triangles[i].prim_id = static_cast<unsigned>(i);
+        triangles[i].geom_id = 0;
+    }
+
+    return triangles;
+}
+
+
+// Per-face normals for the normals_per_face_binding ------
+
+inline aligned_vector<vec3> make_face_normals(aligned_vector<triangle_type> const& triangles)
+{
+    aligned_vector<vec3> normals(triangles.size());
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        normals[i] = normalize(cross(triangles[i].e1, triangles[i].e2));
+    }
+
+    return normals;
+}
+
+
+// Camera looking down at the terrain ---------------------
+
+inline pinhole_camera make_camera(int width, int height)
+{
+    pinhole_camera cam;
+    cam.perspective(
+            45.0f * constants::degrees_to_radians<float>(),
+            width / static_cast<float>(height),
+            0.01f,
+            100.0f
+            );
+    cam.look_at(vec3(0.0f, 1.2f, 2.2f), vec3(0.0f, 0.0f, 0.0f));
+    cam.set_viewport(0, 0, width, height);
+    return cam;
+}
+
+
+// Coherent primary rays through the pixels of the camera -
+
+inline aligned_vector<basic_ray<float>> make_primary_rays(pinhole_camera const& cam)
+{
+    int width  = cam.get_viewport().w;
+    int height = cam.get_viewport().h;
+
+    vec3 eye = cam.eye();
+    vec3 w = normalize(cam.center() - eye);
+    vec3 u = normalize(cross(w, cam.up()));
+    vec3 v = cross(u, w);
+
+    float tan_half = std::tan(cam.fovy() / 2.0f);
+    float aspect = width / static_cast<float>(height);
+
+    aligned_vector<basic_ray<float>> rays(width * height);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float sx = ((x + 0.5f) / width  * 2.0f - 1.0f) * tan_half * aspect;
+            float sy = ((y + 0.5f) / height * 2.0f - 1.0f) * tan_half;
+
+            rays[y * width + x] = basic_ray<float>(eye, normalize(w + sx * u + sy * v));
+        }
+    }
+
+    return rays;
+}
+
+
+// Incoherent rays with random origins and directions -----
+
+inline aligned_vector<basic_ray<float>> make_random_rays(size_t count, unsigned seed = 1)
+{
+    random_generator<float> gen(seed);
+
+    aligned_vector<basic_ray<float>> rays(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        vec3 ori(gen.next() * 2.0f - 1.0f, gen.next() * 0.5f, gen.next() * 2.0f - 1.0f);
+
+        float z = gen.next() * 2.0f - 1.0f;
+        float phi = gen.next() * constants::two_pi<float>();
+        float r = std::sqrt(1.0f - z * z);
+
+        rays[i] = basic_ray<float>(ori, vec3(r * std::cos(phi), z, r * std::sin(phi)));
+    }
+
+    return rays;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Terrain with a plastic material and two point lights, to be rendered with the
+// built-in kernels
+//
+
+struct kernel_scene
+{
+    using bvh_type = index_bvh<triangle_type>;
+    using bvh_ref  = bvh_type::bvh_ref;
+
+    int width  = 512;
+    int height = 512;
+
+    aligned_vector<triangle_type>       triangles;
+    aligned_vector<vec3>                normals;
+    bvh_type                            tree;
+    aligned_vector<bvh_ref>             refs;
+    aligned_vector<plastic<float>>      materials;
+    aligned_vector<point_light<float>>  lights;
+    pinhole_camera                      cam;
+
+    kernel_scene()
+        : triangles(make_terrain(256))
+        , normals(make_face_normals(triangles))
+        , cam(make_camera(width, height))
+    {
+        binned_sah_builder builder;
+        tree = builder.build(bvh_type{}, triangles.data(), triangles.size());
+        refs.push_back(tree.ref());
+
+        plastic<float> mat;
+        mat.ca() = from_rgb(vec3(0.0f));
+        mat.cd() = from_rgb(vec3(0.6f, 0.5f, 0.4f));
+        mat.cs() = from_rgb(vec3(0.2f));
+        mat.ka() = 0.0f;
+        mat.kd() = 1.0f;
+        mat.ks() = 1.0f;
+        mat.specular_exp() = 32.0f;
+        materials.push_back(mat);
+
+        point_light<float> light;
+        light.set_cl(vec3(1.0f));
+        light.set_kl(1.0f);
+        light.set_constant_attenuation(1.0f);
+        light.set_linear_attenuation(0.0f);
+        light.set_quadratic_attenuation(0.0f);
+
+        light.set_position(vec3(-1.0f, 2.0f, 1.0f));
+        lights.push_back(light);
+
+        light.set_position(vec3(1.0f, 1.0f, -0.5f));
+        lights.push_back(light);
+    }
+
+    auto kernel_params() const
+        -> decltype(make_kernel_params(
+                normals_per_face_binding{},
+                refs.data(),
+                refs.data(),
+                normals.data(),
+                normals.data(),
+                materials.data(),
+                lights.data(),
+                lights.data(),
+                unsigned(),
+                float(),
+                vec4(),
+                vec4()
+                ))
+    {
+        return make_kernel_params(
+                normals_per_face_binding{},
+                refs.data(),
+                refs.data() + refs.size(),
+                normals.data(),
+                normals.data(),
+                materials.data(),
+                lights.data(),
+                lights.data() + lights.size(),
+                4,
+                1e-4f,
+                vec4(0.1f, 0.2f, 0.4f, 1.0f),
+                vec4(0.0f)
+                );
+    }
+};
+
+inline kernel_scene const& get_kernel_scene()
+{
+    static kernel_scene scene;
+    return scene;
+}
+
+} // benchmark
+} // visionaray
+
+#endif // VSNRAY_BENCHMARKS_SCENE_H
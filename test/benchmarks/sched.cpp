@@ -0,0 +1,71 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <string>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/kernels.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include "benchmark.h"
+#include "scene.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+
+
+//-------------------------------------------------------------------------------------------------
+// Scaling of tiled_sched with the number of threads, in both scheduling modes.
+// Renders the terrain with the whitted kernel and 4-wide packets
+//
+
+static void render(state& s, unsigned num_threads, tiled_sched_mode mode)
+{
+    auto& scene = get_kernel_scene();
+    auto kparams = scene.kernel_params();
+
+    whitted::kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    tiled_sched<basic_ray<simd::float4>> sched(num_threads, mode);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(scene.width, scene.height);
+
+    auto sparams = make_sched_params(pixel_sampler::uniform_type{}, scene.cam, rt);
+
+    s.measure(scene.width * scene.height, "Mrays/s", [&]()
+    {
+        sched.frame(kernel, sparams);
+    });
+}
+
+// Thread counts 1, 2, 4, ... up to and including the number of hardware threads
+static int register_benchmarks()
+{
+    unsigned max_threads = hardware_threads();
+
+    for (unsigned n = 1; ; n = n * 2 < max_threads ? n * 2 : max_threads)
+    {
+        registry().push_back({
+                "sched/tiled/fixed/threads:" + std::to_string(n),
+                [n](state& s) { render(s, n, tiled_sched_mode::fixed); }
+                });
+
+        registry().push_back({
+                "sched/tiled/adaptive/threads:" + std::to_string(n),
+                [n](state& s) { render(s, n, tiled_sched_mode::adaptive); }
+                });
+
+        if (n == max_threads)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static int dummy = register_benchmarks();
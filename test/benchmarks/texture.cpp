@@ -0,0 +1,326 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/texture/bricked_texture.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/texture/tiled_texture.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/array.h>
+#include <visionaray/random_generator.h>
+
+#include "benchmark.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+
+
+//-------------------------------------------------------------------------------------------------
+// 2D texture lookups, reported in million lookups per second
+//
+// Lookups use either coherent coordinates (a scan over the texture at roughly
+// one texel per lookup) or random coordinates that mostly miss the cache
+//
+
+static texture<vec4, 2> const& get_texture()
+{
+    static texture<vec4, 2> tex = []()
+    {
+        int size = 2048;
+
+        aligned_vector<vec4> texels(size * size);
+
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                float checker = ((x / 32) ^ (y / 32)) & 1 ? 1.0f : 0.2f;
+                texels[y * size + x] = vec4(x / float(size), y / float(size), checker, 1.0f);
+            }
+        }
+
+        texture<vec4, 2> result(size, size);
+        result.reset(texels.data());
+        result.set_address_mode(Wrap);
+        return result;
+    }();
+
+    return tex;
+}
+
+static aligned_vector<vec2> make_coords(bool coherent)
+{
+    size_t width  = 1024;
+    size_t height = 1024;
+
+    aligned_vector<vec2> coords(width * height);
+
+    random_generator<float> gen(2U);
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            coords[y * width + x] = coherent
+                ? vec2((x + 0.3f) / width, (y + 0.7f) / height)
+                : vec2(gen.next(), gen.next());
+        }
+    }
+
+    return coords;
+}
+
+template <typename T>
+static aligned_vector<vector<2, T>> pack_coords(aligned_vector<vec2> const& coords)
+{
+    enum { N = simd::num_elements<T>::value };
+
+    aligned_vector<vector<2, T>> result(coords.size() / N);
+
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        array<vec2, N> arr;
+
+        for (size_t j = 0; j < N; ++j)
+        {
+            arr[j] = coords[i * N + j];
+        }
+
+        result[i] = simd::pack(arr);
+    }
+
+    return result;
+}
+
+template <>
+aligned_vector<vec2> pack_coords<float>(aligned_vector<vec2> const& coords)
+{
+    return coords;
+}
+
+template <typename T>
+static void sample(state& s, tex_filter_mode filter_mode, bool coherent)
+{
+    texture_ref<vec4, 2> tex(get_texture());
+    tex.set_filter_mode(filter_mode);
+
+    auto coords = pack_coords<T>(make_coords(coherent));
+
+    s.measure(coords.size() * simd::num_elements<T>::value, "Mlookups/s", [&]()
+    {
+        for (auto const& tc : coords)
+        {
+            auto texel = tex2D(tex, tc);
+            do_not_optimize(texel);
+        }
+    });
+}
+
+
+// Minified lookups with a footprint of eight texels along each axis, either from
+// level 0 or with gradients from the mip pyramid
+template <typename T>
+static void sample_minified(state& s, bool mipmapped, bool coherent)
+{
+    static texture<vec4, 2> mipmapped_tex = []()
+    {
+        texture<vec4, 2> result(get_texture());
+        result.build_mipmaps();
+        return result;
+    }();
+
+    texture_ref<vec4, 2> tex(mipmapped ? mipmapped_tex : get_texture());
+    tex.set_filter_mode(Linear);
+
+    size_t size = get_texture().width() / 8;
+
+    aligned_vector<vec2> coords(size * size);
+
+    random_generator<float> gen(3U);
+
+    for (size_t y = 0; y < size; ++y)
+    {
+        for (size_t x = 0; x < size; ++x)
+        {
+            coords[y * size + x] = coherent
+                ? vec2((x + 0.3f) / size, (y + 0.7f) / size)
+                : vec2(gen.next(), gen.next());
+        }
+    }
+
+    auto packed = pack_coords<T>(coords);
+
+    vector<2, T> ddx(T(1.0f / size), T(0.0f));
+    vector<2, T> ddy(T(0.0f), T(1.0f / size));
+
+    s.measure(packed.size() * simd::num_elements<T>::value, "Mlookups/s", [&]()
+    {
+        for (auto const& tc : packed)
+        {
+            auto texel = mipmapped ? tex2DGrad(tex, tc, ddx, ddy) : tex2D(tex, tc);
+            do_not_optimize(texel);
+        }
+    });
+}
+
+// Lookups from a tiled texture whose cache holds all tiles (hits only) or a quarter of
+// the tiles (misses copy tiles from memory, a lower bound for disk backed textures).
+// Random lookups with the smaller cache only measure thrashing and are left out.
+static void sample_tiled(state& s, bool coherent, size_t cache_fraction)
+{
+    auto loader = std::make_shared<texture_tile_loader<vec4>>(texture_ref<vec4, 2>(get_texture()));
+
+    size_t tile_bytes = loader->layout().texels_per_tile() * sizeof(vec4);
+
+    tiled_texture<vec4> tex(loader, loader->layout().total_tiles() * tile_bytes / cache_fraction);
+    tex.set_filter_mode(Linear);
+
+    auto coords = make_coords(coherent);
+
+    s.measure(coords.size(), "Mlookups/s", [&]()
+    {
+        for (auto const& tc : coords)
+        {
+            auto texel = tex2D(tex, tc);
+            do_not_optimize(texel);
+        }
+    });
+}
+
+// 3D lookups with linear filtering from a sparse 256^3 volume (a noisy shell, zero
+// elsewhere), stored densely or in 16^3 bricks with uniform bricks compressed
+static aligned_vector<float> const& get_sparse_voxels()
+{
+    static aligned_vector<float> voxels = []()
+    {
+        int size = 256;
+
+        aligned_vector<float> result(size * size * size);
+        random_generator<float> gen(3U);
+
+        for (int z = 0; z < size; ++z)
+        {
+            for (int y = 0; y < size; ++y)
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    vec3 p = (vec3(x, y, z) + 0.5f) / static_cast<float>(size) - 0.5f;
+                    bool shell = abs(length(p) - 0.3f) < 0.05f;
+                    result[(z * size + y) * size + x] = shell ? gen.next() : 0.0f;
+                }
+            }
+        }
+
+        return result;
+    }();
+
+    return voxels;
+}
+
+static aligned_vector<vec3> make_coords3(bool coherent)
+{
+    size_t n = 64;
+
+    aligned_vector<vec3> coords(n * n * n);
+
+    random_generator<float> gen(2U);
+
+    for (size_t z = 0; z < n; ++z)
+    {
+        for (size_t y = 0; y < n; ++y)
+        {
+            for (size_t x = 0; x < n; ++x)
+            {
+                coords[(z * n + y) * n + x] = coherent
+                    ? vec3((x + 0.3f) / n, (y + 0.7f) / n, (z + 0.5f) / n)
+                    : vec3(gen.next(), gen.next(), gen.next());
+            }
+        }
+    }
+
+    return coords;
+}
+
+template <typename Tex>
+static void sample3D(state& s, Tex const& tex, bool coherent)
+{
+    auto coords = make_coords3(coherent);
+
+    s.measure(coords.size(), "Mlookups/s", [&]()
+    {
+        for (auto const& tc : coords)
+        {
+            auto texel = tex3D(tex, tc);
+            do_not_optimize(texel);
+        }
+    });
+}
+
+static void sample3D_dense(state& s, bool coherent)
+{
+    texture<float, 3> tex(256, 256, 256);
+    tex.reset(get_sparse_voxels().data());
+    tex.set_address_mode(Clamp);
+    tex.set_filter_mode(Linear);
+
+    sample3D(s, texture_ref<float, 3>(tex), coherent);
+}
+
+static void sample3D_bricked(state& s, bool coherent)
+{
+    bricked_texture<float> tex(256, 256, 256, 16);
+    tex.reset(get_sparse_voxels().data());
+    tex.set_address_mode(Clamp);
+    tex.set_filter_mode(Linear);
+
+    sample3D(s, bricked_texture_ref<float>(tex), coherent);
+}
+
+// Building the mip pyramid of a 2048x2048 RGBA32F texture, reported in million texels
+// (of level 0) per second
+static void build_mipmaps(state& s)
+{
+    texture<vec4, 2> tex(get_texture());
+
+    s.measure(tex.width() * tex.height(), "Mtexels/s", [&]()
+    {
+        tex.build_mipmaps();
+    });
+}
+
+
+#define VSNRAY_TEXTURE_BENCHMARKS(T)                                                                        \
+    { "texture/nearest/coherent/" #T, [](state& s) { sample<T>(s, Nearest, true); } },                      \
+    { "texture/nearest/random/" #T,   [](state& s) { sample<T>(s, Nearest, false); } },                     \
+    { "texture/linear/coherent/" #T,  [](state& s) { sample<T>(s, Linear, true); } },                       \
+    { "texture/linear/random/" #T,    [](state& s) { sample<T>(s, Linear, false); } },                      \
+    { "texture/bspline/coherent/" #T, [](state& s) { sample<T>(s, BSpline, true); } },                      \
+    { "texture/minified/coherent/level0/" #T, [](state& s) { sample_minified<T>(s, false, true); } },       \
+    { "texture/minified/coherent/mipmap/" #T, [](state& s) { sample_minified<T>(s, true, true); } },        \
+    { "texture/minified/random/level0/" #T,   [](state& s) { sample_minified<T>(s, false, false); } },      \
+    { "texture/minified/random/mipmap/" #T,   [](state& s) { sample_minified<T>(s, true, false); } }
+
+using simd::float4;
+using simd::float8;
+
+static registrar reg[] = {
+    { "texture/build_mipmaps", build_mipmaps },
+    { "texture/tiled/coherent/resident", [](state& s) { sample_tiled(s, true, 1); } },
+    { "texture/tiled/random/resident",   [](state& s) { sample_tiled(s, false, 1); } },
+    { "texture/tiled/coherent/quarter",  [](state& s) { sample_tiled(s, true, 4); } },
+    { "texture/3D/dense/coherent",       [](state& s) { sample3D_dense(s, true); } },
+    { "texture/3D/dense/random",         [](state& s) { sample3D_dense(s, false); } },
+    { "texture/3D/bricked/coherent",     [](state& s) { sample3D_bricked(s, true); } },
+    { "texture/3D/bricked/random",       [](state& s) { sample3D_bricked(s, false); } },
+    VSNRAY_TEXTURE_BENCHMARKS(float),
+    VSNRAY_TEXTURE_BENCHMARKS(float4),
+#if VSNRAY_SIMD_ISA_GE(VSNRAY_SIMD_ISA_AVX)
+    // The cubic filters of 8-wide lookups need the int8 -> float8 conversions of AVX
+    VSNRAY_TEXTURE_BENCHMARKS(float8),
+#endif
+    };
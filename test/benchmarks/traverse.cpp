@@ -0,0 +1,257 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <string>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/array.h>
+#include <visionaray/bvh.h>
+#include <visionaray/intersector.h>
+#include <visionaray/traverse.h>
+
+#include "benchmark.h"
+#include "scene.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+
+
+//-------------------------------------------------------------------------------------------------
+// BVH traversal with single rays and ray packets, reported in million rays per second
+//
+// Packets are formed from consecutive rays, for the primary rays these are
+// neighboring pixels of the same row
+//
+
+using bvh_type = index_bvh<triangle_type>;
+using bvh_ref  = bvh_type::bvh_ref;
+
+struct traversal_scene
+{
+    aligned_vector<triangle_type>   triangles;
+    bvh_type                        tree;
+    aligned_vector<bvh_ref>         refs;
+    aligned_vector<basic_ray<float>> primary_rays;
+    aligned_vector<basic_ray<float>> random_rays;
+
+    traversal_scene()
+        : triangles(make_terrain(512))
+    {
+        binned_sah_builder builder;
+        builder.set_num_threads(hardware_threads());
+        tree = builder.build(bvh_type{}, triangles.data(), triangles.size());
+        refs.push_back(tree.ref());
+
+        primary_rays = make_primary_rays(make_camera(1024, 1024));
+        random_rays  = make_random_rays(1024 * 1024);
+    }
+};
+
+static traversal_scene const& get_scene()
+{
+    static traversal_scene scene;
+    return scene;
+}
+
+template <typename T>
+static aligned_vector<basic_ray<T>> pack_rays(aligned_vector<basic_ray<float>> const& rays)
+{
+    enum { N = simd::num_elements<T>::value };
+
+    aligned_vector<basic_ray<T>> result(rays.size() / N);
+
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        array<basic_ray<float>, N> arr;
+
+        for (size_t j = 0; j < N; ++j)
+        {
+            arr[j] = rays[i * N + j];
+        }
+
+        result[i] = simd::pack(arr);
+    }
+
+    return result;
+}
+
+template <>
+aligned_vector<basic_ray<float>> pack_rays<float>(aligned_vector<basic_ray<float>> const& rays)
+{
+    return rays;
+}
+
+template <typename T>
+static void closest_hit(state& s, bool primary)
+{
+    auto const& scene = get_scene();
+    auto rays = pack_rays<T>(primary ? scene.primary_rays : scene.random_rays);
+
+    auto begin = scene.refs.data();
+    auto end   = scene.refs.data() + scene.refs.size();
+
+    s.measure(rays.size() * simd::num_elements<T>::value, "Mrays/s", [&]()
+    {
+        for (auto const& r : rays)
+        {
+            auto hr = visionaray::closest_hit(r, begin, end);
+            do_not_optimize(hr);
+        }
+    });
+}
+
+template <typename T>
+static void any_hit(state& s, bool primary)
+{
+    auto const& scene = get_scene();
+    auto rays = pack_rays<T>(primary ? scene.primary_rays : scene.random_rays);
+
+    auto begin = scene.refs.data();
+    auto end   = scene.refs.data() + scene.refs.size();
+
+    s.measure(rays.size() * simd::num_elements<T>::value, "Mrays/s", [&]()
+    {
+        for (auto const& r : rays)
+        {
+            auto hr = visionaray::any_hit(r, begin, end);
+            do_not_optimize(hr);
+        }
+    });
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Single rays, BVHs with up to N triangles per leaf stored as triangles or triangle packets
+//
+
+template <size_t N>
+struct packet_leaves_scene
+{
+    bvh_type                                tree;
+    bvh<basic_triangle_packet<N>>           packed;
+
+    packet_leaves_scene()
+    {
+        auto const& scene = get_scene();
+
+        binned_sah_builder builder;
+        builder.set_num_threads(hardware_threads());
+        tree = builder.build(bvh_type{}, scene.triangles.data(), scene.triangles.size(), N);
+        pack_leaves(packed, tree);
+    }
+
+    static packet_leaves_scene const& get()
+    {
+        static packet_leaves_scene scene;
+        return scene;
+    }
+};
+
+template <size_t N>
+static void packet_leaves(state& s, bool primary, bool packed)
+{
+    auto const& scene = packet_leaves_scene<N>::get();
+    auto const& rays = primary ? get_scene().primary_rays : get_scene().random_rays;
+
+    auto tree_ref = scene.tree.ref();
+    auto packed_ref = scene.packed.ref();
+
+    s.measure(rays.size(), "Mrays/s", [&]()
+    {
+        for (auto const& r : rays)
+        {
+            if (packed)
+            {
+                auto hr = visionaray::closest_hit(r, &packed_ref, &packed_ref + 1);
+                do_not_optimize(hr);
+            }
+            else
+            {
+                auto hr = visionaray::closest_hit(r, &tree_ref, &tree_ref + 1);
+                do_not_optimize(hr);
+            }
+        }
+    });
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Single rays, BVHs of the terrain stored as triangles or as indexed triangles
+//
+
+struct indexed_scene
+{
+    aligned_vector<vec3>                            vertices;
+    aligned_vector<basic_indexed_triangle<float>>   triangles;
+    index_bvh<basic_indexed_triangle<float>>        tree;
+
+    indexed_scene()
+        : triangles(make_indexed_terrain(512, vertices))
+    {
+        aligned_vector<basic_indexed_triangle_ref<float>> refs;
+        refs.reserve(triangles.size());
+
+        for (auto const& t : triangles)
+        {
+            refs.emplace_back(t, vertices.data());
+        }
+
+        binned_sah_builder builder;
+        builder.set_num_threads(hardware_threads());
+        tree = builder.build(index_bvh<basic_indexed_triangle<float>>{}, refs.data(), refs.size());
+    }
+
+    static indexed_scene const& get()
+    {
+        static indexed_scene scene;
+        return scene;
+    }
+};
+
+static void indexed(state& s, bool primary)
+{
+    auto const& scene = indexed_scene::get();
+    auto const& rays = primary ? get_scene().primary_rays : get_scene().random_rays;
+
+    auto ref = scene.tree.ref();
+
+    indexed_triangle_intersector<float> isect(scene.vertices.data());
+
+    s.measure(rays.size(), "Mrays/s", [&]()
+    {
+        for (auto const& r : rays)
+        {
+            auto hr = visionaray::closest_hit(r, &ref, &ref + 1, isect);
+            do_not_optimize(hr);
+        }
+    });
+}
+
+#define VSNRAY_TRAVERSE_BENCHMARKS(T)                                                                       \
+    { "traverse/closest_hit/primary/" #T, [](state& s) { closest_hit<T>(s, true); } },                      \
+    { "traverse/closest_hit/random/" #T,  [](state& s) { closest_hit<T>(s, false); } },                     \
+    { "traverse/any_hit/primary/" #T,     [](state& s) { any_hit<T>(s, true); } },                          \
+    { "traverse/any_hit/random/" #T,      [](state& s) { any_hit<T>(s, false); } }
+
+using simd::float4;
+using simd::float8;
+using simd::float16;
+
+static registrar reg[] = {
+    VSNRAY_TRAVERSE_BENCHMARKS(float),
+    VSNRAY_TRAVERSE_BENCHMARKS(float4),
+    VSNRAY_TRAVERSE_BENCHMARKS(float8),
+    VSNRAY_TRAVERSE_BENCHMARKS(float16),
+    { "traverse/indexed/primary",                  [](state& s) { indexed(s, true); } },
+    { "traverse/indexed/random",                   [](state& s) { indexed(s, false); } },
+    { "traverse/packet_leaves/primary/triangle/4", [](state& s) { packet_leaves<4>(s, true, false); } },
+    { "traverse/packet_leaves/primary/triangle4",  [](state& s) { packet_leaves<4>(s, true, true); } },
+    { "traverse/packet_leaves/primary/triangle/8", [](state& s) { packet_leaves<8>(s, true, false); } },
+    { "traverse/packet_leaves/primary/triangle8",  [](state& s) { packet_leaves<8>(s, true, true); } },
+    { "traverse/packet_leaves/random/triangle/4",  [](state& s) { packet_leaves<4>(s, false, false); } },
+    { "traverse/packet_leaves/random/triangle4",   [](state& s) { packet_leaves<4>(s, false, true); } },
+    { "traverse/packet_leaves/random/triangle/8",  [](state& s) { packet_leaves<8>(s, false, false); } },
+    { "traverse/packet_leaves/random/triangle8",   [](state& s) { packet_leaves<8>(s, false, true); } },
+    };
@@ -0,0 +1,169 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/macrocell_grid.h>
+
+#include "benchmark.h"
+
+using namespace visionaray;
+using namespace visionaray::benchmark;
+
+
+//-------------------------------------------------------------------------------------------------
+// Volume ray marching, reported in million rays per second
+//
+// The volume resembles a CT scan, a dense object surrounded by air: more than 80% of the
+// macrocells are transparent under the transfer function, which is constant for values
+// above 0.5 so that adaptive sampling can take larger steps inside the object. Rays are cast orthographically
+// through the volume in texture space and composited front-to-back with early ray
+// termination.
+//
+
+enum march_mode { Fixed, Skip, SkipAdaptive };
+
+static texture<float, 3> const& get_volume()
+{
+    static texture<float, 3> vol = []()
+    {
+        int size = 128;
+
+        aligned_vector<float> voxels(size * size * size);
+
+        for (int z = 0; z < size; ++z)
+        {
+            for (int y = 0; y < size; ++y)
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    vec3 p = (vec3(x, y, z) + 0.5f) / static_cast<float>(size) - 0.5f;
+                    float body = clamp((0.3f - length(p)) * 40.0f, 0.0f, 1.0f);
+                    float tissue = 0.7f + 0.2f * sin(p.x * 40.0f) * sin(p.y * 40.0f);
+                    voxels[(z * size + y) * size + x] = body * tissue;
+                }
+            }
+        }
+
+        texture<float, 3> result(size, size, size);
+        result.reset(voxels.data());
+        result.set_address_mode(Clamp);
+        result.set_filter_mode(Linear);
+        return result;
+    }();
+
+    return vol;
+}
+
+static texture<vec4, 1> const& get_transfunc()
+{
+    static texture<vec4, 1> tf = []()
+    {
+        aligned_vector<vec4> data(256);
+
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            float v = (i + 0.5f) / data.size();
+            float a = clamp((v - 0.3f) * 5.0f, 0.0f, 1.0f);
+            data[i] = vec4(1.0f, 0.8f, 0.5f, 0.02f) * a;
+        }
+
+        texture<vec4, 1> result(data.size());
+        result.reset(data.data());
+        result.set_address_mode(Clamp);
+        result.set_filter_mode(Linear);
+        return result;
+    }();
+
+    return tf;
+}
+
+// Composite samples at multiples of dt in [t0..t1), returns false when the ray is opaque
+static bool march(
+        basic_ray<float> const&     ray,
+        float                       t0,
+        float                       t1,
+        float                       dt,
+        vec4&                       dst
+        )
+{
+    auto const& vol = get_volume();
+    auto const& tf = get_transfunc();
+
+    for (float t = ceil(t0 / dt) * dt; t < t1; t += dt)
+    {
+        vec4 color = tex1D(tf, tex3D(vol, ray.ori + ray.dir * t));
+
+        // Opacity correction for the step size
+        color.w = 1.0f - pow(1.0f - color.w, dt * 256.0f);
+        color.xyz() *= color.w;
+
+        dst += color * (1.0f - dst.w);
+
+        if (dst.w >= 0.99f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void render(state& s, march_mode mode)
+{
+    int width  = 256;
+    int height = 256;
+
+    float base_step = 1.0f / 256.0f;
+
+    macrocell_grid grid;
+    grid.build(texture_ref<float, 3>(get_volume()), 8);
+    grid.update_opacity(texture_ref<vec4, 1>(get_transfunc()));
+
+    auto grid_ref = grid.ref();
+
+    s.measure(width * height, "Mrays/s", [&]()
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                basic_ray<float> ray;
+                ray.ori = vec3((x + 0.5f) / width, (y + 0.5f) / height, -0.5f);
+                ray.dir = normalize(vec3(0.1f, 0.05f, 1.0f));
+
+                vec4 dst(0.0f);
+
+                if (mode == Fixed)
+                {
+                    vec3 inv_dir = 1.0f / ray.dir;
+                    vec3 t1 = -ray.ori * inv_dir;
+                    vec3 t2 = (vec3(1.0f) - ray.ori) * inv_dir;
+                    float tmin = max_element(min(t1, t2));
+                    float tmax = min_element(max(t1, t2));
+
+                    march(ray, max(tmin, 0.0f), tmax, base_step, dst);
+                }
+                else
+                {
+                    traverse_macrocells(grid_ref, ray, 0.0f, 10.0f, [&](float t0, float t1, macrocell const& c)
+                    {
+                        float dt = mode == SkipAdaptive ? macrocell_step(c, base_step, 4.0f) : base_step;
+                        return march(ray, t0, t1, dt, dst);
+                    });
+                }
+
+                do_not_optimize(dst);
+            }
+        }
+    });
+}
+
+static registrar reg[] = {
+    { "volume/fixed",         [](state& s) { render(s, Fixed); } },
+    { "volume/skip",          [](state& s) { render(s, Skip); } },
+    { "volume/skip_adaptive", [](state& s) { render(s, SkipAdaptive); } },
+    };
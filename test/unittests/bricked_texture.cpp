@@ -0,0 +1,197 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/texture/bricked_texture.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/texture/texture_traits.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+// Sparse volume: random values in a sphere, zero elsewhere
+template <typename T, typename Func>
+static aligned_vector<T> make_voxels(int w, int h, int d, Func make_value)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    aligned_vector<T> result(w * h * d);
+
+    for (int z = 0; z < d; ++z)
+    {
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                vec3 p = (vec3(x, y, z) + 0.5f) / vec3(w, h, d) - 0.5f;
+                result[(z * h + y) * w + x] = length(p) < 0.25f ? make_value(dist(rng)) : make_value(0.0f);
+            }
+        }
+    }
+
+    return result;
+}
+
+static std::vector<vec3> make_coords(size_t n)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-0.25f, 1.25f);
+
+    std::vector<vec3> result(n);
+
+    for (auto& c : result)
+    {
+        c = vec3(dist(rng), dist(rng), dist(rng));
+    }
+
+    return result;
+}
+
+template <typename T>
+static void test_sample(aligned_vector<T> const& voxels, int w, int h, int d, int brick_size, float tolerance)
+{
+    texture<T, 3> dense(w, h, d);
+    dense.reset(voxels.data());
+
+    bricked_texture<T> bricked(w, h, d, brick_size);
+    bricked.reset(voxels.data());
+
+    EXPECT_LT(bricked.num_dense_bricks(), static_cast<size_t>(bricked.num_bricks().x * bricked.num_bricks().y * bricked.num_bricks().z));
+
+    auto coords = make_coords(4000);
+
+    for (auto filter_mode : { Nearest, Linear, CardinalSpline })
+    {
+        for (auto address_mode : { Clamp, Wrap })
+        {
+            dense.set_filter_mode(filter_mode);
+            dense.set_address_mode(address_mode);
+            bricked.set_filter_mode(filter_mode);
+            bricked.set_address_mode(address_mode);
+
+            for (auto const& c : coords)
+            {
+                auto expected = tex3D(dense, c);
+                auto actual = tex3D(bricked_texture_ref<T>(bricked), c);
+
+                EXPECT_NEAR(expected, actual, tolerance)
+                        << "filter mode: " << filter_mode << ", address mode: " << address_mode
+                        << ", coord: (" << c.x << ',' << c.y << ',' << c.z << ')';
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Compare lookups with the dense texture
+//
+
+TEST(BrickedTexture, Sample)
+{
+    static_assert(texture_dimensions<bricked_texture<float>>::value == 3, "Wrong texture dimensions");
+
+    // Size not a multiple of the brick size
+    auto voxels = make_voxels<float>(37, 29, 21, [](float v) { return v; });
+    test_sample(voxels, 37, 29, 21, 8, 1e-4f);
+    test_sample(voxels, 37, 29, 21, 16, 1e-4f);
+
+    auto voxels8 = make_voxels<unorm<8>>(32, 32, 32, [](float v) { return unorm<8>(v); });
+    test_sample(voxels8, 32, 32, 32, 8, 1e-4f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Uniform bricks are stored as constants
+//
+
+TEST(BrickedTexture, Compression)
+{
+    int size = 64;
+    auto voxels = make_voxels<float>(size, size, size, [](float v) { return v; });
+
+    bricked_texture<float> compressed(size, size, size, 8);
+    compressed.reset(voxels.data());
+
+    bricked_texture<float> uncompressed(size, size, size, 8);
+    uncompressed.set_compress_uniform_bricks(false);
+    uncompressed.reset(voxels.data());
+
+    EXPECT_EQ(uncompressed.num_dense_bricks(), size_t(8 * 8 * 8));
+    EXPECT_LT(compressed.num_dense_bricks(), uncompressed.num_dense_bricks() / 2);
+    EXPECT_LT(compressed.size_in_bytes(), voxels.size() * sizeof(float) / 2);
+
+    for (int z = 0; z < size; ++z)
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                EXPECT_EQ(compressed.value(x, y, z), voxels[(z * size + y) * size + x]);
+                EXPECT_EQ(uncompressed.value(x, y, z), voxels[(z * size + y) * size + x]);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Build brick by brick, replace bricks, copy
+//
+
+TEST(BrickedTexture, SetBrick)
+{
+    bricked_texture<float> tex(20, 20, 20, 8, 0.5f);
+
+    EXPECT_EQ(tex.num_dense_bricks(), size_t(0));
+    EXPECT_EQ(tex.value(19, 19, 19), 0.5f);
+
+    std::vector<float> brick(8 * 8 * 8);
+
+    for (size_t i = 0; i < brick.size(); ++i)
+    {
+        brick[i] = static_cast<float>(i);
+    }
+
+    tex.set_brick(1, 2, 0, brick.data());
+    tex.set_brick(2, 2, 2, brick.data());
+
+    EXPECT_EQ(tex.num_dense_bricks(), size_t(2));
+    EXPECT_EQ(tex.value(8 + 3, 16 + 2, 1), static_cast<float>((1 * 8 + 2) * 8 + 3));
+    EXPECT_EQ(tex.value(16 + 3, 16 + 3, 16 + 3), static_cast<float>((3 * 8 + 3) * 8 + 3));
+
+    // The visible part of a border brick is uniform, the rest is ignored
+    std::vector<float> border(8 * 8 * 8, 2.0f);
+    border[7] = 3.0f;
+    tex.set_brick(2, 2, 2, border.data());
+
+    EXPECT_EQ(tex.num_dense_bricks(), size_t(1));
+    EXPECT_EQ(tex.value(19, 19, 19), 2.0f);
+
+    // Freed pool bricks are reused
+    tex.set_constant_brick(1, 2, 0, 1.0f);
+    tex.set_brick(0, 0, 0, brick.data());
+
+    EXPECT_EQ(tex.num_dense_bricks(), size_t(1));
+    EXPECT_EQ(tex.value(8 + 3, 16 + 2, 1), 1.0f);
+    EXPECT_EQ(tex.value(7, 7, 7), static_cast<float>(brick.size() - 1));
+
+    bricked_texture<float> copy(tex);
+    tex.set_constant_brick(0, 0, 0, 0.0f);
+    tex.compact();
+
+    EXPECT_EQ(tex.num_dense_bricks(), size_t(0));
+    EXPECT_EQ(copy.num_dense_bricks(), size_t(1));
+    EXPECT_EQ(copy.value(7, 7, 7), static_cast<float>(brick.size() - 1));
+}
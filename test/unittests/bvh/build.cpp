@@ -1,6 +1,10 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
 #include <visionaray/aligned_vector.h>
 #include <visionaray/array_ref.h>
 #include <visionaray/bvh.h>
@@ -46,6 +50,29 @@ aligned_vector<triangle_t, 32> make_triangles()
     return triangles;
 }
 
+// generate lots of random triangles ---------------------
+
+aligned_vector<triangle_t, 32> make_random_triangles(size_t count)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> ext(-1.0f, 1.0f);
+
+    aligned_vector<triangle_t, 32> triangles(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        vec3 v1(pos(rng), pos(rng), pos(rng));
+        vec3 e1(ext(rng), ext(rng), ext(rng));
+        vec3 e2(ext(rng), ext(rng), ext(rng));
+
+        triangles[i] = triangle_t(v1, e1, e2);
+        triangles[i].prim_id = static_cast<unsigned>(i);
+    }
+
+    return triangles;
+}
+
 // generate some spheres ----------------------------------
 
 aligned_vector<sphere_t, 32> make_spheres()
@@ -120,3 +147,523 @@ TEST(BVH, BuildArrayRefBvh)
     EXPECT_TRUE(triangle_bvh.primitives().size() == triangles.size());
     EXPECT_TRUE(sphere_bvh.primitives().size()   == spheres.size());
 }
+
+
+// parallel build -----------------------------------------
+
+TEST(BVH, BuildParallel)
+{
+    // Large enough so that the root node is binned in parallel
+    auto triangles = make_random_triangles(binned_sah_builder::ParallelThreshold * 2);
+
+    binned_sah_builder serial_builder;
+    serial_builder.set_num_threads(1);
+
+    binned_sah_builder parallel_builder;
+    parallel_builder.set_num_threads(4);
+
+    auto serial_bvh   = serial_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+    auto parallel_bvh = parallel_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    auto serial_index_bvh   = serial_builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+    auto parallel_index_bvh = parallel_builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    // Same splits, only the node order differs
+    EXPECT_EQ(serial_bvh.nodes().size(), parallel_bvh.nodes().size());
+    EXPECT_EQ(serial_index_bvh.nodes().size(), parallel_index_bvh.nodes().size());
+
+    EXPECT_FLOAT_EQ(sah_cost(serial_bvh), sah_cost(parallel_bvh));
+    EXPECT_FLOAT_EQ(sah_cost(serial_index_bvh), sah_cost(parallel_index_bvh));
+
+    // A thread pool owned by the caller is shared between builds
+    thread_pool pool(4);
+
+    binned_sah_builder pool_builder;
+
+    auto pool_bvh       = pool_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+    auto pool_index_bvh = pool_builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+
+    EXPECT_FLOAT_EQ(sah_cost(serial_bvh), sah_cost(pool_bvh));
+    EXPECT_FLOAT_EQ(sah_cost(serial_index_bvh), sah_cost(pool_index_bvh));
+
+    serial_builder.enable_spatial_splits(true);
+    parallel_builder.enable_spatial_splits(true);
+
+    auto serial_split_bvh   = serial_builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+    auto parallel_split_bvh = parallel_builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    EXPECT_EQ(serial_split_bvh.num_indices(), parallel_split_bvh.num_indices());
+    EXPECT_FLOAT_EQ(sah_cost(serial_split_bvh), sah_cost(parallel_split_bvh));
+
+    // Each primitive is referenced exactly once and lies inside its leaf
+    std::vector<int> ref_count(triangles.size(), 0);
+
+    traverse_leaves(parallel_bvh, [&](bvh_node const& leaf)
+    {
+        for (auto i = leaf.get_indices().first; i != leaf.get_indices().last; ++i)
+        {
+            auto const& prim = parallel_bvh.primitive(i);
+            ++ref_count[prim.prim_id];
+
+            auto bounds = combine(leaf.get_bounds(), get_bounds(prim));
+            EXPECT_TRUE(bounds.min == leaf.get_bounds().min);
+            EXPECT_TRUE(bounds.max == leaf.get_bounds().max);
+        }
+    });
+
+    for (auto c : ref_count)
+    {
+        EXPECT_EQ(c, 1);
+    }
+
+    // Trees must report the same closest hits
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = intersect(r, serial_bvh);
+        auto hr2 = intersect(r, parallel_bvh);
+        auto hr3 = intersect(r, parallel_index_bvh);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+        EXPECT_EQ(hr1.hit, hr3.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_EQ(hr1.prim_id, hr3.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            EXPECT_FLOAT_EQ(hr1.t, hr3.t);
+        }
+    }
+}
+
+
+// lbvh ---------------------------------------------------
+
+template <typename BVH>
+void check_lbvh(BVH const& tree, aligned_vector<triangle_t, 32> const& triangles)
+{
+    // Each primitive is referenced exactly once and lies inside its leaf,
+    // child bounds are contained in their parents' bounds
+    std::vector<int> ref_count(triangles.size(), 0);
+    size_t num_leaves = 0;
+
+    for (auto const& n : tree.nodes())
+    {
+        if (is_inner(n))
+        {
+            EXPECT_TRUE(n.get_bounds().contains(tree.node(n.get_child(0)).get_bounds()));
+            EXPECT_TRUE(n.get_bounds().contains(tree.node(n.get_child(1)).get_bounds()));
+        }
+        else
+        {
+            ++num_leaves;
+
+            for (auto i = n.get_indices().first; i != n.get_indices().last; ++i)
+            {
+                auto const& prim = tree.primitive(i);
+                ++ref_count[prim.prim_id];
+
+                EXPECT_TRUE(n.get_bounds().contains(get_bounds(prim)));
+            }
+        }
+    }
+
+    EXPECT_EQ(tree.num_nodes(), 2 * num_leaves - 1);
+
+    for (auto c : ref_count)
+    {
+        EXPECT_EQ(c, 1);
+    }
+}
+
+TEST(BVH, BuildLbvh)
+{
+    auto triangles = make_random_triangles(lbvh_builder::MinParallelSize * 4);
+
+    // Tiny trees
+    for (size_t n = 1; n <= 9; ++n)
+    {
+        lbvh_builder builder;
+
+        auto tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), n);
+        EXPECT_EQ(tree.num_indices(), n);
+        EXPECT_TRUE(tree.num_nodes() > 0);
+    }
+
+    for (bool use_64bit_codes : { false, true })
+    {
+        lbvh_builder serial_builder;
+        serial_builder.set_num_threads(1);
+        serial_builder.enable_64bit_codes(use_64bit_codes);
+
+        lbvh_builder parallel_builder;
+        parallel_builder.set_num_threads(4);
+        parallel_builder.enable_64bit_codes(use_64bit_codes);
+
+        auto serial_bvh   = serial_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+        auto parallel_bvh = parallel_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+        auto parallel_index_bvh = parallel_builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+        // Caller-owned thread pool
+        thread_pool pool(4);
+        auto pool_bvh = serial_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+
+        check_lbvh(serial_bvh, triangles);
+        check_lbvh(parallel_bvh, triangles);
+        check_lbvh(parallel_index_bvh, triangles);
+
+        // The parallel build must produce exactly the same tree
+        ASSERT_EQ(serial_bvh.num_nodes(), parallel_bvh.num_nodes());
+
+        for (size_t i = 0; i < serial_bvh.num_nodes(); ++i)
+        {
+            EXPECT_TRUE(memcmp(&serial_bvh.node(i), &parallel_bvh.node(i), sizeof(bvh_node)) == 0);
+        }
+
+        ASSERT_EQ(serial_bvh.num_nodes(), pool_bvh.num_nodes());
+
+        for (size_t i = 0; i < serial_bvh.num_nodes(); ++i)
+        {
+            EXPECT_TRUE(memcmp(&serial_bvh.node(i), &pool_bvh.node(i), sizeof(bvh_node)) == 0);
+        }
+
+        // Compare closest hits with a SAH tree
+        binned_sah_builder sah_builder;
+        auto sah_bvh = sah_builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+        std::default_random_engine rng(1);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+            auto hr1 = intersect(r, sah_bvh);
+            auto hr2 = intersect(r, parallel_bvh);
+            auto hr3 = intersect(r, parallel_index_bvh);
+
+            EXPECT_EQ(hr1.hit, hr2.hit);
+            EXPECT_EQ(hr1.hit, hr3.hit);
+
+            if (hr1.hit)
+            {
+                EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+                EXPECT_EQ(hr1.prim_id, hr3.prim_id);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Collapse binary BVHs into BVHs with 4-wide and 8-wide nodes
+//
+
+template <typename WideBVH, typename BVH>
+void check_wide_bvh(WideBVH const& wide, BVH const& tree)
+{
+    using wide_node = typename WideBVH::node_type;
+
+    ASSERT_TRUE(wide.num_nodes() > 0);
+    EXPECT_TRUE(wide.num_nodes() < tree.num_nodes());
+
+    aabb b1 = get_bounds(tree);
+    aabb b2 = get_bounds(wide);
+    EXPECT_TRUE(b2.contains(b1));
+
+    // Each primitive is referenced by exactly one leaf
+    std::vector<int> refs(tree.num_primitives(), 0);
+
+    for (size_t n = 0; n < wide.num_nodes(); ++n)
+    {
+        wide_node const& node = wide.node(n);
+
+        EXPECT_TRUE(node.num_children() > 0);
+
+        for (unsigned i = 0; i < node.num_children(); ++i)
+        {
+            if (node.is_leaf(i))
+            {
+                for (unsigned j = node.get_indices(i).first; j != node.get_indices(i).last; ++j)
+                {
+                    ++refs[j];
+                }
+            }
+            else
+            {
+                EXPECT_TRUE(node.get_child(i) > n);
+                EXPECT_TRUE(node.get_child(i) < wide.num_nodes());
+            }
+        }
+    }
+
+    for (int r : refs)
+    {
+        EXPECT_EQ(r, 1);
+    }
+
+    std::default_random_engine rng(2);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = intersect(r, tree);
+        auto hr2 = intersect(r, wide);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+
+        default_intersector isect;
+        auto any1 = intersect<detail::AnyHit>(r, tree, isect);
+        auto any2 = intersect<detail::AnyHit>(r, wide, isect);
+        EXPECT_EQ(any1.hit, any2.hit);
+    }
+
+    // Ray packets
+    for (int i = 0; i < 100; ++i)
+    {
+        basic_ray<simd::float4> r;
+        r.ori = vector<3, simd::float4>(vec3(0.0f));
+        r.dir = normalize(vector<3, simd::float4>(
+                simd::float4(dist(rng), dist(rng), dist(rng), dist(rng)),
+                simd::float4(dist(rng), dist(rng), dist(rng), dist(rng)),
+                simd::float4(dist(rng), dist(rng), dist(rng), dist(rng))
+                ));
+
+        auto hr1 = intersect(r, tree);
+        auto hr2 = intersect(r, wide);
+
+        EXPECT_TRUE(all(hr1.hit == hr2.hit));
+        EXPECT_TRUE(all(!hr1.hit || hr1.prim_id == hr2.prim_id));
+    }
+}
+
+TEST(BVH, CollapseWide)
+{
+    auto triangles = make_random_triangles(10000);
+
+    binned_sah_builder builder;
+
+    auto tree = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+    auto index_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    bvh4<triangle_t> wide4;
+    collapse(wide4, tree);
+    check_wide_bvh(wide4, tree);
+
+    bvh8<triangle_t> wide8;
+    collapse(wide8, tree);
+    check_wide_bvh(wide8, tree);
+
+    index_bvh4<triangle_t> index_wide4;
+    collapse(index_wide4, index_tree);
+    check_wide_bvh(index_wide4, index_tree);
+
+    index_bvh8<triangle_t> index_wide8;
+    collapse(index_wide8, index_tree);
+    check_wide_bvh(index_wide8, index_tree);
+
+    // Compressed nodes, bounds are quantized conservatively
+    compressed_bvh4<triangle_t> compressed4;
+    collapse(compressed4, tree);
+    check_wide_bvh(compressed4, tree);
+
+    compressed_bvh8<triangle_t> compressed8;
+    collapse(compressed8, tree);
+    check_wide_bvh(compressed8, tree);
+
+    // Leaf sizes don't fit into compressed nodes
+    auto large = make_random_triangles(70000);
+    auto large_leaf_tree = builder.build(bvh<triangle_t>{}, large.data(), large.size(), 70000);
+    compressed_bvh4<triangle_t> large_compressed4;
+    EXPECT_THROW(collapse(large_compressed4, large_leaf_tree), std::runtime_error);
+
+    index_compressed_bvh8<triangle_t> index_compressed8;
+    collapse(index_compressed8, index_tree);
+    check_wide_bvh(index_compressed8, index_tree);
+
+    bvh_t<aligned_vector<triangle_t>, aligned_vector<compressed_bvh_node<4, unsigned short>>> compressed4_16;
+    collapse(compressed4_16, tree);
+    check_wide_bvh(compressed4_16, tree);
+
+    ASSERT_EQ(compressed8.num_nodes(), wide8.num_nodes());
+
+    for (size_t n = 0; n < wide8.num_nodes(); ++n)
+    {
+        for (unsigned i = 0; i < wide8.node(n).num_children(); ++i)
+        {
+            aabb b1 = wide8.node(n).get_child_bounds(i);
+            aabb b2 = compressed8.node(n).get_child_bounds(i);
+            EXPECT_TRUE(b2.contains(b1));
+        }
+    }
+
+    EXPECT_TRUE(compressed8.num_nodes() * sizeof(compressed_bvh_node8) * 2 < tree.num_nodes() * sizeof(bvh_node));
+
+    // Trees with a single leaf
+    auto tiny = builder.build(bvh<triangle_t>{}, triangles.data(), 2);
+    bvh8<triangle_t> tiny8;
+    collapse(tiny8, tiny);
+    ASSERT_EQ(tiny8.num_nodes(), size_t(1));
+    EXPECT_EQ(tiny8.node(0).num_children(), 1U);
+
+    // Instances of wide BVHs
+    auto inst = wide4.inst(mat4::identity());
+    basic_ray<float> r(vec3(0.0f), vec3(0.0f, 0.0f, 1.0f));
+    EXPECT_EQ(intersect(r, inst).hit, intersect(r, tree).hit);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Refit BVHs after moving their primitives
+//
+
+template <typename BVH>
+void check_bounds(BVH const& tree)
+{
+    for (size_t i = 0; i < tree.num_nodes(); ++i)
+    {
+        auto const& node = tree.node(i);
+        aabb bounds = node.get_bounds();
+
+        if (is_leaf(node))
+        {
+            for (auto j = node.get_indices().first; j != node.get_indices().last; ++j)
+            {
+                aabb pb = get_bounds(tree.primitive(j));
+                EXPECT_TRUE(bounds.contains(pb));
+            }
+        }
+        else
+        {
+            EXPECT_TRUE(bounds.contains(tree.node(node.get_child(0)).get_bounds()));
+            EXPECT_TRUE(bounds.contains(tree.node(node.get_child(1)).get_bounds()));
+        }
+    }
+}
+
+// Offsets only depend on prim_id, so that reordered primitives move the same way
+template <typename Primitives>
+void move_triangles(Primitives& triangles, float phase)
+{
+    for (auto& t : triangles)
+    {
+        float id = static_cast<float>(t.prim_id);
+        t.v1 += vec3(sin(id * 1.3f + phase), cos(id * 0.7f + phase), sin(id * 0.3f - phase)) * 0.05f;
+    }
+}
+
+TEST(BVH, Refit)
+{
+    auto triangles = make_random_triangles(20000);
+
+    binned_sah_builder builder;
+    thread_pool pool(4);
+
+    auto serial_bvh   = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+    auto parallel_bvh = serial_bvh;
+    auto index_tree   = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    move_triangles(serial_bvh.primitives(), 1.0f);
+    move_triangles(parallel_bvh.primitives(), 1.0f);
+    move_triangles(index_tree.primitives(), 1.0f);
+
+    refit(serial_bvh);
+    refit(parallel_bvh, pool);
+    refit(index_tree, pool);
+
+    check_bounds(serial_bvh);
+    check_bounds(parallel_bvh);
+    check_bounds(index_tree);
+
+    // Serial and parallel refit produce the same boxes
+    for (size_t i = 0; i < serial_bvh.num_nodes(); ++i)
+    {
+        EXPECT_TRUE(memcmp(&serial_bvh.node(i), &parallel_bvh.node(i), sizeof(bvh_node)) == 0);
+    }
+
+    // Closest hits match a BVH that was built from the moved triangles
+    auto rebuilt = builder.build(index_bvh<triangle_t>{}, index_tree.primitives().data(), index_tree.num_primitives());
+
+    std::default_random_engine rng(3);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = intersect(r, rebuilt);
+        auto hr2 = intersect(r, index_tree);
+        auto hr3 = intersect(r, parallel_bvh);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+        EXPECT_EQ(hr1.hit, hr3.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_EQ(hr1.prim_id, hr3.prim_id);
+        }
+    }
+
+    // Quality check: small motion keeps the topology, scrambling triggers a rebuild
+    float reference_cost = sah_cost(rebuilt);
+
+    move_triangles(rebuilt.primitives(), 2.0f);
+    EXPECT_FALSE(refit_or_rebuild(rebuilt, pool, builder, reference_cost, 1.5f));
+
+    auto scrambled = make_random_triangles(rebuilt.num_primitives());
+
+    for (size_t i = 0; i < scrambled.size(); ++i)
+    {
+        rebuilt.primitives()[i] = scrambled[(i * 7919) % scrambled.size()];
+    }
+
+    EXPECT_TRUE(refit_or_rebuild(rebuilt, builder, reference_cost, 1.5f));
+    EXPECT_FLOAT_EQ(reference_cost, sah_cost(rebuilt));
+    check_bounds(rebuilt);
+}
+
+TEST(BVH, RefitLbvh)
+{
+    auto triangles = make_random_triangles(20000);
+
+    // LBVH children are not stored after their parents
+    lbvh_builder builder;
+    thread_pool pool(4);
+    thread_pool single(1);
+
+    auto serial_bvh   = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+    auto single_bvh   = serial_bvh;
+    auto parallel_bvh = serial_bvh;
+
+    move_triangles(serial_bvh.primitives(), 1.0f);
+    move_triangles(single_bvh.primitives(), 1.0f);
+    move_triangles(parallel_bvh.primitives(), 1.0f);
+
+    refit(serial_bvh);
+    refit(single_bvh, single);
+    refit(parallel_bvh, pool);
+
+    check_bounds(serial_bvh);
+    check_bounds(single_bvh);
+    check_bounds(parallel_bvh);
+
+    for (size_t i = 0; i < serial_bvh.num_nodes(); ++i)
+    {
+        EXPECT_TRUE(memcmp(&serial_bvh.node(i), &parallel_bvh.node(i), sizeof(bvh_node)) == 0);
+        EXPECT_TRUE(memcmp(&single_bvh.node(i), &parallel_bvh.node(i), sizeof(bvh_node)) == 0);
+    }
+}
@@ -0,0 +1,242 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <random>
+#include <vector>
+
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+using triangle_t = basic_triangle<3, float>;
+using blas_type  = bvh<triangle_t>;
+
+static blas_type make_blas()
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> ext(-0.2f, 0.2f);
+
+    aligned_vector<triangle_t> triangles(200);
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i] = triangle_t(
+                vec3(pos(rng), pos(rng), pos(rng)),
+                vec3(ext(rng), ext(rng), ext(rng)),
+                vec3(ext(rng), ext(rng), ext(rng))
+                );
+        triangles[i].prim_id = static_cast<unsigned>(i);
+    }
+
+    binned_sah_builder builder;
+    return builder.build(blas_type{}, triangles.data(), triangles.size());
+}
+
+template <typename TLAS>
+static void check_tlas(TLAS const& tlas, std::vector<unsigned> const& ids)
+{
+    auto const& tree = tlas.tree();
+
+    // Bounds of all reachable nodes contain their children
+    traverse_depth_first(tree, [&](bvh_node const& node)
+    {
+        aabb bounds = node.get_bounds();
+
+        if (is_inner(node))
+        {
+            EXPECT_TRUE(bounds.contains(tree.node(node.get_child(0)).get_bounds()));
+            EXPECT_TRUE(bounds.contains(tree.node(node.get_child(1)).get_bounds()));
+        }
+        else
+        {
+            for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+            {
+                EXPECT_TRUE(tlas.is_active(tree.indices()[i]));
+                EXPECT_TRUE(bounds.contains(get_bounds(tree.primitive(i))));
+            }
+        }
+    });
+
+    // Compare with a top-level BVH that is built from scratch
+    aligned_vector<typename TLAS::instance_type> instances;
+
+    for (unsigned id : ids)
+    {
+        instances.push_back(tree.primitives()[id]);
+    }
+
+    binned_sah_builder builder;
+    auto reference = builder.build(index_bvh<typename TLAS::instance_type>{}, instances.data(), instances.size());
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = intersect(r, reference);
+        auto hr2 = intersect(r, tree);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test top-level BVH updates
+//
+
+TEST(TopLevelBVH, Update)
+{
+    auto blas = make_blas();
+
+    top_level_bvh<blas_type::bvh_inst> tlas;
+    tlas.set_num_threads(4);
+
+    std::default_random_engine rng(2);
+    std::uniform_real_distribution<float> pos(-50.0f, 50.0f);
+
+    auto random_transform = [&]()
+    {
+        return mat4::translation(vec3(pos(rng), pos(rng), pos(rng)));
+    };
+
+    std::vector<unsigned> ids;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        ids.push_back(tlas.add(blas.ref(), random_transform()));
+    }
+
+    EXPECT_TRUE(tlas.update());
+    EXPECT_EQ(tlas.num_instances(), size_t(2000));
+    check_tlas(tlas, ids);
+
+    // Side table
+    mat4 m = random_transform();
+    tlas.set_transform(ids[0], m);
+    EXPECT_TRUE(tlas.transform(ids[0]) == m);
+
+    // Move some instances a bit
+    for (int i = 0; i < 20; ++i)
+    {
+        mat4 t = tlas.transform(ids[i]);
+        tlas.set_transform(ids[i], mat4::translation(vec3(0.5f, 0.0f, -0.5f)) * t);
+    }
+
+    EXPECT_FALSE(tlas.update());
+    check_tlas(tlas, ids);
+
+    // Remove and add instances, ids of removed instances are reused
+    for (int i = 0; i < 50; ++i)
+    {
+        tlas.remove(ids.back());
+        ids.pop_back();
+    }
+
+    for (int i = 0; i < 20; ++i)
+    {
+        ids.push_back(tlas.add(blas.ref(), random_transform()));
+        EXPECT_TRUE(ids.back() < 2000U);
+    }
+
+    EXPECT_FALSE(tlas.update());
+    EXPECT_EQ(tlas.num_instances(), ids.size());
+    check_tlas(tlas, ids);
+
+    // Move all instances
+    for (unsigned id : ids)
+    {
+        tlas.set_transform(id, random_transform());
+    }
+
+    tlas.update();
+    check_tlas(tlas, ids);
+
+    // Remove everything
+    for (unsigned id : ids)
+    {
+        tlas.remove(id);
+    }
+
+    tlas.update();
+    EXPECT_EQ(tlas.num_instances(), size_t(0));
+    EXPECT_EQ(tlas.tree().num_nodes(), size_t(0));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Insert next to an instance that was moved, but not yet refitted
+//
+
+TEST(TopLevelBVH, InsertAfterMove)
+{
+    auto blas = make_blas();
+
+    top_level_bvh<blas_type::bvh_inst> tlas;
+    tlas.set_num_threads(4);
+
+    std::vector<unsigned> ids;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        vec3 pos(static_cast<float>(i % 4), static_cast<float>((i / 4) % 4), static_cast<float>(i / 16));
+        ids.push_back(tlas.add(blas.ref(), mat4::translation(pos * 4.0f)));
+    }
+
+    EXPECT_TRUE(tlas.update());
+
+    // Move an instance away, the new instance then lands on its (dirty) leaf
+    unsigned a = ids[21];
+    mat4 old_transform = tlas.transform(a);
+    vec3 target(0.0f, 40.0f, 0.0f);
+
+    tlas.set_transform(a, mat4::translation(target));
+    ids.push_back(tlas.add(blas.ref(), old_transform));
+
+    EXPECT_FALSE(tlas.update());
+    check_tlas(tlas, ids);
+
+    // Rays hit the moved instance
+    auto const& inst = tlas.tree().primitives()[a];
+
+    std::default_random_engine rng(3);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+
+    int num_hits = 0;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        // Shoot from above, the other instances are below the moved one
+        vec3 ori = target + vec3(0.0f, 20.0f, 0.0f);
+        basic_ray<float> r(ori, normalize(target + vec3(dist(rng), dist(rng), dist(rng)) - ori));
+
+        auto hr1 = intersect(r, inst);
+        auto hr2 = intersect(r, tlas.tree());
+
+        if (hr1.hit)
+        {
+            EXPECT_TRUE(hr2.hit);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            ++num_hits;
+        }
+    }
+
+    EXPECT_TRUE(num_hits > 0);
+}
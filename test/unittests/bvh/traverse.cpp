@@ -1,6 +1,10 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <random>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/aligned_vector.h>
 #include <visionaray/bvh.h>
 
 #include <gtest/gtest.h>
@@ -346,3 +350,197 @@ TEST(BVH, TraverseParents)
         }
         );
 }
+
+
+//-------------------------------------------------------------------------------------------------
+// Test ray packet traversal against single ray traversal
+//
+
+template <typename T>
+void check_packet_traversal(index_bvh<basic_triangle<3, float>> const& tree, bool coherent)
+{
+    enum { N = simd::num_elements<T>::value };
+
+    using ray_array = array<basic_ray<float>, N>;
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        ray_array rays;
+
+        vec3 ori(dist(rng), dist(rng), dist(rng));
+        vec3 dir(dist(rng), dist(rng), dist(rng));
+
+        for (int j = 0; j < N; ++j)
+        {
+            if (coherent)
+            {
+                rays[j] = basic_ray<float>(ori, normalize(dir + vec3(dist(rng), dist(rng), dist(rng)) * 0.01f));
+            }
+            else
+            {
+                rays[j] = basic_ray<float>(
+                        vec3(dist(rng), dist(rng), dist(rng)),
+                        normalize(vec3(dist(rng), dist(rng), dist(rng)))
+                        );
+            }
+        }
+
+        auto packet = simd::pack(rays);
+
+        auto hrs = simd::unpack(intersect(packet, tree));
+
+        default_intersector isect;
+        auto any_hrs = simd::unpack(intersect<detail::AnyHit>(packet, tree, isect));
+
+        for (int j = 0; j < N; ++j)
+        {
+            auto hr = intersect(rays[j], tree);
+
+            EXPECT_EQ(hrs[j].hit, hr.hit);
+            EXPECT_EQ(any_hrs[j].hit, hr.hit);
+
+            if (hr.hit)
+            {
+                EXPECT_EQ(hrs[j].prim_id, hr.prim_id);
+                EXPECT_FLOAT_EQ(hrs[j].t, hr.t);
+            }
+        }
+    }
+}
+
+TEST(BVH, PacketTraversal)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> ext(-0.05f, 0.05f);
+
+    aligned_vector<basic_triangle<3, float>> triangles(5000);
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i] = basic_triangle<3, float>(
+                vec3(pos(rng), pos(rng), pos(rng)),
+                vec3(ext(rng), ext(rng), ext(rng)),
+                vec3(ext(rng), ext(rng), ext(rng))
+                );
+        triangles[i].prim_id = static_cast<unsigned>(i);
+    }
+
+    binned_sah_builder builder;
+    auto tree = builder.build(index_bvh<basic_triangle<3, float>>{}, triangles.data(), triangles.size());
+
+    // Incoherent packets fall back to single ray traversal
+    EXPECT_TRUE((detail::supports_lane_compaction<
+            detail::ClosestHit,
+            basic_ray<simd::float4>,
+            index_bvh<basic_triangle<3, float>>,
+            default_intersector,
+            is_closer_t
+            >::value));
+
+    check_packet_traversal<simd::float4>(tree, true);
+    check_packet_traversal<simd::float4>(tree, false);
+
+    // float8 is emulated with bool masks on SSE-only builds (the default configuration)
+    check_packet_traversal<simd::float8>(tree, true);
+    check_packet_traversal<simd::float8>(tree, false);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test BVHs with triangle packet leaves against BVHs with triangle leaves
+//
+
+template <typename PackedBVH, typename BVH>
+void check_packed_traversal(PackedBVH const& packed, BVH const& tree)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(
+                vec3(dist(rng), dist(rng), dist(rng)),
+                normalize(vec3(dist(rng), dist(rng), dist(rng)))
+                );
+
+        auto hr1 = intersect(r, tree);
+        auto hr2 = intersect(r, packed);
+
+        default_intersector isect;
+        auto any_hr = intersect<detail::AnyHit>(r, packed, isect);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+        EXPECT_EQ(any_hr.hit, hr1.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_EQ(hr2.prim_id, hr1.prim_id);
+            EXPECT_FLOAT_EQ(hr2.t, hr1.t);
+            EXPECT_FLOAT_EQ(hr2.u, hr1.u);
+            EXPECT_FLOAT_EQ(hr2.v, hr1.v);
+
+            // The lane identifies the triangle that was hit
+            auto t = get_triangle(packed.primitive(hr2.primitive_list_index), hr2.lane);
+            EXPECT_EQ(t.prim_id, hr1.prim_id);
+        }
+    }
+}
+
+TEST(BVH, TrianglePacketLeaves)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> ext(-0.05f, 0.05f);
+
+    aligned_vector<basic_triangle<3, float>> triangles(5000);
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i] = basic_triangle<3, float>(
+                vec3(pos(rng), pos(rng), pos(rng)),
+                vec3(ext(rng), ext(rng), ext(rng)),
+                vec3(ext(rng), ext(rng), ext(rng))
+                );
+        triangles[i].prim_id = static_cast<unsigned>(i);
+    }
+
+    binned_sah_builder builder;
+    auto tree4 = builder.build(index_bvh<basic_triangle<3, float>>{}, triangles.data(), triangles.size(), 4);
+    auto tree8 = builder.build(index_bvh<basic_triangle<3, float>>{}, triangles.data(), triangles.size(), 8);
+
+    bvh<triangle4> packed4;
+    pack_leaves(packed4, tree4);
+
+    bvh<triangle8> packed8;
+    pack_leaves(packed8, tree8);
+
+    // Leaves hold a single packet, the bounds are unchanged
+    for (size_t i = 0; i < packed4.num_nodes(); ++i)
+    {
+        auto const& n = packed4.node(i);
+
+        if (is_leaf(n))
+        {
+            EXPECT_EQ(n.get_num_primitives(), 1U);
+
+            aabb b = get_bounds(packed4.primitive(n.get_first_primitive()));
+            EXPECT_TRUE(n.get_bounds().contains(b));
+        }
+    }
+
+    check_packed_traversal(packed4, tree4);
+    check_packed_traversal(packed8, tree8);
+
+    // Leaves with more than N triangles hold several packets
+    bvh<triangle4> packed_large;
+    pack_leaves(packed_large, tree8);
+    check_packed_traversal(packed_large, tree8);
+
+    bvh4<triangle4> wide;
+    collapse(wide, packed4);
+    check_packed_traversal(wide, tree4);
+}
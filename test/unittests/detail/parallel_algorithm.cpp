@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <array>
 #include <cstdlib>
+#include <random>
 #include <vector>
 
 #include <visionaray/detail/parallel_algorithm.h>
@@ -114,3 +115,78 @@ TEST(ParallelAlgorithm, CountingSort)
 }
 
 #endif // VSNRAY_HAVE_TBB
+
+
+//-------------------------------------------------------------------------------------------------
+// Test radix_sort()
+//
+
+TEST(ParallelAlgorithm, RadixSort)
+{
+    thread_pool pool(4);
+
+    // Array of unsigned ints
+    {
+        std::vector<unsigned> a{3, 1, 4, 3, 2, 1, 8, 7, 7, 7, 0xFFFFFFFF, 0x80000000};
+        std::vector<unsigned> b(a);
+        std::vector<unsigned> temp(a.size());
+
+        paralgo::radix_sort(pool, a.begin(), a.end(), temp.begin(), [](unsigned k) { return k; }, 32);
+        EXPECT_TRUE(std::is_sorted(a.begin(), a.end()));
+
+        std::sort(b.begin(), b.end());
+        EXPECT_TRUE(a == b);
+    }
+
+    // Larger array of 64-bit keys
+    {
+        static const size_t N = 1000000;
+
+        std::default_random_engine rng;
+        std::uniform_int_distribution<unsigned long long> dist(0, (1ULL << 63) - 1);
+
+        std::vector<unsigned long long> a(N);
+        std::vector<unsigned long long> temp(N);
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            a[i] = dist(rng);
+        }
+
+        std::vector<unsigned long long> b(a);
+
+        paralgo::radix_sort(pool, a.begin(), a.end(), temp.begin(), [](unsigned long long k) { return k; }, 63);
+
+        std::sort(b.begin(), b.end());
+        EXPECT_TRUE(a == b);
+    }
+
+    // Stability, only the lower bits are considered
+    {
+        static const size_t N = 100000;
+
+        struct item
+        {
+            unsigned key;
+            size_t index;
+        };
+
+        std::vector<item> a(N);
+        std::vector<item> temp(N);
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            a[i].key = static_cast<unsigned>(rand());
+            a[i].index = i;
+        }
+
+        paralgo::radix_sort(pool, a.begin(), a.end(), temp.begin(), [](item const& it) { return it.key & 0x3FFu; }, 10);
+
+        for (size_t i = 1; i < N; ++i)
+        {
+            auto k1 = a[i - 1].key & 0x3FFu;
+            auto k2 = a[i].key & 0x3FFu;
+            EXPECT_TRUE(k1 < k2 || (k1 == k2 && a[i - 1].index < a[i].index));
+        }
+    }
+}
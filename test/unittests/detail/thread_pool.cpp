@@ -0,0 +1,118 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <visionaray/detail/parallel_for.h>
+#include <visionaray/detail/range.h>
+#include <visionaray/detail/thread_pool.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test thread_pool::run()
+//
+
+TEST(ThreadPool, Run)
+{
+    for (unsigned num_threads : { 0U, 1U, 4U })
+    {
+        thread_pool pool(num_threads);
+
+        // Empty queue
+        pool.run([](long) { ADD_FAILURE(); }, 0);
+
+        // Each item is processed exactly once
+        for (long n : { 1L, 3L, 1000L, 100000L })
+        {
+            std::vector<std::atomic<int>> counts(n);
+
+            for (auto& c : counts)
+            {
+                c = 0;
+            }
+
+            pool.run([&](long i) { ++counts[i]; }, n);
+
+            for (auto const& c : counts)
+            {
+                EXPECT_EQ(c, 1);
+            }
+        }
+
+        // Many small runs in a row
+        std::atomic<long> sum(0);
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            pool.run([&](long j) { sum += j; }, 4);
+        }
+
+        EXPECT_EQ(sum, 6000);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test load balancing and nested parallelism
+//
+
+TEST(ThreadPool, WorkStealing)
+{
+    thread_pool pool(4);
+    pool.set_spin_time(std::chrono::microseconds(0));
+
+    // Unbalanced work items, all the expensive ones are in the first range
+    std::atomic<int> count(0);
+
+    pool.run([&](long i)
+        {
+            if (i < 8)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+
+            ++count;
+
+        }, 64);
+
+    EXPECT_EQ(count, 64);
+
+    // Nested parallel_for
+    std::vector<std::atomic<int>> counts(64 * 64);
+
+    for (auto& c : counts)
+    {
+        c = 0;
+    }
+
+    parallel_for(pool, range1d<int>(0, 64), [&](int i)
+    {
+        parallel_for(pool, tiled_range1d<int>(0, 64, 4), [&](range1d<int> const& r)
+        {
+            for (int j = r.begin(); j != r.end(); ++j)
+            {
+                ++counts[i * 64 + j];
+            }
+        });
+    });
+
+    for (auto const& c : counts)
+    {
+        EXPECT_EQ(c, 1);
+    }
+
+    // Reset while idle
+    pool.reset(2);
+    EXPECT_EQ(pool.num_threads, 2U);
+
+    count = 0;
+    pool.run([&](long) { ++count; }, 100);
+    EXPECT_EQ(count, 100);
+}
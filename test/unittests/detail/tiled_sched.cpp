@@ -0,0 +1,89 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <visionaray/detail/range.h>
+#include <visionaray/scheduler.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test adaptive tile scheduling
+//
+
+TEST(TiledSched, Adaptive)
+{
+    tiled_sched_backend backend(2, tiled_sched_mode::adaptive);
+
+    // 64x48 pixels, 16x16 tiles, 4x4 packets, hot tile at [32..48)x[16..32)
+    int width = 64;
+    int height = 48;
+    tiled_range2d<int> tr(0, width, 16, 0, height, 16);
+
+    auto is_hot = [](int x, int y)
+    {
+        return x >= 32 && x < 48 && y >= 16 && y < 32;
+    };
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        std::vector<std::atomic<int>> counts((width / 4) * (height / 4));
+        std::vector<int> seq((width / 4) * (height / 4));
+
+        for (auto& c : counts)
+        {
+            c = 0;
+        }
+
+        std::atomic<int> counter(0);
+
+        backend.for_each_packet(tr, 4, 4, [&](int x, int y)
+        {
+            int i = (y / 4) * (width / 4) + x / 4;
+
+            ++counts[i];
+            seq[i] = counter++;
+
+            if (is_hot(x, y))
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        });
+
+        // Each packet is processed exactly once, no matter how tiles were split
+        for (auto const& c : counts)
+        {
+            EXPECT_EQ(c, 1);
+        }
+
+        if (frame > 0)
+        {
+            // The hot tile is processed first
+            for (int y = 0; y < height; y += 4)
+            {
+                for (int x = 0; x < width; x += 4)
+                {
+                    if (seq[(y / 4) * (width / 4) + x / 4] == 0)
+                    {
+                        EXPECT_TRUE(is_hot(x, y));
+                    }
+                }
+            }
+        }
+    }
+
+    // Switching modes
+    backend.set_mode(tiled_sched_mode::fixed);
+    EXPECT_TRUE(backend.mode() == tiled_sched_mode::fixed);
+
+    std::atomic<int> num_packets(0);
+    backend.for_each_packet(tr, 4, 4, [&](int, int) { ++num_packets; });
+    EXPECT_EQ(num_packets, (width / 4) * (height / 4));
+}
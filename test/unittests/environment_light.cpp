@@ -0,0 +1,218 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/distribution_2d.h>
+#include <visionaray/environment_light.h>
+#include <visionaray/random_generator.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Sky with a small, bright sun
+//
+
+static texture<vec4, 2> make_sky(int width, int height)
+{
+    std::vector<vec4> texels(width * height);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            bool sun = x >= 10 && x < 12 && y >= 6 && y < 8;
+            texels[y * width + x] = sun ? vec4(500.0f, 450.0f, 400.0f, 1.0f) : vec4(0.3f, 0.4f, 0.6f, 1.0f);
+        }
+    }
+
+    texture<vec4, 2> tex(width, height);
+    tex.set_address_mode(Wrap);
+    tex.set_filter_mode(Nearest);
+    tex.reset(texels.data());
+    return tex;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Piecewise-constant 2D distribution
+//
+
+TEST(Distribution2D, Sample)
+{
+    int width = 8;
+    int height = 4;
+
+    std::vector<float> func(width * height);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        func[i] = static_cast<float>(i % 5);
+    }
+
+    // Zero row
+    for (int x = 0; x < width; ++x)
+    {
+        func[2 * width + x] = 0.0f;
+    }
+
+    distribution_2d dist;
+    dist.build(func.data(), width, height);
+
+    auto ref = dist.ref();
+
+    // pdf integrates to one over [0,1)^2
+    double integral = 0.0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            integral += ref.pdf(vec2((x + 0.5f) / width, (y + 0.5f) / height)) / (width * height);
+        }
+    }
+
+    EXPECT_NEAR(integral, 1.0, 1e-5);
+
+    // Sample frequencies match the function
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+
+    int num_samples = 100000;
+    std::vector<int> counts(width * height);
+
+    for (int i = 0; i < num_samples; ++i)
+    {
+        float pdf = 0.0f;
+        vec2 s = ref.sample(vec2(u01(rng), u01(rng)), pdf);
+
+        ASSERT_GE(s.x, 0.0f);
+        ASSERT_LT(s.x, 1.0f);
+        ASSERT_GE(s.y, 0.0f);
+        ASSERT_LT(s.y, 1.0f);
+
+        EXPECT_GT(pdf, 0.0f);
+        EXPECT_FLOAT_EQ(pdf, ref.pdf(s));
+
+        ++counts[static_cast<int>(s.y * height) * width + static_cast<int>(s.x * width)];
+    }
+
+    float sum = 0.0f;
+
+    for (float f : func)
+    {
+        sum += f;
+    }
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        float expected = func[i] / sum * num_samples;
+        EXPECT_NEAR(counts[i], expected, 5.0f * std::sqrt(expected) + 1.0f);
+    }
+
+    // Functions that are zero everywhere result in a uniform distribution
+    std::vector<float> zero(width * height, 0.0f);
+    dist.build(zero.data(), width, height);
+    ref = dist.ref();
+
+    float pdf = 0.0f;
+    ref.sample(vec2(0.3f, 0.7f), pdf);
+    EXPECT_FLOAT_EQ(pdf, 1.0f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Sampled directions and pdf() are consistent, pdf() integrates to one over the sphere
+//
+
+TEST(EnvironmentLight, Sample)
+{
+    auto sky = make_sky(32, 16);
+
+    distribution_2d dist;
+    make_environment_distribution(dist, sky);
+
+    environment_light<float, texture_ref<vec4, 2>> env;
+    env.texture() = texture_ref<vec4, 2>(sky);
+    env.scale() = from_rgb(vec3(1.0f));
+    env.set_light_to_world_transform(mat4::rotation(normalize(vec3(1.0f, 2.0f, 0.5f)), 0.7f));
+    env.set_distribution(dist.ref());
+
+    random_generator<float> gen(1);
+
+    int num_sun = 0;
+    int num_mismatches = 0;
+    int num_samples = 10000;
+
+    for (int i = 0; i < num_samples; ++i)
+    {
+        float pdf = 0.0f;
+        vec3 dir = env.sample(gen, pdf);
+
+        EXPECT_NEAR(length(dir), 1.0f, 1e-5f);
+        EXPECT_GE(pdf, 0.0f);
+
+        // u = 0 maps to the pole where the pdf w.r.t. solid angle is undefined
+        if (pdf == 0.0f)
+        {
+            EXPECT_NEAR(std::abs(dot(dir, env.light_to_world_transform()(1).xyz())), 1.0f, 1e-5f);
+            continue;
+        }
+
+        // Directions close to texel boundaries may map back to the neighboring texel
+        num_mismatches += std::abs(env.pdf(dir) - pdf) > 1e-3f * pdf ? 1 : 0;
+
+        // The sun covers 1/128 of the texels but dominates the power
+        num_sun += env.intensity(dir).x > 100.0f ? 1 : 0;
+    }
+
+    EXPECT_LT(num_mismatches, num_samples / 100);
+    EXPECT_GT(num_sun, num_samples / 2);
+
+    // Monte Carlo estimate of the integral of pdf() over the sphere
+    double integral = 0.0;
+    int num_dirs = 200000;
+
+    for (int i = 0; i < num_dirs; ++i)
+    {
+        float z = 1.0f - 2.0f * gen.next();
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi = constants::two_pi<float>() * gen.next();
+        vec3 dir(r * std::cos(phi), r * std::sin(phi), z);
+
+        integral += env.pdf(dir) * 4.0 * constants::pi<double>() / num_dirs;
+    }
+
+    EXPECT_NEAR(integral, 1.0, 0.05);
+
+    // Packets
+    random_generator<simd::float4> gen4(array<unsigned, 4>{{ 1, 2, 3, 4 }});
+
+    simd::float4 pdf4;
+    auto dir4 = env.sample(gen4, pdf4);
+
+    simd::aligned_array_t<simd::float4> pdfs;
+    simd::aligned_array_t<simd::float4> ref_pdfs;
+    store(pdfs, pdf4);
+    store(ref_pdfs, env.pdf(dir4));
+
+    auto dirs = simd::unpack(dir4);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (pdfs[i] == 0.0f)
+        {
+            continue;
+        }
+
+        EXPECT_NEAR(ref_pdfs[i], env.pdf(dirs[i]), 1e-3f * ref_pdfs[i]);
+    }
+}
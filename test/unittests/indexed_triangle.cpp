@@ -0,0 +1,305 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <random>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/get_area.h>
+#include <visionaray/get_color.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/get_shading_normal.h>
+#include <visionaray/get_surface.h>
+#include <visionaray/get_tex_coord.h>
+#include <visionaray/intersector.h>
+#include <visionaray/kernels.h>
+#include <visionaray/material.h>
+#include <visionaray/point_light.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Height field with shared vertices, and the same mesh with one triangle per face
+//
+
+struct test_mesh
+{
+    aligned_vector<vec3> vertices;
+    aligned_vector<vec3> normals;
+    aligned_vector<vec2> tex_coords;
+
+    aligned_vector<basic_indexed_triangle<float>> indexed_triangles;
+    aligned_vector<basic_indexed_triangle_ref<float>> indexed_triangle_refs;
+    aligned_vector<basic_triangle<3, float>> triangles;
+
+    // Per-corner attributes for the triangles
+    aligned_vector<vec3> corner_normals;
+    aligned_vector<vec2> corner_tex_coords;
+
+    explicit test_mesh(int n)
+    {
+        std::default_random_engine rng(0);
+        std::uniform_real_distribution<float> dist(-0.1f, 0.1f);
+
+        for (int y = 0; y <= n; ++y)
+        {
+            for (int x = 0; x <= n; ++x)
+            {
+                float u = x / static_cast<float>(n);
+                float v = y / static_cast<float>(n);
+
+                vertices.emplace_back(u * 2.0f - 1.0f, dist(rng), v * 2.0f - 1.0f);
+                normals.push_back(normalize(vec3(dist(rng), 1.0f, dist(rng))));
+                tex_coords.emplace_back(u, v);
+            }
+        }
+
+        auto add = [&](unsigned i1, unsigned i2, unsigned i3)
+        {
+            basic_indexed_triangle<float> it(i1, i2, i3);
+            it.prim_id = static_cast<unsigned>(indexed_triangles.size());
+            it.geom_id = 0;
+            indexed_triangles.push_back(it);
+
+            basic_triangle<3, float> t(vertices[i1], vertices[i2] - vertices[i1], vertices[i3] - vertices[i1]);
+            t.prim_id = it.prim_id;
+            t.geom_id = 0;
+            triangles.push_back(t);
+
+            for (unsigned i : { i1, i2, i3 })
+            {
+                corner_normals.push_back(normals[i]);
+                corner_tex_coords.push_back(tex_coords[i]);
+            }
+        };
+
+        unsigned stride = static_cast<unsigned>(n + 1);
+
+        for (unsigned y = 0; y < static_cast<unsigned>(n); ++y)
+        {
+            for (unsigned x = 0; x < static_cast<unsigned>(n); ++x)
+            {
+                unsigned i = y * stride + x;
+                add(i, i + 1, i + stride);
+                add(i + 1, i + stride + 1, i + stride);
+            }
+        }
+
+        for (auto const& it : indexed_triangles)
+        {
+            indexed_triangle_refs.emplace_back(it, vertices.data());
+        }
+    }
+};
+
+
+TEST(IndexedTriangle, Geometry)
+{
+    test_mesh mesh(8);
+
+    for (size_t i = 0; i < mesh.triangles.size(); ++i)
+    {
+        auto const& it = mesh.indexed_triangles[i];
+        auto const& ref = mesh.indexed_triangle_refs[i];
+        auto const& t = mesh.triangles[i];
+
+        aabb b1 = get_bounds(it, mesh.vertices.data());
+        aabb b2 = get_bounds(t);
+
+        // Triangle vertices are reconstructed from edges, allow for rounding
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            EXPECT_NEAR(b1.min[axis], b2.min[axis], 1e-6f);
+            EXPECT_NEAR(b1.max[axis], b2.max[axis], 1e-6f);
+        }
+
+        EXPECT_FLOAT_EQ(area(it, mesh.vertices.data()), area(t));
+
+        aabb b3 = get_bounds(ref);
+        EXPECT_TRUE(b1.contains(b3) && b3.contains(b1));
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float plane = (b2.min[axis] + b2.max[axis]) * 0.5f;
+
+            aabb L1;
+            aabb R1;
+            split_primitive(L1, R1, plane, axis, ref);
+
+            aabb L2;
+            aabb R2;
+            split_primitive(L2, R2, plane, axis, t);
+
+            EXPECT_TRUE(L1.contains(L2) && L2.contains(L1));
+            EXPECT_TRUE(R1.contains(R2) && R2.contains(R1));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Traverse BVHs of indexed triangles and compare with BVHs of triangles
+//
+
+TEST(IndexedTriangle, Traverse)
+{
+    test_mesh mesh(64);
+
+    binned_sah_builder builder;
+    builder.enable_spatial_splits(true);
+
+    auto tree1 = builder.build(
+            index_bvh<basic_indexed_triangle<float>>{},
+            mesh.indexed_triangle_refs.data(),
+            mesh.indexed_triangle_refs.size()
+            );
+
+    auto tree2 = builder.build(
+            index_bvh<basic_triangle<3, float>>{},
+            mesh.triangles.data(),
+            mesh.triangles.size()
+            );
+
+    // The tree only stores the indices
+    for (size_t i = 0; i < tree1.num_primitives(); ++i)
+    {
+        auto const& it = tree1.primitive(i);
+        auto const& expected = mesh.indexed_triangles[it.prim_id];
+
+        EXPECT_EQ(it.index[0], expected.index[0]);
+        EXPECT_EQ(it.index[1], expected.index[1]);
+        EXPECT_EQ(it.index[2], expected.index[2]);
+    }
+
+    indexed_triangle_intersector<float> isect(mesh.vertices.data());
+
+    auto ref1 = tree1.ref();
+    auto ref2 = tree2.ref();
+
+    aligned_vector<plastic<float>> materials(1);
+
+    auto params1 = make_kernel_params(
+            normals_per_vertex_binding{},
+            &ref1,
+            &ref1 + 1,
+            static_cast<vec3*>(nullptr),
+            mesh.normals.data(),
+            materials.data(),
+            static_cast<point_light<float>*>(nullptr),
+            static_cast<point_light<float>*>(nullptr)
+            );
+    params1.vertices = mesh.vertices.data();
+
+    auto params2 = make_kernel_params(
+            normals_per_vertex_binding{},
+            &ref2,
+            &ref2 + 1,
+            static_cast<vec3*>(nullptr),
+            mesh.corner_normals.data(),
+            materials.data(),
+            static_cast<point_light<float>*>(nullptr),
+            static_cast<point_light<float>*>(nullptr)
+            );
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    int num_hits = 0;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(
+                vec3(dist(rng), 1.0f, dist(rng)),
+                normalize(vec3(dist(rng) * 0.5f, -1.0f, dist(rng) * 0.5f))
+                );
+
+        auto hr1 = intersect(r, tree1, isect);
+        auto hr2 = intersect(r, tree2);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (!hr1.hit)
+        {
+            continue;
+        }
+
+        ++num_hits;
+
+        EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+        EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        EXPECT_FLOAT_EQ(hr1.u, hr2.u);
+        EXPECT_FLOAT_EQ(hr1.v, hr2.v);
+
+        // Attributes through the vertex indices match the per-corner attributes
+        auto const& it = tree1.primitive(hr1.primitive_list_index);
+        auto const& t = tree2.primitive(hr2.primitive_list_index);
+
+        vec3 n1 = get_normal(hr1, get_triangle(it, mesh.vertices.data()));
+        vec3 n2 = get_normal(hr2, t);
+        EXPECT_NEAR(dot(n1, n2), 1.0f, 1e-5f);
+
+        vec3 sn1 = get_shading_normal(mesh.normals.data(), hr1, it, normals_per_vertex_binding{});
+        vec3 sn2 = get_shading_normal(mesh.corner_normals.data(), hr2, t, normals_per_vertex_binding{});
+        EXPECT_FLOAT_EQ(sn1.x, sn2.x);
+        EXPECT_FLOAT_EQ(sn1.y, sn2.y);
+        EXPECT_FLOAT_EQ(sn1.z, sn2.z);
+
+        vec2 tc1 = get_tex_coord(mesh.tex_coords.data(), hr1, it);
+        vec2 tc2 = get_tex_coord(mesh.corner_tex_coords.data(), hr2, t);
+        EXPECT_FLOAT_EQ(tc1.x, tc2.x);
+        EXPECT_FLOAT_EQ(tc1.y, tc2.y);
+
+        vec3 c1 = get_color(mesh.normals.data(), hr1, it, colors_per_vertex_binding{});
+        vec3 c2 = get_color(mesh.corner_normals.data(), hr2, t, colors_per_vertex_binding{});
+        EXPECT_FLOAT_EQ(c1.x, c2.x);
+        EXPECT_FLOAT_EQ(c1.y, c2.y);
+        EXPECT_FLOAT_EQ(c1.z, c2.z);
+
+        // get_surface() fetches the vertices from the kernel params
+        auto surf1 = get_surface(hr1, params1);
+        auto surf2 = get_surface(hr2, params2);
+        EXPECT_NEAR(dot(surf1.geometric_normal, surf2.geometric_normal), 1.0f, 1e-5f);
+        EXPECT_FLOAT_EQ(surf1.shading_normal.x, surf2.shading_normal.x);
+        EXPECT_FLOAT_EQ(surf1.shading_normal.y, surf2.shading_normal.y);
+        EXPECT_FLOAT_EQ(surf1.shading_normal.z, surf2.shading_normal.z);
+
+        // The path tracer's light pdf needs the area of the primitive that was hit
+        EXPECT_FLOAT_EQ(detail::get_area(params1, hr1), detail::get_area(params2, hr2));
+    }
+
+    EXPECT_GT(num_hits, 500);
+
+    // Ray packets
+    for (int i = 0; i < 100; ++i)
+    {
+        array<basic_ray<float>, 4> rays;
+
+        for (auto& r : rays)
+        {
+            r = basic_ray<float>(
+                    vec3(dist(rng), 1.0f, dist(rng)),
+                    normalize(vec3(dist(rng) * 0.5f, -1.0f, dist(rng) * 0.5f))
+                    );
+        }
+
+        auto hrs1 = simd::unpack(intersect(simd::pack(rays), tree1, isect));
+        auto hrs2 = simd::unpack(intersect(simd::pack(rays), tree2));
+
+        for (int j = 0; j < 4; ++j)
+        {
+            ASSERT_EQ(hrs1[j].hit, hrs2[j].hit);
+
+            if (hrs1[j].hit)
+            {
+                EXPECT_EQ(hrs1[j].prim_id, hrs2[j].prim_id);
+                EXPECT_FLOAT_EQ(hrs1[j].t, hrs2[j].t);
+            }
+        }
+    }
+}
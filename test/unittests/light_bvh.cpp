@@ -0,0 +1,262 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/area_light.h>
+#include <visionaray/generic_light.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/light_bvh.h>
+#include <visionaray/point_light.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/spot_light.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helper functions
+//
+
+static point_light<float> make_point_light(vec3 pos, float power)
+{
+    point_light<float> result;
+    result.set_position(pos);
+    result.set_cl(vec3(power));
+    result.set_kl(1.0f);
+    result.set_constant_attenuation(1.0f);
+    result.set_linear_attenuation(0.0f);
+    result.set_quadratic_attenuation(0.0f);
+    return result;
+}
+
+// Emissive triangles scattered over a box, facing in random directions
+static aligned_vector<area_light<float, basic_triangle<3, float>>> make_area_lights(int count)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> power(0.1f, 2.0f);
+
+    aligned_vector<area_light<float, basic_triangle<3, float>>> result;
+
+    for (int i = 0; i < count; ++i)
+    {
+        vec3 v1(dist(rng) * 10.0f, dist(rng) * 10.0f, dist(rng) * 10.0f);
+        vec3 e1(dist(rng), dist(rng), dist(rng));
+        vec3 e2(dist(rng), dist(rng), dist(rng));
+
+        basic_triangle<3, float> t(v1, e1, e2);
+        t.prim_id = static_cast<unsigned>(i * 3); // not contiguous
+        t.geom_id = 0;
+
+        area_light<float, basic_triangle<3, float>> light(t);
+        light.set_cl(vec3(power(rng)));
+        light.set_kl(1.0f);
+        result.push_back(light);
+    }
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Light selection probabilities form a distribution, and sample() selects lights with
+// the probabilities pmf() reports
+//
+
+TEST(LightBVH, PMF)
+{
+    auto lights = make_area_lights(200);
+
+    light_bvh bvh;
+    bvh.build(lights.data(), lights.size());
+
+    auto ref = bvh.ref();
+
+    EXPECT_EQ(bvh.num_nodes(), 2 * lights.size() - 1);
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-12.0f, 12.0f);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        vec3 p(dist(rng), dist(rng), dist(rng));
+
+        double sum = 0.0;
+        std::vector<float> pmfs(lights.size());
+
+        for (size_t j = 0; j < lights.size(); ++j)
+        {
+            pmfs[j] = ref.pmf(p, static_cast<unsigned>(j));
+            EXPECT_GE(pmfs[j], 0.0f);
+            sum += pmfs[j];
+        }
+
+        EXPECT_NEAR(sum, 1.0, 1e-4);
+
+        int num_samples = 20000;
+        std::vector<int> counts(lights.size());
+
+        for (int s = 0; s < num_samples; ++s)
+        {
+            float pmf = 0.0f;
+            int index = ref.sample(p, u01(rng), pmf);
+
+            ASSERT_GE(index, 0);
+            ASSERT_LT(index, static_cast<int>(lights.size()));
+            EXPECT_FLOAT_EQ(pmf, pmfs[index]);
+
+            ++counts[index];
+        }
+
+        for (size_t j = 0; j < lights.size(); ++j)
+        {
+            float expected = pmfs[j] * num_samples;
+            EXPECT_NEAR(counts[j], expected, 5.0f * std::sqrt(expected) + 3.0f);
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Nearer, brighter and facing lights are preferred
+//
+
+TEST(LightBVH, Importance)
+{
+    aligned_vector<point_light<float>> points;
+    points.push_back(make_point_light(vec3(1.0f, 0.0f, 0.0f), 1.0f));
+    points.push_back(make_point_light(vec3(10.0f, 0.0f, 0.0f), 1.0f));
+    points.push_back(make_point_light(vec3(-10.0f, 0.0f, 0.0f), 10.0f));
+    points.push_back(make_point_light(vec3(0.0f, 5.0f, 0.0f), 0.0f)); // no power
+
+    light_bvh bvh;
+    bvh.build(points.data(), points.size());
+
+    auto ref = bvh.ref();
+    vec3 p(0.0f);
+
+    EXPECT_GT(ref.pmf(p, 0), ref.pmf(p, 1));
+    EXPECT_GT(ref.pmf(p, 2), ref.pmf(p, 1));
+    EXPECT_FLOAT_EQ(ref.pmf(p, 3), 0.0f);
+
+
+    // Triangles emit to the side they face and to the back side
+
+    basic_triangle<3, float> t1(vec3(-1.0f, 0.0f, 4.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 2.0f, 0.0f));
+    basic_triangle<3, float> t2(vec3(4.0f, -1.0f, 0.0f), vec3(0.0f, 2.0f, 0.0f), vec3(0.0f, 0.0f, 2.0f));
+    basic_triangle<3, float> t3(vec3(4.0f, 4.0f, -1.0f), vec3(0.0f, 0.0f, 2.0f), vec3(2.0f, 0.0f, 0.0f));
+    t1.geom_id = 0;
+    t1.prim_id = 7;
+    t2.geom_id = 0;
+    t2.prim_id = 3;
+    t3.geom_id = 1;
+    t3.prim_id = 7;
+
+    aligned_vector<area_light<float, basic_triangle<3, float>>> tris;
+
+    for (auto const& t : { t1, t2, t3 })
+    {
+        area_light<float, basic_triangle<3, float>> light(t);
+        light.set_cl(vec3(1.0f));
+        light.set_kl(1.0f);
+        tris.push_back(light);
+    }
+
+    bvh.build(tris.data(), 1);
+
+    auto const& leaf = bvh.node(0);
+    ASSERT_TRUE(leaf.is_leaf());
+
+    // t1 lies in the plane z = 4
+    float front = leaf.importance(vec3(0.0f, 1.0f, 14.0f));
+    float back = leaf.importance(vec3(0.0f, 1.0f, -6.0f));
+    float side = leaf.importance(vec3(10.0f, 1.0f, 4.0f));
+
+    EXPECT_FLOAT_EQ(front, back);
+    EXPECT_GT(front, 2.0f * side);
+
+    bvh.build(tris.data(), tris.size());
+    ref = bvh.ref();
+
+    // Lights are found by geometry and primitive id, t1 and t3 share their prim_id
+    EXPECT_EQ(ref.light_index(0, 7), 0);
+    EXPECT_EQ(ref.light_index(0, 3), 1);
+    EXPECT_EQ(ref.light_index(1, 7), 2);
+    EXPECT_EQ(ref.light_index(0, 4), -1);
+    EXPECT_EQ(ref.light_index(1, 3), -1);
+    EXPECT_EQ(ref.light_index(2, 7), -1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Mixed light types, sample_light() with single rays and packets
+//
+
+TEST(LightBVH, SampleLight)
+{
+    using light_type = generic_light<point_light<float>, spot_light<float>, area_light<float, basic_triangle<3, float>>>;
+
+    auto tris = make_area_lights(20);
+
+    aligned_vector<light_type> lights(tris.begin(), tris.end());
+    lights.push_back(make_point_light(vec3(0.0f, 0.0f, 0.0f), 5.0f));
+
+    spot_light<float> spot;
+    spot.set_position(vec3(0.0f, 20.0f, 0.0f));
+    spot.set_spot_direction(vec3(0.0f, -1.0f, 0.0f));
+    spot.set_spot_cutoff(0.3f);
+    spot.set_spot_exponent(1.0f);
+    spot.set_cl(vec3(5.0f));
+    spot.set_kl(1.0f);
+    spot.set_constant_attenuation(1.0f);
+    spot.set_linear_attenuation(0.0f);
+    spot.set_quadratic_attenuation(0.0f);
+    lights.push_back(spot);
+
+    light_bvh bvh;
+    bvh.build(lights.data(), lights.size());
+
+    auto ref = bvh.ref();
+
+    // Inside and outside the cone of the spot light
+    EXPECT_GT(ref.pmf(vec3(0.0f, 0.0f, 0.0f), 21), 0.0f);
+    EXPECT_FLOAT_EQ(ref.pmf(vec3(20.0f, 0.0f, 0.0f), 21), 0.0f);
+
+    random_generator<float> gen(0);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        // Outside the cone of the spot light, spot lights cannot be sampled yet
+        vec3 p(10.0f + gen.next() * 4.0f, gen.next() * 4.0f, gen.next() * 4.0f);
+
+        float pmf = 0.0f;
+        auto ls = sample_light(ref, lights.data(), p, gen, pmf);
+
+        EXPECT_GT(pmf, 0.0f);
+        EXPECT_LE(pmf, 1.0f);
+        EXPECT_GT(max_element(ls.intensity), 0.0f);
+    }
+
+    random_generator<simd::float4> gen4(array<unsigned, 4>{{ 0, 1, 2, 3 }});
+
+    vector<3, simd::float4> p4(
+            simd::float4(10.0f, 11.0f, 12.0f, 13.0f),
+            simd::float4(1.0f),
+            simd::float4(-1.0f, -2.0f, -3.0f, -4.0f)
+            );
+
+    simd::float4 pmf4;
+    auto ls4 = sample_light(ref, lights.data(), p4, gen4, pmf4);
+
+    EXPECT_TRUE(all(pmf4 > simd::float4(0.0f)));
+    EXPECT_TRUE(all(pmf4 <= simd::float4(1.0f)));
+    EXPECT_TRUE(all(max_element(ls4.intensity) > simd::float4(0.0f)));
+}
@@ -0,0 +1,313 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/macrocell_grid.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+// Mostly empty volume: a sphere with values rising towards its center
+static texture<float, 3> make_volume(int size)
+{
+    aligned_vector<float> data(size * size * size);
+
+    for (int z = 0; z < size; ++z)
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                vec3 p = (vec3(x, y, z) + 0.5f) / static_cast<float>(size) - 0.5f;
+                data[(z * size + y) * size + x] = max(0.0f, 1.0f - length(p) * 4.0f);
+            }
+        }
+    }
+
+    texture<float, 3> vol(size, size, size);
+    vol.reset(data.data());
+    vol.set_address_mode(Clamp);
+    vol.set_filter_mode(Linear);
+    return vol;
+}
+
+// Transparent below threshold, opaque (and constant) above
+static texture<vec4, 1> make_transfunc(float threshold)
+{
+    aligned_vector<vec4> data(256);
+
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        float v = (i + 0.5f) / data.size();
+        data[i] = v < threshold ? vec4(0.0f) : vec4(1.0f, 0.5f, 0.25f, 0.5f);
+    }
+
+    texture<vec4, 1> tf(data.size());
+    tf.reset(data.data());
+    tf.set_address_mode(Clamp);
+    tf.set_filter_mode(Linear);
+    return tf;
+}
+
+static float opacity(texture<float, 3> const& vol, texture<vec4, 1> const& tf, vec3 const& coord)
+{
+    return tex1D(tf, tex3D(vol, coord)).w;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test value ranges against trilinear samples inside each cell
+//
+
+TEST(MacrocellGrid, Build)
+{
+    auto vol = make_volume(30);
+
+    macrocell_grid grid;
+    grid.build(texture_ref<float, 3>(vol), 8, 4);
+
+    EXPECT_TRUE(all(grid.dims() == vector<3, int>(4)));
+
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        vec3 coord(dist(rng), dist(rng), dist(rng));
+        float value = tex3D(vol, coord);
+
+        vector<3, int> cell(coord * vec3(30.0f) / 8.0f);
+        auto const& c = grid(cell.x, cell.y, cell.z);
+
+        EXPECT_GE(value, c.value_min - 1e-6f);
+        EXPECT_LE(value, c.value_max + 1e-6f);
+    }
+
+    // Serial build yields the same grid
+    macrocell_grid serial;
+    serial.build(texture_ref<float, 3>(vol), 8, 1);
+
+    for (int z = 0; z < 4; ++z)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                EXPECT_EQ(grid(x, y, z).value_min, serial(x, y, z).value_min);
+                EXPECT_EQ(grid(x, y, z).value_max, serial(x, y, z).value_max);
+            }
+        }
+    }
+
+    // So does a build with a thread pool owned by the caller
+    thread_pool pool(4);
+
+    macrocell_grid pooled;
+    pooled.build(texture_ref<float, 3>(vol), 8, pool);
+
+    for (int z = 0; z < 4; ++z)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                EXPECT_EQ(grid(x, y, z).value_min, pooled(x, y, z).value_min);
+                EXPECT_EQ(grid(x, y, z).value_max, pooled(x, y, z).value_max);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Opacity must be conservative, incremental updates match full updates
+//
+
+TEST(MacrocellGrid, UpdateOpacity)
+{
+    auto vol = make_volume(64);
+    auto tf = make_transfunc(0.5f);
+
+    macrocell_grid grid;
+    grid.build(texture_ref<float, 3>(vol), 4);
+    grid.update_opacity(texture_ref<vec4, 1>(tf));
+
+    EXPECT_GT(grid.empty_fraction(), 0.8f);
+
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        vec3 coord(dist(rng), dist(rng), dist(rng));
+        vector<3, int> cell(coord * vec3(64.0f) / 4.0f);
+
+        if (opacity(vol, tf, coord) > 0.0f)
+        {
+            EXPECT_GT(grid(cell.x, cell.y, cell.z).opacity_max, 0.0f);
+        }
+    }
+
+    // Cells entirely above the threshold see a constant transfer function
+    bool found_constant = false;
+
+    for (int z = 0; z < 16; ++z)
+    {
+        for (int y = 0; y < 16; ++y)
+        {
+            for (int x = 0; x < 16; ++x)
+            {
+                auto const& c = grid(x, y, z);
+
+                if (c.value_min > 0.51f)
+                {
+                    EXPECT_FLOAT_EQ(c.variation, 0.0f);
+                    found_constant = true;
+                }
+            }
+        }
+    }
+
+    EXPECT_TRUE(found_constant);
+
+    // Lower threshold, only cells with values in the changed range are updated
+    auto tf2 = make_transfunc(0.25f);
+
+    macrocell_grid full = grid;
+    full.update_opacity(texture_ref<vec4, 1>(tf2));
+    grid.update_opacity(texture_ref<vec4, 1>(tf2), 0.25f - 1.0f / 256, 0.5f + 1.0f / 256);
+
+    EXPECT_LT(full.empty_fraction(), 1.0f);
+
+    for (int z = 0; z < 16; ++z)
+    {
+        for (int y = 0; y < 16; ++y)
+        {
+            for (int x = 0; x < 16; ++x)
+            {
+                EXPECT_EQ(grid(x, y, z).opacity_max, full(x, y, z).opacity_max);
+                EXPECT_EQ(grid(x, y, z).variation, full(x, y, z).variation);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Traversal visits intervals front-to-back and covers all visible samples along the ray
+//
+
+TEST(MacrocellGrid, Traverse)
+{
+    auto vol = make_volume(40);
+    auto tf = make_transfunc(0.3f);
+
+    macrocell_grid grid;
+    grid.build(texture_ref<float, 3>(vol), 8);
+    grid.update_opacity(texture_ref<vec4, 1>(tf));
+
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(-1.0f, 2.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> ray;
+        ray.ori = vec3(dist(rng), dist(rng), dist(rng));
+        ray.dir = normalize(vec3(0.5f) + vec3(dist(rng), dist(rng), dist(rng)) * 0.2f - ray.ori);
+
+        // Axis aligned rays exercise zero direction components
+        if (i % 10 == 0)
+        {
+            ray.ori = vec3(0.5f, dist(rng) * 0.3f + 0.2f, -0.5f);
+            ray.dir = vec3(0.0f, 0.0f, 1.0f);
+        }
+
+        std::vector<std::pair<float, float>> intervals;
+
+        traverse_macrocells(grid.ref(), ray, 0.0f, 10.0f, [&](float t0, float t1, macrocell const& c)
+        {
+            EXPECT_GT(c.opacity_max, 0.0f);
+            EXPECT_LT(t0, t1);
+
+            if (!intervals.empty())
+            {
+                EXPECT_LE(intervals.back().second, t0 + 1e-5f);
+            }
+
+            intervals.emplace_back(t0, t1);
+            return true;
+        });
+
+        for (float t = 0.0f; t < 10.0f; t += 0.002f)
+        {
+            vec3 coord = ray.ori + ray.dir * t;
+
+            if (any(coord < vec3(0.0f)) || any(coord > vec3(1.0f)))
+            {
+                continue;
+            }
+
+            if (opacity(vol, tf, coord) > 0.0f)
+            {
+                bool covered = false;
+
+                for (auto const& iv : intervals)
+                {
+                    covered |= t >= iv.first - 1e-4f && t <= iv.second + 1e-4f;
+                }
+
+                EXPECT_TRUE(covered);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Traversal stops when func returns false
+//
+
+TEST(MacrocellGrid, EarlyTermination)
+{
+    auto vol = make_volume(32);
+    auto tf = make_transfunc(0.0f);
+
+    macrocell_grid grid;
+    grid.build(texture_ref<float, 3>(vol), 4);
+    grid.update_opacity(texture_ref<vec4, 1>(tf));
+
+    EXPECT_FLOAT_EQ(grid.empty_fraction(), 0.0f);
+
+    basic_ray<float> ray;
+    ray.ori = vec3(0.5f, 0.5f, -1.0f);
+    ray.dir = vec3(0.0f, 0.0f, 1.0f);
+
+    int num_cells = 0;
+    traverse_macrocells(grid.ref(), ray, 0.0f, 10.0f, [&](float, float, macrocell const&)
+    {
+        return ++num_cells < 3;
+    });
+
+    EXPECT_EQ(num_cells, 3);
+
+    num_cells = 0;
+    traverse_macrocells(grid.ref(), ray, 0.0f, 10.0f, [&](float, float, macrocell const&)
+    {
+        ++num_cells;
+        return true;
+    });
+
+    EXPECT_EQ(num_cells, 8);
+}
@@ -69,6 +69,37 @@ TEST(Morton, Encode3D)
     EXPECT_EQ(z, 7);
 }
 
+TEST(Morton, Encode3D64)
+{
+    unsigned long long z;
+
+    z = morton_encode3D_64(0, 0, 0);
+    EXPECT_EQ(z, 0ULL);
+    z = morton_encode3D_64(1, 0, 0);
+    EXPECT_EQ(z, 1ULL);
+    z = morton_encode3D_64(0, 1, 0);
+    EXPECT_EQ(z, 2ULL);
+    z = morton_encode3D_64(0, 0, 1);
+    EXPECT_EQ(z, 4ULL);
+    z = morton_encode3D_64(1, 1, 1);
+    EXPECT_EQ(z, 7ULL);
+
+    // Same as the 32-bit version for 10-bit coordinates
+    for (unsigned i = 0; i < 1024; i += 7)
+    {
+        z = morton_encode3D_64(i, 1023 - i, i / 2);
+        EXPECT_EQ(z, static_cast<unsigned long long>(morton_encode3D(i, 1023 - i, i / 2)));
+    }
+
+    // Highest bits
+    z = morton_encode3D_64(1 << 20, 0, 0);
+    EXPECT_EQ(z, 1ULL << 60);
+    z = morton_encode3D_64(0, 0, 1 << 20);
+    EXPECT_EQ(z, 1ULL << 62);
+    z = morton_encode3D_64(0x1FFFFF, 0x1FFFFF, 0x1FFFFF);
+    EXPECT_EQ(z, 0x7FFFFFFFFFFFFFFFULL);
+}
+
 TEST(Morton, Decode2D)
 {
     vec2ui p;
@@ -166,3 +197,16 @@ TEST(Morton, Decode3D)
     EXPECT_EQ(p.y, 1);
     EXPECT_EQ(p.z, 1);
 }
+
+TEST(Morton, Decode3D64)
+{
+    vec3ui p;
+
+    for (unsigned i = 0; i < (1 << 21); i += 4093)
+    {
+        p = morton_decode3D_64(morton_encode3D_64(i, (1 << 21) - 1 - i, i / 3));
+        EXPECT_EQ(p.x, i);
+        EXPECT_EQ(p.y, (1 << 21) - 1 - i);
+        EXPECT_EQ(p.z, i / 3);
+    }
+}
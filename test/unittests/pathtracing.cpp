@@ -0,0 +1,475 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cmath>
+#include <vector>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/area_light.h>
+#include <visionaray/distribution_2d.h>
+#include <visionaray/environment_light.h>
+#include <visionaray/generic_material.h>
+#include <visionaray/kernels.h>
+#include <visionaray/light_bvh.h>
+#include <visionaray/material.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+#include <visionaray/texture/texture.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Small scene with a matte floor, a mirror sphere and a spherical light
+//
+
+using material_type = generic_material<emissive<float>, matte<float>, mirror<float>>;
+
+struct scene
+{
+    aligned_vector<basic_sphere<float>> spheres;
+    aligned_vector<material_type>       materials;
+    aligned_vector<area_light<float, basic_sphere<float>>> lights;
+
+    pinhole_camera cam;
+
+    scene(int width, int height)
+    {
+        add_sphere(vec3(0.0f, -1000.0f, 0.0f), 1000.0f);
+        matte<float> floor;
+        floor.ca() = from_rgb(vec3(0.0f));
+        floor.cd() = from_rgb(vec3(0.7f, 0.7f, 0.7f));
+        floor.ka() = 0.0f;
+        floor.kd() = 1.0f;
+        materials.push_back(floor);
+
+        add_sphere(vec3(-1.0f, 1.0f, 0.0f), 1.0f);
+        mirror<float> mir;
+        mir.cr() = from_rgb(vec3(0.9f));
+        mir.kr() = 0.9f;
+        mir.ior() = spectrum<float>(0.0f);
+        mir.absorption() = spectrum<float>(0.0f);
+        materials.push_back(mir);
+
+        add_sphere(vec3(1.5f, 0.7f, 0.5f), 0.7f);
+        matte<float> ball;
+        ball.ca() = from_rgb(vec3(0.0f));
+        ball.cd() = from_rgb(vec3(0.2f, 0.4f, 0.8f));
+        ball.ka() = 0.0f;
+        ball.kd() = 1.0f;
+        materials.push_back(ball);
+
+        add_sphere(vec3(0.0f, 5.0f, 1.0f), 1.5f);
+        emissive<float> light;
+        light.ce() = from_rgb(vec3(4.0f));
+        light.ls() = 1.0f;
+        materials.push_back(light);
+
+        area_light<float, basic_sphere<float>> al(spheres.back());
+        al.set_cl(vec3(4.0f));
+        al.set_kl(1.0f);
+        lights.push_back(al);
+
+        cam.perspective(45.0f * constants::degrees_to_radians<float>(), width / static_cast<float>(height), 0.1f, 100.0f);
+        cam.look_at(vec3(0.0f, 2.0f, 8.0f), vec3(0.0f, 0.5f, 0.0f));
+        cam.set_viewport(0, 0, width, height);
+    }
+
+    void add_sphere(vec3 center, float radius)
+    {
+        basic_sphere<float> s(center, radius);
+        s.prim_id = static_cast<int>(spheres.size());
+        s.geom_id = static_cast<int>(spheres.size());
+        spheres.push_back(s);
+    }
+
+    auto kernel_params()
+        -> decltype(make_kernel_params(
+                spheres.data(),
+                spheres.data(),
+                materials.data(),
+                lights.data(),
+                lights.data(),
+                unsigned(),
+                float(),
+                vec4(),
+                vec4()
+                ))
+    {
+        return make_kernel_params(
+                spheres.data(),
+                spheres.data() + spheres.size(),
+                materials.data(),
+                lights.data(),
+                lights.data() + lights.size(),
+                6,
+                1e-3f,
+                vec4(0.0f),
+                vec4(0.5f, 0.5f, 0.5f, 1.0f)
+                );
+    }
+};
+
+template <
+    typename Sampler = pixel_sampler::jittered_blend_type,
+    typename Kernel,
+    typename Sched,
+    typename RT
+    >
+static float render_mean(Kernel kernel, Sched& sched, scene& s, RT& rt, int num_frames)
+{
+    rt.clear_color_buffer();
+
+    for (int frame = 1; frame <= num_frames; ++frame)
+    {
+        Sampler blend_params;
+        blend_params.sfactor = 1.0f / frame;
+        blend_params.dfactor = 1.0f - 1.0f / frame;
+
+        auto sparams = make_sched_params(blend_params, s.cam, rt);
+        sched.frame(kernel, sparams);
+    }
+
+    double sum = 0.0;
+
+    for (int i = 0; i < rt.width() * rt.height(); ++i)
+    {
+        vec4 c = rt.color()[i];
+        sum += (c.x + c.y + c.z) / 3.0f;
+    }
+
+    return static_cast<float>(sum / (rt.width() * rt.height()));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Compare the wavefront path tracer with the megakernel
+//
+
+TEST(Pathtracing, Wavefront)
+{
+    int width = 48;
+    int height = 32;
+
+    scene s(width, height);
+    auto kparams = s.kernel_params();
+
+    pathtracing::kernel<decltype(kparams)> mega;
+    mega.params = kparams;
+
+    pathtracing::wavefront_kernel<decltype(kparams)> wavefront;
+    wavefront.params = kparams;
+
+    tiled_sched<basic_ray<simd::float4>> sched(2);
+
+
+    // Primary hits are the same
+
+    simple_buffer_rt<PF_RGBA32F, PF_DEPTH32F> rt1;
+    rt1.resize(width, height);
+
+    simple_buffer_rt<PF_RGBA32F, PF_DEPTH32F> rt2;
+    rt2.resize(width, height);
+
+    simple::kernel<decltype(kparams)> primary;
+    primary.params = kparams;
+
+    sched.frame(primary, make_sched_params(pixel_sampler::uniform_type{}, s.cam, rt1));
+    sched.frame(wavefront, make_sched_params(pixel_sampler::uniform_type{}, s.cam, rt2));
+
+    int num_hits = 0;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        EXPECT_NEAR(rt1.depth()[i], rt2.depth()[i], 1e-5f);
+        num_hits += rt2.depth()[i] < 1.0f ? 1 : 0;
+    }
+
+    EXPECT_GT(num_hits, 0);
+    EXPECT_LT(num_hits, width * height);
+
+
+    // Converged images have the same brightness
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt3;
+    rt3.resize(width, height);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt4;
+    rt4.resize(width, height);
+
+    float mean1 = render_mean(mega, sched, s, rt3, 64);
+    float mean2 = render_mean(wavefront, sched, s, rt4, 64);
+
+    EXPECT_GT(mean1, 0.0f);
+    EXPECT_NEAR(mean1, mean2, 0.05f * mean1);
+
+    // Works with 8-wide packets as well
+    tiled_sched<basic_ray<simd::float8>> sched8(2);
+
+    float mean3 = render_mean(wavefront, sched8, s, rt4, 64);
+    EXPECT_NEAR(mean1, mean3, 0.05f * mean1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Path tracing with low-discrepancy samplers converges to the same image
+//
+
+TEST(Pathtracing, LowDiscrepancy)
+{
+    int width = 48;
+    int height = 32;
+
+    scene s(width, height);
+    auto kparams = s.kernel_params();
+
+    pathtracing::kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    tiled_sched<basic_ray<simd::float4>> sched(2);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    using pixel_sampler::ld_jittered_blend_type;
+
+    float mean1 = render_mean(kernel, sched, s, rt, 64);
+    float mean2 = render_mean<ld_jittered_blend_type<pixel_sampler::sobol_sequence>>(kernel, sched, s, rt, 64);
+    float mean3 = render_mean<ld_jittered_blend_type<pixel_sampler::halton_sequence>>(kernel, sched, s, rt, 64);
+    float mean4 = render_mean<ld_jittered_blend_type<pixel_sampler::blue_noise_sequence>>(kernel, sched, s, rt, 64);
+
+    EXPECT_GT(mean1, 0.0f);
+    EXPECT_NEAR(mean1, mean2, 0.05f * mean1);
+    EXPECT_NEAR(mean1, mean3, 0.05f * mean1);
+    EXPECT_NEAR(mean1, mean4, 0.05f * mean1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// The MIS weights of light samples and emission hits sum to one: next event estimation
+// converges to the same image as picking up emission only with BRDF samples
+//
+
+TEST(Pathtracing, MIS)
+{
+    int width = 48;
+    int height = 32;
+
+    scene s(width, height);
+    auto kparams = s.kernel_params();
+
+    pathtracing::kernel<decltype(kparams)> nee;
+    nee.params = kparams;
+
+    // No lights to sample, emissive surfaces are only found by BRDF samples
+    pathtracing::kernel<decltype(kparams)> brdf_only;
+    brdf_only.params = kparams;
+    brdf_only.params.lights.end = brdf_only.params.lights.begin;
+
+    tiled_sched<basic_ray<simd::float4>> sched(2);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    float mean1 = render_mean(nee, sched, s, rt, 64);
+    float mean2 = render_mean(brdf_only, sched, s, rt, 256);
+
+    EXPECT_GT(mean1, 0.0f);
+    EXPECT_NEAR(mean1, mean2, 0.03f * mean1);
+
+    // Same for the wavefront path tracer
+    pathtracing::wavefront_kernel<decltype(kparams)> wavefront;
+    wavefront.params = kparams;
+
+    float mean3 = render_mean(wavefront, sched, s, rt, 64);
+    EXPECT_NEAR(mean2, mean3, 0.03f * mean2);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Light selection with a light BVH converges to the same image as uniform selection
+//
+
+TEST(Pathtracing, LightBVH)
+{
+    int width = 48;
+    int height = 32;
+
+    scene s(width, height);
+
+    // Ring of small lights around the scene
+    for (int i = 0; i < 12; ++i)
+    {
+        float angle = i * constants::two_pi<float>() / 12.0f;
+        s.add_sphere(vec3(cos(angle) * 4.0f, 0.3f + (i % 3) * 0.5f, sin(angle) * 4.0f), 0.2f);
+
+        emissive<float> light;
+        light.ce() = from_rgb(vec3(2.0f + i % 4));
+        light.ls() = 1.0f;
+        s.materials.push_back(light);
+
+        area_light<float, basic_sphere<float>> al(s.spheres.back());
+        al.set_cl(vec3(2.0f + i % 4));
+        al.set_kl(1.0f);
+        s.lights.push_back(al);
+    }
+
+    auto kparams = s.kernel_params();
+
+    light_bvh bvh;
+    bvh.build(s.lights.data(), s.lights.size());
+
+    pathtracing::kernel<decltype(kparams)> uniform;
+    uniform.params = kparams;
+
+    auto bvh_params = with_light_sampler(kparams, bvh.ref());
+
+    pathtracing::kernel<decltype(bvh_params)> importance;
+    importance.params = bvh_params;
+
+    tiled_sched<basic_ray<simd::float4>> sched(2);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    float mean1 = render_mean(uniform, sched, s, rt, 64);
+    float mean2 = render_mean(importance, sched, s, rt, 64);
+
+    EXPECT_GT(mean1, 0.0f);
+    EXPECT_NEAR(mean1, mean2, 0.05f * mean1);
+
+    // Works with the wavefront path tracer as well
+    pathtracing::wavefront_kernel<decltype(bvh_params)> wavefront;
+    wavefront.params = bvh_params;
+
+    float mean3 = render_mean(wavefront, sched, s, rt, 64);
+    EXPECT_NEAR(mean1, mean3, 0.05f * mean1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Next event estimation with the environment light converges to the same image as
+// picking up the environment only with paths that exit
+//
+
+TEST(Pathtracing, EnvironmentLight)
+{
+    int width = 48;
+    int height = 32;
+
+    scene s(width, height);
+    auto kparams = s.kernel_params();
+
+    // Sky with a sun, bright enough to dominate the lighting
+    int env_width = 64;
+    int env_height = 32;
+
+    std::vector<vec4> texels(env_width * env_height);
+
+    for (int y = 0; y < env_height; ++y)
+    {
+        for (int x = 0; x < env_width; ++x)
+        {
+            bool sun = x >= 20 && x < 22 && y >= 6 && y < 8;
+            texels[y * env_width + x] = sun ? vec4(100.0f, 90.0f, 80.0f, 1.0f) : vec4(0.3f, 0.4f, 0.6f, 1.0f);
+        }
+    }
+
+    texture<vec4, 2> sky(env_width, env_height);
+    sky.set_address_mode(Wrap);
+    sky.set_filter_mode(Nearest);
+    sky.reset(texels.data());
+
+    environment_light<float, texture_ref<vec4, 2>> env;
+    env.texture() = texture_ref<vec4, 2>(sky);
+    env.scale() = from_rgb(vec3(1.0f));
+    env.set_light_to_world_transform(mat4::identity());
+
+    pathtracing::kernel<decltype(with_environment_map(kparams, env))> exiting;
+    exiting.params = with_environment_map(kparams, env);
+
+    distribution_2d dist;
+    make_environment_distribution(dist, sky);
+    env.set_distribution(dist.ref());
+
+    pathtracing::kernel<decltype(with_environment_map(kparams, env))> nee;
+    nee.params = with_environment_map(kparams, env);
+
+    tiled_sched<basic_ray<simd::float4>> sched(2);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    float mean1 = render_mean(exiting, sched, s, rt, 256);
+    float mean2 = render_mean(nee, sched, s, rt, 64);
+
+    EXPECT_GT(mean1, 0.0f);
+    EXPECT_NEAR(mean1, mean2, 0.05f * mean1);
+
+    // Works with the wavefront path tracer as well
+    pathtracing::wavefront_kernel<decltype(nee.params)> wavefront;
+    wavefront.params = nee.params;
+
+    float mean3 = render_mean(wavefront, sched, s, rt, 64);
+    EXPECT_NEAR(mean2, mean3, 0.05f * mean2);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Single rays converge to the same image as packets
+//
+
+TEST(Pathtracing, Scalar)
+{
+    int width = 48;
+    int height = 32;
+
+    scene s(width, height);
+    auto kparams = s.kernel_params();
+
+    pathtracing::kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    tiled_sched<basic_ray<simd::float4>> sched4(2);
+    tiled_sched<basic_ray<float>> sched1(2);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    float mean1 = render_mean(kernel, sched4, s, rt, 64);
+    float mean2 = render_mean(kernel, sched1, s, rt, 64);
+
+    EXPECT_GT(mean1, 0.0f);
+    EXPECT_NEAR(mean1, mean2, 0.05f * mean1);
+
+    // Environment light with importance sampling
+    vec4 texel(0.3f, 0.4f, 0.6f, 1.0f);
+
+    texture<vec4, 2> sky(1, 1);
+    sky.set_address_mode(Wrap);
+    sky.set_filter_mode(Nearest);
+    sky.reset(&texel);
+
+    distribution_2d dist;
+    make_environment_distribution(dist, sky);
+
+    environment_light<float, texture_ref<vec4, 2>> env;
+    env.texture() = texture_ref<vec4, 2>(sky);
+    env.scale() = from_rgb(vec3(1.0f));
+    env.set_light_to_world_transform(mat4::identity());
+    env.set_distribution(dist.ref());
+
+    pathtracing::kernel<decltype(with_environment_map(kparams, env))> env_kernel;
+    env_kernel.params = with_environment_map(kparams, env);
+
+    float mean3 = render_mean(env_kernel, sched4, s, rt, 64);
+    float mean4 = render_mean(env_kernel, sched1, s, rt, 64);
+
+    EXPECT_GT(mean3, 0.0f);
+    EXPECT_NEAR(mean3, mean4, 0.05f * mean3);
+}
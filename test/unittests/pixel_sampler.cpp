@@ -0,0 +1,173 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/packet_traits.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+template <typename S>
+S make_value(float const* values)
+{
+    return S(values);
+}
+
+template <>
+float make_value<float>(float const* values)
+{
+    return values[0];
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Render with the adaptive pixel sampler, left half of the image is constant,
+// right half is noisy
+//
+
+template <typename R, typename Sched>
+void test_adaptive(Sched& sched)
+{
+    using S = typename R::scalar_type;
+
+    int width = 16;
+    int height = 8;
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    std::vector<pixel_sampler::pixel_statistics> stats(width * height);
+
+    for (auto& s : stats)
+    {
+        s = {};
+    }
+
+    pixel_sampler::adaptive_type params;
+    params.stats = stats.data();
+    params.threshold = 0.05f;
+    params.min_samples = 16;
+    params.max_samples = 16;
+
+    // dummies
+    mat4 mv = mat4::identity();
+    mat4 pr = mat4::identity();
+
+    auto sparams = make_sched_params(params, mv, pr, rt);
+
+    // Noise from per-pixel engines with fixed seeds, so that the test does not depend on
+    // the generators handed out by the scheduler. Pixels are only rendered by one thread
+    // at a time
+    std::vector<std::minstd_rand> engines(width * height);
+
+    for (size_t i = 0; i < engines.size(); ++i)
+    {
+        engines[i].seed(static_cast<unsigned>(i + 1));
+    }
+
+    auto kernel = [&](R, random_generator<S>&, int x, int y) -> vector<4, S>
+    {
+        enum { W = packet_size<S>::w, H = packet_size<S>::h };
+
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+        float values[W * H];
+
+        for (int row = 0; row < H; ++row)
+        {
+            for (int col = 0; col < W; ++col)
+            {
+                int px = x + col;
+                int py = y + row;
+
+                bool noisy = px >= width / 2 && px < width && py < height;
+                values[row * W + col] = noisy ? dist(engines[py * width + px]) : 0.5f;
+            }
+        }
+
+        S value = make_value<S>(values);
+        return vector<4, S>(value, value, value, S(1.0f));
+    };
+
+    for (int frame = 0; frame < 40; ++frame)
+    {
+        sched.frame(kernel, sparams);
+    }
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            auto const& s = stats[y * width + x];
+
+            if (x < width / 2)
+            {
+                // Converged after min_samples
+                EXPECT_EQ(s.count, 16U);
+                EXPECT_FLOAT_EQ(s.mean[0], 0.5f);
+                EXPECT_FLOAT_EQ(s.m2, 0.0f);
+            }
+            else
+            {
+                // Uniform noise, std. dev. 0.29, needs about (0.29 / 0.025)^2 samples
+                EXPECT_GT(s.count, 50U);
+                EXPECT_LT(s.count, 300U);
+                EXPECT_NEAR(s.mean[0], 0.5f, 0.1f);
+
+                // Converged pixels no longer get samples
+                EXPECT_EQ(detail::adaptive_num_samples(s, params), 0U);
+            }
+
+            // Color buffer stores the mean
+            EXPECT_FLOAT_EQ(rt.color()[y * width + x].x, s.mean[0]);
+        }
+    }
+
+    // Sample budget
+    for (auto& s : stats)
+    {
+        s = {};
+    }
+
+    sparams.sample_params.max_total_samples = 8;
+
+    for (int frame = 0; frame < 4; ++frame)
+    {
+        sched.frame(kernel, sparams);
+    }
+
+    for (auto const& s : stats)
+    {
+        EXPECT_LE(s.count, 8U);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test adaptive sampling with scalar and SIMD rays
+//
+
+TEST(PixelSampler, Adaptive)
+{
+    simple_sched<basic_ray<float>> sched1;
+    test_adaptive<basic_ray<float>>(sched1);
+
+    tiled_sched<basic_ray<float>> sched2(2);
+    test_adaptive<basic_ray<float>>(sched2);
+
+    tiled_sched<basic_ray<simd::float4>> sched3(2);
+    test_adaptive<basic_ray<simd::float4>>(sched3);
+}
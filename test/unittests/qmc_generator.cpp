@@ -0,0 +1,266 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cmath>
+#include <vector>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/make_generator.h>
+#include <visionaray/qmc_generator.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+// Draw dimensions dim and dim + 1 of the first n points of a pixel's sequence
+template <typename Generator>
+static std::vector<vec2> draw_points(unsigned pixel, unsigned dim, unsigned n)
+{
+    std::vector<vec2> result(n);
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        Generator gen(pixel, 0U, i);
+        gen.set_dimension(dim);
+
+        result[i].x = gen.next();
+        result[i].y = gen.next();
+    }
+
+    return result;
+}
+
+// Check that each of the n x m elementary intervals contains exactly one point
+static bool is_stratified(std::vector<vec2> const& points, int n, int m)
+{
+    std::vector<int> counts(n * m, 0);
+
+    for (auto p : points)
+    {
+        if (p.x < 0.0f || p.x >= 1.0f || p.y < 0.0f || p.y >= 1.0f)
+        {
+            return false;
+        }
+
+        ++counts[static_cast<int>(p.y * m) * n + static_cast<int>(p.x * n)];
+    }
+
+    for (int c : counts)
+    {
+        if (c != 1)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// RMS error of estimating the integral of f over [0,1)^2 (= 1/4) with n samples
+template <typename Generator>
+static double rms_error(unsigned n)
+{
+    double sum = 0.0;
+    int num_pixels = 64;
+
+    for (int pixel = 0; pixel < num_pixels; ++pixel)
+    {
+        auto points = draw_points<Generator>(pixel, 2, n);
+
+        double estimate = 0.0;
+
+        for (auto p : points)
+        {
+            estimate += p.x * p.y;
+        }
+
+        double err = estimate / n - 0.25;
+        sum += err * err;
+    }
+
+    return std::sqrt(sum / num_pixels);
+}
+
+template <typename Generator, typename T>
+static void test_lanes()
+{
+    enum { N = simd::num_elements<T>::value };
+
+    auto pixels = detail::pixel_key(T{}, 6, 10);
+
+    Generator gen(pixels, 0U, 5U);
+
+    for (int d = 0; d < 40; ++d)
+    {
+        simd::aligned_array_t<T> arr;
+        store(arr, gen.next());
+
+        for (int i = 0; i < N; ++i)
+        {
+            auto& lane = gen.get_generator(i);
+            typename std::remove_reference<decltype(lane)>::type ref(pixels[i], 0U, 5U);
+            ref.set_dimension(d);
+            EXPECT_EQ(arr[i], ref.next());
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Points of the scrambled sequences are stratified
+//
+
+TEST(QMCGenerator, Stratification)
+{
+    for (unsigned pixel : { 0U, 1U, 4711U })
+    {
+        for (unsigned dim : { 0U, 2U, 10U, 100U })
+        {
+            // Sobol pairs are (0,2)-sequences
+            auto sobol = draw_points<sobol_generator<float>>(pixel, dim, 16);
+            EXPECT_TRUE(is_stratified(sobol, 16, 1));
+            EXPECT_TRUE(is_stratified(sobol, 1, 16));
+            EXPECT_TRUE(is_stratified(sobol, 4, 4));
+            EXPECT_TRUE(is_stratified(sobol, 8, 2));
+        }
+
+        // Halton: base 2 and 3
+        auto halton = draw_points<halton_generator<float>>(pixel, 0, 6);
+        EXPECT_TRUE(is_stratified(halton, 2, 3));
+
+        halton = draw_points<halton_generator<float>>(pixel, 0, 36);
+        EXPECT_TRUE(is_stratified(halton, 4, 9));
+    }
+
+    // Pixels are scrambled differently
+    auto p1 = draw_points<sobol_generator<float>>(1, 0, 4);
+    auto p2 = draw_points<sobol_generator<float>>(2, 0, 4);
+    EXPECT_NE(p1[0].x, p2[0].x);
+
+    auto h1 = draw_points<halton_generator<float>>(1, 0, 4);
+    auto h2 = draw_points<halton_generator<float>>(2, 0, 4);
+    EXPECT_NE(h1[0].x, h2[0].x);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Low-discrepancy sequences converge faster than random numbers
+//
+
+TEST(QMCGenerator, Convergence)
+{
+    double err_random = rms_error<random_generator<float>>(64);
+    double err_sobol  = rms_error<sobol_generator<float>>(64);
+    double err_halton = rms_error<halton_generator<float>>(64);
+    double err_blue   = rms_error<blue_noise_generator<float>>(64);
+
+    EXPECT_LT(err_sobol, 0.25 * err_random);
+    EXPECT_LT(err_halton, 0.5 * err_random);
+    EXPECT_LT(err_blue, 0.5 * err_random);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Blue noise: neighboring pixels get different offsets, each pixel converges
+//
+
+TEST(QMCGenerator, BlueNoise)
+{
+    // All pixels use the same sequence, only shifted
+    auto p1 = draw_points<blue_noise_generator<float>>(detail::pixel_key(float{}, 3, 4), 0, 16);
+    auto p2 = draw_points<blue_noise_generator<float>>(detail::pixel_key(float{}, 4, 4), 0, 16);
+
+    float shift = p2[0].x - p1[0].x;
+
+    for (size_t i = 1; i < p1.size(); ++i)
+    {
+        float s = p2[i].x - p1[i].x;
+        EXPECT_NEAR(fmod(s - shift + 2.5f, 1.0f), 0.5f, 1e-5f);
+    }
+
+    // Offsets of adjacent pixels are far apart
+    float d = std::abs(shift);
+    EXPECT_GT(std::min(d, 1.0f - d), 0.1f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// SIMD versions produce the same numbers as the scalar versions
+//
+
+TEST(QMCGenerator, SIMD)
+{
+    test_lanes<sobol_generator<simd::float4>, simd::float4>();
+    test_lanes<halton_generator<simd::float8>, simd::float8>();
+    test_lanes<blue_noise_generator<simd::float16>, simd::float16>();
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Render with the low-discrepancy pixel samplers
+//
+
+template <typename R, typename Sampler, typename Sched>
+static std::vector<vec4> render(Sched& sched, Sampler sampler)
+{
+    using S = typename R::scalar_type;
+
+    int width = 10;
+    int height = 6;
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    // dummies
+    mat4 mv = mat4::identity();
+    mat4 pr = mat4::identity();
+
+    auto sparams = make_sched_params(sampler, mv, pr, rt);
+
+    sched.frame([](R, typename detail::make_generator_impl<S, Sampler>::generator_type& gen) -> vector<4, S>
+    {
+        S u = gen.next();
+        return vector<4, S>(u, u, u, S(1.0f));
+    }, sparams);
+
+    return std::vector<vec4>(rt.color(), rt.color() + width * height);
+}
+
+TEST(QMCGenerator, PixelSampler)
+{
+    using sampler_type = pixel_sampler::ld_jittered_blend_type<pixel_sampler::sobol_sequence>;
+
+    sampler_type sampler;
+    sampler.sfactor = 1.0f;
+    sampler.dfactor = 0.0f;
+
+    simple_sched<basic_ray<float>> sched1;
+    auto img1 = render<basic_ray<float>>(sched1, sampler);
+
+    tiled_sched<basic_ray<simd::float4>> sched2(2);
+    auto img2 = render<basic_ray<simd::float4>>(sched2, sampler);
+
+    for (size_t i = 0; i < img1.size(); ++i)
+    {
+        EXPECT_GE(img1[i].x, 0.0f);
+        EXPECT_LT(img1[i].x, 1.0f);
+        EXPECT_EQ(img1[i].x, img2[i].x);
+    }
+
+    // Frames take the next points of the sequence
+    auto img3 = render<basic_ray<float>>(sched1, sampler);
+    EXPECT_NE(img1[0].x, img3[0].x);
+
+    sched1.set_frame_num(0);
+    auto img4 = render<basic_ray<float>>(sched1, sampler);
+    EXPECT_EQ(img1[0].x, img4[0].x);
+}
@@ -0,0 +1,265 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <vector>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Philox4x32-10 known-answer tests (Random123)
+//
+
+template <typename I>
+static void test_philox(array<unsigned, 4> ctr, array<unsigned, 2> key, array<unsigned, 4> expected)
+{
+    auto bits = detail::philox4x32(
+            array<I, 4>{{ I(static_cast<int>(ctr[0])), I(static_cast<int>(ctr[1])), I(static_cast<int>(ctr[2])), I(static_cast<int>(ctr[3])) }},
+            array<I, 2>{{ I(static_cast<int>(key[0])), I(static_cast<int>(key[1])) }}
+            );
+
+    for (int i = 0; i < 4; ++i)
+    {
+        simd::aligned_array_t<I> arr;
+        store(arr, bits[i]);
+
+        for (int j = 0; j < simd::num_elements<I>::value; ++j)
+        {
+            EXPECT_EQ(static_cast<unsigned>(arr[j]), expected[i]);
+        }
+    }
+}
+
+static void test_philox(array<unsigned, 4> ctr, array<unsigned, 2> key, array<unsigned, 4> expected)
+{
+    auto bits = detail::philox4x32(ctr, key);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(bits[i], expected[i]);
+    }
+
+    test_philox<simd::int4>(ctr, key, expected);
+    test_philox<simd::int8>(ctr, key, expected);
+    test_philox<simd::int16>(ctr, key, expected);
+}
+
+TEST(RandomGenerator, Philox)
+{
+    test_philox(
+            {{ 0x00000000, 0x00000000, 0x00000000, 0x00000000 }},
+            {{ 0x00000000, 0x00000000 }},
+            {{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 }}
+            );
+
+    test_philox(
+            {{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }},
+            {{ 0xffffffff, 0xffffffff }},
+            {{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd }}
+            );
+
+    test_philox(
+            {{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }},
+            {{ 0xa4093822, 0x299f31d0 }},
+            {{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }}
+            );
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// SIMD generators produce the same numbers as scalar generators with the same keys
+//
+
+template <typename T>
+static void test_lanes()
+{
+    using float_array = simd::aligned_array_t<T>;
+
+    enum { N = simd::num_elements<T>::value };
+
+    array<unsigned, N> pixels;
+
+    for (int i = 0; i < N; ++i)
+    {
+        pixels[i] = 1000 + i * 17;
+    }
+
+    random_generator<T> gen(pixels, 3U, 7U);
+
+    array<random_generator<float>, N> scalar_gens;
+
+    for (int i = 0; i < N; ++i)
+    {
+        scalar_gens[i] = random_generator<float>(pixels[i], 3U, 7U);
+    }
+
+    for (int d = 0; d < 100; ++d)
+    {
+        float_array arr;
+        store(arr, gen.next());
+
+        for (int i = 0; i < N; ++i)
+        {
+            EXPECT_EQ(arr[i], scalar_gens[i].next());
+        }
+    }
+
+    // Lane generators share the dimension with the SIMD generator
+    EXPECT_EQ(gen.get_generator(0).next(), scalar_gens[0].next());
+}
+
+TEST(RandomGenerator, Counter)
+{
+    // Same key, same sequence
+    random_generator<float> gen1(42U, 1U, 5U);
+    random_generator<float> gen2(42U, 1U, 5U);
+
+    double sum = 0.0;
+    double sum2 = 0.0;
+    int num_samples = 100000;
+
+    for (int i = 0; i < num_samples; ++i)
+    {
+        float u = gen1.next();
+        EXPECT_EQ(u, gen2.next());
+        EXPECT_GE(u, 0.0f);
+        EXPECT_LT(u, 1.0f);
+
+        sum += u;
+        sum2 += u * u;
+    }
+
+    // Mean and variance of U(0,1)
+    EXPECT_NEAR(sum / num_samples, 0.5, 0.01);
+    EXPECT_NEAR(sum2 / num_samples - (sum / num_samples) * (sum / num_samples), 1.0 / 12.0, 0.01);
+
+    // Neighboring pixels, samples and frames are uncorrelated
+    random_generator<float> base(42U, 1U, 5U);
+    random_generator<float> pixel(43U, 1U, 5U);
+    random_generator<float> sample(42U, 2U, 5U);
+    random_generator<float> frame(42U, 1U, 6U);
+
+    int num_equal = 0;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        float u = base.next();
+        num_equal += u == pixel.next() ? 1 : 0;
+        num_equal += u == sample.next() ? 1 : 0;
+        num_equal += u == frame.next() ? 1 : 0;
+    }
+
+    EXPECT_LT(num_equal, 3);
+
+    // Switching to another sample restarts the sequence of that sample
+    random_generator<float> gen3(42U, 1U, 5U);
+    gen3.next();
+    gen3.set_sample(2U);
+    random_generator<float> gen4(42U, 2U, 5U);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(gen3.next(), gen4.next());
+    }
+
+    // Seeded generators don't repeat the sequence of a pixel
+    random_generator<float> seeded(0U);
+    random_generator<float> pixel0(0U, 0U, 0U);
+    EXPECT_NE(seeded.next(), pixel0.next());
+
+    test_lanes<simd::float4>();
+    test_lanes<simd::float8>();
+    test_lanes<simd::float16>();
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Rendered images don't depend on the scheduler or the number of threads
+//
+
+template <typename R, typename Sched>
+static std::vector<vec4> render_noise(Sched& sched)
+{
+    using S = typename R::scalar_type;
+
+    int width = 37;
+    int height = 21;
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    // dummies
+    mat4 mv = mat4::identity();
+    mat4 pr = mat4::identity();
+
+    auto sparams = make_sched_params(pixel_sampler::jittered_type{}, mv, pr, rt);
+
+    sched.frame([](R, random_generator<S>& gen) -> vector<4, S>
+    {
+        S r = gen.next();
+        S g = gen.next();
+        return vector<4, S>(r, g, S(0.0f), S(1.0f));
+    }, sparams);
+
+    return std::vector<vec4>(rt.color(), rt.color() + width * height);
+}
+
+TEST(RandomGenerator, Reproducible)
+{
+    simple_sched<basic_ray<float>> sched1;
+    auto img1 = render_noise<basic_ray<float>>(sched1);
+
+    tiled_sched<basic_ray<float>> sched2(1);
+    auto img2 = render_noise<basic_ray<float>>(sched2);
+
+    tiled_sched<basic_ray<float>> sched3(4);
+    auto img3 = render_noise<basic_ray<float>>(sched3);
+
+    tiled_sched<basic_ray<simd::float4>> sched4(3);
+    auto img4 = render_noise<basic_ray<simd::float4>>(sched4);
+
+    tiled_sched<basic_ray<simd::float8>> sched5(2);
+    auto img5 = render_noise<basic_ray<simd::float8>>(sched5);
+
+    for (size_t i = 0; i < img1.size(); ++i)
+    {
+        EXPECT_EQ(img1[i].x, img2[i].x);
+        EXPECT_EQ(img1[i].y, img2[i].y);
+        EXPECT_EQ(img1[i].x, img3[i].x);
+        EXPECT_EQ(img1[i].y, img3[i].y);
+        EXPECT_EQ(img1[i].x, img4[i].x);
+        EXPECT_EQ(img1[i].y, img4[i].y);
+        EXPECT_EQ(img1[i].x, img5[i].x);
+        EXPECT_EQ(img1[i].y, img5[i].y);
+    }
+
+    // The next frame is different
+    EXPECT_EQ(sched3.frame_num(), 1U);
+    auto img6 = render_noise<basic_ray<float>>(sched3);
+
+    int num_equal = 0;
+
+    for (size_t i = 0; i < img1.size(); ++i)
+    {
+        num_equal += img1[i].x == img6[i].x ? 1 : 0;
+    }
+
+    EXPECT_LT(num_equal, 3);
+
+    // Unless rendered again with the same frame number
+    sched3.set_frame_num(0);
+    auto img7 = render_noise<basic_ray<float>>(sched3);
+
+    for (size_t i = 0; i < img1.size(); ++i)
+    {
+        EXPECT_EQ(img1[i].x, img7[i].x);
+    }
+}
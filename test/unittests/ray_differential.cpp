@@ -0,0 +1,230 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/get_surface.h>
+#include <visionaray/kernels.h>
+#include <visionaray/material.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/point_light.h>
+#include <visionaray/ray_differential.h>
+#include <visionaray/thin_lens_camera.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+static void expect_near(vec3 const& a, vec3 const& b, float eps)
+{
+    EXPECT_NEAR(a.x, b.x, eps);
+    EXPECT_NEAR(a.y, b.y, eps);
+    EXPECT_NEAR(a.z, b.z, eps);
+}
+
+static pinhole_camera make_camera(vec3 eye, vec3 center, int width, int height)
+{
+    pinhole_camera cam;
+    cam.perspective(45.0f * constants::degrees_to_radians<float>(), width / static_cast<float>(height), 0.1f, 100.0f);
+    cam.look_at(eye, center);
+    cam.set_viewport(0, 0, width, height);
+    cam.begin_frame();
+    return cam;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Camera differentials match finite differences
+//
+
+TEST(RayDifferential, PinholeCamera)
+{
+    float width = 64.0f;
+    float height = 48.0f;
+
+    auto cam = make_camera(vec3(1.0f, 2.0f, 3.0f), vec3(0.0f), int(width), int(height));
+
+    float h = 0.01f;
+
+    for (float y : { 0.0f, 10.5f, 47.0f })
+    {
+        for (float x : { 0.0f, 31.25f, 63.0f })
+        {
+            auto r = cam.primary_ray(ray{}, x, y, width, height);
+            auto rd = cam.primary_ray_differential(r, width, height);
+
+            auto rx = cam.primary_ray(ray{}, x + h, y, width, height);
+            auto ry = cam.primary_ray(ray{}, x, y + h, width, height);
+
+            expect_near(rd.ori_dx, vec3(0.0f), 1e-6f);
+            expect_near(rd.ori_dy, vec3(0.0f), 1e-6f);
+            expect_near(rd.dir_dx, (rx.dir - r.dir) / h, 1e-3f);
+            expect_near(rd.dir_dy, (ry.dir - r.dir) / h, 1e-3f);
+
+            // SIMD rays
+            basic_ray<simd::float4> r4(vector<3, simd::float4>(r.ori), vector<3, simd::float4>(r.dir));
+            auto rd4 = cam.primary_ray_differential(r4, simd::float4(width), simd::float4(height));
+
+            expect_near(simd::unpack(rd4.dir_dx)[2], rd.dir_dx, 1e-6f);
+            expect_near(simd::unpack(rd4.dir_dy)[3], rd.dir_dy, 1e-6f);
+        }
+    }
+
+    // Thin lens cameras use the pinhole differentials
+    thin_lens_camera tl;
+    tl.perspective(45.0f * constants::degrees_to_radians<float>(), width / height, 0.1f, 100.0f);
+    tl.look_at(vec3(1.0f, 2.0f, 3.0f), vec3(0.0f));
+    tl.set_lens_radius(0.0f);
+    tl.set_focal_distance(5.0f);
+    tl.begin_frame();
+
+    auto r = cam.primary_ray(ray{}, 20.0f, 30.0f, width, height);
+    expect_near(tl.primary_ray_differential(r, width, height).dir_dx, cam.primary_ray_differential(r, width, height).dir_dx, 1e-6f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Transfer to a plane and to texture coordinates
+//
+
+TEST(RayDifferential, Transfer)
+{
+    // Triangle in the plane z = -2, texture coordinates are x and y
+    basic_triangle<3, float> tri(vec3(-1.0f, -1.0f, -2.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 2.0f, 0.0f));
+    vec2 tc1(-1.0f, -1.0f);
+    vec2 tc2( 1.0f, -1.0f);
+    vec2 tc3(-1.0f,  1.0f);
+
+    vec3 n(0.0f, 0.0f, 1.0f);
+
+    ray r(vec3(0.2f, 0.1f, 0.0f), normalize(vec3(0.1f, 0.2f, -1.0f)));
+
+    ray_differential<float> rd;
+    rd.ori_dx = vec3(0.01f, 0.0f, 0.0f);
+    rd.ori_dy = vec3(0.0f, 0.0f, 0.0f);
+    rd.dir_dx = vec3(0.0f, 0.0f, 0.0f);
+    rd.dir_dy = vec3(0.0f, 0.02f, 0.0f);
+
+    // Hit distances of the ray and of the offset rays with the plane
+    auto hit = [&](vec3 o, vec3 d) { return o + d * ((-2.0f - o.z) / d.z); };
+
+    float t = (-2.0f - r.ori.z) / r.dir.z;
+
+    vec3 dpdx;
+    vec3 dpdy;
+    position_differentials(rd, r, t, n, dpdx, dpdy);
+
+    float h = 0.01f;
+    auto p = hit(r.ori, r.dir);
+    auto px = hit(r.ori + rd.ori_dx * h, r.dir + rd.dir_dx * h);
+    auto py = hit(r.ori + rd.ori_dy * h, r.dir + rd.dir_dy * h);
+
+    expect_near(dpdx, (px - p) / h, 1e-3f);
+    expect_near(dpdy, (py - p) / h, 1e-3f);
+
+    vec2 dtdx;
+    vec2 dtdy;
+    tex_coord_differentials(tri, tc1, tc2, tc3, dpdx, dpdy, dtdx, dtdy);
+
+    EXPECT_NEAR(dtdx.x, dpdx.x, 1e-5f);
+    EXPECT_NEAR(dtdx.y, dpdx.y, 1e-5f);
+    EXPECT_NEAR(dtdy.x, dpdy.x, 1e-5f);
+    EXPECT_NEAR(dtdy.y, dpdy.y, 1e-5f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Minified textures are sampled from coarser mip levels
+//
+
+TEST(RayDifferential, GetSurface)
+{
+    // Checkerboard with 1x1 texel squares, all levels > 0 are gray
+    size_t texsize = 256;
+    aligned_vector<float> data(texsize * texsize);
+
+    for (size_t y = 0; y < texsize; ++y)
+    {
+        for (size_t x = 0; x < texsize; ++x)
+        {
+            data[y * texsize + x] = (x + y) % 2 == 0 ? 0.0f : 1.0f;
+        }
+    }
+
+    texture<float, 2> tex(texsize, texsize);
+    tex.reset(data.data());
+    tex.set_address_mode(Clamp);
+    tex.set_filter_mode(Nearest);
+    tex.build_mipmaps();
+
+    aligned_vector<texture<float, 2>::ref_type> textures(1, texture<float, 2>::ref_type(tex));
+
+    // Quad [-1,1]^2 at z = 0
+    aligned_vector<basic_triangle<3, float>> triangles;
+    triangles.emplace_back(vec3(-1.0f, -1.0f, 0.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 2.0f, 0.0f));
+    triangles.emplace_back(vec3( 1.0f,  1.0f, 0.0f), vec3(-2.0f, 0.0f, 0.0f), vec3(0.0f, -2.0f, 0.0f));
+
+    for (unsigned i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i].prim_id = i;
+        triangles[i].geom_id = 0;
+    }
+
+    aligned_vector<vec3> normals(2, vec3(0.0f, 0.0f, 1.0f));
+    aligned_vector<vec2> tex_coords = {
+            vec2(0.0f, 0.0f), vec2(1.0f, 0.0f), vec2(0.0f, 1.0f),
+            vec2(1.0f, 1.0f), vec2(0.0f, 1.0f), vec2(1.0f, 0.0f)
+            };
+    aligned_vector<plastic<float>> materials(1);
+
+    auto params = make_kernel_params(
+            normals_per_face_binding{},
+            triangles.data(),
+            triangles.data() + triangles.size(),
+            normals.data(),
+            normals.data(),
+            tex_coords.data(),
+            materials.data(),
+            textures.data(),
+            static_cast<point_light<float>*>(nullptr),
+            static_cast<point_light<float>*>(nullptr)
+            );
+
+    int width = 64;
+    int height = 64;
+
+    auto surface_color = [&](pinhole_camera const& cam, bool use_differentials)
+    {
+        auto r = cam.primary_ray(ray{}, 32.3f, 31.7f, float(width), float(height));
+        auto hr = closest_hit(r, triangles.data(), triangles.data() + triangles.size());
+
+        EXPECT_TRUE(hr.hit);
+
+        if (use_differentials)
+        {
+            auto rd = cam.primary_ray_differential(r, float(width), float(height));
+            return get_surface(hr, params, r, rd).tex_color.x;
+        }
+
+        return get_surface(hr, params).tex_color.x;
+    };
+
+    // Far away, a pixel covers many texels
+    auto far = make_camera(vec3(0.0f, 0.0f, 10.0f), vec3(0.0f), width, height);
+
+    EXPECT_FLOAT_EQ(surface_color(far, true), 0.5f);
+    EXPECT_NE(surface_color(far, false), 0.5f);
+
+    // Close up, texels are magnified and level 0 is sampled
+    auto close = make_camera(vec3(0.0f, 0.0f, 0.1f), vec3(0.0f), width, height);
+
+    EXPECT_FLOAT_EQ(surface_color(close, true), surface_color(close, false));
+}
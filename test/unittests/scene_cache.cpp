@@ -0,0 +1,275 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+
+#include <common/scene_cache.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helper functions
+//
+
+enum section_id : uint64_t
+{
+    Normals  = 0,
+    Bounds   = 1,
+    BVH      = 100, // + 2
+    Textures = 200  // + 1
+};
+
+static aligned_vector<basic_triangle<3, float>> make_triangles(size_t count)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> ext(-0.1f, 0.1f);
+
+    aligned_vector<basic_triangle<3, float>> triangles(count);
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i] = basic_triangle<3, float>(
+                vec3(pos(rng), pos(rng), pos(rng)),
+                vec3(ext(rng), ext(rng), ext(rng)),
+                vec3(ext(rng), ext(rng), ext(rng))
+                );
+        triangles[i].prim_id = static_cast<unsigned>(i);
+    }
+
+    return triangles;
+}
+
+static texture<vector<4, unorm<8>>, 2> make_texture(size_t width, size_t height, tex_address_mode mode)
+{
+    std::vector<vector<4, unorm<8>>> texels(width * height);
+
+    for (size_t i = 0; i < texels.size(); ++i)
+    {
+        texels[i] = vector<4, unorm<8>>(
+                (i % 7) / 7.0f,
+                (i % 5) / 5.0f,
+                (i % 3) / 3.0f,
+                1.0f
+                );
+    }
+
+    texture<vector<4, unorm<8>>, 2> tex(width, height);
+    tex.reset(texels.data());
+    tex.set_address_mode(mode);
+    tex.set_filter_mode(Nearest);
+    tex.set_color_space(sRGB);
+    return tex;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Data read from the mapped cache matches the data that was written
+//
+
+TEST(SceneCache, RoundTrip)
+{
+    auto triangles = make_triangles(2000);
+
+    binned_sah_builder builder;
+    auto tree = builder.build(index_bvh<basic_triangle<3, float>>{}, triangles.data(), triangles.size());
+
+    aligned_vector<vec3> normals(triangles.size());
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        normals[i] = normalize(cross(triangles[i].e1, triangles[i].e2));
+    }
+
+    aabb bounds = tree.node(0).get_bounds();
+
+    auto tex1 = make_texture(16, 8, Wrap);
+    auto tex2 = make_texture(3, 5, Clamp);
+
+    aligned_vector<texture_ref<vector<4, unorm<8>>, 2>> textures;
+    textures.emplace_back(tex1);
+    textures.emplace_back(tex2);
+    textures.emplace_back(tex1); // shared texels
+    textures.emplace_back(texture_ref<vector<4, unorm<8>>, 2>(0, 0));
+    textures.back().reset(nullptr);
+
+    std::string filename = "scene_cache_test.vsnc";
+    uint64_t key = 0x1234;
+
+    scene_cache_writer writer;
+    writer.append(Normals, normals);
+    writer.append(Bounds, &bounds, 1);
+    add_bvh(writer, BVH, tree);
+    add_textures(writer, Textures, textures.data(), textures.size());
+
+    ASSERT_TRUE(writer.write(filename, key));
+
+    scene_cache cache;
+    ASSERT_TRUE(cache.open(filename, key));
+
+    // Sections
+    auto cached_normals = cache.get<vec3>(Normals);
+    ASSERT_EQ(cached_normals.size(), normals.size());
+
+    for (size_t i = 0; i < normals.size(); ++i)
+    {
+        EXPECT_EQ(cached_normals[i], normals[i]);
+    }
+
+    auto cached_bounds = cache.get<aabb>(Bounds);
+    ASSERT_EQ(cached_bounds.size(), size_t(1));
+    EXPECT_EQ(cached_bounds[0].min, bounds.min);
+    EXPECT_EQ(cached_bounds[0].max, bounds.max);
+
+    // Missing sections and wrong types
+    EXPECT_FALSE(cache.has(42));
+    EXPECT_TRUE(cache.get<vec3>(42).empty());
+    EXPECT_TRUE(cache.get<vec2>(Normals).empty());
+
+    // Section data is aligned
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(cached_normals.data()) % 64, uintptr_t(0));
+
+    // BVH
+    auto ref = get_index_bvh_ref<basic_triangle<3, float>>(cache, BVH);
+    ASSERT_EQ(ref.num_primitives(), tree.num_primitives());
+    ASSERT_EQ(ref.num_nodes(), tree.num_nodes());
+    ASSERT_EQ(ref.num_indices(), tree.num_indices());
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(
+                vec3(dist(rng), dist(rng), dist(rng)),
+                normalize(vec3(dist(rng), dist(rng), dist(rng)))
+                );
+
+        auto hr1 = intersect(r, tree);
+        auto hr2 = intersect(r, ref);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_EQ(hr2.prim_id, hr1.prim_id);
+            EXPECT_FLOAT_EQ(hr2.t, hr1.t);
+        }
+    }
+
+    // Textures
+    auto cached_textures = get_textures<vector<4, unorm<8>>>(cache, Textures);
+    ASSERT_EQ(cached_textures.size(), textures.size());
+
+    // Shared texels are stored once
+    using texel_type = vector<4, unorm<8>>;
+    EXPECT_EQ(cache.get<texel_type>(Textures + 1).size(), size_t(16 * 8 + 3 * 5));
+    EXPECT_EQ(cached_textures[0].data(), cached_textures[2].data());
+    EXPECT_FALSE(cached_textures[3]);
+
+    for (size_t t = 0; t < 3; ++t)
+    {
+        auto const& tex = textures[t];
+        auto const& cached = cached_textures[t];
+
+        ASSERT_EQ(cached.width(), tex.width());
+        ASSERT_EQ(cached.height(), tex.height());
+        EXPECT_EQ(cached.get_address_mode(0), tex.get_address_mode(0));
+        EXPECT_EQ(cached.get_address_mode(1), tex.get_address_mode(1));
+        EXPECT_EQ(cached.get_filter_mode(), tex.get_filter_mode());
+        EXPECT_EQ(cached.get_color_space(), sRGB);
+
+        for (size_t i = 0; i < tex.width() * tex.height(); ++i)
+        {
+            EXPECT_EQ(cached.data()[i], tex.data()[i]);
+        }
+
+        vec2 coord(0.3f, 1.7f);
+        EXPECT_EQ(vec4(tex2D(cached, coord)), vec4(tex2D(tex, coord)));
+    }
+
+    cache.close();
+    std::remove(filename.c_str());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Caches that do not match are rejected
+//
+
+TEST(SceneCache, Reject)
+{
+    std::string filename = "scene_cache_test_reject.vsnc";
+
+    std::vector<float> data(100, 1.0f);
+
+    scene_cache_writer writer;
+    writer.append(0, data);
+    ASSERT_TRUE(writer.write(filename, 7));
+
+    scene_cache cache;
+
+    // Missing file
+    EXPECT_FALSE(cache.open("does_not_exist.vsnc", 7));
+
+    // Other key
+    EXPECT_FALSE(cache.open(filename, 8));
+    EXPECT_FALSE(cache.good());
+
+    ASSERT_TRUE(cache.open(filename, 7));
+    EXPECT_EQ(cache.get<float>(0).size(), data.size());
+    cache.close();
+
+    std::vector<char> bytes;
+
+    {
+        std::ifstream file(filename, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    auto write_bytes = [&](std::vector<char> const& b)
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file.write(b.data(), static_cast<std::streamsize>(b.size()));
+    };
+
+    // Other version
+    auto other_version = bytes;
+    other_version[8] = static_cast<char>(scene_cache_version + 1);
+    write_bytes(other_version);
+    EXPECT_FALSE(cache.open(filename, 7));
+
+    // Truncated section data
+    auto truncated = bytes;
+    truncated.resize(bytes.size() - 4);
+    write_bytes(truncated);
+    EXPECT_FALSE(cache.open(filename, 7));
+
+    // Not a scene cache
+    auto garbage = bytes;
+    garbage[0] = 'X';
+    write_bytes(garbage);
+    EXPECT_FALSE(cache.open(filename, 7));
+
+    // Rewriting replaces the file
+    write_bytes(garbage);
+    ASSERT_TRUE(writer.write(filename, 7));
+    EXPECT_TRUE(cache.open(filename, 7));
+    cache.close();
+
+    std::remove(filename.c_str());
+}
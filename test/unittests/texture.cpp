@@ -0,0 +1,293 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+// Checkerboard with 1x1 texel squares
+static texture<float, 2> make_checkerboard(size_t width, size_t height)
+{
+    aligned_vector<float> data(width * height);
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            data[y * width + x] = (x + y) % 2 == 0 ? 0.0f : 1.0f;
+        }
+    }
+
+    texture<float, 2> tex(width, height);
+    tex.reset(data.data());
+    tex.set_address_mode(Wrap);
+    tex.set_filter_mode(Linear);
+    return tex;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test mip pyramid construction
+//
+
+TEST(Texture, BuildMipmaps)
+{
+    // Level sizes, also for non-power-of-two textures
+    texture<float, 2> tex1(5, 3);
+    aligned_vector<float> data(15, 1.0f);
+    tex1.reset(data.data());
+
+    EXPECT_EQ(tex1.num_levels(), size_t(1));
+
+    tex1.build_mipmaps();
+
+    ASSERT_EQ(tex1.num_levels(), size_t(3));
+    EXPECT_EQ(tex1.level_size(1), (vector<2, size_t>(2, 1)));
+    EXPECT_EQ(tex1.level_size(2), (vector<2, size_t>(1, 1)));
+    EXPECT_EQ(tex1.level_data(0), tex1.data());
+
+    for (size_t l = 0; l < tex1.num_levels(); ++l)
+    {
+        auto size = tex1.level_size(l);
+
+        for (size_t i = 0; i < size.x * size.y; ++i)
+        {
+            EXPECT_FLOAT_EQ(tex1.level_data(l)[i], 1.0f);
+        }
+    }
+
+    // Box filter averages texels
+    auto tex2 = make_checkerboard(8, 8);
+    tex2.build_mipmaps();
+
+    ASSERT_EQ(tex2.num_levels(), size_t(4));
+
+    for (size_t l = 1; l < tex2.num_levels(); ++l)
+    {
+        auto size = tex2.level_size(l);
+
+        for (size_t i = 0; i < size.x * size.y; ++i)
+        {
+            EXPECT_FLOAT_EQ(tex2.level_data(l)[i], 0.5f);
+        }
+    }
+
+    // References see the mip levels of the texture
+    texture<float, 2>::ref_type ref(tex2);
+
+    EXPECT_EQ(ref.num_levels(), tex2.num_levels());
+    EXPECT_EQ(ref.level_data(2), tex2.level_data(2));
+
+    // sRGB textures are averaged in linear space
+    texture<vector<4, unorm<8>>, 2> tex3(2, 2);
+    vector<4, unorm<8>> rgba[] = {
+            vector<4, unorm<8>>(0.0f, 0.0f, 0.0f, 1.0f),
+            vector<4, unorm<8>>(1.0f, 1.0f, 1.0f, 1.0f),
+            vector<4, unorm<8>>(1.0f, 1.0f, 1.0f, 1.0f),
+            vector<4, unorm<8>>(0.0f, 0.0f, 0.0f, 1.0f)
+            };
+    tex3.reset(rgba);
+    tex3.set_color_space(sRGB);
+    tex3.build_mipmaps();
+
+    auto texel = vector<4, float>(tex3.level_data(1)[0]);
+    EXPECT_NEAR(texel.x, std::pow(0.5f, 1.0f / 2.2f), 1.0f / 255.0f);
+    EXPECT_FLOAT_EQ(texel.w, 1.0f);
+}
+
+TEST(Texture, BuildMipmapsParallel)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    size_t width = 600;
+    size_t height = 500;
+
+    aligned_vector<float> data(width * height);
+
+    for (auto& d : data)
+    {
+        d = dist(rng);
+    }
+
+    texture<float, 2> tex1(width, height);
+    tex1.reset(data.data());
+    tex1.build_mipmaps(1);
+
+    texture<float, 2> tex2(width, height);
+    tex2.reset(data.data());
+    tex2.build_mipmaps(4);
+
+    // Thread pool owned by the caller
+    thread_pool pool(4);
+
+    texture<float, 2> tex3(width, height);
+    tex3.reset(data.data());
+    tex3.build_mipmaps(pool);
+
+    ASSERT_EQ(tex1.num_levels(), tex2.num_levels());
+    ASSERT_EQ(tex1.num_levels(), tex3.num_levels());
+
+    for (size_t l = 1; l < tex1.num_levels(); ++l)
+    {
+        auto size = tex1.level_size(l);
+
+        for (size_t i = 0; i < size.x * size.y; ++i)
+        {
+            EXPECT_EQ(tex1.level_data(l)[i], tex2.level_data(l)[i]);
+            EXPECT_EQ(tex1.level_data(l)[i], tex3.level_data(l)[i]);
+        }
+    }
+}
+
+TEST(Texture, ResetDropsMipmaps)
+{
+    auto tex = make_checkerboard(8, 8);
+    tex.build_mipmaps();
+
+    ASSERT_EQ(tex.num_levels(), size_t(4));
+
+    texture_ref<float, 2> ref(tex);
+    EXPECT_EQ(ref.num_levels(), size_t(4));
+
+    // The pyramid is out of date after the texels changed
+    aligned_vector<float> data(64, 1.0f);
+    tex.reset(data.data());
+
+    EXPECT_EQ(tex.num_levels(), size_t(1));
+    EXPECT_FLOAT_EQ(tex2DLod(tex, vec2(0.3f, 0.55f), 2.0f), 1.0f);
+
+    ref.reset(data.data());
+    EXPECT_EQ(ref.num_levels(), size_t(1));
+
+    tex.build_mipmaps();
+    EXPECT_EQ(tex.num_levels(), size_t(4));
+    EXPECT_FLOAT_EQ(tex2DLod(tex, vec2(0.3f, 0.55f), 2.0f), 1.0f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test tex2DLod()
+//
+
+TEST(Texture, Lod)
+{
+    auto tex = make_checkerboard(8, 8);
+
+    vec2 coord(0.3f, 0.55f);
+
+    // Without mip levels, tex2DLod() samples level 0
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 2.0f), tex2D(tex, coord));
+
+    tex.build_mipmaps();
+
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 0.0f), tex2D(tex, coord));
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 1.0f), 0.5f);
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 10.0f), 0.5f);
+
+    // Trilinear filtering
+    float l0 = tex2DLod(tex, coord, 0.0f);
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 0.25f), 0.75f * l0 + 0.25f * 0.5f);
+
+    // Nearest mip level
+    tex.set_filter_mode(Nearest);
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 0.25f), tex2D(tex, coord));
+    EXPECT_FLOAT_EQ(tex2DLod(tex, coord, 0.75f), 0.5f);
+    tex.set_filter_mode(Linear);
+
+    // SIMD lanes may access different levels
+    simd::float4 lods(0.0f, 2.0f, 0.5f, 0.25f);
+    vector<2, simd::float4> coords(
+            simd::float4(0.3f, 0.1f, 0.7f, 0.9f),
+            simd::float4(0.55f, 0.2f, 0.4f, 0.8f)
+            );
+
+    simd::aligned_array_t<simd::float4> result;
+    simd::aligned_array_t<simd::float4> lod_arr;
+    simd::aligned_array_t<simd::float4> x_arr;
+    simd::aligned_array_t<simd::float4> y_arr;
+
+    store(result, tex2DLod(tex, coords, lods));
+    store(lod_arr, lods);
+    store(x_arr, coords.x);
+    store(y_arr, coords.y);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_FLOAT_EQ(result[i], tex2DLod(tex, vec2(x_arr[i], y_arr[i]), lod_arr[i]));
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test tex2DGrad()
+//
+
+TEST(Texture, Grad)
+{
+    auto tex = make_checkerboard(16, 16);
+    tex.build_mipmaps();
+
+    vec2 coord(0.3f, 0.55f);
+    float texel = 1.0f / 16.0f;
+
+    // One texel per pixel: level 0, two texels per pixel: level 1
+    EXPECT_FLOAT_EQ(tex2DGrad(tex, coord, vec2(texel, 0.0f), vec2(0.0f, texel)), tex2DLod(tex, coord, 0.0f));
+    EXPECT_FLOAT_EQ(tex2DGrad(tex, coord, vec2(2.0f * texel, 0.0f), vec2(0.0f, texel)), tex2DLod(tex, coord, 1.0f));
+
+    // Anisotropic footprint, four probes along x at level 0
+    tex.set_max_anisotropy(8.0f);
+
+    vec2 ddx(4.0f * texel, 0.0f);
+    vec2 ddy(0.0f, texel);
+
+    float expected = 0.0f;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        expected += tex2DLod(tex, coord + ddx * ((i + 0.5f) / 4.0f - 0.5f), 0.0f) / 4.0f;
+    }
+
+    EXPECT_FLOAT_EQ(tex2DGrad(tex, coord, ddx, ddy), expected);
+
+    // Probes are limited by the max. anisotropy, the level is raised instead
+    tex.set_max_anisotropy(2.0f);
+
+    expected = 0.0f;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        expected += tex2DLod(tex, coord + ddx * ((i + 0.5f) / 2.0f - 0.5f), 1.0f) / 2.0f;
+    }
+
+    EXPECT_FLOAT_EQ(tex2DGrad(tex, coord, ddx, ddy), expected);
+
+    // SIMD
+    vector<2, simd::float4> coords(simd::float4(0.3f), simd::float4(0.55f));
+    vector<2, simd::float4> ddxs(simd::float4(texel, 4.0f * texel, 0.0f, 8.0f * texel), simd::float4(0.0f));
+    vector<2, simd::float4> ddys(simd::float4(0.0f), simd::float4(texel));
+
+    simd::aligned_array_t<simd::float4> result;
+    simd::aligned_array_t<simd::float4> ddx_arr;
+
+    store(result, tex2DGrad(tex, coords, ddxs, ddys));
+    store(ddx_arr, ddxs.x);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_FLOAT_EQ(result[i], tex2DGrad(tex, coord, vec2(ddx_arr[i], 0.0f), vec2(0.0f, texel)));
+    }
+}
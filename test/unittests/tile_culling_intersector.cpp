@@ -0,0 +1,203 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <random>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/result_record.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+#include <visionaray/tile_culling_intersector.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+using triangle_type = basic_triangle<3, float>;
+using bvh_type      = index_bvh<triangle_type>;
+using bvh_ref       = bvh_type::bvh_ref;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+static aligned_vector<triangle_type> make_triangles()
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> pos(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> ext(-0.1f, 0.1f);
+
+    aligned_vector<triangle_type> triangles(2000);
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i] = triangle_type(
+                vec3(pos(rng), pos(rng), pos(rng)),
+                vec3(ext(rng), ext(rng), ext(rng)),
+                vec3(ext(rng), ext(rng), ext(rng))
+                );
+        triangles[i].prim_id = static_cast<unsigned>(i);
+    }
+
+    return triangles;
+}
+
+// Kernel that stores the primitive id and the hit distance
+struct hit_kernel
+{
+    bvh_ref const* begin;
+    bvh_ref const* end;
+
+    template <typename Intersector, typename R>
+    result_record<typename R::scalar_type> operator()(Intersector& isect, R ray) const
+    {
+        using S = typename R::scalar_type;
+
+        auto hr = closest_hit(ray, begin, end, isect);
+
+        result_record<S> result;
+        result.hit = hr.hit;
+        result.color = vector<4, S>(
+                select(hr.hit, convert_to_float(hr.prim_id), S(-1.0)),
+                select(hr.hit, hr.t, S(-1.0)),
+                S(0.0),
+                S(1.0)
+                );
+        return result;
+    }
+
+    template <typename R>
+    result_record<typename R::scalar_type> operator()(R ray) const
+    {
+        default_intersector isect;
+        return (*this)(isect, ray);
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Images rendered with and without tile culling are the same
+//
+
+TEST(TileCullingIntersector, Render)
+{
+    auto triangles = make_triangles();
+
+    binned_sah_builder builder;
+    auto tree = builder.build(bvh_type{}, triangles.data(), triangles.size());
+
+    aligned_vector<bvh_ref> refs;
+    refs.push_back(tree.ref());
+
+    int width = 100;
+    int height = 75;
+
+    pinhole_camera cam;
+    cam.perspective(45.0f * constants::degrees_to_radians<float>(), width / static_cast<float>(height), 0.1f, 100.0f);
+    cam.look_at(vec3(0.5f, 1.0f, 4.0f), vec3(0.8f, 0.0f, 0.0f));
+    cam.set_viewport(0, 0, width, height);
+
+    hit_kernel kernel{ refs.data(), refs.data() + refs.size() };
+
+    tiled_sched<basic_ray<simd::float4>> sched(2);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt1;
+    rt1.resize(width, height);
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt2;
+    rt2.resize(width, height);
+
+    default_intersector isect1;
+    sched.frame(kernel, make_sched_params(pixel_sampler::uniform_type{}, cam, rt1, isect1));
+
+    tile_culling_intersector<bvh_ref> isect2(tree.ref());
+    sched.frame(kernel, make_sched_params(pixel_sampler::uniform_type{}, cam, rt2, isect2));
+
+    int num_hits = 0;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        EXPECT_EQ(rt1.color()[i].x, rt2.color()[i].x);
+        EXPECT_EQ(rt1.color()[i].y, rt2.color()[i].y);
+
+        if (rt1.color()[i].x >= 0.0f)
+        {
+            ++num_hits;
+        }
+    }
+
+    // Some, but not all pixels see the triangles
+    EXPECT_GT(num_hits, 0);
+    EXPECT_LT(num_hits, width * height);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test culling of single tiles
+//
+
+TEST(TileCullingIntersector, CullTile)
+{
+    auto triangles = make_triangles();
+
+    binned_sah_builder builder;
+    auto tree = builder.build(bvh_type{}, triangles.data(), triangles.size());
+
+    int width = 64;
+    int height = 64;
+
+    pinhole_camera cam;
+    cam.perspective(45.0f * constants::degrees_to_radians<float>(), 1.0f, 0.1f, 100.0f);
+    cam.set_viewport(0, 0, width, height);
+
+    tile_culling_intersector<bvh_ref> isect(tree.ref());
+
+    // Camera looking away from the triangles, no subtrees remain
+    cam.look_at(vec3(0.0f, 0.0f, 4.0f), vec3(0.0f, 0.0f, 8.0f));
+    cam.begin_frame();
+    isect.cull_tile(cam, range2d<int>(0, 16, 0, 16), width, height);
+
+    EXPECT_TRUE(isect.culled());
+    EXPECT_EQ(isect.num_roots(), 0U);
+
+    // Camera looking at the triangles, subtrees are culled
+    cam.look_at(vec3(0.0f, 0.0f, 4.0f), vec3(0.0f, 0.0f, 0.0f));
+    cam.begin_frame();
+    isect.cull_tile(cam, range2d<int>(16, 32, 16, 32), width, height);
+
+    EXPECT_TRUE(isect.culled());
+    EXPECT_GT(isect.num_roots(), 0U);
+    EXPECT_LE(isect.num_roots(), unsigned(tile_culling_intersector<bvh_ref>::MaxRoots));
+
+    // Rays that don't belong to the tile (e.g. secondary rays) traverse the whole BVH
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    aligned_vector<bvh_ref> refs;
+    refs.push_back(tree.ref());
+
+    for (int i = 0; i < 100; ++i)
+    {
+        array<basic_ray<float>, 4> rays;
+
+        for (auto& r : rays)
+        {
+            r = basic_ray<float>(vec3(dist(rng), dist(rng), dist(rng)), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+        }
+
+        auto packet = simd::pack(rays);
+
+        default_intersector ignore;
+        auto hr1 = closest_hit(packet, refs.data(), refs.data() + refs.size(), ignore);
+        auto hr2 = closest_hit(packet, refs.data(), refs.data() + refs.size(), isect);
+
+        EXPECT_TRUE(all(hr1.hit == hr2.hit));
+        EXPECT_TRUE(all(!hr1.hit || (hr1.prim_id == hr2.prim_id)));
+    }
+}
@@ -0,0 +1,370 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/texture/texture.h>
+#include <visionaray/texture/texture_traits.h>
+#include <visionaray/texture/tiled_texture.h>
+
+#include <common/tiled_texture_file.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+static texture<float, 2> make_random_texture(size_t width, size_t height, tex_address_mode address_mode)
+{
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    aligned_vector<float> data(width * height);
+
+    for (auto& d : data)
+    {
+        d = dist(rng);
+    }
+
+    texture<float, 2> tex(width, height);
+    tex.reset(data.data());
+    tex.set_address_mode(address_mode);
+    tex.set_filter_mode(Linear);
+    tex.build_mipmaps();
+    return tex;
+}
+
+static std::vector<vec2> make_coords(size_t n)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-0.5f, 1.5f);
+
+    std::vector<vec2> result(n);
+
+    for (auto& c : result)
+    {
+        c = vec2(dist(rng), dist(rng));
+    }
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Lookups match ordinary textures, also across tile and texture borders
+//
+
+TEST(TiledTexture, Sample)
+{
+    static_assert(texture_dimensions<tiled_texture_ref<float>>::value == 2, "Tiled textures are 2D textures");
+
+    auto coords = make_coords(2000);
+
+    for (auto address_mode : { Wrap, Clamp })
+    {
+        // Not a multiple of the tile size
+        auto tex = make_random_texture(200, 150, address_mode);
+
+        tiled_texture<float> tiled(std::make_shared<texture_tile_loader<float>>(tex, 32), 1024 * 1024);
+
+        EXPECT_EQ(tiled.width(), size_t(200));
+        EXPECT_EQ(tiled.height(), size_t(150));
+        EXPECT_EQ(tiled.num_levels(), tex.num_levels());
+
+        for (auto filter_mode : { Nearest, Linear, CardinalSpline })
+        {
+            tex.set_filter_mode(filter_mode);
+            tiled.set_filter_mode(filter_mode);
+
+            for (auto const& c : coords)
+            {
+                EXPECT_NEAR(tex2D(tiled, c), tex2D(tex, c), 1e-4f);
+            }
+        }
+
+        tex.set_filter_mode(Linear);
+        tiled.set_filter_mode(Linear);
+
+        for (auto const& c : coords)
+        {
+            EXPECT_NEAR(tex2DLod(tiled, c, 2.3f), tex2DLod(tex, c, 2.3f), 1e-4f);
+            EXPECT_NEAR(tex2DGrad(tiled, c, vec2(0.05f, 0.0f), vec2(0.0f, 0.01f)),
+                        tex2DGrad(tex, c, vec2(0.05f, 0.0f), vec2(0.0f, 0.01f)), 1e-4f);
+        }
+    }
+
+    // RGBA8, sRGB
+    texture<vector<4, unorm<8>>, 2> tex(70, 40);
+    aligned_vector<vector<4, unorm<8>>> data(70 * 40);
+
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = vector<4, unorm<8>>((i % 7) / 7.0f, (i % 13) / 13.0f, (i % 17) / 17.0f, 1.0f);
+    }
+
+    tex.reset(data.data());
+    tex.set_address_mode(Wrap);
+    tex.set_filter_mode(Linear);
+    tex.set_color_space(sRGB);
+
+    tiled_texture<vector<4, unorm<8>>> tiled(std::make_shared<texture_tile_loader<vector<4, unorm<8>>>>(tex, 16), 1024 * 1024);
+    tiled.set_color_space(sRGB);
+
+    for (auto const& c : coords)
+    {
+        auto expected = tex2D(tex, c);
+        auto actual = tex2D(tiled, c);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            EXPECT_NEAR(actual[i], expected[i], 1.0f / 255.0f);
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Resident memory is bounded by the cache size
+//
+
+TEST(TiledTexture, Eviction)
+{
+    auto tex = make_random_texture(256, 256, Wrap);
+
+    auto loader = std::make_shared<texture_tile_loader<float>>(tex, 32);
+    size_t tile_bytes = loader->layout().texels_per_tile() * sizeof(float);
+
+    tiled_texture<float> tiled(loader, 4 * tile_bytes);
+
+    EXPECT_EQ(tiled.cache_size_in_bytes(), 4 * tile_bytes);
+
+    // Same tile twice: loaded once
+    tex2D(tiled, vec2(0.01f, 0.01f));
+    tex2D(tiled, vec2(0.02f, 0.02f));
+    EXPECT_EQ(tiled.num_tile_loads(), size_t(1));
+
+    // Coarse levels fit into a single tile
+    tex2DLod(tiled, vec2(0.5f), 4.0f);
+    EXPECT_EQ(tiled.num_tile_loads(), size_t(2));
+
+    // Touching all 64 tiles of level 0 evicts
+    for (auto const& c : make_coords(5000))
+    {
+        EXPECT_NEAR(tex2D(tiled, c), tex2D(tex, c), 1e-4f);
+    }
+
+    EXPECT_GT(tiled.num_tile_loads(), size_t(64));
+    EXPECT_EQ(tiled.cache_size_in_bytes(), 4 * tile_bytes);
+
+    tiled.clear_cache();
+
+    size_t loads = tiled.num_tile_loads();
+    tex2D(tiled, vec2(0.01f, 0.01f));
+    EXPECT_EQ(tiled.num_tile_loads(), loads + 1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Concurrent lookups while tiles are evicted
+//
+
+TEST(TiledTexture, Concurrent)
+{
+    auto tex = make_random_texture(256, 256, Wrap);
+
+    auto loader = std::make_shared<texture_tile_loader<float>>(tex, 16);
+    size_t tile_bytes = loader->layout().texels_per_tile() * sizeof(float);
+
+    tiled_texture<float> tiled(loader, 8 * tile_bytes);
+    tiled_texture<float>::ref_type ref(tiled);
+
+    auto coords = make_coords(20000);
+
+    std::vector<float> expected(coords.size());
+
+    for (size_t i = 0; i < coords.size(); ++i)
+    {
+        expected[i] = tex2D(tex, coords[i]);
+    }
+
+    unsigned num_threads = 4;
+    std::vector<size_t> errors(num_threads, 0);
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t i = t; i < coords.size(); i += num_threads)
+            {
+                if (std::abs(tex2D(ref, coords[i]) - expected[i]) > 1e-4f)
+                {
+                    ++errors[t];
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    for (auto e : errors)
+    {
+        EXPECT_EQ(e, size_t(0));
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Misses on different tiles load in parallel
+//
+
+TEST(TiledTexture, ParallelLoads)
+{
+    struct slow_loader : texture_tile_loader<float>
+    {
+        using texture_tile_loader<float>::texture_tile_loader;
+
+        std::atomic<int> in_flight{0};
+        std::atomic<int> max_in_flight{0};
+
+        void load_tile(size_t level, size_t tile_x, size_t tile_y, float* dst)
+        {
+            int n = ++in_flight;
+
+            int m = max_in_flight.load();
+            while (n > m && !max_in_flight.compare_exchange_weak(m, n))
+            {
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            texture_tile_loader<float>::load_tile(level, tile_x, tile_y, dst);
+
+            --in_flight;
+        }
+    };
+
+    auto tex = make_random_texture(256, 256, Wrap);
+
+    auto loader = std::make_shared<slow_loader>(tex, 64);
+    tiled_texture<float> tiled(loader, 1024 * 1024);
+    tiled_texture<float>::ref_type ref(tiled);
+
+    // One tile per thread
+    std::vector<vec2> coords = { vec2(0.1f, 0.1f), vec2(0.6f, 0.1f), vec2(0.1f, 0.6f), vec2(0.6f, 0.6f) };
+    std::vector<float> values(coords.size());
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < coords.size(); ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            values[t] = tex2D(ref, coords[t]);
+        });
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    for (size_t t = 0; t < coords.size(); ++t)
+    {
+        EXPECT_NEAR(values[t], tex2D(tex, coords[t]), 1e-4f);
+    }
+
+    EXPECT_EQ(tiled.num_tile_loads(), coords.size());
+    EXPECT_GT(loader->max_in_flight.load(), 1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Tiles are read from tiled texture files
+//
+
+TEST(TiledTexture, File)
+{
+    auto tex = make_random_texture(100, 60, Clamp);
+
+    std::string filename = "tiled_texture_test.vtt";
+
+    ASSERT_TRUE(write_tiled_texture_file(filename, texture_ref<float, 2>(tex), 32));
+
+    // Wrong texel type
+    tiled_texture_file_loader<vec4> wrong;
+    EXPECT_FALSE(wrong.open(filename));
+
+    auto loader = std::make_shared<tiled_texture_file_loader<float>>();
+    ASSERT_TRUE(loader->open(filename));
+
+    EXPECT_EQ(loader->layout().width, size_t(100));
+    EXPECT_EQ(loader->layout().num_levels, tex.num_levels());
+    EXPECT_EQ(loader->layout().address_mode[1], Clamp);
+
+    tiled_texture<float> tiled(loader, 1024 * 1024);
+
+    for (auto const& c : make_coords(1000))
+    {
+        EXPECT_NEAR(tex2D(tiled, c), tex2D(tex, c), 1e-4f);
+        EXPECT_NEAR(tex2DLod(tiled, c, 1.5f), tex2DLod(tex, c, 1.5f), 1e-4f);
+    }
+
+    std::remove(filename.c_str());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Tiles that cannot be read throw and are not cached
+//
+
+TEST(TiledTexture, FileError)
+{
+    auto tex = make_random_texture(100, 60, Clamp);
+
+    std::string filename = "tiled_texture_error_test.vtt";
+
+    ASSERT_TRUE(write_tiled_texture_file(filename, texture_ref<float, 2>(tex), 32));
+
+    // Keep the header and the first tile
+    {
+        std::ifstream in(filename, std::ios::binary);
+        std::vector<char> data(detail::tiled_texture_header_size + 36 * 36 * sizeof(float));
+        in.read(data.data(), data.size());
+        in.close();
+
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    }
+
+    auto loader = std::make_shared<tiled_texture_file_loader<float>>();
+    ASSERT_TRUE(loader->open(filename));
+
+    tiled_texture<float> tiled(loader, 1024 * 1024);
+
+    EXPECT_NEAR(tex2D(tiled, vec2(0.1f, 0.1f)), tex2D(tex, vec2(0.1f, 0.1f)), 1e-4f);
+
+    EXPECT_THROW(tex2D(tiled, vec2(0.9f, 0.9f)), std::runtime_error);
+    EXPECT_THROW(tex2D(tiled, vec2(0.9f, 0.9f)), std::runtime_error);
+    EXPECT_EQ(tiled.num_tile_loads(), size_t(1));
+
+    // Resident tiles are still valid
+    EXPECT_NEAR(tex2D(tiled, vec2(0.2f, 0.2f)), tex2D(tex, vec2(0.2f, 0.2f)), 1e-4f);
+
+    std::remove(filename.c_str());
+}
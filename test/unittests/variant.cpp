@@ -92,6 +92,10 @@ TEST(VariantTest, General)
 
     variant<int, double> var_id1 = double(0.0);
     EXPECT_TRUE( apply_visitor( is_double_visitor(), var_id1 ) );
+    EXPECT_EQ( var_id1.which(), 2U );
+
+    var_id1 = 4711;
+    EXPECT_EQ( var_id1.which(), 1U );
 
 
     // struct with some members